@@ -45,6 +45,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include <limits>
 #include <algorithm>
+#include <vector>
 
 #include <glm/gtx/norm.hpp>
 
@@ -69,21 +70,27 @@ const float PathFinder::HEIGHT_DEFAULT = 0.0f;
 class PathFinder::Node {
 	
 	NodeId id;
-	const Node * parent;
+	NodeIndex parent;
 	
 	float cost;
 	float distance;
 	
+	size_t heapIndex;
+	
 public:
 	
-	Node(long _id, const Node * _parent, float _distance, float _remaining)
-		: id(_id), parent(_parent), cost(_distance + _remaining), distance(_distance) { }
+	static const NodeIndex None;
+	static const size_t Closed;
+	
+	Node(NodeId _id, NodeIndex _parent, float _distance, float _remaining)
+		: id(_id), parent(_parent), cost(_distance + _remaining), distance(_distance),
+		  heapIndex(Closed) { }
 	
 	inline NodeId getId() const {
 		return id;
 	}
 	
-	inline const Node * getParent() const {
+	inline NodeIndex getParent() const {
 		return parent;
 	}
 	
@@ -95,104 +102,384 @@ public:
 		return distance;
 	}
 	
-	inline void newParent(const Node * _parent, float _distance) {
+	inline bool isClosed() const {
+		return heapIndex == Closed;
+	}
+	
+	inline void newParent(NodeIndex _parent, float _distance) {
 		parent = _parent;
 		cost = cost - distance + _distance;
 		distance = _distance;
 	}
 	
+	friend class SearchState;
+	
 };
 
-class PathFinder::OpenNodeList {
+const PathFinder::NodeIndex PathFinder::Node::None = NodeIndex(-1);
+const size_t PathFinder::Node::Closed = size_t(-1);
+
+/*!
+ * Open and closed node sets for the A* searches.
+ *
+ * Nodes are allocated from an arena that keeps its memory between searches.
+ * The open nodes are kept in a binary min-heap ordered by cost. Each anchor
+ * remembers the node created for it and the search generation in which that
+ * node was created, so starting a new search does not need to clear anything.
+ */
+class PathFinder::SearchState {
+	
+	typedef std::vector<Node> NodeArena;
+	NodeArena nodes;
+	
+	typedef std::vector<NodeIndex> NodeHeap;
+	NodeHeap open;
+	
+	//! Search generation in which anchorNodes[i] was set for each anchor
+	std::vector<u32> anchorGenerations;
+	std::vector<NodeIndex> anchorNodes;
+	u32 generation;
+	
+	inline bool less(NodeIndex a, NodeIndex b) const {
+		return nodes[a].getCost() < nodes[b].getCost();
+	}
+	
+	inline void place(size_t pos, NodeIndex node) {
+		open[pos] = node;
+		nodes[node].heapIndex = pos;
+	}
 	
-	typedef std::vector<Node*> NodeList;
-	NodeList nodes;
+	void siftUp(size_t pos) {
+		NodeIndex node = open[pos];
+		while(pos > 0) {
+			size_t parent = (pos - 1) / 2;
+			if(!less(node, open[parent])) {
+				break;
+			}
+			place(pos, open[parent]);
+			pos = parent;
+		}
+		place(pos, node);
+	}
+	
+	void siftDown(size_t pos) {
+		NodeIndex node = open[pos];
+		size_t count = open.size();
+		while(true) {
+			size_t child = 2 * pos + 1;
+			if(child >= count) {
+				break;
+			}
+			if(child + 1 < count && less(open[child + 1], open[child])) {
+				child++;
+			}
+			if(!less(open[child], node)) {
+				break;
+			}
+			place(pos, open[child]);
+			pos = child;
+		}
+		place(pos, node);
+	}
+	
+	NodeIndex create(NodeId id, NodeIndex parent, float distance, float remaining) {
+		NodeIndex index = nodes.size();
+		nodes.push_back(Node(id, parent, distance, remaining));
+		anchorGenerations[id] = generation;
+		anchorNodes[id] = index;
+		return index;
+	}
 	
 public:
 	
-	~OpenNodeList() {
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			delete *i;
+	explicit SearchState(size_t mapSize)
+		: anchorGenerations(mapSize, 0), anchorNodes(mapSize, Node::None), generation(0) { }
+	
+	/*!
+	 * Forget all nodes from the previous search and create a closed start node.
+	 * \return the index of the start node
+	 */
+	NodeIndex start(NodeId id) {
+		
+		nodes.clear();
+		open.clear();
+		
+		if(++generation == 0) {
+			// Generation counter wrapped around - stamps from old searches could match again
+			std::fill(anchorGenerations.begin(), anchorGenerations.end(), 0);
+			generation = 1;
 		}
+		
+		return create(id, Node::None, 0.0f, 0.0f);
+	}
+	
+	const Node & operator[](NodeIndex index) const {
+		return nodes[index];
+	}
+	
+	bool isClosed(NodeId id) const {
+		return anchorGenerations[id] == generation && nodes[anchorNodes[id]].isClosed();
 	}
 	
 	/*!
-	 * If a node with the same ID exists, update it.
+	 * If an open node with the same ID exists, update it.
 	 * Otherwise add a new node.
 	 * Assumes that remaining never changes for the same node id.
 	 */
-	inline void add(NodeId id, const Node * parent, float distance, float remaining) {
+	void add(NodeId id, NodeIndex parent, float distance, float remaining) {
 		
-		// Check if node is already in open list.
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			if((*i)->getId() == id) {
-				if((*i)->getDistance() > distance) {
-					(*i)->newParent(parent, distance);
-				}
-				return;
+		if(anchorGenerations[id] == generation) {
+			Node & node = nodes[anchorNodes[id]];
+			if(!node.isClosed() && node.getDistance() > distance) {
+				node.newParent(parent, distance);
+				siftUp(node.heapIndex);
 			}
+			return;
 		}
 		
-		nodes.push_back(new Node(id, parent, distance, remaining));
+		NodeIndex index = create(id, parent, distance, remaining);
+		open.push_back(index);
+		siftUp(open.size() - 1);
 	}
 	
-	Node * extractBestNode() {
-		// TODO use a better datastructure
+	/*!
+	 * Remove the best node (lowest cost) from the open list and close it.
+	 * \return the node or Node::None if the open list is empty
+	 */
+	NodeIndex extractBestNode() {
 		
-		if(nodes.empty()) {
-			return NULL;
+		if(open.empty()) {
+			return Node::None;
 		}
 		
-		NodeList::iterator best = nodes.begin();
-		float cost = std::numeric_limits<float>::max();
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			if((*i)->getCost() < cost) {
-				cost = (*i)->getCost();
-				best = i;
-			}
-		}
+		NodeIndex best = open.front();
+		nodes[best].heapIndex = Node::Closed;
 		
-		Node * node = *best;
-		nodes.erase(best);
+		NodeIndex last = open.back();
+		open.pop_back();
+		if(!open.empty()) {
+			place(0, last);
+			siftDown(0);
+		}
 		
-		return node;
+		return best;
 	}
 	
 };
 
-class PathFinder::ClosedNodeList {
+/*!
+ * Uniform grid over the horizontal (x, z) plane of the map, see createIndex().
+ *
+ * Each cell lists the anchors with links that lie in it, and the lights whose
+ * range (fallend) overlaps it. Lights are indexed by slot, so lights that are
+ * switched on or off later are still handled, but their position and range
+ * are assumed not to change.
+ */
+class PathFinder::SpatialIndex {
+	
+	static const float MIN_CELL_SIZE;
+	static const size_t MAX_CELLS_PER_AXIS = 256;
+	
+	Vec2f origin;
+	float cellSize;
+	size_t width;
+	size_t height;
+	
+	//! For each cell, the range of entries in anchors / lights, indexed by cell and cell + 1
+	std::vector<size_t> anchorCells;
+	std::vector<NodeId> anchors;
+	std::vector<size_t> lightCells;
+	std::vector<size_t> lights;
+	std::vector<size_t> allLights; //!< Used for positions outside of the grid
+	
+	size_t getCellX(float x) const {
+		float cell = std::floor((x - origin.x) / cellSize);
+		return size_t(std::min(std::max(cell, 0.f), float(width - 1)));
+	}
 	
-	typedef std::vector<Node*> NodeList;
-	NodeList nodes;
+	size_t getCellY(float z) const {
+		float cell = std::floor((z - origin.y) / cellSize);
+		return size_t(std::min(std::max(cell, 0.f), float(height - 1)));
+	}
 	
-public:
+	bool contains(const Vec3f & pos) const {
+		return pos.x >= origin.x && pos.x < origin.x + width * cellSize
+		       && pos.z >= origin.y && pos.z < origin.y + height * cellSize;
+	}
 	
-	~ClosedNodeList() {
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			delete *i;
+	/*!
+	 * Store the items for each cell contiguously.
+	 * \param cells Receives the offset of the first item for each cell, plus the total
+	 * \param items Receives the items sorted by cell and by index within each cell
+	 * \param entries Pairs of cell and item
+	 */
+	template <class T>
+	void build(std::vector<size_t> & cells, std::vector<T> & items,
+	           const std::vector<std::pair<size_t, T> > & entries) {
+		
+		cells.assign(width * height + 1, 0);
+		for(size_t i = 0; i < entries.size(); i++) {
+			cells[entries[i].first + 1]++;
+		}
+		for(size_t i = 1; i < cells.size(); i++) {
+			cells[i] += cells[i - 1];
+		}
+		
+		std::vector<size_t> next(cells.begin(), cells.end() - 1);
+		items.resize(entries.size());
+		for(size_t i = 0; i < entries.size(); i++) {
+			items[next[entries[i].first]++] = entries[i].second;
 		}
 	}
 	
-	void add(Node * node) {
-		nodes.push_back(node);
+public:
+	
+	SpatialIndex(size_t map_s, const ANCHOR_DATA * map_d,
+	             size_t slight_c, const EERIE_LIGHT * const * slight_l)
+		: origin(0.f), cellSize(MIN_CELL_SIZE), width(1), height(1) {
+		
+		if(map_s > 0) {
+			
+			Vec2f min(std::numeric_limits<float>::max());
+			Vec2f max(-std::numeric_limits<float>::max());
+			for(size_t i = 0; i < map_s; i++) {
+				min = glm::min(min, Vec2f(map_d[i].pos.x, map_d[i].pos.z));
+				max = glm::max(max, Vec2f(map_d[i].pos.x, map_d[i].pos.z));
+			}
+			
+			Vec2f size = max - min;
+			cellSize = std::max(MIN_CELL_SIZE, std::max(size.x, size.y) / MAX_CELLS_PER_AXIS);
+			origin = min;
+			width = size_t(size.x / cellSize) + 1;
+			height = size_t(size.y / cellSize) + 1;
+		}
+		
+		std::vector<std::pair<size_t, NodeId> > anchorEntries;
+		for(size_t i = 0; i < map_s; i++) {
+			if(map_d[i].nblinked) {
+				size_t cell = getCellY(map_d[i].pos.z) * width + getCellX(map_d[i].pos.x);
+				anchorEntries.push_back(std::make_pair(cell, NodeId(i)));
+			}
+		}
+		build(anchorCells, anchors, anchorEntries);
+		
+		std::vector<std::pair<size_t, size_t> > lightEntries;
+		for(size_t i = 0; i < slight_c; i++) {
+			
+			if(!slight_l[i]) {
+				continue;
+			}
+			
+			const EERIE_LIGHT & light = *slight_l[i];
+			allLights.push_back(i);
+			
+			size_t x0 = getCellX(light.pos.x - light.fallend);
+			size_t x1 = getCellX(light.pos.x + light.fallend);
+			size_t y0 = getCellY(light.pos.z - light.fallend);
+			size_t y1 = getCellY(light.pos.z + light.fallend);
+			for(size_t y = y0; y <= y1; y++) {
+				for(size_t x = x0; x <= x1; x++) {
+					lightEntries.push_back(std::make_pair(y * width + x, i));
+				}
+			}
+		}
+		build(lightCells, lights, lightEntries);
+		
 	}
 	
-	bool contains(NodeId id) const {
-		// TODO better datastructure: set of closed node ids
-		for(NodeList::const_iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			if((*i)->getId() == id) {
-				return true;
+	/*!
+	 * Find the linked anchor closest to a position.
+	 * Of several anchors at the same distance, the one with the lowest index is returned.
+	 * \return false if there are no linked anchors
+	 */
+	bool getNearestAnchor(const ANCHOR_DATA * map_d, const Vec3f & pos, NodeId & result) const {
+		
+		if(anchors.empty()) {
+			return false;
+		}
+		
+		size_t cx = getCellX(pos.x);
+		size_t cy = getCellY(pos.z);
+		size_t maxRing = std::max(width, height);
+		
+		bool found = false;
+		float distance = std::numeric_limits<float>::max();
+		
+		for(size_t ring = 0; ring <= maxRing; ring++) {
+			
+			// Anchors in this ring are at least this far from pos
+			if(found && ring > 0) {
+				float bound = (ring - 1) * cellSize;
+				if(bound * bound > distance) {
+					break;
+				}
+			}
+			
+			size_t y0 = (cy >= ring) ? cy - ring : 0;
+			size_t y1 = std::min(cy + ring, height - 1);
+			size_t x0 = (cx >= ring) ? cx - ring : 0;
+			size_t x1 = std::min(cx + ring, width - 1);
+			
+			for(size_t y = y0; y <= y1; y++) {
+				bool edgeRow = (y + ring == cy || y == cy + ring);
+				for(size_t x = x0; x <= x1; x++) {
+					
+					if(!edgeRow && x + ring != cx && x != cx + ring) {
+						continue; // Inside the ring - already searched
+					}
+					
+					size_t cell = y * width + x;
+					for(size_t i = anchorCells[cell]; i < anchorCells[cell + 1]; i++) {
+						NodeId id = anchors[i];
+						float dist = glm::distance2(map_d[id].pos, pos);
+						if(dist < distance || (dist == distance && id < result)) {
+							result = id;
+							distance = dist;
+							found = true;
+						}
+					}
+				}
 			}
 		}
-		return false;
+		
+		return found;
+	}
+	
+	//! Get the indices of all lights that may reach a position, in increasing order
+	void getLights(const Vec3f & pos, const size_t * & begin, const size_t * & end) const {
+		
+		if(!contains(pos)) {
+			begin = allLights.empty() ? NULL : &allLights[0];
+			end = allLights.empty() ? NULL : &allLights[0] + allLights.size();
+			return;
+		}
+		
+		size_t cell = getCellY(pos.z) * width + getCellX(pos.x);
+		begin = lights.empty() ? NULL : &lights[0] + lightCells[cell];
+		end = lights.empty() ? NULL : &lights[0] + lightCells[cell + 1];
 	}
 	
 };
 
+const float PathFinder::SpatialIndex::MIN_CELL_SIZE = 200.f;
+
+PathFinder::IndexPtr PathFinder::createIndex(size_t map_size, const ANCHOR_DATA * map_data,
+                                             size_t light_count,
+                                             const EERIE_LIGHT * const * light_list) {
+	return IndexPtr(new SpatialIndex(map_size, map_data, light_count, light_list));
+}
+
 PathFinder::PathFinder(size_t map_size, const ANCHOR_DATA * map_data,
                        size_t slight_count, const EERIE_LIGHT * const * slight_list)
 	: radius(RADIUS_DEFAULT), height(HEIGHT_DEFAULT), heuristic(HEURISTIC_DEFAULT),
-	  map_s(map_size), map_d(map_data), slight_c(slight_count), slight_l(slight_list) { }
+	  map_s(map_size), map_d(map_data), slight_c(slight_count), slight_l(slight_list),
+	  search(new SearchState(map_size)) { }
+
+PathFinder::~PathFinder() { }
+
+void PathFinder::setIndex(const IndexPtr & _index) {
+	index = _index;
+}
 
 void PathFinder::setHeuristic(float _heuristic) {
 	if(_heuristic >= HEURISTIC_MAX) {
@@ -216,25 +503,19 @@ bool PathFinder::move(NodeId from, NodeId to, Result & rlist, bool stealth) cons
 		return true;
 	}
 	
-	// Create start node and put it on open list
-	Node * node = new Node(from, NULL, 0.0f, 0.0f);
-	if(!node) {
-		return false;
-	}
+	SearchState & state = *search;
+	
+	// Create start node and put it on close list
+	NodeIndex node = state.start(from);
 	
 	// A* main loop
-	OpenNodeList open;
-	ClosedNodeList close;
 	do {
 		
-		// Put node onto close list as we have now examined this node.
-		close.add(node);
-		
-		NodeId nid = node->getId();
+		NodeId nid = state[node].getId();
 		
 		// If it's the goal node then we're done.
 		if(nid == to) {
-			buildPath(*node, rlist);
+			buildPath(node, rlist);
 			return true;
 		}
 		
@@ -248,7 +529,7 @@ bool PathFinder::move(NodeId from, NodeId to, Result & rlist, bool stealth) cons
 				continue;
 			}
 			
-			if(close.contains(cid)) {
+			if(state.isClosed(cid)) {
 				continue;
 			}
 			
@@ -258,16 +539,17 @@ bool PathFinder::move(NodeId from, NodeId to, Result & rlist, bool stealth) cons
 				distance += getIlluminationCost(map_d[cid].pos);
 			}
 			distance *= heuristic;
-			distance += node->getDistance();
+			distance += state[node].getDistance();
 			
 			// Estimated cost to get from this node to the destination.
 			float remaining = (1.0f - heuristic) * fdist(map_d[cid].pos, map_d[to].pos);
 			
-			open.add(cid, node, distance, remaining);
+			state.add(cid, node, distance, remaining);
 		}
-	
-		node = open.extractBestNode();
-	} while(node);
+		
+		// Take the best node off the open list and put it onto close list.
+		node = state.extractBestNode();
+	} while(node != Node::None);
 	
 	// No path found!
 	return false;
@@ -283,27 +565,21 @@ bool PathFinder::flee(NodeId from, const Vec3f & danger, float safeDist, Result
 		return true;
 	}
 	
-	// Create start node and put it on open list
-	Node * node = new Node(from, NULL, 0.0f, 0.0f);
-	if(!node) {
-		return false;
-	}
+	SearchState & state = *search;
+	
+	// Create start node and put it on close list
+	NodeIndex node = state.start(from);
 	
 	// A* main loop
-	OpenNodeList open;
-	ClosedNodeList close;
 	do {
 		
-		// Put node onto close list as we have now examined this node.
-		close.add(node);
-		
 		// If it's the goal node then we're done.
-		if(node->getCost() == node->getDistance()) {
-			buildPath(*node, rlist);
+		if(state[node].getCost() == state[node].getDistance()) {
+			buildPath(node, rlist);
 			return true;
 		}
 		
-		NodeId nid = node->getId();
+		NodeId nid = state[node].getId();
 		
 		// Otherwise, generate child from current node.
 		for(short i(0); i < map_d[nid].nblinked; i++) {
@@ -315,12 +591,12 @@ bool PathFinder::flee(NodeId from, const Vec3f & danger, float safeDist, Result
 				continue;
 			}
 			
-			if(close.contains(cid)) {
+			if(state.isClosed(cid)) {
 				continue;
 			}
 			
 			// Cost to reach this node.
-			float distance = node->getDistance() + fdist(map_d[cid].pos, map_d[nid].pos);
+			float distance = state[node].getDistance() + fdist(map_d[cid].pos, map_d[nid].pos);
 			if(stealth) {
 				distance += getIlluminationCost(map_d[cid].pos);
 			}
@@ -329,11 +605,12 @@ bool PathFinder::flee(NodeId from, const Vec3f & danger, float safeDist, Result
 			float remaining = std::max(0.0f, safeDist - fdist(map_d[cid].pos, danger));
 			remaining *= FLEE_DISTANCE_COST;
 			
-			open.add(cid, node, distance, remaining);
+			state.add(cid, node, distance, remaining);
 		}
 		
-		node = open.extractBestNode();
-	} while(node);
+		// Take the best node off the open list and put it onto close list.
+		node = state.extractBestNode();
+	} while(node != Node::None);
 	
 	// No path found!
 	return false;
@@ -397,16 +674,10 @@ bool PathFinder::wanderAround(NodeId from, float rad, Result & rlist, bool steal
 
 PathFinder::NodeId PathFinder::getNearestNode(const Vec3f & pos) const {
 	
-	NodeId best = 0;
-	float distance = std::numeric_limits<float>::max();
+	arx_assert(index);
 	
-	for(size_t i = 0; i < map_s; i++) {
-		float dist = glm::distance2(map_d[i].pos, pos);
-		if(dist < distance && map_d[i].nblinked) {
-			best = i;
-			distance = dist;
-		}
-	}
+	NodeId best = 0;
+	index->getNearestAnchor(map_d, pos, best);
 	
 	return best;
 }
@@ -449,15 +720,15 @@ bool PathFinder::lookFor(NodeId from, const Vec3f & pos, float radius, Result &
 	return true;
 }
 
-void PathFinder::buildPath(const Node & node, Result & rlist) {
+void PathFinder::buildPath(NodeIndex node, Result & rlist) const {
 	
-	const Node * next = &node;
+	NodeIndex next = node;
 	
 	size_t s = rlist.size();
 	
-	while(next) {
-		rlist.push_back(next->getId());
-		next = next->getParent();
+	while(next != Node::None) {
+		rlist.push_back((*search)[next].getId());
+		next = (*search)[next].getParent();
 	}
 	
 	std::reverse(rlist.begin() + s, rlist.end());
@@ -467,9 +738,17 @@ float PathFinder::getIlluminationCost(const Vec3f & pos) const {
 	
 	static const float STEALTH_LIGHT_COST = 300.0F;
 	
+	arx_assert(index);
+	
+	const size_t * begin;
+	const size_t * end;
+	index->getLights(pos, begin, end);
+	
 	float cost = 0.0f;
 	
-	for(size_t i = 0; i < slight_c; i++) {
+	for(const size_t * it = begin; it != end; ++it) {
+		
+		size_t i = *it;
 		
 		if(!slight_l[i] || !slight_l[i]->exist || !slight_l[i]->m_ignitionStatus) {
 			continue;
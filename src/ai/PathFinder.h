@@ -47,6 +47,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <stddef.h>
 #include <vector>
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
 #include "math/Types.h"
 
 struct ANCHOR_DATA;
@@ -64,17 +67,36 @@ public:
 	static const float RADIUS_DEFAULT;
 	static const float HEIGHT_DEFAULT;
 	
+	class SpatialIndex;
+	typedef boost::shared_ptr<const SpatialIndex> IndexPtr;
+	
+	/*!
+	 * Index anchors and lights by position.
+	 * This reads the anchor and light positions, which must not change while the index
+	 * is in use. The lights must be re-indexed when lights are added or removed.
+	 * The index is not modified after creation and can be shared between PathFinder
+	 * instances used by different threads.
+	 */
+	static IndexPtr createIndex(size_t map_size, const ANCHOR_DATA * map_data,
+	                            size_t light_count, const EERIE_LIGHT * const * light_list);
+	
 	/*!
 	 * Create a PathFinder instance for the provided data.
 	 * The pathfinder instance does not copy the provided data and will not clean it up
 	 * The light data is only used when the stealth parameter is set to true.
+	 * An index for the same data must be set with setIndex() before searching.
 	 */
 	PathFinder(size_t map_size, const ANCHOR_DATA * map_data,
 	           size_t light_count, const EERIE_LIGHT * const * light_list);
 	
+	~PathFinder();
+	
 	typedef unsigned long NodeId;
 	typedef std::vector<NodeId> Result;
 	
+	//! Set the index created by createIndex() for the anchors and lights of this PathFinder.
+	void setIndex(const IndexPtr & index);
+	
 	/*!
 	 * Set a heuristic for selecting the best next node.
 	 * For 0.0f only the distance to the target will be considered.
@@ -134,14 +156,12 @@ public:
 	
 private:
 	
+	typedef size_t NodeIndex;
+	
 	class Node;
-	class OpenNodeList;
-	class ClosedNodeList;
+	class SearchState;
 	
-	/*!
-	 * \return the best node (lowest cost) from open list or NULL if the list is empty
-	 */
-	static void buildPath(const Node & node, Result & rlist);
+	void buildPath(NodeIndex node, Result & rlist) const;
 	float getIlluminationCost(const Vec3f & pos) const;
 	NodeId getNearestNode(const Vec3f & pos) const;
 	
@@ -154,6 +174,15 @@ private:
 	size_t slight_c; // Light count
 	const EERIE_LIGHT * const * slight_l; // Light data
 	
+	/*!
+	 * Open and closed lists, reused between searches.
+	 * A PathFinder instance must therefore not be used by more than one thread at a time.
+	 */
+	boost::scoped_ptr<SearchState> search;
+	
+	//! Anchors and lights by position, shared with other PathFinder instances
+	IndexPtr index;
+	
 };
 
 #endif // ARX_AI_PATHFINDER_H
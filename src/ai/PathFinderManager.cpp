@@ -49,13 +49,20 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <cstring>
 #include <cstdlib>
 #include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "ai/PathFinder.h"
+#include "core/Config.h"
 #include "game/Entity.h"
 #include "game/NPC.h"
 #include "graphics/Math.h"
 #include "platform/Thread.h"
 #include "platform/Lock.h"
+#include "platform/Time.h"
 #include "platform/profiler/Profiler.h"
 #include "physics/Anchors.h"
 #include "scene/Light.h"
@@ -66,110 +73,136 @@ static const float PATHFINDER_HEURISTIC_RANGE = PATHFINDER_HEURISTIC_MAX
                                                 - PATHFINDER_HEURISTIC_MIN;
 static const float PATHFINDER_DISTANCE_MAX = 5000.0f;
 
-// Pathfinder Definitions
-static unsigned long PATHFINDER_UPDATE_INTERVAL = 10;
-
-long PATHFINDER_WORKING = 0;
-
-class PathFinderThread : public StoppableThread {
+class PathFinderThread : public Thread {
 	
 	void run();
 	
+public:
+	
+	//! Entity whose request is currently being processed, protected by the queue mutex
+	Entity * entity;
+	
+	//! Set if the result for entity is no longer wanted, protected by the queue mutex
+	bool superseded;
+	
+	PathFinderThread() : entity(NULL), superseded(false) { }
+	
 };
 
-static PathFinderThread * pathfinder = NULL;
-static Lock * mutex = NULL;
+/*!
+ * A request taken from the queue together with the entity state needed to
+ * process it, so that workers do not need to access the entity while searching.
+ */
+struct PATHFINDER_TASK {
+	PATHFINDER_REQUEST req;
+	PathFinder::IndexPtr index;
+	u64 queueTime;
+	Cylinder cylinder;
+	Behaviour behavior;
+	float behaviorParam;
+	Vec3f pos;
+	Vec3f target;
+};
+
+enum PathFinderPriority {
+	PathFinderHighPriority,
+	PathFinderNormalPriority,
+	PathFinderPriorityCount
+};
 
 struct PATHFINDER_QUEUE_ELEMENT {
 	PATHFINDER_REQUEST req;
-	PATHFINDER_QUEUE_ELEMENT * next;
-	long valid;
+	PathFinderPriority priority;
+	u64 sequence;
+	u64 queueTime;
 };
 
-static PATHFINDER_QUEUE_ELEMENT * pathfinder_queue_start = NULL;
+struct PATHFINDER_QUEUE_TICKET {
+	Entity * io;
+	u64 sequence;
+};
+
+static std::vector<PathFinderThread *> pathfinders;
+static Lock * mutex = NULL;
+
+// Anchors and lights by position, replaced by EERIE_PATHFINDER_Update_Index()
+static PathFinder::IndexPtr pathfinder_index;
+
+// Posted once for each queued ticket and once for each worker when stopping
+static Semaphore * pathfinder_wake = NULL;
+static bool pathfinder_stopping = false;
 
 // An Io can request Pathfinding only once so we insure that it's always the case.
 // A new pathfinder request from the same IO will overwrite the precedent.
-static PATHFINDER_QUEUE_ELEMENT * PATHFINDER_Find_ioid(Entity * io) {
-	
-	if(!pathfinder_queue_start)
-		return NULL;
+typedef boost::unordered_map<Entity *, PATHFINDER_QUEUE_ELEMENT> PendingRequests;
+static PendingRequests pathfinder_pending;
 
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
+// Order in which the pending requests are processed, by priority.
+// Tickets whose entity has no pending request with the same sequence number are stale.
+static std::deque<PATHFINDER_QUEUE_TICKET> pathfinder_queue[PathFinderPriorityCount];
+static u64 pathfinder_sequence = 0;
 
-	while(cur) {
-		if(cur->req.ioid == io)
-			return cur->valid ? cur : NULL;
-		
-		cur = cur->next;
+static PathFinderStatistics pathfinder_stats;
+
+static PathFinderPriority EERIE_PATHFINDER_Get_Priority(const PATHFINDER_REQUEST & req) {
+	if(   req.ioid && req.ioid->_npcdata
+	   && (req.ioid->_npcdata->behavior & (BEHAVIOUR_MOVE_TO | BEHAVIOUR_FLEE | BEHAVIOUR_LOOK_FOR))) {
+		return PathFinderHighPriority;
 	}
+	return PathFinderNormalPriority;
+}
 
-	return NULL;
+// Queues a ticket for the pending request of an entity
+static void EERIE_PATHFINDER_Push_Ticket(PATHFINDER_QUEUE_ELEMENT & element) {
+	
+	element.sequence = pathfinder_sequence++;
+	
+	PATHFINDER_QUEUE_TICKET ticket;
+	ticket.io = element.req.ioid;
+	ticket.sequence = element.sequence;
+	pathfinder_queue[element.priority].push_back(ticket);
+	
+	pathfinder_wake->post();
 }
 
 // Adds a Pathfinder Search Element to the pathfinder queue.
 bool EERIE_PATHFINDER_Add_To_Queue(const PATHFINDER_REQUEST & req) {
 	
-	if(!pathfinder) {
+	if(pathfinders.empty()) {
 		return false;
 	}
 	
 	Autolock lock(mutex);
-
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
-
-	PATHFINDER_QUEUE_ELEMENT * temp;
-
-	// If this NPC is already requesting a Pathfinding then either
-	// try to Override it or add it to queue if it is currently being
-	// processed.
-	temp = PATHFINDER_Find_ioid(req.ioid);
-
-	if(temp && temp->valid && temp != pathfinder_queue_start) {
-		temp->valid = 0;
-		temp->req = req;
-		temp->valid = 1;
-		return true;
-	}
-
-	// Create a New element for the queue
-	temp = new PATHFINDER_QUEUE_ELEMENT;
-
-	if(!temp) {
-		return false;
+	
+	// A result for an older request from this entity would overwrite the new one
+	BOOST_FOREACH(PathFinderThread * thread, pathfinders) {
+		if(thread->entity == req.ioid) {
+			thread->superseded = true;
+		}
 	}
-
-	// Fill this New element with new request
-	temp->req = req;
-	temp->valid = 1;
-
-	// No queue start ? then this element becomes the queue start
-	if(!cur) {
-		temp->next = NULL;
-		pathfinder_queue_start = temp;
-		
-	} else if((req.ioid->_npcdata->behavior & (BEHAVIOUR_MOVE_TO | BEHAVIOUR_FLEE
-	                                            | BEHAVIOUR_LOOK_FOR)) && cur->next) {
-		// priority: insert as second element of queue
-		temp->next = cur->next;
-		cur->next = temp;
-		
-	} else {
-		
-		// add to end of queue
-		temp->next = NULL;
-		
-		if(!pathfinder_queue_start) {
-			pathfinder_queue_start = temp;
-			return true;
-		} else {
-			while(cur->next) {
-				cur = cur->next;
-			}
-			cur->next = temp;
+	
+	PathFinderPriority priority = EERIE_PATHFINDER_Get_Priority(req);
+	
+	// If this NPC is already requesting a Pathfinding then override it
+	PendingRequests::iterator it = pathfinder_pending.find(req.ioid);
+	if(it != pathfinder_pending.end()) {
+		PATHFINDER_QUEUE_ELEMENT & element = it->second;
+		element.req = req;
+		element.queueTime = platform::getTimeUs();
+		if(element.priority != priority) {
+			// Move to the other queue, the old ticket becomes stale
+			element.priority = priority;
+			EERIE_PATHFINDER_Push_Ticket(element);
 		}
+		return true;
 	}
 	
+	PATHFINDER_QUEUE_ELEMENT & element = pathfinder_pending[req.ioid];
+	element.req = req;
+	element.priority = priority;
+	element.queueTime = platform::getTimeUs();
+	EERIE_PATHFINDER_Push_Ticket(element);
+	
 	return true;
 }
 
@@ -179,34 +212,48 @@ long EERIE_PATHFINDER_Get_Queued_Number() {
 
 	Autolock lock(mutex);
 	
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
-
-	long count = 0;
-
-	while (cur) cur = cur->next, count++;
+	return pathfinder_pending.size();
+}
 
-	return count;
+PathFinderStatistics EERIE_PATHFINDER_Get_Statistics() {
+	
+	if(!mutex) {
+		return PathFinderStatistics();
+	}
+	
+	Autolock lock(mutex);
+	
+	PathFinderStatistics stats = pathfinder_stats;
+	stats.workers = pathfinders.size();
+	stats.queued = pathfinder_pending.size();
+	stats.working = 0;
+	BOOST_FOREACH(PathFinderThread * thread, pathfinders) {
+		if(thread->entity) {
+			stats.working++;
+		}
+	}
+	
+	return stats;
 }
 
 static void EERIE_PATHFINDER_Clear_Private() {
 	
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
-	PATHFINDER_QUEUE_ELEMENT * next;
-	
-	while(cur) {
-		next = cur->next;
-		delete cur;
-		cur = next;
+	pathfinder_pending.clear();
+	for(size_t i = 0; i < PathFinderPriorityCount; i++) {
+		pathfinder_queue[i].clear();
 	}
 	
-	pathfinder_queue_start = NULL;
+	// Results for requests already being processed must not be written back
+	BOOST_FOREACH(PathFinderThread * thread, pathfinders) {
+		thread->superseded = true;
+	}
 	
 }
 
 
 void EERIE_PATHFINDER_Clear() {
 	
-	if(!pathfinder) {
+	if(pathfinders.empty()) {
 		return;
 	}
 	
@@ -217,27 +264,78 @@ void EERIE_PATHFINDER_Clear() {
 }
 
 // Retrieves & Removes next Pathfind request from queue
-static bool EERIE_PATHFINDER_Get_Next_Request(PATHFINDER_REQUEST & request) {
+static bool EERIE_PATHFINDER_Get_Next_Request(PathFinderThread & thread, PATHFINDER_TASK & task) {
 	
-	if(!pathfinder_queue_start || !pathfinder_queue_start->valid) {
-		return false;
+	Autolock lock(mutex);
+	
+	for(size_t i = 0; i < PathFinderPriorityCount; i++) {
+		while(!pathfinder_queue[i].empty()) {
+			
+			PATHFINDER_QUEUE_TICKET ticket = pathfinder_queue[i].front();
+			pathfinder_queue[i].pop_front();
+			
+			PendingRequests::iterator it = pathfinder_pending.find(ticket.io);
+			if(it == pathfinder_pending.end() || it->second.sequence != ticket.sequence) {
+				continue;
+			}
+			
+			PATHFINDER_QUEUE_ELEMENT element = it->second;
+			pathfinder_pending.erase(it);
+			
+			Entity * io = element.req.ioid;
+			if(!element.req.isvalid || !io || !io->_npcdata) {
+				continue;
+			}
+			
+			if((io->ioflags & IO_NPC) && io->_npcdata->behavior == BEHAVIOUR_NONE) {
+				continue;
+			}
+			
+			task.req = element.req;
+			task.index = pathfinder_index;
+			task.queueTime = element.queueTime;
+			task.cylinder = io->physics.cyl;
+			task.behavior = io->_npcdata->behavior;
+			task.behaviorParam = io->_npcdata->behavior_param;
+			task.pos = io->pos;
+			task.target = io->target;
+			
+			thread.entity = io;
+			thread.superseded = false;
+			
+			return true;
+		}
 	}
 	
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
+	return false;
+}
 
-	if ((cur->req.ioid)
-	        && (cur->req.ioid->ioflags & IO_NPC)
-	        && (cur->req.ioid->_npcdata->behavior == BEHAVIOUR_NONE)) {
-		pathfinder_queue_start = cur->next;
-		delete cur;
-		return false;
+// Publishes the result of a request unless it has been superseded
+static void EERIE_PATHFINDER_Finish_Request(PathFinderThread & thread, const PATHFINDER_TASK & task,
+                                            const PathFinder::Result & result) {
+	
+	Autolock lock(mutex);
+	
+	if(!thread.superseded) {
+		
+		if(!result.empty()) {
+			long * list = (long*)malloc(result.size() * sizeof(long));
+			std::copy(result.begin(), result.end(), list);
+			*(task.req.returnlist) = list;
+		}
+		*(task.req.returnnumber) = result.size();
+		
+		float latency = (platform::getTimeUs() - task.queueTime) / 1000.f;
+		pathfinder_stats.processed++;
+		pathfinder_stats.totalLatency += latency;
+		pathfinder_stats.maxLatency = std::max(pathfinder_stats.maxLatency, latency);
+		
+	} else {
+		pathfinder_stats.superseded++;
 	}
-
-	request = cur->req;
-	pathfinder_queue_start = cur->next;
-	delete cur;
-
-	return true;
+	
+	thread.entity = NULL;
+	thread.superseded = false;
 }
 
 // Pathfinder Thread
@@ -246,111 +344,116 @@ void PathFinderThread::run() {
 	EERIE_BACKGROUND * eb = ACTIVEBKG;
 	PathFinder pathfinder(eb->nbanchors, eb->anchors, MAX_LIGHTS, (EERIE_LIGHT **)GLight);
 
-	while(!isStopRequested()) {
+	for(;;) {
 		
-		mutex->lock();
-
-		PATHFINDER_WORKING = 1;
-
-		PATHFINDER_REQUEST curpr;
-		if(EERIE_PATHFINDER_Get_Next_Request(curpr) && curpr.isvalid) {
+		pathfinder_wake->wait();
+		
+		{
+			Autolock lock(mutex);
+			if(pathfinder_stopping) {
+				break;
+			}
+		}
+		
+		// The ticket may have been stale or cleared
+		PATHFINDER_TASK task;
+		if(!EERIE_PATHFINDER_Get_Next_Request(*this, task)) {
+			continue;
+		}
+		
+		PathFinder::Result result;
+		
+		{
 			
 			ARX_PROFILE_FUNC();
 			
-			PATHFINDER_WORKING = 2;
-
-			if(curpr.ioid && curpr.ioid->_npcdata) {
-				float heuristic(PATHFINDER_HEURISTIC_MAX);
-
-				pathfinder.setCylinder(curpr.ioid->physics.cyl.radius, curpr.ioid->physics.cyl.height);
-
-				bool stealth = (curpr.ioid->_npcdata->behavior & (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE))
-				                == (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE);
-
-				
-				PathFinder::Result result;
-				
-				if(   (curpr.ioid->_npcdata->behavior & BEHAVIOUR_MOVE_TO)
-				   || (curpr.ioid->_npcdata->behavior & BEHAVIOUR_GO_HOME)
-				) {
-					float distance = fdist(ACTIVEBKG->anchors[curpr.from].pos, ACTIVEBKG->anchors[curpr.to].pos);
-
-					if(distance < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (distance / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					pathfinder.move(curpr.from, curpr.to, result, stealth);
-				} else if(curpr.ioid->_npcdata->behavior & BEHAVIOUR_WANDER_AROUND) {
-					if(curpr.ioid->_npcdata->behavior_param < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (curpr.ioid->_npcdata->behavior_param / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					pathfinder.wanderAround(curpr.from, curpr.ioid->_npcdata->behavior_param, result, stealth);
-				} else if(curpr.ioid->_npcdata->behavior & (BEHAVIOUR_FLEE | BEHAVIOUR_HIDE)) {
-					if(curpr.ioid->_npcdata->behavior_param < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN
-						            + PATHFINDER_HEURISTIC_RANGE
-						              * (curpr.ioid->_npcdata->behavior_param / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					float safedist = curpr.ioid->_npcdata->behavior_param
-					                 + fdist(curpr.ioid->target, curpr.ioid->pos);
-
-					pathfinder.flee(curpr.from, curpr.ioid->target, safedist, result, stealth);
-				} else if(curpr.ioid->_npcdata->behavior & BEHAVIOUR_LOOK_FOR) {
-					float distance = fdist(curpr.ioid->pos, curpr.ioid->target);
-
-					if(distance < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (distance / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					pathfinder.lookFor(curpr.from, curpr.ioid->target,
-					                   curpr.ioid->_npcdata->behavior_param, result, stealth);
-				}
-				
-				if(!result.empty()) {
-					long * list = (long*)malloc(result.size() * sizeof(long));
-					std::copy(result.begin(), result.end(), list);
-					*(curpr.returnlist) = list;
-				}
-				*(curpr.returnnumber) = result.size();
-				
-			}
-		}
+			pathfinder.setIndex(task.index);
+			
+			float heuristic(PATHFINDER_HEURISTIC_MAX);
 
-		PATHFINDER_WORKING = 0;
+			pathfinder.setCylinder(task.cylinder.radius, task.cylinder.height);
 
-		mutex->unlock();
-		sleep(PATHFINDER_UPDATE_INTERVAL);
+			bool stealth = (task.behavior & (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE))
+			                == (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE);
+			
+			if(   (task.behavior & BEHAVIOUR_MOVE_TO)
+			   || (task.behavior & BEHAVIOUR_GO_HOME)
+			) {
+				float distance = fdist(eb->anchors[task.req.from].pos, eb->anchors[task.req.to].pos);
+
+				if(distance < PATHFINDER_DISTANCE_MAX)
+					heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (distance / PATHFINDER_DISTANCE_MAX);
+
+				pathfinder.setHeuristic(heuristic);
+				pathfinder.move(task.req.from, task.req.to, result, stealth);
+			} else if(task.behavior & BEHAVIOUR_WANDER_AROUND) {
+				if(task.behaviorParam < PATHFINDER_DISTANCE_MAX)
+					heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (task.behaviorParam / PATHFINDER_DISTANCE_MAX);
+
+				pathfinder.setHeuristic(heuristic);
+				pathfinder.wanderAround(task.req.from, task.behaviorParam, result, stealth);
+			} else if(task.behavior & (BEHAVIOUR_FLEE | BEHAVIOUR_HIDE)) {
+				if(task.behaviorParam < PATHFINDER_DISTANCE_MAX)
+					heuristic = PATHFINDER_HEURISTIC_MIN
+					            + PATHFINDER_HEURISTIC_RANGE
+					              * (task.behaviorParam / PATHFINDER_DISTANCE_MAX);
+
+				pathfinder.setHeuristic(heuristic);
+				float safedist = task.behaviorParam + fdist(task.target, task.pos);
+
+				pathfinder.flee(task.req.from, task.target, safedist, result, stealth);
+			} else if(task.behavior & BEHAVIOUR_LOOK_FOR) {
+				float distance = fdist(task.pos, task.target);
+
+				if(distance < PATHFINDER_DISTANCE_MAX)
+					heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (distance / PATHFINDER_DISTANCE_MAX);
+
+				pathfinder.setHeuristic(heuristic);
+				pathfinder.lookFor(task.req.from, task.target, task.behaviorParam, result, stealth);
+			}
+			
+		}
+		
+		EERIE_PATHFINDER_Finish_Request(*this, task, result);
 	}
-
-	// fix leaks memory but freeze characters
-	// pathfinder.Clean();
-
-	PATHFINDER_WORKING = 0;
 	
 }
 
 void EERIE_PATHFINDER_Release() {
 	
-	if(!pathfinder) {
+	if(pathfinders.empty()) {
 		return;
 	}
 	
-	mutex->lock();
+	{
+		Autolock lock(mutex);
+		EERIE_PATHFINDER_Clear_Private();
+		pathfinder_stopping = true;
+	}
 	
-	EERIE_PATHFINDER_Clear_Private();
+	pathfinder_wake->post(unsigned(pathfinders.size()));
 	
-	pathfinder->stop();
+	// Workers need the mutex to finish their current request
+	BOOST_FOREACH(PathFinderThread * thread, pathfinders) {
+		thread->waitForCompletion();
+	}
 	
-	delete pathfinder, pathfinder = NULL;
+	{
+		Autolock lock(mutex);
+		BOOST_FOREACH(PathFinderThread * thread, pathfinders) {
+			delete thread;
+		}
+		pathfinders.clear();
+	}
 	
-	mutex->unlock(), delete mutex, mutex = NULL;
+	delete mutex, mutex = NULL;
+	delete pathfinder_wake, pathfinder_wake = NULL;
+	pathfinder_index.reset();
 }
 
 void EERIE_PATHFINDER_Create() {
 	
-	if(pathfinder) {
+	if(!pathfinders.empty()) {
 		EERIE_PATHFINDER_Release();
 	}
 	
@@ -358,7 +461,40 @@ void EERIE_PATHFINDER_Create() {
 		mutex = new Lock();
 	}
 	
-	pathfinder = new PathFinderThread();
-	pathfinder->setThreadName("Pathfinder");
-	pathfinder->start();
+	pathfinder_wake = new Semaphore();
+	pathfinder_stopping = false;
+	
+	size_t count = std::max(config.misc.pathfinderThreads, 0);
+	if(count == 0) {
+		count = std::max(Thread::getCPUCount(), 2u) - 1;
+	}
+	
+	pathfinder_stats = PathFinderStatistics();
+	
+	EERIE_BACKGROUND * eb = ACTIVEBKG;
+	pathfinder_index = PathFinder::createIndex(eb->nbanchors, eb->anchors,
+	                                           MAX_LIGHTS, (EERIE_LIGHT **)GLight);
+	
+	for(size_t i = 0; i < count; i++) {
+		PathFinderThread * thread = new PathFinderThread();
+		thread->setThreadName("Pathfinder");
+		thread->start();
+		pathfinders.push_back(thread);
+	}
+}
+
+void EERIE_PATHFINDER_Update_Index() {
+	
+	if(pathfinders.empty()) {
+		return;
+	}
+	
+	// Requests already being processed keep using the old index
+	EERIE_BACKGROUND * eb = ACTIVEBKG;
+	PathFinder::IndexPtr index = PathFinder::createIndex(eb->nbanchors, eb->anchors,
+	                                                     MAX_LIGHTS, (EERIE_LIGHT **)GLight);
+	
+	Autolock lock(mutex);
+	
+	pathfinder_index = index;
 }
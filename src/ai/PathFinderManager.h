@@ -47,7 +47,10 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #ifndef ARX_AI_PATHFINDERMANAGER_H
 #define ARX_AI_PATHFINDERMANAGER_H
 
+#include <stddef.h>
+
 #include "game/GameTypes.h"
+#include "platform/Platform.h"
 
 class Entity;
 
@@ -62,12 +65,32 @@ struct PATHFINDER_REQUEST {
 	long ** returnlist;	//must be NULL
 };
 
-extern long PATHFINDER_WORKING;
+struct PathFinderStatistics {
+	
+	size_t workers; //!< Number of pathfinder threads
+	size_t queued; //!< Number of requests waiting for a thread
+	size_t working; //!< Number of requests currently being processed
+	
+	u64 processed; //!< Number of results delivered since the pathfinder was created
+	u64 superseded; //!< Number of results discarded because a newer request was made
+	
+	float totalLatency; //!< Sum of the times from request to result in ms
+	float maxLatency; //!< Longest time from request to result in ms
+	
+	PathFinderStatistics()
+		: workers(0), queued(0), working(0), processed(0), superseded(0),
+		  totalLatency(0.f), maxLatency(0.f) { }
+	
+};
 
 bool EERIE_PATHFINDER_Add_To_Queue(const PATHFINDER_REQUEST & request);
 long EERIE_PATHFINDER_Get_Queued_Number();
+PathFinderStatistics EERIE_PATHFINDER_Get_Statistics();
 void EERIE_PATHFINDER_Clear();
 void EERIE_PATHFINDER_Create();
 void EERIE_PATHFINDER_Release();
 
+//! Re-index the level lights for the pathfinder threads after lights were added or removed.
+void EERIE_PATHFINDER_Update_Index();
+
 #endif // ARX_AI_PATHFINDERMANAGER_H
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ai/Perception.h"
+
+#include <limits>
+
+#include "game/Entity.h"
+#include "game/EntityManager.h"
+#include "graphics/BaseGraphicsTypes.h"
+#include "graphics/data/Mesh.h"
+#include "physics/Anchors.h"
+#include "physics/EntityGrid.h"
+#include "platform/Time.h"
+
+namespace {
+
+const float PERCEPTION_GRID_CELL_SIZE = 400.f;
+// How far entities may move during a frame after the grid has been updated
+const float PERCEPTION_GRID_MARGIN = 200.f;
+// First radius tried when searching for the nearest anchor, doubled for each round
+const float PERCEPTION_ANCHOR_SEARCH_RADIUS = 400.f;
+const int PERCEPTION_ANCHOR_SEARCH_ROUNDS = 8;
+
+EntityGrid entityGrid(PERCEPTION_GRID_CELL_SIZE);
+//! Number of entity slots when the grid was updated, or 0 if it is not up to date
+size_t indexedEntities = 0;
+
+EntityGrid anchorGrid(PERCEPTION_GRID_CELL_SIZE);
+const ANCHOR_DATA * indexedAnchors = NULL;
+long indexedAnchorCount = 0;
+
+PerceptionStatistics currentStats;
+PerceptionStatistics lastStats;
+
+//! Accounts the time and results of a query in the statistics
+class QueryTimer {
+	
+	u64 m_start;
+	
+public:
+	
+	QueryTimer() : m_start(platform::getTimeUs()) {
+		currentStats.queries++;
+	}
+	
+	~QueryTimer() {
+		currentStats.time += platform::getElapsedUs(m_start) / 1000.f;
+	}
+	
+};
+
+bool isValidAnchor(const ANCHOR_DATA & anchor, const Cylinder & cyl) {
+	return anchor.nblinked && anchor.height <= cyl.height && anchor.radius >= cyl.radius
+	       && !(anchor.flags & ANCHOR_FLAG_BLOCKED);
+}
+
+void updateAnchorGrid() {
+	
+	const EERIE_BACKGROUND * eb = ACTIVEBKG;
+	const ANCHOR_DATA * anchors = eb ? eb->anchors : NULL;
+	long count = eb ? eb->nbanchors : 0;
+	if(anchors == indexedAnchors && count == indexedAnchorCount) {
+		return;
+	}
+	
+	anchorGrid.clear();
+	for(long i = 0; i < count; i++) {
+		if(anchors[i].nblinked) {
+			anchorGrid.insert(i, anchors[i].pos);
+		}
+	}
+	
+	indexedAnchors = anchors;
+	indexedAnchorCount = count;
+}
+
+} // anonymous namespace
+
+void ARX_PERCEPTION_Update() {
+	
+	lastStats = currentStats;
+	currentStats = PerceptionStatistics();
+	
+	entityGrid.clear();
+	for(size_t i = 0; i < entities.size(); i++) {
+		const Entity * entity = entities[EntityHandle(i)];
+		if(entity) {
+			entityGrid.insert(long(i), entity->pos);
+		}
+	}
+	indexedEntities = entities.size();
+	
+	updateAnchorGrid();
+}
+
+void ARX_PERCEPTION_Clear() {
+	
+	entityGrid.clear();
+	indexedEntities = 0;
+	
+	anchorGrid.clear();
+	indexedAnchors = NULL;
+	indexedAnchorCount = 0;
+}
+
+void ARX_PERCEPTION_GetNearbyEntities(const Vec3f & pos, float radius, std::vector<long> & result) {
+	
+	QueryTimer timer;
+	
+	size_t start = result.size();
+	
+	if(indexedEntities == 0 || !(radius < std::numeric_limits<float>::max())) {
+		// Not indexed yet this level, or unbounded radius
+		for(size_t i = 0; i < entities.size(); i++) {
+			result.push_back(long(i));
+		}
+	} else {
+		entityGrid.query(pos, radius + PERCEPTION_GRID_MARGIN, result);
+		// Entities added since the last update are not in the grid
+		for(size_t i = indexedEntities; i < entities.size(); i++) {
+			result.push_back(long(i));
+		}
+	}
+	
+	currentStats.candidates += u32(result.size() - start);
+}
+
+long ARX_PERCEPTION_GetNearestAnchor(const Vec3f & pos, const Cylinder & cyl, long except) {
+	
+	QueryTimer timer;
+	
+	updateAnchorGrid();
+	
+	const ANCHOR_DATA * anchors = indexedAnchors;
+	
+	std::vector<long> candidates;
+	float radius = PERCEPTION_ANCHOR_SEARCH_RADIUS;
+	for(int round = 0; round < PERCEPTION_ANCHOR_SEARCH_ROUNDS; round++, radius *= 2.f) {
+		
+		candidates.clear();
+		anchorGrid.query(pos, radius, candidates);
+		currentStats.candidates += u32(candidates.size());
+		
+		long best = -1;
+		float distmax = std::numeric_limits<float>::max();
+		
+		// Candidates are sorted so that ties go to the lowest index
+		for(size_t i = 0; i < candidates.size(); i++) {
+			long id = candidates[i];
+			const ANCHOR_DATA & anchor = anchors[id];
+			if(id == except || !isValidAnchor(anchor, cyl)) {
+				continue;
+			}
+			float d = glm::distance2(anchor.pos, pos);
+			if(d < distmax) {
+				best = id;
+				distmax = d;
+			}
+		}
+		
+		// Anchors outside of the searched area are farther away than radius
+		if((best != -1 && distmax <= radius * radius) || candidates.size() == anchorGrid.size()) {
+			return best;
+		}
+	}
+	
+	// Only reached for positions far outside of the level
+	long best = -1;
+	float distmax = std::numeric_limits<float>::max();
+	for(long i = 0; i < indexedAnchorCount; i++) {
+		if(i != except && isValidAnchor(anchors[i], cyl)) {
+			float d = glm::distance2(anchors[i].pos, pos);
+			if(d < distmax) {
+				best = i;
+				distmax = d;
+			}
+		}
+	}
+	
+	return best;
+}
+
+PerceptionStatistics ARX_PERCEPTION_GetStatistics() {
+	return lastStats;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_AI_PERCEPTION_H
+#define ARX_AI_PERCEPTION_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "math/Types.h"
+#include "platform/Platform.h"
+
+struct Cylinder;
+
+/*!
+ * \file
+ *
+ * Spatial queries for NPC hearing, sight and anchor lookups.
+ *
+ * Entity positions are indexed once per frame by ARX_PERCEPTION_Update().
+ * Queries return candidates that may be in range, taking into account how far
+ * entities can move during a frame. Callers must still check the exact distance
+ * and any other conditions against the current entity state.
+ */
+
+struct PerceptionStatistics {
+	
+	u32 queries; //!< Number of queries during the last frame
+	u32 candidates; //!< Number of entities or anchors returned by those queries
+	float time; //!< Time spent in those queries in ms
+	
+	PerceptionStatistics() : queries(0), candidates(0), time(0.f) { }
+	
+};
+
+//! Index the current entity positions, and the anchors if they have changed
+void ARX_PERCEPTION_Update();
+
+//! Forget all indexed entities and anchors - must be called when the level is cleared
+void ARX_PERCEPTION_Clear();
+
+/*!
+ * Append the indices of entities that may be within radius of pos.
+ * The appended indices are sorted in increasing order.
+ */
+void ARX_PERCEPTION_GetNearbyEntities(const Vec3f & pos, float radius, std::vector<long> & result);
+
+/*!
+ * Find the nearest linked anchor that is not blocked and fits the given cylinder.
+ * Of several anchors at the same distance, the one with the lowest index is returned.
+ * \param except An anchor to ignore, or -1
+ * \return the anchor index or -1 if there is no such anchor
+ */
+long ARX_PERCEPTION_GetNearestAnchor(const Vec3f & pos, const Cylinder & cyl, long except = -1);
+
+PerceptionStatistics ARX_PERCEPTION_GetStatistics();
+
+#endif // ARX_AI_PERCEPTION_H
@@ -57,10 +57,13 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <zlib.h>
+
 #include "util/String.h"
 
 #include "audio/Audio.h"
 
+#include "core/Config.h"
 #include "core/GameTime.h"
 
 #include "game/EntityManager.h"
@@ -69,6 +72,10 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "graphics/BaseGraphicsTypes.h"
 #include "graphics/Math.h"
 
+#include "io/fs/FilePath.h"
+#include "io/fs/FileStream.h"
+#include "io/fs/Filesystem.h"
+#include "io/fs/SystemPaths.h"
 #include "io/resource/ResourcePath.h"
 #include "io/resource/PakReader.h"
 #include "io/log/Logger.h"
@@ -167,20 +174,66 @@ ANIM_HANDLE::ANIM_HANDLE() : path() {
 	locks = 0;
 }
 
+/*!
+ * Animations are stored in a single allocation: the EERIE_ANIM itself followed by
+ * the frames, groups and voidgroups arrays. This is also the layout of the data
+ * in the animation cache, so cached animations only need their pointers fixed up.
+ */
+static size_t alignAnimBlock(size_t offset) {
+	return (offset + 15) & ~size_t(15);
+}
+
+static size_t getAnimBlockSize(long nb_key_frames, long nb_groups,
+                               size_t * groupsOffset = NULL, size_t * voidgroupsOffset = NULL) {
+	
+	size_t size = alignAnimBlock(sizeof(EERIE_ANIM));
+	size += alignAnimBlock(sizeof(EERIE_FRAME) * size_t(nb_key_frames));
+	if(groupsOffset) {
+		*groupsOffset = size;
+	}
+	size += alignAnimBlock(sizeof(EERIE_GROUP) * size_t(nb_key_frames) * size_t(nb_groups));
+	if(voidgroupsOffset) {
+		*voidgroupsOffset = size;
+	}
+	size += size_t(nb_groups);
+	
+	return size;
+}
+
+//! Point the frames, groups and voidgroups arrays into the animation's block
+static void fixupAnimPointers(EERIE_ANIM * ea) {
+	
+	size_t groupsOffset, voidgroupsOffset;
+	getAnimBlockSize(ea->nb_key_frames, ea->nb_groups, &groupsOffset, &voidgroupsOffset);
+	
+	char * block = reinterpret_cast<char *>(ea);
+	ea->frames = reinterpret_cast<EERIE_FRAME *>(block + alignAnimBlock(sizeof(EERIE_ANIM)));
+	ea->groups = reinterpret_cast<EERIE_GROUP *>(block + groupsOffset);
+	ea->voidgroups = reinterpret_cast<unsigned char *>(block + voidgroupsOffset);
+}
+
+static EERIE_ANIM * allocAnim(long nb_key_frames, long nb_groups) {
+	
+	size_t size = getAnimBlockSize(nb_key_frames, nb_groups);
+	
+	EERIE_ANIM * ea = reinterpret_cast<EERIE_ANIM *>(malloc(size));
+	memset(ea, 0, size);
+	ea->nb_key_frames = nb_key_frames;
+	ea->nb_groups = nb_groups;
+	fixupAnimPointers(ea);
+	
+	return ea;
+}
+
 static void ReleaseAnim(EERIE_ANIM * ea) {
 
 	if(!ea)
 		return;
 
-	if(ea->frames) {
-		for(long i = 0; i < ea->nb_key_frames; i++) {
-			ARX_SOUND_Free(ea->frames[i].sample);
-		}
-		free(ea->frames);
+	for(long i = 0; i < ea->nb_key_frames; i++) {
+		ARX_SOUND_Free(ea->frames[i].sample);
 	}
 
-	free(ea->groups);
-	free(ea->voidgroups);
 	free(ea);
 }
 
@@ -235,7 +288,14 @@ static float GetTimeBetweenKeyFrames(EERIE_ANIM * ea, long f1, long f2) {
 	return time;
 }
 
-static EERIE_ANIM * TheaToEerie(const char * adr, size_t size, const res::path & file) {
+/*!
+ * Convert a TEA file
+ *
+ * \param samples Receives the name of the sound sample played at each key frame,
+ *                or an empty path for frames without one.
+ */
+static EERIE_ANIM * TheaToEerie(const char * adr, size_t size, const res::path & file,
+                                std::vector<res::path> & samples) {
 
 	(void)size; // TODO use size
 
@@ -243,12 +303,9 @@ static EERIE_ANIM * TheaToEerie(const char * adr, size_t size, const res::path &
 
 	size_t pos = 0;
 
-	EERIE_ANIM * eerie = allocStructZero<EERIE_ANIM>();
-
 	const THEA_HEADER * th = reinterpret_cast<const THEA_HEADER *>(adr + pos);
 	if(th->version < 2014) {
 		LogError << "Invalid TEA Version " << th->version << " in " << file;
-		free(eerie);
 		return NULL;
 	}
 	pos += sizeof(THEA_HEADER);
@@ -258,12 +315,9 @@ static EERIE_ANIM * TheaToEerie(const char * adr, size_t size, const res::path &
 	LogDebug("Version - " << th->version << "  Frames " << th->nb_frames
 			 << "  Groups " << th->nb_groups << "  KeyFrames " << th->nb_key_frames);
 
-	eerie->nb_groups = th->nb_groups;
-	eerie->nb_key_frames = th->nb_key_frames;
+	EERIE_ANIM * eerie = allocAnim(th->nb_key_frames, th->nb_groups);
 
-	eerie->frames = allocStructZero<EERIE_FRAME>(th->nb_key_frames);
-	eerie->groups = allocStructZero<EERIE_GROUP>(th->nb_key_frames * th->nb_groups);
-	eerie->voidgroups = allocStructZero<unsigned char>(th->nb_groups);
+	samples.assign(size_t(th->nb_key_frames), res::path());
 
 	eerie->anim_time = 0;
 
@@ -369,7 +423,8 @@ static EERIE_ANIM * TheaToEerie(const char * adr, size_t size, const res::path &
 			LogDebug(" -> sample " << ts->sample_name << " size " << ts->sample_size
 					 << " THEA_SAMPLE:" << sizeof(THEA_SAMPLE));
 
-			eerie->frames[i].sample = ARX_SOUND_Load(res::path::load(util::loadString(ts->sample_name)));
+			samples[i] = res::path::load(util::loadString(ts->sample_name));
+			eerie->frames[i].sample = ARX_SOUND_Load(samples[i]);
 		}
 
 		pos += 4; // num_sfx
@@ -464,22 +519,230 @@ static EERIE_ANIM * TheaToEerie(const char * adr, size_t size, const res::path &
 	return eerie;
 }
 
+namespace {
 
+const char ANIMATION_CACHE_MAGIC[4] = { 'A', 'R', 'X', 'A' };
 
-static bool EERIE_ANIMMANAGER_AddAltAnim(ANIM_HANDLE * ah, const res::path & path) {
+//! Increment when the conversion in TheaToEerie changes
+const u32 ANIMATION_CACHE_VERSION = 1;
+
+/*!
+ * Header of a converted animation in the on-disk cache
+ *
+ * The header is followed by the animation block with its pointers cleared, and then
+ * by the name of the sample played at each key frame, as nul-terminated strings.
+ * The block is stored in the in-memory layout, so the struct sizes are recorded to
+ * reject caches written by a different build.
+ */
+struct AnimationCacheHeader {
+	char magic[4];
+	u32 version;
+	u32 animSize;
+	u32 frameSize;
+	u32 groupSize;
+	u32 sourceSize;
+	u32 sourceHash;
+	s32 nb_key_frames;
+	s32 nb_groups;
+	u32 blockSize;
+	u32 samplesSize;
+};
+
+fs::path getAnimationCachePath(const res::path & file) {
+	fs::path path = fs::paths.user / "cache" / file.string();
+	path.set_ext("anim");
+	return path;
+}
+
+bool isAnimationCacheEnabled() {
+	return config.misc.animationCache && !fs::paths.user.empty();
+}
+
+void initAnimationCacheHeader(AnimationCacheHeader & header, size_t sourceSize, u32 sourceHash) {
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ANIMATION_CACHE_MAGIC, sizeof(header.magic));
+	header.version = ANIMATION_CACHE_VERSION;
+	header.animSize = sizeof(EERIE_ANIM);
+	header.frameSize = sizeof(EERIE_FRAME);
+	header.groupSize = sizeof(EERIE_GROUP);
+	header.sourceSize = u32(sourceSize);
+	header.sourceHash = sourceHash;
+}
+
+//! \return the cached conversion of the given TEA file or NULL if it is missing or outdated
+EERIE_ANIM * loadCachedAnimation(const res::path & file, size_t sourceSize, u32 sourceHash) {
 	
-	if(!ah || ah->path.empty()) {
-		return false;
+	fs::ifstream ifs(getAnimationCachePath(file), fs::fstream::in | fs::fstream::binary);
+	if(!ifs.is_open()) {
+		return NULL;
+	}
+	
+	AnimationCacheHeader header;
+	if(!fs::read(ifs, header)) {
+		return NULL;
+	}
+	
+	AnimationCacheHeader expected;
+	initAnimationCacheHeader(expected, sourceSize, sourceHash);
+	if(memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0
+	   || header.version != expected.version
+	   || header.animSize != expected.animSize
+	   || header.frameSize != expected.frameSize
+	   || header.groupSize != expected.groupSize
+	   || header.sourceSize != expected.sourceSize
+	   || header.sourceHash != expected.sourceHash
+	   || header.nb_key_frames < 0 || header.nb_groups < 0
+	   || header.blockSize != getAnimBlockSize(header.nb_key_frames, header.nb_groups)) {
+		LogDebug("Outdated animation cache for " << file);
+		return NULL;
+	}
+	
+	EERIE_ANIM * ea = reinterpret_cast<EERIE_ANIM *>(malloc(header.blockSize));
+	std::string samples(header.samplesSize, '\0');
+	if(fs::read(ifs, ea, header.blockSize).fail()
+	   || (!samples.empty() && fs::read(ifs, &samples[0], samples.size()).fail())
+	   || ea->nb_key_frames != header.nb_key_frames || ea->nb_groups != header.nb_groups) {
+		LogWarning << "Corrupt animation cache for " << file;
+		free(ea);
+		return NULL;
+	}
+	
+	fixupAnimPointers(ea);
+	
+	size_t pos = 0;
+	for(long i = 0; i < ea->nb_key_frames; i++) {
+		size_t end = samples.find('\0', pos);
+		if(end == std::string::npos) {
+			LogWarning << "Corrupt animation cache for " << file;
+			for(long j = 0; j < i; j++) {
+				ARX_SOUND_Free(ea->frames[j].sample);
+			}
+			free(ea);
+			return NULL;
+		}
+		ea->frames[i].sample = -1;
+		if(end != pos) {
+			ea->frames[i].sample = ARX_SOUND_Load(res::path(samples.substr(pos, end - pos)));
+		}
+		pos = end + 1;
+	}
+	
+	return ea;
+}
+
+void storeCachedAnimation(const res::path & file, size_t sourceSize, u32 sourceHash,
+                          const EERIE_ANIM * ea, const std::vector<res::path> & samples) {
+	
+	fs::path path = getAnimationCachePath(file);
+	if(!fs::create_directories(path.parent())) {
+		LogWarning << "Could not create animation cache directory " << path.parent();
+		return;
+	}
+	
+	AnimationCacheHeader header;
+	initAnimationCacheHeader(header, sourceSize, sourceHash);
+	header.nb_key_frames = s32(ea->nb_key_frames);
+	header.nb_groups = s32(ea->nb_groups);
+	header.blockSize = u32(getAnimBlockSize(ea->nb_key_frames, ea->nb_groups));
+	
+	std::string names;
+	BOOST_FOREACH(const res::path & sample, samples) {
+		names.append(sample.string());
+		names.push_back('\0');
 	}
+	header.samplesSize = u32(names.size());
 	
-	size_t FileSize;
-	char * adr = resources->readAlloc(path, FileSize);
-	if(!adr) {
+	// Pointers and sample ids are only valid for this run
+	EERIE_ANIM anim = *ea;
+	anim.frames = NULL;
+	anim.groups = NULL;
+	anim.voidgroups = NULL;
+	std::vector<char> block(reinterpret_cast<const char *>(ea),
+	                        reinterpret_cast<const char *>(ea) + header.blockSize);
+	memcpy(&block[0], &anim, sizeof(anim));
+	EERIE_FRAME * frames = reinterpret_cast<EERIE_FRAME *>(&block[alignAnimBlock(sizeof(EERIE_ANIM))]);
+	for(long i = 0; i < ea->nb_key_frames; i++) {
+		frames[i].sample = -1;
+	}
+	
+	// Write to a temporary file first so that a partial cache is never loaded
+	fs::path tempPath = path;
+	tempPath.set_ext("tmp");
+	{
+		fs::ofstream ofs(tempPath, fs::fstream::out | fs::fstream::binary | fs::fstream::trunc);
+		if(!ofs.is_open()) {
+			LogWarning << "Could not write animation cache " << tempPath;
+			return;
+		}
+		fs::write(ofs, header);
+		fs::write(ofs, &block[0], block.size());
+		fs::write(ofs, names.data(), names.size());
+		if(ofs.fail()) {
+			LogWarning << "Could not write animation cache " << tempPath;
+			ofs.close();
+			fs::remove(tempPath);
+			return;
+		}
+	}
+	
+	if(!fs::rename(tempPath, path, true)) {
+		LogWarning << "Could not write animation cache " << path;
+		fs::remove(tempPath);
+	}
+}
+
+} // anonymous namespace
+
+/*!
+ * Load and convert a TEA file, using the animation cache if possible
+ *
+ * The cache is validated against a hash of the TEA file. Files in mapped archives are
+ * hashed in place, so a cache hit never copies the source.
+ */
+static EERIE_ANIM * loadAnimation(const res::path & path) {
+	
+	PakFile * file = resources->getFile(path);
+	if(!file) {
+		return NULL;
+	}
+	
+	char * buffer = NULL;
+	const char * data = file->data();
+	if(!data) {
+		data = buffer = file->readAlloc();
+		if(!buffer) {
+			return NULL;
+		}
+	}
+	
+	bool cache = isAnimationCacheEnabled();
+	u32 hash = 0;
+	EERIE_ANIM * ea = NULL;
+	if(cache) {
+		hash = crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef *>(data), uInt(file->size()));
+		ea = loadCachedAnimation(path, file->size(), hash);
+	}
+	
+	if(!ea) {
+		std::vector<res::path> samples;
+		ea = TheaToEerie(data, file->size(), path, samples);
+		if(ea && cache) {
+			storeCachedAnimation(path, file->size(), hash, ea, samples);
+		}
+	}
+	
+	free(buffer);
+	
+	return ea;
+}
+
+static bool EERIE_ANIMMANAGER_AddAltAnim(ANIM_HANDLE * ah, const res::path & path) {
+	
+	if(!ah || ah->path.empty()) {
 		return false;
 	}
 	
-	EERIE_ANIM * temp = TheaToEerie(adr, FileSize, path);
-	free(adr);
+	EERIE_ANIM * temp = loadAnimation(path);
 	if(!temp) {
 		return false;
 	}
@@ -515,22 +778,15 @@ ANIM_HANDLE * EERIE_ANIMMANAGER_Load_NoWarning(const res::path & path) {
 			continue;
 		}
 		
-		size_t FileSize;
-		char * adr = resources->readAlloc(path, FileSize);
-		if(!adr) {
+		EERIE_ANIM * anim = loadAnimation(path);
+		if(!anim) {
 			return NULL;
 		}
 		
 		animations[i].anims = (EERIE_ANIM **)malloc(sizeof(EERIE_ANIM *));
-		animations[i].anims[0] = TheaToEerie(adr, FileSize, path);
+		animations[i].anims[0] = anim;
 		animations[i].alt_nb = 1;
 		
-		free(adr);
-		
-		if(!animations[i].anims[0]) {
-			return NULL;
-		}
-		
 		animations[i].path = path;
 		animations[i].locks = 1;
 		
@@ -569,7 +825,8 @@ Vec3f GetAnimTotalTranslate(ANIM_HANDLE * eanim, long alt_idx) {
  * \param time Time increment to current animation in Ms
  * \param io Referrence to Interactive Object (NULL if no IO)
  */
-void PrepareAnim(AnimLayer & layer, unsigned long time, Entity *io) {
+void PrepareAnim(AnimLayer & layer, unsigned long time, Entity * io,
+                 AnimFrameEvents * events) {
 
 	if(layer.flags & EA_PAUSED)
 		time = 0;
@@ -684,11 +941,16 @@ void PrepareAnim(AnimLayer & layer, unsigned long time, Entity *io) {
 
 				Vec3f * position = io ? &io->pos : NULL;
 				
+				long first = fr;
 				if(layer.lastframe < fr && layer.lastframe != -1) {
-					for(long n = layer.lastframe + 1; n <= fr; n++)
+					first = layer.lastframe + 1;
+				}
+				for(long n = first; n <= fr; n++) {
+					if(events) {
+						events->samples.push_back(anim->frames[n].sample);
+					} else {
 						ARX_SOUND_PlayAnim(anim->frames[n].sample, position);
-				} else {
-					ARX_SOUND_PlayAnim(anim->frames[fr].sample, position);
+					}
 				}
 			}
 
@@ -698,14 +960,20 @@ void PrepareAnim(AnimLayer & layer, unsigned long time, Entity *io) {
 			   && (layer.lastframe != fr)) {
 				
 				if(io && io != entities.player()) {
+					long first = fr;
 					if(layer.lastframe < fr && layer.lastframe != -1) {
-						for(long n = layer.lastframe + 1; n <= fr; n++) {
-							if(anim->frames[n].flag == 9)
-								ARX_NPC_NeedStepSound(io, io->pos);
+						first = layer.lastframe + 1;
+					}
+					for(long n = first; n <= fr; n++) {
+						if(anim->frames[n].flag != 9) {
+							continue;
+						}
+						if(events) {
+							events->steps++;
+						} else {
+							ARX_NPC_NeedStepSound(io, io->pos);
 						}
 					}
-					else if(anim->frames[fr].flag == 9)
-						ARX_NPC_NeedStepSound(io, io->pos);
 				}
 			}
 			
@@ -718,6 +986,19 @@ void PrepareAnim(AnimLayer & layer, unsigned long time, Entity *io) {
 	}
 }
 
+void PlayAnimFrameEvents(const AnimFrameEvents & events, Entity * io) {
+	
+	Vec3f * position = io ? &io->pos : NULL;
+	
+	for(size_t i = 0; i < events.samples.size(); i++) {
+		audio::SampleId sample = events.samples[i];
+		ARX_SOUND_PlayAnim(sample, position);
+	}
+	
+	for(size_t i = 0; i < events.steps; i++) {
+		ARX_NPC_NeedStepSound(io, io->pos);
+	}
+}
 
 void ResetAnim(AnimLayer & layer) {
 	
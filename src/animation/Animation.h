@@ -49,6 +49,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include <stddef.h>
 #include <string>
+#include <vector>
 
 #include "math/Types.h"
 #include "graphics/BaseGraphicsTypes.h"
@@ -139,6 +140,21 @@ struct AnimLayer {
 	long fr;
 };
 
+//! Frame sounds and step events reached while advancing animation layers
+struct AnimFrameEvents {
+	
+	AnimFrameEvents()
+		: steps(0)
+	{}
+	
+	std::vector<audio::SampleId> samples;
+	size_t steps;
+	
+	bool empty() const { return samples.empty() && steps == 0; }
+	void clear() { samples.clear(); steps = 0; }
+	
+};
+
 /*!
  * Cancel any existing animation and then start a new one.
  * This will reset the current annimation even if it is the same as the given animation.
@@ -192,7 +208,17 @@ void EERIE_ANIMMANAGER_ReleaseHandle(ANIM_HANDLE * anim);
 ANIM_HANDLE * EERIE_ANIMMANAGER_Load(const res::path & path);
 ANIM_HANDLE * EERIE_ANIMMANAGER_Load_NoWarning(const res::path & path);
 
-void PrepareAnim(AnimLayer & layer, unsigned long time, Entity *io);
+/*!
+ * Advance an animation layer
+ *
+ * \param events If not NULL, frame sounds and step events are stored here instead
+ *               of being played, so that they can be applied later with
+ *               PlayAnimFrameEvents().
+ */
+void PrepareAnim(AnimLayer & layer, unsigned long time, Entity * io,
+                 AnimFrameEvents * events = NULL);
+//! Play frame sounds and step events stored by PrepareAnim()
+void PlayAnimFrameEvents(const AnimFrameEvents & events, Entity * io);
 void ResetAnim(AnimLayer & layer);
 
 void AcquireLastAnim(Entity * io);
@@ -47,8 +47,11 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <utility>
+#include <vector>
 
 #include "animation/Animation.h"
+#include "animation/Skeleton.h"
 
 #include "core/Application.h"
 #include "core/GameTime.h"
@@ -74,18 +77,23 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "graphics/particle/ParticleEffects.h"
 #include "graphics/effects/Halo.h"
 
+#include "io/log/Logger.h"
+
 #include "math/Angle.h"
 #include "math/Vector.h"
 
 #include "physics/Collisions.h"
 
+#include "platform/JobPool.h"
 #include "platform/Platform.h"
+#include "platform/Time.h"
 #include "platform/profiler/Profiler.h"
 
 #include "scene/Light.h"
 #include "scene/GameSound.h"
 #include "scene/Scene.h"
 #include "scene/Interactive.h"
+#include "scene/LightBatch.h"
 
 extern Color ulBKGColor;
 
@@ -511,10 +519,13 @@ static bool Cedric_IO_Visible(const Vec3f & pos) {
 /* Object dynamic lighting */
 static void Cedric_ApplyLighting(EERIE_3DOBJ * eobj, Skeleton * obj, const ColorMod & colorMod) {
 
+	LightBatch lights;
+	PrepareLlights(lights, colorMod);
+
 	/* Apply light on all vertices */
 	for(size_t i = 0; i != obj->bones.size(); i++) {
 
-		glm::quat *quat = &obj->bones[i].anim.quat;
+		lights.setRotation(obj->bones[i].anim.quat);
 
 		/* Get light value for each vertex */
 		for(size_t v = 0; v != obj->bones[i].idxvertices.size(); v++) {
@@ -523,7 +534,7 @@ static void Cedric_ApplyLighting(EERIE_3DOBJ * eobj, Skeleton * obj, const Color
 			Vec3f & position = eobj->vertexlist3[vertexIndex].v;
 			Vec3f & normal = eobj->vertexlist[vertexIndex].norm;
 
-			eobj->vertexlist3[vertexIndex].vert.color = ApplyLight(quat, position, normal, colorMod);
+			eobj->vertexlist3[vertexIndex].vert.color = lights.apply(position, normal, colorMod.ambientColor);
 		}
 	}
 }
@@ -728,6 +739,12 @@ void DrawEERIEInter_Render(EERIE_3DOBJ *eobj, const TransformInfo &t, Entity *io
 
 	UpdateLlights(tv, false);
 
+	bool angular = io && (io->ioflags & IO_ANGULAR);
+
+	LightBatch lights;
+	PrepareLlights(lights, colorMod, angular ? 0.5f : 1.f);
+	lights.setRotation(t.rotation);
+
 	for(size_t i = 0; i < eobj->facelist.size(); i++) {
 		const EERIE_FACE & face = eobj->facelist[i];
 
@@ -746,16 +763,16 @@ void DrawEERIEInter_Render(EERIE_3DOBJ *eobj, const TransformInfo &t, Entity *io
 
 		for(size_t n = 0; n < 3; n++) {
 
-			if(io && (io->ioflags & IO_ANGULAR)) {
+			if(angular) {
 				const Vec3f & position = eobj->vertexlist3[face.vid[n]].v;
 				const Vec3f & normal = face.norm;
 
-				eobj->vertexlist3[face.vid[n]].vert.color = ApplyLight(&t.rotation, position, normal, colorMod, 0.5f);
+				eobj->vertexlist3[face.vid[n]].vert.color = lights.apply(position, normal, colorMod.ambientColor);
 			} else {
 				Vec3f & position = eobj->vertexlist3[face.vid[n]].v;
 				Vec3f & normal = eobj->vertexlist[face.vid[n]].norm;
 
-				eobj->vertexlist3[face.vid[n]].vert.color = ApplyLight(&t.rotation, position, normal, colorMod);
+				eobj->vertexlist3[face.vid[n]].vert.color = lights.apply(position, normal, colorMod.ambientColor);
 			}
 
 			tvList[n] = eobj->vertexlist[face.vid[n]].vert;
@@ -1401,37 +1418,89 @@ static void Cedric_ConcatenateTM(Skeleton & rig, const TransformInfo & t) {
 	}
 }
 
-/*!
- * Transform object vertices
- */
-static void Cedric_TransformVerts(EERIE_3DOBJ * eobj, const Vec3f & pos) {
+static glm::mat4x4 Cedric_BoneMatrix(const Bone & bone) {
+	
+	glm::mat4x4 matrix = glm::toMat4(bone.anim.quat);
+	
+	// Apply Scale
+	matrix[0][0] *= bone.anim.scale.x;
+	matrix[0][1] *= bone.anim.scale.x;
+	matrix[0][2] *= bone.anim.scale.x;
+
+	matrix[1][0] *= bone.anim.scale.y;
+	matrix[1][1] *= bone.anim.scale.y;
+	matrix[1][2] *= bone.anim.scale.y;
+
+	matrix[2][0] *= bone.anim.scale.z;
+	matrix[2][1] *= bone.anim.scale.z;
+	matrix[2][2] *= bone.anim.scale.z;
+	
+	return matrix;
+}
+
+//! Move the vertices of an object to the current bone transforms
+static void Cedric_SkinVerts(EERIE_3DOBJ * eobj) {
 
 	Skeleton & rig = *eobj->m_skeleton;
+	const SkinnedVertices & vertices = rig.vertices;
+	const long * indices = vertices.indices();
 
 	// Transform & project all vertices
 	for(size_t i = 0; i != rig.bones.size(); i++) {
 		Bone & bone = rig.bones[i];
 
-		glm::mat4x4 matrix = glm::toMat4(bone.anim.quat);
+		glm::mat4x4 matrix = Cedric_BoneMatrix(bone);
+
+		Vec3f vector = bone.anim.trans;
 		
-		// Apply Scale
-		matrix[0][0] *= bone.anim.scale.x;
-		matrix[0][1] *= bone.anim.scale.x;
-		matrix[0][2] *= bone.anim.scale.x;
+		// Transform contiguous runs of the bone's vertices, then scatter them
+		const size_t chunkSize = 64;
+		Vec3f transformed[chunkSize];
+		for(size_t begin = vertices.begin(i); begin < vertices.end(i); begin += chunkSize) {
+			size_t end = std::min(begin + chunkSize, vertices.end(i));
+			vertices.transform(begin, end, matrix, vector, transformed);
+			for(size_t v = begin; v < end; v++) {
+				EERIE_VERTEX & outVert = eobj->vertexlist3[indices[v]];
+				outVert.v = transformed[v - begin];
+				outVert.vert.p = outVert.v;
+			}
+		}
+	}
+}
 
-		matrix[1][0] *= bone.anim.scale.y;
-		matrix[1][1] *= bone.anim.scale.y;
-		matrix[1][2] *= bone.anim.scale.y;
+/*!
+ * Transform object vertices
+ */
+static void Cedric_TransformVerts(EERIE_3DOBJ * eobj, const Vec3f & pos) {
 
-		matrix[2][0] *= bone.anim.scale.z;
-		matrix[2][1] *= bone.anim.scale.z;
-		matrix[2][2] *= bone.anim.scale.z;
+	Cedric_SkinVerts(eobj);
 
-		Vec3f vector = bone.anim.trans;
+	if(eobj->sdata) {
+		for(size_t i = 0; i < eobj->vertexlist.size(); i++) {
+			eobj->vertexlist[i].vert.p = eobj->vertexlist3[i].v - pos;
+		}
+	}
+}
 
+/*!
+ * The per-vertex loop used before the vertices were sorted by bone
+ *
+ * Only kept as a baseline for SkinningBenchmark().
+ */
+static void Cedric_SkinVertsUnsorted(EERIE_3DOBJ * eobj) {
+	
+	Skeleton & rig = *eobj->m_skeleton;
+	
+	for(size_t i = 0; i != rig.bones.size(); i++) {
+		Bone & bone = rig.bones[i];
+		
+		glm::mat4x4 matrix = Cedric_BoneMatrix(bone);
+		
+		Vec3f vector = bone.anim.trans;
+		
 		for(size_t v = 0; v != bone.idxvertices.size(); v++) {
 			long index = bone.idxvertices[v];
-
+			
 			Vec3f & inVert = eobj->vertexlocal[index];
 			EERIE_VERTEX & outVert = eobj->vertexlist3[index];
 			
@@ -1441,12 +1510,57 @@ static void Cedric_TransformVerts(EERIE_3DOBJ * eobj, const Vec3f & pos) {
 			outVert.vert.p = outVert.v;
 		}
 	}
+}
 
-	if(eobj->sdata) {
-		for(size_t i = 0; i < eobj->vertexlist.size(); i++) {
-			eobj->vertexlist[i].vert.p = eobj->vertexlist3[i].v - pos;
+void SkinningBenchmark() {
+	
+	// Replay the current pose of each animated mesh, shared meshes only once
+	std::vector<EERIE_3DOBJ *> objects;
+	size_t vertexCount = 0;
+	for(size_t i = 0; i < entities.size(); i++) {
+		Entity * io = entities[EntityHandle(i)];
+		if(!io || !io->obj || !io->obj->m_skeleton || !io->obj->vertexlocal) {
+			continue;
+		}
+		if(std::find(objects.begin(), objects.end(), io->obj) != objects.end()) {
+			continue;
+		}
+		objects.push_back(io->obj);
+		vertexCount += io->obj->m_skeleton->vertices.size();
+	}
+	
+	if(vertexCount == 0) {
+		LogInfo << "Skinning benchmark: no animated meshes";
+		return;
+	}
+	
+	const size_t repeat = 100;
+	
+	// Both loops write the same values, so the meshes are left as they were
+	u64 start = platform::getTimeUs();
+	for(size_t r = 0; r < repeat; r++) {
+		for(size_t i = 0; i < objects.size(); i++) {
+			Cedric_SkinVertsUnsorted(objects[i]);
 		}
 	}
+	u64 unsortedTime = platform::getElapsedUs(start);
+	
+	start = platform::getTimeUs();
+	for(size_t r = 0; r < repeat; r++) {
+		for(size_t i = 0; i < objects.size(); i++) {
+			Cedric_SkinVerts(objects[i]);
+		}
+	}
+	u64 sortedTime = platform::getElapsedUs(start);
+	
+	double count = double(vertexCount) * double(repeat);
+	LogInfo << "Skinning benchmark: " << objects.size() << " meshes, " << vertexCount
+	        << " vertices x " << repeat;
+	LogInfo << " - per vertex: " << unsortedTime << " us, "
+	        << (unsortedTime > 0 ? count / double(unsortedTime) : 0.0) << " Mvertices/s";
+	LogInfo << " - sorted by bone (" << SkinnedVertices::getImplementation() << "): "
+	        << sortedTime << " us, "
+	        << (sortedTime > 0 ? count / double(sortedTime) : 0.0) << " Mvertices/s";
 }
 
 static void Cedric_ViewProjectTransform(EERIE_3DOBJ * eobj) {
@@ -1524,9 +1638,41 @@ static void Cedric_AnimateDrawEntity(Skeleton & skeleton, AnimLayer * animlayer,
 	}
 }
 
-void EERIEDrawAnimQuatUpdate(EERIE_3DOBJ *eobj, AnimLayer * animlayer,const Anglef & angle, const Vec3f & pos, unsigned long time, Entity *io, bool update_movement) {
+namespace {
 
-	ARX_PROFILE_FUNC();
+//! State needed to pose an object once its animation layers have been advanced
+struct AnimationPose {
+	
+	EERIE_3DOBJ * eobj;
+	AnimLayer animlayer[MAX_ANIM_LAYERS];
+	Entity * io;
+	Vec3f pos;
+	glm::quat rotation;
+	float scale;
+	Vec3f ftr;
+	EERIE_EXTRA_ROTATE * extraRotation;
+	AnimationBlendStatus * animBlend;
+	EERIE_EXTRA_SCALE extraScale;
+	
+};
+
+} // anonymous namespace
+
+/*!
+ * Advance the animation layers of an object and move the entity
+ *
+ * The layer state is copied into the pose so that it can be posed even if the
+ * layers are changed later on.
+ *
+ * \param events If not NULL, frame sounds and step events are stored here instead
+ *               of being played.
+ *
+ * \return false if the object is not visible and does not need to be posed.
+ */
+static bool Cedric_AdvanceAnimation(EERIE_3DOBJ * eobj, AnimLayer * animlayer,
+                                    const Anglef & angle, const Vec3f & pos,
+                                    unsigned long time, Entity * io, bool update_movement,
+                                    AnimationPose & pose, AnimFrameEvents * events) {
 	
 	if(io) {
 		float speedfactor = io->basespeed + io->speed_modif;
@@ -1554,7 +1700,7 @@ void EERIEDrawAnimQuatUpdate(EERIE_3DOBJ *eobj, AnimLayer * animlayer,const Angl
 		for(size_t count = 0; count < MAX_ANIM_LAYERS; count++) {
 			AnimLayer & layer = animlayer[count];
 			if(layer.cur_anim)
-				PrepareAnim(layer, time, io);
+				PrepareAnim(layer, time, io, events);
 		}
 	}
 
@@ -1570,7 +1716,7 @@ void EERIEDrawAnimQuatUpdate(EERIE_3DOBJ *eobj, AnimLayer * animlayer,const Angl
 		StoreEntityMovement(io, ftr, scale);
 
 	if(io && io != entities.player() && !Cedric_IO_Visible(io->pos))
-		return;
+		return false;
 
 	glm::quat rotation;
 
@@ -1599,25 +1745,170 @@ void EERIEDrawAnimQuatUpdate(EERIE_3DOBJ *eobj, AnimLayer * animlayer,const Angl
 		extraScale.groupIndex = eobj->fastaccess.head_group;
 		extraScale.scale = Vec3f_ONE;
 	}
+	
+	pose.eobj = eobj;
+	std::copy(animlayer, animlayer + MAX_ANIM_LAYERS, pose.animlayer);
+	pose.io = io;
+	pose.pos = pos;
+	pose.rotation = rotation;
+	pose.scale = scale;
+	pose.ftr = ftr;
+	pose.extraRotation = extraRotation;
+	pose.animBlend = animBlend;
+	pose.extraScale = extraScale;
+	
+	return true;
+}
 
+/*!
+ * Pose the skeleton and transform the vertices of an object
+ *
+ * Only touches the object and the entity's bounding boxes and blend state, so
+ * different objects may be posed in parallel.
+ */
+static void Cedric_PoseObject(AnimationPose & pose) {
+	
+	EERIE_3DOBJ * eobj = pose.eobj;
+	
 	arx_assert(eobj->m_skeleton);
 	Skeleton & skeleton = *eobj->m_skeleton;
 
-	Cedric_AnimateDrawEntity(skeleton, animlayer, extraRotation, animBlend, extraScale);
+	Cedric_AnimateDrawEntity(skeleton, pose.animlayer, pose.extraRotation, pose.animBlend,
+	                         pose.extraScale);
 
 	// Build skeleton in Object Space
-	TransformInfo t(pos, rotation, scale, ftr);
+	TransformInfo t(pose.pos, pose.rotation, pose.scale, pose.ftr);
 	Cedric_ConcatenateTM(skeleton, t);
 
-	Cedric_TransformVerts(eobj, pos);
-	if(io) {
-		UpdateBbox3d(eobj, io->bbox3D);
+	Cedric_TransformVerts(eobj, pose.pos);
+	if(pose.io) {
+		UpdateBbox3d(eobj, pose.io->bbox3D);
 	}
 
 	Cedric_ViewProjectTransform(eobj);
-	if(io) {
-		Cedric_UpdateBbox2d(*eobj, io->bbox2D);
+	if(pose.io) {
+		Cedric_UpdateBbox2d(*eobj, pose.io->bbox2D);
+	}
+}
+
+void EERIEDrawAnimQuatUpdate(EERIE_3DOBJ *eobj, AnimLayer * animlayer,const Anglef & angle, const Vec3f & pos, unsigned long time, Entity *io, bool update_movement) {
+
+	ARX_PROFILE_FUNC();
+	
+	AnimationPose pose;
+	if(Cedric_AdvanceAnimation(eobj, animlayer, angle, pos, time, io, update_movement,
+	                           pose, NULL)) {
+		Cedric_PoseObject(pose);
+	}
+}
+
+namespace {
+
+class AnimationPoseJob : public JobPool::Job {
+	
+public:
+	
+	AnimationPose pose;
+	bool visible;
+	AnimFrameEvents events;
+	
+	void run() {
+		Cedric_PoseObject(pose);
+	}
+	
+};
+
+std::vector<AnimationPoseJob> animationJobs;
+size_t animationJobCount = 0;
+std::vector<JobPool::Job *> animationJobList;
+std::vector<std::pair<EERIE_3DOBJ *, size_t> > animationObjects;
+std::vector<bool> animationShared;
+
+} // anonymous namespace
+
+void EERIEDrawAnimQuatQueueUpdate(EERIE_3DOBJ * eobj, AnimLayer * animlayer,
+                                  const Anglef & angle, const Vec3f & pos,
+                                  unsigned long time, Entity * io, bool update_movement) {
+	
+	// Jobs are reused between frames to keep the event buffers allocated
+	if(animationJobCount == animationJobs.size()) {
+		animationJobs.push_back(AnimationPoseJob());
+	}
+	AnimationPoseJob & job = animationJobs[animationJobCount];
+	
+	job.events.clear();
+	job.visible = Cedric_AdvanceAnimation(eobj, animlayer, angle, pos, time, io,
+	                                      update_movement, job.pose, &job.events);
+	if(!job.visible && job.events.empty()) {
+		return;
+	}
+	
+	job.pose.io = io;
+	animationJobCount++;
+}
+
+void FlushAnimationUpdates() {
+	
+	ARX_PROFILE_FUNC();
+	
+	if(animationJobCount == 0) {
+		return;
+	}
+	
+	// Objects shared by more than one entity must be posed in order on this thread
+	animationObjects.clear();
+	for(size_t i = 0; i < animationJobCount; i++) {
+		if(animationJobs[i].visible) {
+			animationObjects.push_back(std::make_pair(animationJobs[i].pose.eobj, i));
+		}
+	}
+	std::sort(animationObjects.begin(), animationObjects.end());
+	
+	animationShared.assign(animationJobCount, false);
+	for(size_t i = 1; i < animationObjects.size(); i++) {
+		if(animationObjects[i].first == animationObjects[i - 1].first) {
+			animationShared[animationObjects[i - 1].second] = true;
+			animationShared[animationObjects[i].second] = true;
+		}
+	}
+	
+	animationJobList.clear();
+	for(size_t i = 0; i < animationJobCount; i++) {
+		if(animationJobs[i].visible && !animationShared[i]) {
+			animationJobList.push_back(&animationJobs[i]);
+		}
+	}
+	
+	// Pose everything before any events are applied so that scripts see the new state
+	ARX_SCENE_GetJobPool().run(animationJobList);
+	
+	for(size_t i = 0; i < animationJobCount; i++) {
+		if(animationShared[i]) {
+			animationJobs[i].run();
+		}
 	}
+	
+	// Events may run scripts that destroy entities that have not been handled yet
+	for(size_t i = 0; i < animationJobCount; i++) {
+		const AnimationPoseJob & job = animationJobs[i];
+		if(job.events.empty()) {
+			continue;
+		}
+		if(job.pose.io && !ValidIOAddress(job.pose.io)) {
+			continue;
+		}
+		PlayAnimFrameEvents(job.events, job.pose.io);
+	}
+	
+	animationJobCount = 0;
+}
+
+void ReleaseAnimationUpdates() {
+	animationJobs.clear();
+	animationJobCount = 0;
+	animationJobList.clear();
+	animationObjects.clear();
+	animationShared.clear();
 }
 
 void EERIEDrawAnimQuatRender(EERIE_3DOBJ *eobj, const Vec3f & pos, Entity *io, float invisibility) {
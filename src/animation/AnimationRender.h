@@ -98,6 +98,36 @@ void DrawEERIEInter_Render(EERIE_3DOBJ *eobj, const TransformInfo &t, Entity *io
 void DrawEERIEInter(EERIE_3DOBJ *eobj, const TransformInfo & t, Entity *io, bool forceDraw = false, float invisibility = 0.f);
 
 void EERIEDrawAnimQuatUpdate(EERIE_3DOBJ *eobj, AnimLayer * animlayer,const Anglef & angle, const Vec3f & pos, unsigned long time, Entity *io, bool update_movement);
+
+/*!
+ * Like EERIEDrawAnimQuatUpdate(), but only advance the animation now
+ *
+ * Entity movement is still handled immediately. Posing the skeleton, transforming
+ * the vertices and playing the frame sounds and step events are deferred until
+ * the next call to FlushAnimationUpdates().
+ */
+void EERIEDrawAnimQuatQueueUpdate(EERIE_3DOBJ * eobj, AnimLayer * animlayer,
+                                  const Anglef & angle, const Vec3f & pos,
+                                  unsigned long time, Entity * io, bool update_movement);
+
+/*!
+ * Handle all objects queued by EERIEDrawAnimQuatQueueUpdate()
+ *
+ * The objects are first posed in parallel on the scene job pool. Their animation
+ * events are then applied on this thread, in the order the objects were queued.
+ */
+void FlushAnimationUpdates();
+
+void ReleaseAnimationUpdates();
+
+/*!
+ * Time skinning the current pose of all animated meshes
+ *
+ * Compares the old per-vertex loop with the bone-sorted transform and logs the
+ * vertex throughput of both.
+ */
+void SkinningBenchmark();
+
 void EERIEDrawAnimQuatRender(EERIE_3DOBJ *eobj, const Vec3f & pos, Entity *io, float invisibility);
 
 void EERIEDrawAnimQuat(EERIE_3DOBJ *eobj, AnimLayer * animlayer, const Anglef & angle, const Vec3f & pos, unsigned long time, Entity *io, bool update_movement = true, float invisibility = 0.f);
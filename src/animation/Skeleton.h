@@ -25,6 +25,7 @@
 
 #include "glm/gtc/quaternion.hpp"
 
+#include "animation/Skinning.h"
 #include "math/Types.h"
 
 struct VertexGroup {
@@ -60,6 +61,7 @@ struct Bone {
 
 struct Skeleton {
 	std::vector<Bone> bones;
+	SkinnedVertices vertices; //!< Local vertex positions sorted by bone
 };
 
 #endif // ARX_ANIMATION_SKELETON_H
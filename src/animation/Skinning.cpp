@@ -0,0 +1,143 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "animation/Skinning.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ARX_SKINNING_SSE2 1
+#include <emmintrin.h>
+#else
+#define ARX_SKINNING_SSE2 0
+#endif
+
+#include "animation/Skeleton.h"
+#include "platform/Platform.h"
+
+void SkinnedVertices::build(const std::vector<Bone> & bones, const Vec3f * local) {
+	
+	clear();
+	
+	size_t count = 0;
+	for(size_t i = 0; i < bones.size(); i++) {
+		count += bones[i].idxvertices.size();
+	}
+	
+	m_begin.reserve(bones.size() + 1);
+	m_indices.reserve(count);
+	m_x.reserve(count);
+	m_y.reserve(count);
+	m_z.reserve(count);
+	
+	for(size_t i = 0; i < bones.size(); i++) {
+		m_begin.push_back(m_indices.size());
+		const std::vector<long> & vertices = bones[i].idxvertices;
+		for(size_t v = 0; v < vertices.size(); v++) {
+			const Vec3f & pos = local[vertices[v]];
+			m_indices.push_back(vertices[v]);
+			m_x.push_back(pos.x);
+			m_y.push_back(pos.y);
+			m_z.push_back(pos.z);
+		}
+	}
+	m_begin.push_back(m_indices.size());
+}
+
+void SkinnedVertices::clear() {
+	m_begin.clear();
+	m_indices.clear();
+	m_x.clear();
+	m_y.clear();
+	m_z.clear();
+}
+
+void SkinnedVertices::transform(size_t begin, size_t end, const glm::mat4x4 & matrix,
+                                const Vec3f & translation, Vec3f * out) const {
+	
+	ARX_STATIC_ASSERT(sizeof(Vec3f) == 3 * sizeof(float), "Vec3f must be packed");
+	
+	size_t i = begin;
+	
+	/*
+	 * Evaluated in the same order as glm's mat4 * vec4:
+	 * (m[0] * x + m[1] * y) + (m[2] * z + m[3] * 1)
+	 */
+	
+	#if ARX_SKINNING_SSE2
+	
+	const __m128 m00 = _mm_set1_ps(matrix[0][0]);
+	const __m128 m01 = _mm_set1_ps(matrix[0][1]);
+	const __m128 m02 = _mm_set1_ps(matrix[0][2]);
+	const __m128 m10 = _mm_set1_ps(matrix[1][0]);
+	const __m128 m11 = _mm_set1_ps(matrix[1][1]);
+	const __m128 m12 = _mm_set1_ps(matrix[1][2]);
+	const __m128 m20 = _mm_set1_ps(matrix[2][0]);
+	const __m128 m21 = _mm_set1_ps(matrix[2][1]);
+	const __m128 m22 = _mm_set1_ps(matrix[2][2]);
+	const __m128 m30 = _mm_set1_ps(matrix[3][0]);
+	const __m128 m31 = _mm_set1_ps(matrix[3][1]);
+	const __m128 m32 = _mm_set1_ps(matrix[3][2]);
+	const __m128 tx = _mm_set1_ps(translation.x);
+	const __m128 ty = _mm_set1_ps(translation.y);
+	const __m128 tz = _mm_set1_ps(translation.z);
+	
+	for(; i + 4 <= end; i += 4, out += 4) {
+		
+		__m128 x = _mm_loadu_ps(&m_x[i]);
+		__m128 y = _mm_loadu_ps(&m_y[i]);
+		__m128 z = _mm_loadu_ps(&m_z[i]);
+		
+		__m128 rx = _mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m10, y));
+		__m128 ry = _mm_add_ps(_mm_mul_ps(m01, x), _mm_mul_ps(m11, y));
+		__m128 rz = _mm_add_ps(_mm_mul_ps(m02, x), _mm_mul_ps(m12, y));
+		rx = _mm_add_ps(_mm_add_ps(rx, _mm_add_ps(_mm_mul_ps(m20, z), m30)), tx);
+		ry = _mm_add_ps(_mm_add_ps(ry, _mm_add_ps(_mm_mul_ps(m21, z), m31)), ty);
+		rz = _mm_add_ps(_mm_add_ps(rz, _mm_add_ps(_mm_mul_ps(m22, z), m32)), tz);
+		
+		// Interleave into x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+		__m128 xy01 = _mm_unpacklo_ps(rx, ry); // x0 y0 x1 y1
+		__m128 zx01 = _mm_unpacklo_ps(rz, rx); // z0 x0 z1 x1
+		__m128 yz01 = _mm_unpacklo_ps(ry, rz); // y0 z0 y1 z1
+		__m128 xy23 = _mm_unpackhi_ps(rx, ry); // x2 y2 x3 y3
+		__m128 zx23 = _mm_unpackhi_ps(rz, rx); // z2 x2 z3 x3
+		__m128 yz23 = _mm_unpackhi_ps(ry, rz); // y2 z2 y3 z3
+		float * dst = &out->x;
+		_mm_storeu_ps(dst + 0, _mm_shuffle_ps(xy01, zx01, _MM_SHUFFLE(3, 0, 1, 0)));
+		_mm_storeu_ps(dst + 4, _mm_shuffle_ps(yz01, xy23, _MM_SHUFFLE(1, 0, 3, 2)));
+		_mm_storeu_ps(dst + 8, _mm_shuffle_ps(zx23, yz23, _MM_SHUFFLE(3, 2, 3, 0)));
+	}
+	
+	#endif
+	
+	for(; i < end; i++, out++) {
+		float x = m_x[i];
+		float y = m_y[i];
+		float z = m_z[i];
+		out->x = ((matrix[0][0] * x + matrix[1][0] * y) + (matrix[2][0] * z + matrix[3][0])) + translation.x;
+		out->y = ((matrix[0][1] * x + matrix[1][1] * y) + (matrix[2][1] * z + matrix[3][1])) + translation.y;
+		out->z = ((matrix[0][2] * x + matrix[1][2] * y) + (matrix[2][2] * z + matrix[3][2])) + translation.z;
+	}
+}
+
+const char * SkinnedVertices::getImplementation() {
+	#if ARX_SKINNING_SSE2
+	return "SSE2";
+	#else
+	return "scalar";
+	#endif
+}
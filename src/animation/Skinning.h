@@ -0,0 +1,84 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_ANIMATION_SKINNING_H
+#define ARX_ANIMATION_SKINNING_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "math/Types.h"
+
+struct Bone;
+
+/*!
+ * Local vertex positions of a mesh, sorted by bone
+ *
+ * Positions are stored as separate x, y and z arrays so that the vertices of a bone
+ * can be transformed four at a time with SSE2. A scalar implementation is used on
+ * other platforms.
+ */
+class SkinnedVertices {
+	
+public:
+	
+	/*!
+	 * Copy the local positions of the vertices of each bone
+	 *
+	 * \param local Local vertex positions, indexed by the bones' idxvertices.
+	 */
+	void build(const std::vector<Bone> & bones, const Vec3f * local);
+	
+	void clear();
+	
+	size_t size() const { return m_indices.size(); }
+	
+	//! Index of the first sorted vertex of a bone
+	size_t begin(size_t bone) const { return m_begin[bone]; }
+	
+	//! Index after the last sorted vertex of a bone
+	size_t end(size_t bone) const { return m_begin[bone + 1]; }
+	
+	//! Mesh vertex index for each sorted vertex
+	const long * indices() const { return m_indices.empty() ? NULL : &m_indices[0]; }
+	
+	/*!
+	 * Transform the sorted vertices in [begin, end)
+	 *
+	 * out[i] is set to Vec3f(matrix * Vec4f(local, 1.f)) + translation for the
+	 * sorted vertex begin + i. The result is bit-identical to computing that
+	 * expression with glm.
+	 */
+	void transform(size_t begin, size_t end, const glm::mat4x4 & matrix,
+	               const Vec3f & translation, Vec3f * out) const;
+	
+	//! Name of the transform() implementation used in this build
+	static const char * getImplementation();
+	
+private:
+	
+	std::vector<size_t> m_begin;
+	std::vector<long> m_indices;
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_z;
+	
+};
+
+#endif // ARX_ANIMATION_SKINNING_H
@@ -56,6 +56,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "ai/PathFinderManager.h"
 #include "ai/Paths.h"
+#include "ai/Perception.h"
 
 #include "animation/Animation.h"
 #include "animation/AnimationRender.h"
@@ -127,11 +128,13 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "math/Vector.h"
 
 #include "physics/Attractors.h"
+#include "physics/Collisions.h"
 #include "platform/Time.h"
 
 #include "io/fs/FilePath.h"
 #include "io/fs/Filesystem.h"
 #include "io/fs/SystemPaths.h"
+#include "io/resource/PakPrefetcher.h"
 #include "io/resource/PakReader.h"
 #include "io/Screenshot.h"
 #include "io/log/CriticalLogger.h"
@@ -980,6 +983,8 @@ static const char * default_paks[][2] = {
 	{ "speech.pak", "speech_default.pak" },
 };
 
+static PakPrefetchPool * g_pakPrefetcher = NULL;
+
 #if ARX_PLATFORM != ARX_PLATFORM_WIN32
 static void runDataFilesInstaller() {
 	static const char * const command[] = { "arx-install-data", "--gui", NULL };
@@ -997,6 +1002,9 @@ bool ArxGame::addPaks() {
 	
 	resources = new PakReader;
 	
+	g_pakPrefetcher = new PakPrefetchPool;
+	resources->setPrefetcher(g_pakPrefetcher);
+	
 	// Load required pak files
 	bool missing = false;
 	for(size_t i = 0; i < ARRAY_SIZE(default_paks); i++) {
@@ -1121,6 +1129,8 @@ void ArxGame::shutdownGame() {
 	config.save();
 	
 	RoomDrawRelease();
+	ARX_SCENE_Release();
+	ReleaseAnimationUpdates();
 	EXITING=1;
 	TREATZONE_Release();
 	ClearTileLights();
@@ -1162,6 +1172,8 @@ void ArxGame::shutdownGame() {
 	//object loaders from beforerun
 	gui::ReleaseNecklace();
 	
+	resources->setPrefetcher(NULL);
+	delete g_pakPrefetcher, g_pakPrefetcher = NULL;
 	delete resources;
 	
 	// Current game
@@ -1686,7 +1698,7 @@ void ArxGame::updateInput() {
 		ComputePortalVertexBuffer();
 		*/
 		
-		profiler::flush();
+		profiler::toggle();
 	}
 
 	if(GInput->isKeyPressedNowPressed(Keyboard::Key_F11)) {
@@ -1749,6 +1761,7 @@ void ArxGame::updateLevel() {
 	ARX_PROFILE_FUNC();
 	
 	RenderBatcher::getInstance().clear();
+	RenderBatcher::getInstance().resetStatistics();
 
 	if(!PLAYER_PARALYSED) {
 		manageEditorControls();
@@ -1857,7 +1870,9 @@ void ArxGame::updateLevel() {
 		ARX_INTERACTIVE_Show_Hide_1st(entities.player(), 1);
 	}
 
+	ARX_COLLISION_NewFrame();
 	PrepareIOTreatZone();
+	ARX_PERCEPTION_Update();
 	ARX_PHYSICS_Apply();
 
 	PrecalcIOLighting(ACTIVECAM->orgTrans.pos, ACTIVECAM->cdepth * 0.6f);
@@ -2169,6 +2184,15 @@ void ArxGame::render() {
 	if(g_debugTriggers[1])
 		g_hudRoot.bookIconGui.requestFX();
 	
+	if(g_debugTriggers[2])
+		RaycastBenchmark();
+	
+	if(g_debugTriggers[3])
+		SkinningBenchmark();
+	
+	if(g_debugTriggers[4])
+		ARX_EQUIPMENT_TweakBenchmark();
+	
 	if(isInMenu()) {
 		renderMenu();
 	} else if(isInCinematic()) {
@@ -2279,7 +2303,7 @@ void ArxGame::update2DFX() {
 				}
 
 				if(ltvv.p.z > fZFar ||
-					EERIELaunchRay3(ACTIVECAM->orgTrans.pos, ee3dlv, hit, 1) ||
+					EERIELaunchRay3(ACTIVECAM->orgTrans.pos, ee3dlv, hit) ||
 					GetFirstInterAtPos(ees2dlv, 3, &ee3dlv, pTableIO, &nNbInTableIO )
 					)
 				{
@@ -66,7 +66,10 @@ const int
 	ambianceVolume = 10,
 	mouseSensitivity = 6,
 	migration = Config::OriginalAssets,
-	quicksaveSlots = 3;
+	quicksaveSlots = 3,
+	pathfinderThreads = 0,
+	meshCacheSize = 32,
+	maxParticles = 8192;
 
 const bool
 	fullscreen = true,
@@ -82,7 +85,8 @@ const bool
 	mouseLookToggle = true,
 	autoDescription = true,
 	forceToggle = false,
-	hudScale = false;
+	hudScale = false,
+	animationCache = true;
 
 ActionKey actions[NUM_ACTION_KEY] = {
 	ActionKey(Keyboard::Key_Spacebar), // JUMP
@@ -236,6 +240,10 @@ const std::string
 	forceToggle = "forcetoggle",
 	migration = "migration",
 	quicksaveSlots = "quicksave_slots",
+	pathfinderThreads = "pathfinder_threads",
+	meshCacheSize = "mesh_cache_size",
+	animationCache = "animation_cache",
+	maxParticles = "max_particles",
 	debugLevels = "debug";
 
 } // namespace Key
@@ -424,6 +432,10 @@ bool Config::save() {
 	writer.writeKey(Key::forceToggle, misc.forceToggle);
 	writer.writeKey(Key::migration, misc.migration);
 	writer.writeKey(Key::quicksaveSlots, misc.quicksaveSlots);
+	writer.writeKey(Key::pathfinderThreads, misc.pathfinderThreads);
+	writer.writeKey(Key::meshCacheSize, misc.meshCacheSize);
+	writer.writeKey(Key::animationCache, misc.animationCache);
+	writer.writeKey(Key::maxParticles, misc.maxParticles);
 	writer.writeKey(Key::debugLevels, misc.debug);
 	
 	return writer.flush();
@@ -513,6 +525,10 @@ bool Config::init(const fs::path & file) {
 	misc.forceToggle = reader.getKey(Section::Misc, Key::forceToggle, Default::forceToggle);
 	misc.migration = (MigrationStatus)reader.getKey(Section::Misc, Key::migration, Default::migration);
 	misc.quicksaveSlots = std::max(reader.getKey(Section::Misc, Key::quicksaveSlots, Default::quicksaveSlots), 1);
+	misc.pathfinderThreads = std::max(reader.getKey(Section::Misc, Key::pathfinderThreads, Default::pathfinderThreads), 0);
+	misc.meshCacheSize = std::max(reader.getKey(Section::Misc, Key::meshCacheSize, Default::meshCacheSize), 0);
+	misc.animationCache = reader.getKey(Section::Misc, Key::animationCache, Default::animationCache);
+	misc.maxParticles = std::max(reader.getKey(Section::Misc, Key::maxParticles, Default::maxParticles), 0);
 	misc.debug = reader.getKey(Section::Misc, Key::debugLevels, Default::debugLevels);
 	
 	return loaded;
@@ -172,6 +172,14 @@ public:
 		
 		int quicksaveSlots;
 		
+		int pathfinderThreads; //!< Number of pathfinder threads, 0 to choose automatically
+		
+		int meshCacheSize; //!< Memory budget for parsed FTL meshes in MiB, 0 to disable the cache
+		
+		bool animationCache; //!< Store converted TEA animations in the user directory
+		
+		int maxParticles; //!< Maximum number of live particles, applied when particles are cleared
+		
 		std::string debug; //!< Logger debug levels.
 		
 	} misc;
@@ -177,6 +177,8 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 		LogInfo << "Starting " << arx_version;
 		runGame();
 		
+		profiler::shutdown();
+		
 	}
 	
 	// Shutdown the logging system
@@ -150,6 +150,7 @@ Entity::Entity(const res::path & classPath, EntityInstance instance)
 	
 	stat_count = 0;
 	stat_sent = 0;
+	timers = -1;
 	tweakerinfo = NULL;
 	material = MATERIAL_NONE;
 	
@@ -302,6 +302,7 @@ public:
 	EERIE_SCRIPT over_script; // Overriding Script
 	short stat_count;
 	short stat_sent;
+	long timers; //!< First script timer owned by this entity or -1
 	IO_TWEAKER_INFO * tweakerinfo; // optional tweaker infos
 	Material material;
 	
@@ -73,9 +73,11 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "graphics/Vertex.h"
 #include "graphics/data/Mesh.h"
 #include "graphics/data/MeshManipulation.h"
+#include "graphics/data/MeshTweak.h"
 #include "graphics/data/TextureContainer.h"
 #include "graphics/particle/ParticleEffects.h"
 
+#include "io/log/Logger.h"
 #include "io/resource/ResourcePath.h"
 
 #include "math/Random.h"
@@ -84,6 +86,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "physics/Collisions.h"
 
 #include "platform/Platform.h"
+#include "platform/Time.h"
 #include "platform/profiler/Profiler.h"
 
 #include "scene/Object.h"
@@ -291,6 +294,83 @@ void ARX_EQUIPMENT_RecreatePlayerMesh() {
 	ARX_INTERACTIVE_RemoveGoreOnIO(entities.player()); 
 }
 
+void ARX_EQUIPMENT_TweakBenchmark() {
+	
+	const res::path base = "graph/obj3d/interactive/npc/human_base/human_base.teo";
+	EERIE_3DOBJ * obj = loadObject(base, false);
+	if(!obj) {
+		LogInfo << "Tweak benchmark: could not load " << base;
+		return;
+	}
+	
+	// Same order as ARX_EQUIPMENT_RecreatePlayerMesh()
+	const EquipmentSlot slots[] = { EQUIP_SLOT_HELMET, EQUIP_SLOT_ARMOR, EQUIP_SLOT_LEGGINGS };
+	const TweakType types[] = { TWEAK_HEAD, TWEAK_TORSO, TWEAK_LEGS };
+	
+	std::vector<EERIE_3DOBJ *> tweaks;
+	std::vector<TweakType> tweakTypes;
+	for(size_t i = 0; i < ARRAY_SIZE(slots); i++) {
+		
+		if(!ValidIONum(player.equiped[slots[i]])) {
+			continue;
+		}
+		
+		const IO_TWEAKER_INFO * tweak = entities[player.equiped[slots[i]]]->tweakerinfo;
+		if(!tweak || tweak->filename.empty()) {
+			continue;
+		}
+		
+		res::path mesh = "graph/obj3d/interactive/npc/human_base/tweaks" / tweak->filename;
+		EERIE_3DOBJ * tobj = loadObject(mesh);
+		if(tobj) {
+			tweaks.push_back(tobj);
+			tweakTypes.push_back(types[i]);
+		}
+	}
+	
+	if(tweaks.empty()) {
+		LogInfo << "Tweak benchmark: no equipped items change the player mesh";
+		delete obj;
+		return;
+	}
+	
+	const size_t repeat = 10;
+	
+	size_t vertexCount = 0;
+	size_t faceCount = 0;
+	u64 start = platform::getTimeUs();
+	for(size_t r = 0; r < repeat; r++) {
+		
+		EERIE_3DOBJ * work = obj;
+		for(size_t i = 0; i < tweaks.size(); i++) {
+			// EERIE_MESH_TWEAK_Do() keeps the old mesh if the merge fails
+			EERIE_3DOBJ * result = CreateIntermediaryMesh(work, tweaks[i], tweakTypes[i]);
+			if(result) {
+				if(work != obj) {
+					delete work;
+				}
+				work = result;
+			}
+		}
+		
+		vertexCount = work->vertexlist.size();
+		faceCount = work->facelist.size();
+		if(work != obj) {
+			delete work;
+		}
+	}
+	u64 time = platform::getElapsedUs(start);
+	
+	LogInfo << "Tweak benchmark: " << tweaks.size() << " merges x " << repeat << " into "
+	        << vertexCount << " vertices and " << faceCount << " faces";
+	LogInfo << " - " << time << " us, " << (time / (repeat * tweaks.size())) << " us per merge";
+	
+	for(size_t i = 0; i < tweaks.size(); i++) {
+		delete tweaks[i];
+	}
+	delete obj;
+}
+
 void ARX_EQUIPMENT_UnEquipAllPlayer() {
 	for(long i = 0; i < MAX_EQUIPED; i++) {
 		if(ValidIONum(player.equiped[i])) {
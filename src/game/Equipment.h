@@ -123,6 +123,14 @@ float getEquipmentModifier(EquipmentModifierType modifier, float baseval);
 
 bool ARX_EQUIPMENT_Strike_Check(Entity * io_source, Entity * io_weapon, float percentaim, long flags, EntityHandle targ = EntityHandle::Invalid);
 void ARX_EQUIPMENT_RecreatePlayerMesh();
+
+/*!
+ * Time the mesh merges done by EERIE_MESH_TWEAK_Do() for the player's equipment
+ *
+ * Repeats the head, chest and leggings merges of ARX_EQUIPMENT_RecreatePlayerMesh()
+ * on freshly loaded meshes and logs the time taken. The player is not changed.
+ */
+void ARX_EQUIPMENT_TweakBenchmark();
 float ARX_EQUIPMENT_ComputeDamages(Entity * io_source, Entity * io_target, float ratioaim, Vec3f * pos = NULL);
  
 void ARX_EQUIPMENT_IdentifyAll();
@@ -63,6 +63,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "ai/Paths.h"
 #include "ai/PathFinderManager.h"
+#include "ai/Perception.h"
 
 #include "core/GameTime.h"
 #include "core/Core.h"
@@ -509,28 +510,7 @@ static long ARX_NPC_GetNextAttainableNodeIncrement(Entity * io) {
  * \brief Checks for nearest VALID anchor for a cylinder from a position
  */
 static long AnchorData_GetNearest(const Vec3f & pos, const Cylinder & cyl, long except = -1) {
-	long returnvalue = -1;
-	float distmax = std::numeric_limits<float>::max();
-	EERIE_BACKGROUND * eb = ACTIVEBKG;
-
-	for(long i = 0; i < eb->nbanchors; i++) {
-		if(except != -1 && i == except)
-			continue;
-
-		if(eb->anchors[i].nblinked) {
-			float d = glm::distance2(eb->anchors[i].pos, pos);
-
-			if ((d < distmax) && (eb->anchors[i].height <= cyl.height)
-			        && (eb->anchors[i].radius >= cyl.radius)
-			        && (!(eb->anchors[i].flags & ANCHOR_FLAG_BLOCKED)))
-			{
-				returnvalue = i;
-				distmax = d;
-			}
-		}
-	}
-
-	return returnvalue;
+	return ARX_PERCEPTION_GetNearestAnchor(pos, cyl, except);
 }
 
 static long AnchorData_GetNearest_2(float beta, const Vec3f & pos, const Cylinder & cyl) {
@@ -2626,8 +2606,11 @@ Entity * ARX_NPC_GetFirstNPCInSight(Entity * ioo)
 	Entity * found_io = NULL;
 	float found_dist = std::numeric_limits<float>::max();
 
-	for(size_t i = 0; i < entities.size(); i++) {
-		const EntityHandle handle = EntityHandle(i);
+	std::vector<long> nearby;
+	ARX_PERCEPTION_GetNearbyEntities(ioo->pos, 1800.f, nearby);
+
+	for(size_t n = 0; n < nearby.size(); n++) {
+		const EntityHandle handle = EntityHandle(nearby[n]);
 		Entity * io = entities[handle];
 
 		if(   !io
@@ -2871,8 +2854,12 @@ void ARX_NPC_SpawnAudibleSound(const Vec3f & pos, Entity * source, const float f
 	
 	long Source_Room = ARX_PORTALS_GetRoomNumForPosition(pos, 1);
 	
-	for(size_t i = 0; i < entities.size(); i++) {
-		const EntityHandle handle = EntityHandle(i);
+	// Not reused between calls: the SM_HEAR handlers can spawn more sounds
+	std::vector<long> nearby;
+	ARX_PERCEPTION_GetNearbyEntities(pos, max_distance, nearby);
+	
+	for(size_t n = 0; n < nearby.size(); n++) {
+		const EntityHandle handle = EntityHandle(nearby[n]);
 		Entity * entity = entities[handle];
 		
 		if(   entity
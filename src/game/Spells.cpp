@@ -167,6 +167,8 @@ void SpellManager::clearAll() {
 		
 		m_spells[i] = NULL;
 	}
+	
+	m_targetIndex.clear();
 }
 
 SpellBase * SpellManager::operator[](const SpellHandle handle) {
@@ -232,11 +234,70 @@ bool SpellManager::ExistAnyInstanceForThisCaster(SpellType typ, EntityHandle cas
 	return false;
 }
 
+ARX_STATIC_ASSERT(MAX_SPELLS <= 32, "spell slot masks are 32-bit");
+
+bool SpellManager::isActive(const SpellBase * spell) const {
+	long i = spell->m_thisHandle;
+	return i >= 0 && size_t(i) < MAX_SPELLS && m_spells[i] == spell;
+}
+
+void SpellManager::indexTarget(SpellBase * spell, EntityHandle target) {
+	
+	if(!isActive(spell)) {
+		// Indexed by addSpell()
+		return;
+	}
+	
+	m_targetIndex[std::make_pair(long(target), long(spell->m_type))] |= u32(1) << spell->m_thisHandle;
+}
+
+void SpellManager::unindexTargets(SpellBase * spell) {
+	
+	if(!isActive(spell)) {
+		return;
+	}
+	
+	u32 bit = u32(1) << spell->m_thisHandle;
+	
+	std::vector<EntityHandle>::const_iterator itr;
+	for(itr = spell->m_targets.begin(); itr != spell->m_targets.end(); ++itr) {
+		TargetIndex::iterator entry = m_targetIndex.find(std::make_pair(long(*itr), long(spell->m_type)));
+		if(entry != m_targetIndex.end()) {
+			entry->second &= ~bit;
+			if(!entry->second) {
+				m_targetIndex.erase(entry);
+			}
+		}
+	}
+}
+
 SpellBase * SpellManager::getSpellOnTarget(EntityHandle target, SpellType type)
 {
 	if(target == EntityHandle::Invalid)
 		return NULL;
 	
+	SpellBase * result = NULL;
+	
+	if(!m_targetIndex.empty()) {
+		TargetIndex::const_iterator entry = m_targetIndex.find(std::make_pair(long(target), long(type)));
+		if(entry != m_targetIndex.end()) {
+			u32 mask = entry->second;
+			size_t i = 0;
+			while(!(mask & 1)) {
+				mask >>= 1, i++;
+			}
+			result = m_spells[i];
+		}
+	}
+	
+	arx_assert(result == findSpellOnTarget(target, type));
+	
+	return result;
+}
+
+#ifdef ARX_DEBUG
+SpellBase * SpellManager::findSpellOnTarget(EntityHandle target, SpellType type) {
+	
 	for(size_t i = 0; i < MAX_SPELLS; i++) {
 		SpellBase * spell = m_spells[i];
 		if(!spell)
@@ -252,6 +313,7 @@ SpellBase * SpellManager::getSpellOnTarget(EntityHandle target, SpellType type)
 	
 	return NULL;
 }
+#endif
 
 void SpellManager::replaceCaster(EntityHandle oldCaster, EntityHandle newCaster) {
 	for(size_t i = 0; i < MAX_SPELLS; i++) {
@@ -270,7 +332,20 @@ void SpellManager::removeTarget(Entity *io) {
 		if(!spell)
 			continue;
 		
-		spell->m_targets.erase(std::remove(spell->m_targets.begin(), spell->m_targets.end(), io->index()), spell->m_targets.end());
+		std::vector<EntityHandle>::iterator end;
+		end = std::remove(spell->m_targets.begin(), spell->m_targets.end(), io->index());
+		if(end == spell->m_targets.end()) {
+			continue;
+		}
+		spell->m_targets.erase(end, spell->m_targets.end());
+		
+		TargetIndex::iterator entry = m_targetIndex.find(std::make_pair(long(io->index()), long(spell->m_type)));
+		if(entry != m_targetIndex.end()) {
+			entry->second &= ~(u32(1) << i);
+			if(!entry->second) {
+				m_targetIndex.erase(entry);
+			}
+		}
 	}
 }
 
@@ -292,6 +367,11 @@ void SpellManager::addSpell(SpellBase * spell)
 		if(!m_spells[i]) {
 			m_spells[i] = spell;
 			spell->m_thisHandle = SpellHandle(i);
+			// Targets added by Launch() were not indexed yet
+			std::vector<EntityHandle>::const_iterator itr;
+			for(itr = spell->m_targets.begin(); itr != spell->m_targets.end(); ++itr) {
+				indexTarget(spell, *itr);
+			}
 			return;
 		}
 	}
@@ -301,6 +381,7 @@ void SpellManager::freeSlot(SpellBase * spell)
 {
 	for(size_t i = 0; i < MAX_SPELLS; i++) {
 		if(m_spells[i] == spell) {
+			unindexTargets(spell);
 			delete m_spells[i];
 			m_spells[i] = NULL;
 			return;
@@ -47,6 +47,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include <stddef.h>
 #include <string>
+#include <utility>
+
+#include <boost/unordered_map.hpp>
 
 #include "audio/AudioTypes.h"
 #include "game/magic/Precast.h"
@@ -59,6 +62,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "math/Random.h"
 #include "math/Vector.h"
 #include "platform/Flags.h"
+#include "platform/Platform.h"
 #include "scene/Light.h"
 
 class Entity;
@@ -97,7 +101,31 @@ public:
 	SpellHandle create();
 	
 private:
+	
+	friend class SpellBase;
+	
+	bool isActive(const SpellBase * spell) const;
+	
+	//! Record that an active spell affects the target
+	void indexTarget(SpellBase * spell, EntityHandle target);
+	//! Forget all targets of an active spell
+	void unindexTargets(SpellBase * spell);
+	
+	#ifdef ARX_DEBUG
+	SpellBase * findSpellOnTarget(EntityHandle target, SpellType type);
+	#endif
+	
 	SpellBase * m_spells[MAX_SPELLS];
+	
+	/*!
+	 * Active spells affecting each target, by spell type
+	 *
+	 * Each value is a bit mask of spell slots. Lookups return the spell in the
+	 * lowest slot, like a scan over all slots would.
+	 */
+	typedef boost::unordered_map<std::pair<long, long>, u32> TargetIndex;
+	TargetIndex m_targetIndex;
+	
 };
 
 extern SpellManager spells;
@@ -19,6 +19,7 @@
 
 #include "game/EntityManager.h"
 #include "game/Player.h"
+#include "game/Spells.h"
 #include "game/magic/Spell.h"
 #include "scene/Interactive.h"
 
@@ -39,6 +40,16 @@ SpellBase::SpellBase()
 	m_targets.clear();
 }
 
+void SpellBase::addTarget(EntityHandle target) {
+	m_targets.push_back(target);
+	spells.indexTarget(this, target);
+}
+
+void SpellBase::clearTargets() {
+	spells.unindexTargets(this);
+	m_targets.clear();
+}
+
 Vec3f SpellBase::getPosition() {
 	return getCasterPosition();
 }
@@ -177,13 +177,26 @@ public:
 	audio::SourceId m_snd_loop;
 	
 	long m_launchDuration;
-
 	
-	std::vector<EntityHandle> m_targets;
+	const std::vector<EntityHandle> & targets() const { return m_targets; }
 	
 protected:
+	
+	/*!
+	 * Entities affected by this spell
+	 *
+	 * Only modify this through addTarget() and clearTargets() so that the
+	 * spell manager's target index stays up to date.
+	 */
+	std::vector<EntityHandle> m_targets;
+	
+	void addTarget(EntityHandle target);
+	void clearTargets();
+	
 	Vec3f getTargetPos(EntityHandle source, EntityHandle target);
 	
+	friend class SpellManager;
+	
 public:
 	ARX_USE_ALIGNED_NEW(SpellBase)
 };
@@ -211,7 +211,7 @@ void DetectTrapSpell::Launch()
 	m_fManaCostPerSecond = 0.4f;
 	m_hasDuration = true;
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void DetectTrapSpell::End()
@@ -219,7 +219,7 @@ void DetectTrapSpell::End()
 	if(m_caster == PlayerEntityHandle) {
 		ARX_SOUND_Stop(m_snd_loop);
 	}
-	m_targets.clear();
+	clearTargets();
 }
 
 void DetectTrapSpell::Update(float timeDelta) {
@@ -264,7 +264,7 @@ void ArmorSpell::Launch()
 		io->halo.radius = 45.f;
 	}
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void ArmorSpell::End()
@@ -276,7 +276,7 @@ void ArmorSpell::End()
 		ARX_HALO_SetToNative(entities[m_target]);
 	}
 	
-	m_targets.clear();
+	clearTargets();
 }
 
 void ArmorSpell::Update(float timeDelta)
@@ -336,7 +336,7 @@ void LowerArmorSpell::Launch()
 		}
 	}
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void LowerArmorSpell::End()
@@ -349,7 +349,7 @@ void LowerArmorSpell::End()
 		ARX_HALO_SetToNative(io);
 	}
 	
-	m_targets.clear();
+	clearTargets();
 }
 
 void LowerArmorSpell::Update(float timeDelta)
@@ -85,12 +85,12 @@ void SpeedSpell::Launch()
 		m_trails.push_back(trail);
 	}
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void SpeedSpell::End() {
 	
-	m_targets.clear();
+	clearTargets();
 	
 	if(m_caster == PlayerEntityHandle)
 		ARX_SOUND_Stop(m_snd_loop);
@@ -66,12 +66,12 @@ void BlessSpell::Launch()
 	tex_p1 = TextureContainer::Load("graph/obj3d/textures/(fx)_tsu_blueting");
 	tex_sol = TextureContainer::Load("graph/particles/(fx)_pentagram_bless");
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void BlessSpell::End() {
 	
-	m_targets.clear();
+	clearTargets();
 }
 
 void BlessSpell::Update(float timeDelta) {
@@ -247,7 +247,7 @@ void FireProtectionSpell::Launch()
 		io->halo.radius = 45.f;
 	}
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 	
 	m_snd_loop = ARX_SOUND_PlaySFX(SND_SPELL_FIRE_PROTECTION_LOOP, &entities[m_target]->pos, 1.f, ARX_SOUND_PLAY_LOOPED);
 }
@@ -256,7 +256,7 @@ void FireProtectionSpell::End()
 {
 	ARX_SOUND_Stop(m_snd_loop);
 	ARX_SOUND_PlaySFX(SND_SPELL_FIRE_PROTECTION_END, &entities[m_target]->pos);
-	m_targets.clear();
+	clearTargets();
 	
 	if(ValidIONum(m_target))
 		ARX_HALO_SetToNative(entities[m_target]);
@@ -310,14 +310,14 @@ void ColdProtectionSpell::Launch()
 	
 	m_snd_loop = ARX_SOUND_PlaySFX(SND_SPELL_COLD_PROTECTION_LOOP, &entities[m_target]->pos, 1.f, ARX_SOUND_PLAY_LOOPED);
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void ColdProtectionSpell::End()
 {
 	ARX_SOUND_Stop(m_snd_loop);
 	ARX_SOUND_PlaySFX(SND_SPELL_COLD_PROTECTION_END, &entities[m_target]->pos);
-	m_targets.clear();
+	clearTargets();
 	
 	if(ValidIONum(m_target))
 		ARX_HALO_SetToNative(entities[m_target]);
@@ -396,12 +396,12 @@ void CurseSpell::Launch()
 	fRot = 0.f;
 	tex_p1 = TextureContainer::Load("graph/obj3d/textures/(fx)_tsu_blueting");
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void CurseSpell::End() {
 	
-	m_targets.clear();
+	clearTargets();
 }
 
 void CurseSpell::Update(float timeDelta) {
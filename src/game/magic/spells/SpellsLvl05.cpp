@@ -197,14 +197,14 @@ void LevitateSpell::Launch()
 	
 	m_snd_loop = ARX_SOUND_PlaySFX(SND_SPELL_LEVITATE_LOOP, &entities[m_target]->pos, 0.7f, ARX_SOUND_PLAY_LOOPED);
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void LevitateSpell::End()
 {
 	ARX_SOUND_Stop(m_snd_loop);
 	ARX_SOUND_PlaySFX(SND_SPELL_LEVITATE_END, &entities[m_target]->pos);
-	m_targets.clear();
+	clearTargets();
 	
 	if(m_target == PlayerEntityHandle)
 		player.levitate = false;
@@ -250,13 +250,13 @@ void ParalyseSpell::Launch()
 	
 	entities[m_target]->ioflags |= IO_FREEZESCRIPT;
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 	ARX_NPC_Kill_Spell_Launch(entities[m_target]);
 }
 
 void ParalyseSpell::End()
 {
-	m_targets.clear();
+	clearTargets();
 	entities[m_target]->ioflags &= ~IO_FREEZESCRIPT;
 	
 	ARX_SOUND_PlaySFX(SND_SPELL_PARALYSE_END);
@@ -428,13 +428,13 @@ void SlowDownSpell::Launch()
 	m_hasDuration = true;
 	m_fManaCostPerSecond = 1.2f;
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void SlowDownSpell::End() {
 	
 	ARX_SOUND_PlaySFX(SND_SPELL_SLOW_DOWN_END);
-	m_targets.clear();
+	clearTargets();
 }
 
 void SlowDownSpell::Update(float timeDelta) {
@@ -743,12 +743,12 @@ void ConfuseSpell::Launch() {
 	au.altidx_cur = 0;
 	au.altidx_next = 0;
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void ConfuseSpell::End() {
 	
-	m_targets.clear();
+	clearTargets();
 	endLightDelayed(m_light, 500);
 }
 
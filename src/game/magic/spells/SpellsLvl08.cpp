@@ -57,7 +57,7 @@ void InvisibilitySpell::Launch()
 	
 	ARX_SOUND_PlaySFX(SND_SPELL_INVISIBILITY_START, &m_caster_pos);
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void InvisibilitySpell::End()
@@ -65,7 +65,7 @@ void InvisibilitySpell::End()
 	if(ValidIONum(m_target)) {
 		entities[m_target]->gameFlags &= ~GFLAG_INVISIBILITY;
 		ARX_SOUND_PlaySFX(SND_SPELL_INVISIBILITY_END, &entities[m_target]->pos);
-		m_targets.clear();
+		clearTargets();
 	}
 }
 
@@ -75,7 +75,7 @@ void InvisibilitySpell::Update(float timeDelta)
 	
 	if(m_target != PlayerEntityHandle) {
 		if(!(entities[m_target]->gameFlags & GFLAG_INVISIBILITY)) {
-			m_targets.clear();
+			clearTargets();
 			ARX_SPELLS_Fizzle(this);
 		}
 	}	
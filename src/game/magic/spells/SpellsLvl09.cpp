@@ -454,12 +454,12 @@ void IncinerateSpell::Launch()
 	tio->sfx_flag |= SFX_TYPE_YLSIDE_DEATH | SFX_TYPE_INCINERATE;
 	tio->sfx_time = (unsigned long)(arxtime);
 	
-	m_targets.push_back(m_target);
+	addTarget(m_target);
 }
 
 void IncinerateSpell::End()
 {
-	m_targets.clear();
+	clearTargets();
 	ARX_SOUND_Stop(m_snd_loop);
 	ARX_SOUND_PlaySFX(SND_SPELL_INCINERATE_END);
 }
@@ -507,7 +507,7 @@ void MassParalyseSpell::Launch()
 		tio->ioflags |= IO_FREEZESCRIPT;
 		
 		ARX_NPC_Kill_Spell_Launch(tio);
-		m_targets.push_back(tio->index());
+		addTarget(tio->index());
 	}
 }
 
@@ -523,7 +523,7 @@ void MassParalyseSpell::End()
 		}
 	}
 	
-	m_targets.clear();
+	clearTargets();
 	
 	ARX_SOUND_PlaySFX(SND_SPELL_PARALYSE_END);
 }
@@ -441,7 +441,7 @@ void MassIncinerateSpell::Launch()
 		tio->sfx_flag |= SFX_TYPE_YLSIDE_DEATH | SFX_TYPE_INCINERATE;
 		tio->sfx_time = (unsigned long)(arxtime);
 		nb_targets++;
-		m_targets.push_back(tio->index());
+		addTarget(tio->index());
 	}
 	
 	if(nb_targets) {
@@ -453,7 +453,7 @@ void MassIncinerateSpell::Launch()
 
 void MassIncinerateSpell::End()
 {
-	m_targets.clear();
+	clearTargets();
 	ARX_SOUND_Stop(m_snd_loop);
 	ARX_SOUND_PlaySFX(SND_SPELL_INCINERATE_END);
 }
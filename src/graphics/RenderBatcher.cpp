@@ -19,50 +19,249 @@
 
 #include "graphics/RenderBatcher.h"
 
-#include <list>
-#include <map>
+#include <algorithm>
 #include <vector>
 
 #include "platform/profiler/Profiler.h"
 
-RenderBatcher::RenderBatcher() : m_VertexBuffer(NULL) {
+namespace {
+
+const u32 InvalidTextureSlot = u32(-1);
+
+// Sort key fields, from least to most significant
+const unsigned WrapModeShift = 0;
+const unsigned WrapModeBits = 2;
+const unsigned CullingShift = WrapModeShift + WrapModeBits;
+const unsigned CullingBits = 2;
+const unsigned TextureShift = CullingShift + CullingBits;
+const unsigned TextureBits = 16;
+const unsigned DepthBiasShift = TextureShift + TextureBits;
+const unsigned DepthBiasBits = 16;
+const unsigned DepthTestShift = DepthBiasShift + DepthBiasBits;
+const unsigned DepthTestBits = 1;
+const unsigned BlendTypeShift = DepthTestShift + DepthTestBits;
+const unsigned BlendTypeBits = 3;
+const unsigned LayerShift = BlendTypeShift + BlendTypeBits;
+const unsigned LayerBits = 3;
+const unsigned SortKeyBits = LayerShift + LayerBits;
+
+const int DepthBiasOffset = 1 << (DepthBiasBits - 1);
+
+//! Shared by all textures once the other slots are used up
+const u32 OverflowTextureSlot = (u32(1) << TextureBits) - 1;
+
+const unsigned RadixBits = 8;
+const size_t RadixSize = size_t(1) << RadixBits;
+
+u64 getField(u64 key, unsigned shift, unsigned bits) {
+	return (key >> shift) & ((u64(1) << bits) - 1);
+}
+
+} // anonymous namespace
+
+RenderBatcher::RenderBatcher()
+	: m_lastTexture(NULL)
+	, m_lastTextureSlot(InvalidTextureSlot)
+	, m_VertexBuffer(NULL) {
 }
 
 RenderBatcher::~RenderBatcher() {
 	reset();
 }
 
+RenderBatcher::SortKey RenderBatcher::getSortKey(const RenderMaterial & mat) {
+	
+	Texture * texture = mat.getTexture();
+	if(texture != m_lastTexture || m_lastTextureSlot == InvalidTextureSlot) {
+		TextureSlots::const_iterator slot = m_textureSlots.find(texture);
+		if(slot != m_textureSlots.end()) {
+			m_lastTextureSlot = slot->second;
+		} else if(m_textureSlots.size() < OverflowTextureSlot) {
+			m_lastTextureSlot = u32(m_textureSlots.size());
+			m_textureSlots[texture] = m_lastTextureSlot;
+		} else {
+			m_lastTextureSlot = OverflowTextureSlot;
+		}
+		m_lastTexture = texture;
+	}
+	
+	int depthBias = mat.getDepthBias() + DepthBiasOffset;
+	arx_assert(depthBias >= 0 && depthBias < (1 << DepthBiasBits));
+	
+	SortKey key = 0;
+	key |= SortKey(mat.getLayer()) << LayerShift;
+	key |= SortKey(mat.getBlendType()) << BlendTypeShift;
+	key |= SortKey(mat.getDepthTest() ? 0 : 1) << DepthTestShift;
+	key |= SortKey(depthBias) << DepthBiasShift;
+	key |= SortKey(m_lastTextureSlot) << TextureShift;
+	key |= SortKey(mat.getCulling()) << CullingShift;
+	key |= SortKey(mat.getWrapMode()) << WrapModeShift;
+	
+	return key;
+}
+
+RenderMaterial RenderBatcher::getMaterial(SortKey key) const {
+	
+	RenderMaterial mat;
+	
+	mat.setLayer(RenderMaterial::Layer(getField(key, LayerShift, LayerBits)));
+	mat.setBlendType(RenderMaterial::BlendType(getField(key, BlendTypeShift, BlendTypeBits)));
+	mat.setDepthTest(getField(key, DepthTestShift, DepthTestBits) == 0);
+	mat.setDepthBias(int(getField(key, DepthBiasShift, DepthBiasBits)) - DepthBiasOffset);
+	mat.setCulling(Renderer::CullingMode(getField(key, CullingShift, CullingBits)));
+	mat.setWrapMode(TextureStage::WrapMode(getField(key, WrapModeShift, WrapModeBits)));
+	
+	return mat;
+}
+
+TexturedVertex * RenderBatcher::allocate(const RenderMaterial & mat, size_t count) {
+	
+	SortKey key = getSortKey(mat);
+	Texture * texture = mat.getTexture();
+	
+	size_t first = m_vertices.size();
+	m_vertices.resize(first + count);
+	
+	// Consecutive adds with the same material usually come from the same effect
+	if(!m_records.empty() && m_records.back().key == key && m_records.back().texture == texture) {
+		m_records.back().count += count;
+	} else {
+		DrawRecord record;
+		record.key = key;
+		record.texture = texture;
+		record.first = first;
+		record.count = count;
+		m_records.push_back(record);
+	}
+	
+	return &m_vertices[first];
+}
+
 void RenderBatcher::add(const RenderMaterial& mat, const TexturedVertex (&tri)[3]) {
 	
-	VertexBatch & batch = m_BatchedSprites[mat];
+	TexturedVertex * vertices = allocate(mat, 3);
 	
-	batch.push_back(tri[0]);
-	batch.push_back(tri[1]);
-	batch.push_back(tri[2]);
+	vertices[0] = tri[0];
+	vertices[1] = tri[1];
+	vertices[2] = tri[2];
 }
 
 void RenderBatcher::add(const RenderMaterial& mat, const TexturedQuad& sprite) {
 	
-	VertexBatch & batch = m_BatchedSprites[mat];
+	TexturedVertex * vertices = allocate(mat, 6);
 	
-	batch.push_back(sprite.v[0]);
-	batch.push_back(sprite.v[1]);
-	batch.push_back(sprite.v[2]);
+	vertices[0] = sprite.v[0];
+	vertices[1] = sprite.v[1];
+	vertices[2] = sprite.v[2];
 	
-	batch.push_back(sprite.v[0]);
-	batch.push_back(sprite.v[2]);
-	batch.push_back(sprite.v[3]);
+	vertices[3] = sprite.v[0];
+	vertices[4] = sprite.v[2];
+	vertices[5] = sprite.v[3];
+}
+
+void RenderBatcher::sortRecords() {
+	
+	// Stable LSD radix sort so that draws with the same material keep their submission order
+	
+	size_t count = m_records.size();
+	m_sortBuffer.resize(count);
+	
+	DrawRecord * src = &m_records[0];
+	DrawRecord * dst = &m_sortBuffer[0];
+	
+	for(unsigned shift = 0; shift < SortKeyBits; shift += RadixBits) {
+		
+		size_t offsets[RadixSize] = { 0 };
+		for(size_t i = 0; i < count; i++) {
+			offsets[getField(src[i].key, shift, RadixBits)]++;
+		}
+		
+		// Skip digits that are the same for all records
+		if(offsets[getField(src[0].key, shift, RadixBits)] == count) {
+			continue;
+		}
+		
+		size_t total = 0;
+		for(size_t digit = 0; digit < RadixSize; digit++) {
+			size_t digitCount = offsets[digit];
+			offsets[digit] = total;
+			total += digitCount;
+		}
+		
+		for(size_t i = 0; i < count; i++) {
+			dst[offsets[getField(src[i].key, shift, RadixBits)]++] = src[i];
+		}
+		
+		std::swap(src, dst);
+	}
+	
+	if(src != &m_records[0]) {
+		m_records.swap(m_sortBuffer);
+	}
 }
 
 void RenderBatcher::render() {
 	
 	ARX_PROFILE_FUNC();
 	
-	for(Batches::const_iterator it = m_BatchedSprites.begin(); it != m_BatchedSprites.end(); ++it) {
-		if(!it->second.empty()) {
-			it->first.apply();
-			m_VertexBuffer->draw(Renderer::TriangleList, &it->second.front(), it->second.size());
+	if(!m_records.empty()) {
+		
+		sortRecords();
+		
+		RenderMaterial previous;
+		
+		for(size_t i = 0; i < m_records.size();) {
+			
+			SortKey key = m_records[i].key;
+			Texture * texture = m_records[i].texture;
+			
+			// Only textures in the overflow slot can differ for the same key
+			size_t end = i + 1;
+			while(end < m_records.size() && m_records[end].key == key
+			      && m_records[end].texture == texture) {
+				end++;
+			}
+			
+			// Records with the same material are gathered into a single draw call
+			const TexturedVertex * vertices;
+			size_t count;
+			if(end == i + 1) {
+				vertices = &m_vertices[m_records[i].first];
+				count = m_records[i].count;
+			} else {
+				m_staging.clear();
+				for(size_t j = i; j < end; j++) {
+					const TexturedVertex * first = &m_vertices[m_records[j].first];
+					m_staging.insert(m_staging.end(), first, first + m_records[j].count);
+				}
+				vertices = &m_staging[0];
+				count = m_staging.size();
+			}
+			
+			RenderMaterial mat = getMaterial(key);
+			mat.setTexture(texture);
+			
+			Statistics & stats = m_statistics[mat.getLayer()];
+			stats.drawCalls++;
+			stats.vertices += count;
+			if(i == 0) {
+				// The render state before the first batch is unknown
+				stats.stateChanges += 6;
+			} else {
+				stats.stateChanges += (mat.getTexture() != previous.getTexture())
+				                      + (mat.getBlendType() != previous.getBlendType())
+				                      + (mat.getDepthTest() != previous.getDepthTest())
+				                      + (mat.getDepthBias() != previous.getDepthBias())
+				                      + (mat.getCulling() != previous.getCulling())
+				                      + (mat.getWrapMode() != previous.getWrapMode());
+			}
+			previous = mat;
+			
+			mat.apply();
+			m_VertexBuffer->draw(Renderer::TriangleList, vertices, count);
 			GRenderer->GetTextureStage(0)->setAlphaOp(TextureStage::OpSelectArg1);
+			
+			i = end;
 		}
 	}
 
@@ -75,8 +274,14 @@ void RenderBatcher::render() {
 }
 
 void RenderBatcher::clear() {
-	for(Batches::iterator itBatch = m_BatchedSprites.begin(); itBatch != m_BatchedSprites.end(); ++itBatch)
-		itBatch->second.clear();
+	
+	// Keep the allocated memory around for the next frame
+	m_vertices.clear();
+	m_records.clear();
+	
+	m_textureSlots.clear();
+	m_lastTexture = NULL;
+	m_lastTextureSlot = InvalidTextureSlot;
 }
 
 void RenderBatcher::reset() {
@@ -84,17 +289,39 @@ void RenderBatcher::reset() {
 	ARX_PROFILE_FUNC();
 	
 	clear();
-	m_BatchedSprites.clear();
+	VertexArena().swap(m_vertices);
+	VertexArena().swap(m_staging);
+	DrawRecords().swap(m_records);
+	DrawRecords().swap(m_sortBuffer);
+	TextureSlots().swap(m_textureSlots);
 }
 
 u32 RenderBatcher::getMemoryUsed() const {
-	u32 memoryUsed = 0;
+	
+	size_t memoryUsed = 0;
+	
+	memoryUsed += (m_vertices.capacity() + m_staging.capacity()) * sizeof(TexturedVertex);
+	memoryUsed += (m_records.capacity() + m_sortBuffer.capacity()) * sizeof(DrawRecord);
+	memoryUsed += m_textureSlots.size() * (sizeof(Texture *) + sizeof(u32));
+	
+	return u32(memoryUsed);
+}
 
-	for(Batches::const_iterator it = m_BatchedSprites.begin(); it != m_BatchedSprites.end(); ++it) {
-		memoryUsed += it->second.capacity() * sizeof(TexturedVertex);
+RenderBatcher::Statistics RenderBatcher::getTotalStatistics() const {
+	
+	Statistics total;
+	
+	for(size_t i = 0; i < size_t(LayerCount); i++) {
+		total.drawCalls += m_statistics[i].drawCalls;
+		total.stateChanges += m_statistics[i].stateChanges;
+		total.vertices += m_statistics[i].vertices;
 	}
+	
+	return total;
+}
 
-	return memoryUsed;
+void RenderBatcher::resetStatistics() {
+	std::fill(m_statistics, m_statistics + size_t(LayerCount), Statistics());
 }
 
 void RenderBatcher::initialize() {
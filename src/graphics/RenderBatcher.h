@@ -29,6 +29,8 @@
 #include <map>
 #include <vector>
 
+#include <boost/unordered_map.hpp>
+
 struct TexturedQuad {
 	TexturedVertex v[4];
 };
@@ -97,6 +99,25 @@ private:
 
 class RenderBatcher {
 public:
+	
+	enum { LayerCount = RenderMaterial::HUDEffect + 1 };
+	
+	//! Per-layer counters accumulated by render() until resetStatistics() is called
+	struct Statistics {
+		
+		//! Number of draw calls issued
+		size_t drawCalls;
+		
+		//! Number of individual render states (texture, blending, depth, culling, wrap) changed
+		size_t stateChanges;
+		
+		//! Number of vertices drawn
+		size_t vertices;
+		
+		Statistics() : drawCalls(0), stateChanges(0), vertices(0) { }
+		
+	};
+	
 	RenderBatcher();
 	~RenderBatcher();
 
@@ -116,15 +137,65 @@ public:
 
 	void initialize();
 	void shutdown();
-
+	
+	const Statistics & getStatistics(RenderMaterial::Layer layer) const {
+		return m_statistics[layer];
+	}
+	
+	//! \return the sum of the statistics for all layers
+	Statistics getTotalStatistics() const;
+	
+	void resetStatistics();
+	
 	static RenderBatcher& getInstance();
 	
 private:
-	typedef std::vector<TexturedVertex> VertexBatch;
-	typedef std::map<RenderMaterial, VertexBatch> Batches;
+	
+	/*!
+	 * Material state packed into an integer so that draws can be sorted cheaply.
+	 *
+	 * From the most significant bits: layer, blend type, depth test (enabled first),
+	 * depth bias, texture slot, culling mode and wrap mode. This preserves the
+	 * order of RenderMaterial::operator< except that textures are ordered by their
+	 * first use in the current batch instead of by address. Textures beyond the
+	 * number of slots share the last slot and are told apart by their DrawRecord.
+	 */
+	typedef u64 SortKey;
+	
+	//! A range of vertices in the arena that share the same material
+	struct DrawRecord {
+		SortKey key;
+		Texture * texture;
+		size_t first;
+		size_t count;
+	};
+	
+	typedef std::vector<TexturedVertex> VertexArena;
+	typedef std::vector<DrawRecord> DrawRecords;
+	typedef boost::unordered_map<Texture *, u32> TextureSlots;
+	
+	SortKey getSortKey(const RenderMaterial & mat);
+	RenderMaterial getMaterial(SortKey key) const;
+	
+	TexturedVertex * allocate(const RenderMaterial & mat, size_t count);
+	
+	void sortRecords();
 	
 private:
-	Batches m_BatchedSprites;
+	
+	//! Vertices of all batches in the order they were added, kept allocated across frames
+	VertexArena m_vertices;
+	DrawRecords m_records;
+	DrawRecords m_sortBuffer;
+	VertexArena m_staging;
+	
+	//! Slots in the sort key for the textures used in the current batch
+	TextureSlots m_textureSlots;
+	Texture * m_lastTexture;
+	u32 m_lastTextureSlot;
+	
+	Statistics m_statistics[LayerCount];
+	
 	CircularVertexBuffer<TexturedVertex> * m_VertexBuffer;
 };
 
@@ -51,10 +51,17 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "graphics/data/FTL.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <list>
+#include <string>
+#include <vector>
 
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "core/Config.h"
 
 #include "graphics/data/FTLFormat.h"
 #include "graphics/data/TextureContainer.h"
@@ -359,88 +366,182 @@ bool ARX_FTL_Save(const fs::path & file, const EERIE_3DOBJ * obj) {
 
 #endif // BUILD_EDIT_LOADSAVE
 
-// MESH cache structure definition & Globals
+namespace {
+
+/*!
+ * Cached mesh data
+ *
+ * The cached object is never modified or handed out, entities get their own copy as
+ * they modify the mesh (tweaks, cloth simulation, animation).
+ */
 struct MCACHE_DATA {
 	res::path name;
-	char * data;
+	EERIE_3DOBJ * mesh;
 	size_t size;
 };
-static std::vector<MCACHE_DATA> meshCache;
 
-// Checks for Mesh file existence in cache
-static long MCache_Get(const res::path & file) {
+typedef std::list<MCACHE_DATA> MeshCacheEntries;
+typedef boost::unordered_map<std::string, MeshCacheEntries::iterator> MeshCacheIndex;
+
+MeshCacheEntries meshCache; //!< Most recently used meshes first
+MeshCacheIndex meshCacheIndex;
+size_t meshCacheSize = 0;
+u64 meshCacheHits = 0;
+u64 meshCacheMisses = 0;
+u64 meshCacheEvictions = 0;
+
+size_t MCache_GetBudget() {
+	return size_t(std::max(config.misc.meshCacheSize, 0)) * 1024 * 1024;
+}
+
+template <typename T>
+size_t getVectorSize(const std::vector<T> & vector) {
+	return vector.capacity() * sizeof(T);
+}
+
+//! Estimate the memory used by a mesh loaded from a FTL file
+size_t MCache_GetMeshSize(const EERIE_3DOBJ * obj) {
 	
-	for(size_t i = 0; i < meshCache.size(); i++) {
-		if(meshCache[i].name == file) {
-			return i;
-		}
+	size_t size = sizeof(EERIE_3DOBJ);
+	
+	size += getVectorSize(obj->vertexlist);
+	size += getVectorSize(obj->vertexlist3);
+	size += getVectorSize(obj->facelist);
+	size += getVectorSize(obj->actionlist);
+	size += getVectorSize(obj->texturecontainer);
+	
+	size += getVectorSize(obj->grouplist);
+	for(size_t i = 0; i < obj->grouplist.size(); i++) {
+		size += getVectorSize(obj->grouplist[i].indexes);
+	}
+	
+	size += getVectorSize(obj->selections);
+	for(size_t i = 0; i < obj->selections.size(); i++) {
+		size += getVectorSize(obj->selections[i].selected);
+	}
+	
+	if(obj->sdata) {
+		size += sizeof(COLLISION_SPHERES_DATA) + getVectorSize(obj->sdata->spheres);
+	}
+	
+	if(obj->cdata) {
+		size += sizeof(CLOTHES_DATA) + getVectorSize(obj->cdata->springs);
+		size += 2 * sizeof(CLOTHESVERTEX) * size_t(obj->cdata->nb_cvert);
 	}
 	
-	return -1;
+	return size;
 }
 
-// Pushes a Mesh In Mesh Cache
-static bool MCache_Push(const res::path & file, char * data, size_t size) {
+void MCache_Evict(size_t limit) {
 	
-	if(MCache_Get(file) != -1) {
-		return false; // already cached
+	while(meshCacheSize > limit && !meshCache.empty()) {
+		
+		MCACHE_DATA & entry = meshCache.back();
+		
+		LogDebug("evicting " << entry.name);
+		
+		meshCacheIndex.erase(entry.name.string());
+		meshCacheSize -= entry.size;
+		delete entry.mesh;
+		meshCache.pop_back();
+		
+		meshCacheEvictions++;
 	}
+}
+
+// Retreives a cached mesh and marks it as recently used
+const EERIE_3DOBJ * MCache_Get(const res::path & file) {
+	
+	MeshCacheIndex::iterator it = meshCacheIndex.find(file.string());
+	if(it == meshCacheIndex.end()) {
+		meshCacheMisses++;
+		return NULL;
+	}
+	
+	meshCacheHits++;
+	meshCache.splice(meshCache.begin(), meshCache, it->second);
+	
+	return it->second->mesh;
+}
+
+// Pushes a Mesh In Mesh Cache, taking ownership of it
+bool MCache_Push(const res::path & file, EERIE_3DOBJ * mesh) {
+	
+	arx_assert(meshCacheIndex.find(file.string()) == meshCacheIndex.end());
+	
+	size_t size = MCache_GetMeshSize(mesh);
+	size_t budget = MCache_GetBudget();
+	if(size > budget) {
+		return false;
+	}
+	
+	MCache_Evict(budget - size);
 	
-	LogDebug(file << " #" << meshCache.size());
+	LogDebug(file << " #" << meshCache.size() << " " << size << " bytes");
 	
 	MCACHE_DATA newMesh;
-	newMesh.size = size;
-	newMesh.data = data;
 	newMesh.name = file;
-	meshCache.push_back(newMesh);
+	newMesh.mesh = mesh;
+	newMesh.size = size;
+	meshCache.push_front(newMesh);
+	meshCacheIndex[file.string()] = meshCache.begin();
+	meshCacheSize += size;
 	
 	return true;
 }
 
-void MCache_ClearAll(){
-	for(std::vector<MCACHE_DATA>::iterator it = meshCache.begin(); it != meshCache.end(); ++it) {
-		free(it->data);
+//! Create a modifiable copy of a cached mesh
+EERIE_3DOBJ * MCache_Instantiate(const EERIE_3DOBJ * mesh) {
+	
+	EERIE_3DOBJ * obj = Eerie_Copy(mesh);
+	
+	if(mesh->sdata) {
+		obj->sdata = new COLLISION_SPHERES_DATA(*mesh->sdata);
 	}
-
-	meshCache.clear();
-}
-
-// Retreives a Mesh File pointer from cache...
-static char * MCache_Pop(const res::path & file, size_t & size) {
 	
-	long num = MCache_Get(file);
-	if(num == -1) {
-		return NULL;
+	if(mesh->cdata) {
+		obj->cdata = new CLOTHES_DATA();
+		obj->cdata->nb_cvert = mesh->cdata->nb_cvert;
+		obj->cdata->springs = mesh->cdata->springs;
+		obj->cdata->cvert = new CLOTHESVERTEX[obj->cdata->nb_cvert];
+		obj->cdata->backup = new CLOTHESVERTEX[obj->cdata->nb_cvert];
+		std::copy(mesh->cdata->cvert, mesh->cdata->cvert + obj->cdata->nb_cvert, obj->cdata->cvert);
+		std::copy(mesh->cdata->backup, mesh->cdata->backup + obj->cdata->nb_cvert,
+		          obj->cdata->backup);
 	}
 	
-	size = meshCache[num].size;
-	return meshCache[num].data;
+	return obj;
 }
 
-EERIE_3DOBJ * ARX_FTL_Load(const res::path & file) {
+} // anonymous namespace
+
+void MCache_ClearAll() {
 	
-	// Creates FTL file name
-	res::path filename = (res::path("game") / file).set_ext("ftl");
+	MCache_Evict(0);
 	
-	// Checks for FTL file existence
-	PakFile * pf = resources->getFile(filename);
-	if(!pf) {
-		return NULL;
-	}
+	arx_assert(meshCache.empty() && meshCacheIndex.empty());
+	arx_assert(meshCacheSize == 0);
+}
+
+MeshCacheStatistics MCache_GetStatistics() {
 	
-	size_t compressedSize = 0;
-	char * compressedData = MCache_Pop(filename, compressedSize);
-	LogDebug("File name check " << filename);
+	MeshCacheStatistics stats;
+	stats.hits = meshCacheHits;
+	stats.misses = meshCacheMisses;
+	stats.evictions = meshCacheEvictions;
+	stats.entries = meshCache.size();
+	stats.size = meshCacheSize;
+	stats.budget = MCache_GetBudget();
 	
-	bool NOrelease = true;
-	if(!compressedData) {
-		compressedData = pf->readAlloc();
-		compressedSize = pf->size();
-		NOrelease = MCache_Push(filename, compressedData, compressedSize) ? 1 : 0;
-	}
+	return stats;
+}
+
+static EERIE_3DOBJ * ARX_FTL_Parse(const res::path & filename, const PakFile * pf) {
 	
+	size_t compressedSize = pf->size();
+	char * compressedData = pf->readAlloc();
 	if(!compressedData) {
-		LogError << "ARX_FTL_Load: error loading from PAK/cache " << filename;
+		LogError << "ARX_FTL_Load: error loading from PAK " << filename;
 		return NULL;
 	}
 	
@@ -449,21 +550,17 @@ EERIE_3DOBJ * ARX_FTL_Load(const res::path & file) {
 	// Check if we have an uncompressed FTL file
 	if(compressedData[0] == 'F' && compressedData[1] == 'T' && compressedData[2] == 'L') {
 		LogInfo << "Uncompressed FTL found: " << filename;
-		dat = (char *) malloc(compressedSize);
-		memcpy(dat, compressedData, compressedSize);
+		dat = compressedData;
 	} else {
 		size_t allocsize; // The size of the data TODO size ignored
 		dat = blastMemAlloc(compressedData, compressedSize, allocsize);
+		free(compressedData);
 		if(!dat) {
 			LogError << "ARX_FTL_Load: error decompressing " << filename;
 			return NULL;
 		}
 	}
 	
-	if(!NOrelease) {
-		free(compressedData);
-	}
-	
 	size_t pos = 0; // The position within the data
 	
 	// Pointer to Primary Header
@@ -565,21 +662,26 @@ EERIE_3DOBJ * ARX_FTL_Load(const res::path & file) {
 	// Alloc'n'Copy textures
 	if(af3Ddh->nb_maps > 0) {
 		
-		// Copy in the texture containers
+		const Texture_Container_FTL * tex;
+		tex = reinterpret_cast<const Texture_Container_FTL *>(dat + pos);
+		pos += sizeof(Texture_Container_FTL) * af3Ddh->nb_maps;
+		
+		// Some object files contain textures with empty names
+		// Don't bother trying to load them as that will just generate an error message
+		std::vector<res::path> names(size_t(af3Ddh->nb_maps));
 		for(long i = 0; i < af3Ddh->nb_maps; i++) {
-			
-			const Texture_Container_FTL * tex;
-			tex = reinterpret_cast<const Texture_Container_FTL *>(dat + pos);
-			pos += sizeof(Texture_Container_FTL);
-			
-			if(tex->name[0] == '\0') {
-				// Some object files contain textures with empty names
-				// Don't bother trying to load them as that will just generate an error message
+			if(tex[i].name[0] != '\0') {
+				names[i] = res::path::load(util::loadString(tex[i].name)).remove_ext();
+			}
+		}
+		TextureContainer::Prefetch(names);
+		
+		// Create the textures and put them in the container list
+		for(long i = 0; i < af3Ddh->nb_maps; i++) {
+			if(names[i].empty()) {
 				obj->texturecontainer[i] = NULL;
 			} else {
-				// Create the texture and put it in the container list
-				res::path name = res::path::load(util::loadString(tex->name)).remove_ext();
-				obj->texturecontainer[i] = TextureContainer::Load(name, TextureContainer::Level);
+				obj->texturecontainer[i] = TextureContainer::Load(names[i], TextureContainer::Level);
 			}
 		}
 	}
@@ -705,3 +807,31 @@ EERIE_3DOBJ * ARX_FTL_Load(const res::path & file) {
 	
 	return obj;
 }
+
+EERIE_3DOBJ * ARX_FTL_Load(const res::path & file) {
+	
+	// Creates FTL file name
+	res::path filename = (res::path("game") / file).set_ext("ftl");
+	
+	const EERIE_3DOBJ * cached = MCache_Get(filename);
+	if(cached) {
+		return MCache_Instantiate(cached);
+	}
+	
+	// Checks for FTL file existence
+	PakFile * pf = resources->getFile(filename);
+	if(!pf) {
+		return NULL;
+	}
+	
+	EERIE_3DOBJ * obj = ARX_FTL_Parse(filename, pf);
+	if(!obj) {
+		return NULL;
+	}
+	
+	if(!MCache_Push(filename, obj)) {
+		return obj;
+	}
+	
+	return MCache_Instantiate(obj);
+}
@@ -45,7 +45,10 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #ifndef ARX_GRAPHICS_DATA_FTL_H
 #define ARX_GRAPHICS_DATA_FTL_H
 
+#include <stddef.h>
+
 #include "Configure.h"
+#include "platform/Platform.h"
 
 struct EERIE_3DOBJ;
 
@@ -64,9 +67,24 @@ bool ARX_FTL_Save(const fs::path & file, const EERIE_3DOBJ * obj);
 
 /*!
  * Load a FTL file
+ *
+ * Parsed meshes are kept in a cache so that loading the same file again only needs to
+ * copy the cached mesh. The returned object is always owned by the caller.
  */
 EERIE_3DOBJ * ARX_FTL_Load(const res::path & file);
 
+struct MeshCacheStatistics {
+	u64 hits;
+	u64 misses;
+	u64 evictions;
+	size_t entries;
+	size_t size; //!< Estimated memory used by all cached meshes in bytes
+	size_t budget;
+};
+
+//! Remove all cached meshes - must be called before the level textures are deleted
 void MCache_ClearAll();
 
+MeshCacheStatistics MCache_GetStatistics();
+
 #endif // ARX_GRAPHICS_DATA_FTL_H
@@ -46,9 +46,13 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "graphics/data/Mesh.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <cstdio>
+#include <limits>
 #include <map>
+#include <vector>
 
 #include <boost/scoped_array.hpp>
 #include <boost/unordered_map.hpp>
@@ -87,6 +91,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "io/log/Logger.h"
 
 #include "physics/Anchors.h"
+#include "platform/Time.h"
 #include "platform/profiler/Profiler.h"
 
 #include "scene/Scene.h"
@@ -618,238 +623,362 @@ static bool RayIn3DPolyNoCull(const Vec3f & orgn, const Vec3f & dest, const EERI
 	return false;
 }
 
-int EERIELaunchRay3(const Vec3f & orgn, const Vec3f & dest, Vec3f & hit, long flag) {
+namespace {
+
+/*!
+ * Walks the background tiles crossed by a line segment in order (Amanatides & Woo).
+ *
+ * Positions along the segment are given as a fraction of its length.
+ */
+class TileTraversal {
 	
-	Vec3f p; //current ray pos
-	Vec3f i;
-	long lpx, lpz;
-	long voidlast;
-	float pas = 1.5f;
+public:
 	
-	long iii = 0;
-	float maxstepp = 20000.f / pas;
-	hit = p = orgn;
+	TileTraversal(const EERIE_BACKGROUND & bkg, const Vec3f & orgn, const Vec3f & dest);
 	
-	voidlast = 0;
-	lpx = lpz = -1;
+	//! \return true if the current tile is inside the background and starts before the segment end
+	bool valid() const {
+		return m_enter <= 1.f && m_x >= 0 && m_x < m_bkg.Xsize && m_z >= 0 && m_z < m_bkg.Zsize;
+	}
 	
-	// ray incs
-	Vec3f d = (dest - orgn);
-	// absolute ray incs
-	Vec3f ad = glm::abs(d);
+	//! \return true if the segment left the background before reaching its end
+	bool left() const {
+		return m_enter <= 1.f && !valid();
+	}
+	
+	void next();
+	
+	float enter() const { return m_enter; }
+	const EERIE_BKG_INFO & tile() const { return m_bkg.fastdata[m_x][m_z]; }
+	
+private:
+	
+	const EERIE_BACKGROUND & m_bkg;
+	long m_x;
+	long m_z;
+	long m_stepX;
+	long m_stepZ;
+	Vec2f m_next; //!< Position of the next tile boundary crossing on each axis
+	Vec2f m_delta; //!< Distance between tile boundary crossings on each axis
+	float m_enter; //!< Position where the segment enters the current tile
+	
+};
+
+TileTraversal::TileTraversal(const EERIE_BACKGROUND & bkg, const Vec3f & orgn, const Vec3f & dest)
+	: m_bkg(bkg)
+	, m_enter(0.f)
+{
+	
+	const float infinity = std::numeric_limits<float>::infinity();
+	
+	Vec3f d = dest - orgn;
 	
-	if(ad.x >= ad.y && ad.x >= ad.z) {
-		i.x = (ad.x != d.x) ? (-1.f * pas) : (1.f * pas);
-		i.y = d.y / (ad.x / pas);
-		i.z = d.z / (ad.x / pas);
-	} else if(ad.y >= ad.x && ad.y >= ad.z) {
-		i.x = d.x / (ad.y / pas);
-		i.y = (ad.y != d.y) ? (-1.f * pas) : (1.f * pas);
-		i.z = d.z / (ad.y / pas);
+	m_x = long(std::floor(orgn.x * bkg.Xmul));
+	if(d.x > 0.f) {
+		m_stepX = 1;
+		m_delta.x = float(bkg.Xdiv) / d.x;
+		m_next.x = (float(m_x + 1) * bkg.Xdiv - orgn.x) / d.x;
+	} else if(d.x < 0.f) {
+		m_stepX = -1;
+		m_delta.x = float(bkg.Xdiv) / -d.x;
+		m_next.x = (float(m_x) * bkg.Xdiv - orgn.x) / d.x;
 	} else {
-		i.x = d.x / (ad.z / pas);
-		i.y = d.y / (ad.z / pas);
-		i.z = (ad.z != d.z) ? (-1.f * pas) : (1.f * pas);
+		m_stepX = 0;
+		m_delta.x = m_next.x = infinity;
+	}
+	
+	m_z = long(std::floor(orgn.z * bkg.Zmul));
+	if(d.z > 0.f) {
+		m_stepZ = 1;
+		m_delta.y = float(bkg.Zdiv) / d.z;
+		m_next.y = (float(m_z + 1) * bkg.Zdiv - orgn.z) / d.z;
+	} else if(d.z < 0.f) {
+		m_stepZ = -1;
+		m_delta.y = float(bkg.Zdiv) / -d.z;
+		m_next.y = (float(m_z) * bkg.Zdiv - orgn.z) / d.z;
+	} else {
+		m_stepZ = 0;
+		m_delta.y = m_next.y = infinity;
 	}
 	
-	for(;;) {
-		
-		p += i;
-		
-		if(i.x == -1.f * pas && p.x <= dest.x) {
-			hit = p;
-			return 0;
-		}
-		
-		if(i.x == 1.f * pas && p.x >= dest.x) {
-			hit = p;
-			return 0;
-		}
-		
-		if(i.y == -1.f * pas && p.y <= dest.y) {
-			hit = p;
-			return 0;
-		}
-		
-		if(i.y == 1.f * pas && p.y >= dest.y) {
-			hit = p;
-			return 0;
-		}
-		
-		if(i.z == -1.f * pas && p.z <= dest.z) {
-			hit = p;
-			return 0;
-		}
+}
+
+void TileTraversal::next() {
+	if(m_next.x < m_next.y) {
+		m_x += m_stepX;
+		m_enter = m_next.x;
+		m_next.x += m_delta.x;
+	} else {
+		m_z += m_stepZ;
+		m_enter = m_next.y;
+		m_next.y += m_delta.y;
+	}
+}
+
+//! Check if the segment orgn + d * t with t in [0, 1] intersects an axis-aligned box
+bool SegmentIntersectsBox(const Vec3f & orgn, const Vec3f & d, const Vec3f & min, const Vec3f & max) {
+	
+	float t0 = 0.f;
+	float t1 = 1.f;
+	
+	for(int i = 0; i < 3; i++) {
 		
-		if(i.z == 1.f * pas && p.z >= dest.z) {
-			hit = p;
-			return 0;
+		if(d[i] == 0.f) {
+			if(orgn[i] < min[i] || orgn[i] > max[i]) {
+				return false;
+			}
+			continue;
 		}
 		
-		iii++;
-		
-		if(iii > maxstepp) {
-			hit = p;
-			return -1;
+		float tnear = (min[i] - orgn[i]) / d[i];
+		float tfar = (max[i] - orgn[i]) / d[i];
+		if(tnear > tfar) {
+			std::swap(tnear, tfar);
 		}
 		
-		long tilex = long(p.x * ACTIVEBKG->Xmul);
-		long tilez = long(p.z * ACTIVEBKG->Zmul);
-		
-		if(tilex < 0 || tilex > ACTIVEBKG->Xsize - 1 || tilez < 0 || tilez > ACTIVEBKG->Zsize - 1) {
-			hit = p;
-			return -1;
+		t0 = std::max(t0, tnear);
+		t1 = std::min(t1, tfar);
+		if(t0 > t1) {
+			return false;
 		}
+	}
+	
+	return true;
+}
+
+enum RaycastResult {
+	RaycastMiss,
+	RaycastHitPoly,
+	RaycastHitVoid,
+	RaycastLeftBackground
+};
+
+RaycastResult RaycastBackground(const Vec3f & orgn, const Vec3f & dest, PolyType ignored,
+                                bool voidIsSolid, Vec3f & hit) {
+	
+	// Polygons overlapping several tiles are only listed in the tiles near their center
+	// (see EERIEPOLY_Compute_PolyIn), so keep looking for a closer hit one tile past the
+	// nearest hit found so far.
+	Vec3f d = dest - orgn;
+	float length = glm::length(d);
+	float margin = (length > 0.f) ? float(std::max(ACTIVEBKG->Xdiv, ACTIVEBKG->Zdiv)) / length : 0.f;
+	
+	// RayCollidingPoly() uses a global camera, so this is only ever called from the main thread
+	static std::vector<const EERIEPOLY *> tested;
+	tested.clear();
+	
+	bool found = false;
+	float nearest = 1.f;
+	Vec3f nearestHit = dest;
+	
+	TileTraversal tiles(*ACTIVEBKG, orgn, dest);
+	for(; tiles.valid(); tiles.next()) {
 		
-		if(lpx == tilex && lpz == tilez && voidlast) {
-			continue;
+		if(found && tiles.enter() > nearest + margin) {
+			break;
 		}
 		
-		lpx = tilex;
-		lpz = tilez;
-		voidlast = !flag;
-		long minx = glm::clamp(tilex - 1l, 0l, ACTIVEBKG->Xsize - 1l);
-		long maxx = glm::clamp(tilex + 1l, 0l, ACTIVEBKG->Xsize - 1l);
-		long minz = glm::clamp(tilez - 1l, 0l, ACTIVEBKG->Zsize - 1l);
-		long maxz = glm::clamp(tilez + 1l, 0l, ACTIVEBKG->Zsize - 1l);
+		const EERIE_BKG_INFO & tile = tiles.tile();
 		
-		EERIE_BKG_INFO * eg = &ACTIVEBKG->fastdata[tilex][tilez];
-		if(eg->nbpoly == 0) {
-			hit = p;
-			return 1;
+		if(voidIsSolid && tile.nbpoly == 0 && (!found || tiles.enter() < nearest)) {
+			hit = orgn + d * tiles.enter();
+			return RaycastHitVoid;
 		}
 		
-		for(short z = minz; z < maxz; z++)
-		for(short x = minx; x < maxx; x++) {
-			const EERIE_BKG_INFO & eg = ACTIVEBKG->fastdata[x][z];
-			for(long k = 0; k < eg.nbpoly; k++) {
-				const EERIEPOLY & ep = eg.polydata[k];
-				
-				if(ep.type & POLY_TRANS) {
-					continue;
-				}
-				if(   p.y < ep.min.y - 10.f
-				   || p.y > ep.max.y + 10.f
-				   || p.x < ep.min.x - 10.f
-				   || p.x > ep.max.x + 10.f
-				   || p.z < ep.min.z - 10.f
-				   || p.z > ep.max.z + 10.f
-				) {
-					continue;
-				}
-				voidlast = 0;
-				if(RayIn3DPolyNoCull(orgn, dest, ep)) {
-					hit = p;
-					return 1;
+		for(long k = 0; k < tile.nbpolyin; k++) {
+			const EERIEPOLY * ep = tile.polyin[k];
+			
+			if(!ep || (ep->type & ignored)) {
+				continue;
+			}
+			
+			if(!SegmentIntersectsBox(orgn, d, ep->min - Vec3f(1.f), ep->max + Vec3f(1.f))) {
+				continue;
+			}
+			
+			// Polygons are listed in all tiles near them, only test each one once
+			if(std::find(tested.begin(), tested.end(), ep) != tested.end()) {
+				continue;
+			}
+			tested.push_back(ep);
+			
+			Vec3f polyHit;
+			if(RayCollidingPoly(orgn, dest, *ep, &polyHit)) {
+				float t = glm::dot(polyHit - orgn, d) / (length * length);
+				if(t >= 0.f && t < nearest) {
+					found = true;
+					nearest = t;
+					nearestHit = polyHit;
 				}
 			}
 		}
 	}
+	
+	if(found) {
+		hit = nearestHit;
+		return RaycastHitPoly;
+	}
+	
+	if(tiles.left()) {
+		hit = orgn + d * tiles.enter();
+		return RaycastLeftBackground;
+	}
+	
+	hit = dest;
+	return RaycastMiss;
+}
+
+} // anonymous namespace
+
+bool RaycastBackground(const Vec3f & orgn, const Vec3f & dest, Vec3f & hit, PolyType ignored) {
+	return RaycastBackground(orgn, dest, ignored, false, hit) == RaycastHitPoly;
+}
+
+int EERIELaunchRay3(const Vec3f & orgn, const Vec3f & dest, Vec3f & hit) {
+	
+	RaycastResult result = RaycastBackground(orgn, dest, POLY_TRANS, true, hit);
+	if(result == RaycastMiss) {
+		return 0;
+	}
+	
+	return (result == RaycastLeftBackground) ? -1 : 1;
 }
 
-// TODO visible copy-paste
-// Computes the visibility from a point to another... (sort of...)
+// Computes the visibility from a point to another...
 bool Visible(const Vec3f & orgn, const Vec3f & dest, Vec3f * hit) {
 	
 	ARX_PROFILE_FUNC();
 	
-	Vec3f i;
-	float pas = 35.f;
-
-	Vec3f found_hit = Vec3f_ZERO;
-	EERIEPOLY *found_ep = NULL;
-	float iter;
+	Vec3f polyHit;
+	if(!RaycastBackground(orgn, dest, polyHit)) {
+		return true;
+	}
 	
-	//current ray pos
-	Vec3f tmpPos = orgn;
+	*hit = polyHit;
 	
-	float distance;
-	float nearest = distance = fdist(orgn, dest);
+	return false;
+}
 
-	if(distance < pas)
-		pas = distance * .5f;
+namespace {
 
-	// ray incs
-	Vec3f d = dest - orgn;
-	
-	// absolute ray incs
-	Vec3f ad = glm::abs(d);
-	
-	if(ad.x >= ad.y && ad.x >= ad.z) {
-		if(ad.x != d.x)
-			i.x = -pas;
-		else
-			i.x = pas;
-
-		iter = ad.x / pas;
-		float t = 1.f / (iter);
-		i.y = d.y * t;
-		i.z = d.z * t;
-	} else if(ad.y >= ad.x && ad.y >= ad.z) {
-		if(ad.y != d.y)
-			i.y = -pas;
-		else
-			i.y = pas;
+struct RecordedRay {
+	Vec3f orgn;
+	Vec3f dest;
+};
 
-		iter = ad.y / pas;
-		float t = 1.f / (iter);
-		i.x = d.x * t;
-		i.z = d.z * t;
-	} else {
-		if(ad.z != d.z)
-			i.z = -pas;
-		else
-			i.z = pas;
+const size_t MaxRecordedRays = 4096;
+std::vector<RecordedRay> recordedRays;
+size_t nextRecordedRay = 0;
 
-		iter = ad.z / pas;
-		float t = 1.f / (iter);
-		i.x = d.x * t;
-		i.y = d.y * t;
+//! The fixed-step ray marcher previously used by IO_Visible(), kept for comparison
+bool MarchBackground(const Vec3f & orgn, const Vec3f & dest, Vec3f & hit, PolyType ignored) {
+	
+	float pas = 35.f;
+	
+	bool found = false;
+	float nearest = fdist(orgn, dest);
+	if(nearest < pas) {
+		pas = nearest * .5f;
 	}
 	
-	tmpPos.x -= i.x;
-	tmpPos.y -= i.y;
-	tmpPos.z -= i.z;
-
+	Vec3f d = dest - orgn;
+	Vec3f ad = glm::abs(d);
+	float iter = std::max(ad.x, std::max(ad.y, ad.z)) / pas;
+	Vec3f i = d / iter;
+	
+	Vec3f pos = orgn - i;
+	
 	while(iter > 0.f) {
 		iter -= 1.f;
-		tmpPos.x += i.x;
-		tmpPos.y += i.y;
-		tmpPos.z += i.z;
-
-		long px = (long)(tmpPos.x * ACTIVEBKG->Xmul);
-		long pz = (long)(tmpPos.z * ACTIVEBKG->Zmul);
-
-		if(px < 0 || px > ACTIVEBKG->Xsize - 1 || pz < 0 || pz > ACTIVEBKG->Zsize - 1)
+		pos += i;
+		
+		long px = long(pos.x * ACTIVEBKG->Xmul);
+		long pz = long(pos.z * ACTIVEBKG->Zmul);
+		if(px < 0 || px > ACTIVEBKG->Xsize - 1 || pz < 0 || pz > ACTIVEBKG->Zsize - 1) {
 			break;
-
-		EERIE_BKG_INFO * eg = &ACTIVEBKG->fastdata[px][pz];
-
-		for(long k = 0; k < eg->nbpolyin; k++) {
-			EERIEPOLY * ep = eg->polyin[k];
-
-			if(ep)
-			if((ep->min.y - pas < tmpPos.y) && (ep->max.y + pas > tmpPos.y))
-			if((ep->min.x - pas < tmpPos.x) && (ep->max.x + pas > tmpPos.x))
-			if((ep->min.z - pas < tmpPos.z) && (ep->max.z + pas > tmpPos.z))
-			if(RayCollidingPoly(orgn, dest, *ep, hit)) {
-				float dd = fdist(orgn, *hit);
-
-				if(dd < nearest) {
-					nearest = dd;
-					found_ep = ep;
-					found_hit = *hit;
+		}
+		
+		const EERIE_BKG_INFO & eg = ACTIVEBKG->fastdata[px][pz];
+		for(long k = 0; k < eg.nbpolyin; k++) {
+			const EERIEPOLY * ep = eg.polyin[k];
+			
+			if(ep->type & ignored) {
+				continue;
+			}
+			
+			if(   ep->min.y - pas < pos.y && ep->max.y + pas > pos.y
+			   && ep->min.x - pas < pos.x && ep->max.x + pas > pos.x
+			   && ep->min.z - pas < pos.z && ep->max.z + pas > pos.z) {
+				Vec3f polyHit;
+				if(RayCollidingPoly(orgn, dest, *ep, &polyHit)) {
+					float dd = fdist(orgn, polyHit);
+					if(dd < nearest) {
+						nearest = dd;
+						found = true;
+						hit = polyHit;
+					}
 				}
 			}
 		}
 	}
+	
+	return found;
+}
 
-	if(!found_ep)
-		return true;
+} // anonymous namespace
+
+void RaycastBenchmarkRecord(const Vec3f & orgn, const Vec3f & dest) {
 	
-	*hit = found_hit;
+	RecordedRay ray;
+	ray.orgn = orgn;
+	ray.dest = dest;
 	
-	return false;
+	if(recordedRays.size() < MaxRecordedRays) {
+		recordedRays.push_back(ray);
+	} else {
+		recordedRays[nextRecordedRay] = ray;
+	}
+	nextRecordedRay = (nextRecordedRay + 1) % MaxRecordedRays;
+}
+
+void RaycastBenchmark() {
+	
+	if(recordedRays.empty() || !ACTIVEBKG) {
+		LogInfo << "Raycast benchmark: no recorded line-of-sight queries";
+		return;
+	}
+	
+	const PolyType ignored = POLY_WATER | POLY_TRANS | POLY_NOCOL;
+	const size_t repeat = 10;
+	
+	size_t marchHits = 0;
+	u64 start = platform::getTimeUs();
+	for(size_t r = 0; r < repeat; r++) {
+		for(size_t i = 0; i < recordedRays.size(); i++) {
+			Vec3f hit;
+			marchHits += MarchBackground(recordedRays[i].orgn, recordedRays[i].dest, hit, ignored);
+		}
+	}
+	u64 marchTime = platform::getElapsedUs(start);
+	
+	size_t traversalHits = 0;
+	start = platform::getTimeUs();
+	for(size_t r = 0; r < repeat; r++) {
+		for(size_t i = 0; i < recordedRays.size(); i++) {
+			Vec3f hit;
+			traversalHits += RaycastBackground(recordedRays[i].orgn, recordedRays[i].dest, hit, ignored);
+		}
+	}
+	u64 traversalTime = platform::getElapsedUs(start);
+	
+	size_t count = recordedRays.size() * repeat;
+	LogInfo << "Raycast benchmark: " << recordedRays.size() << " queries x " << repeat;
+	LogInfo << " - fixed step: " << marchTime << " us, " << (marchHits / repeat) << " blocked";
+	LogInfo << " - tile traversal: " << traversalTime << " us, " << (traversalHits / repeat) << " blocked";
+	if(traversalTime > 0) {
+		LogInfo << " - speedup: " << (float(marchTime) / float(traversalTime))
+		        << "x, " << (float(traversalTime) / float(count)) << " us per query";
+	}
 }
 
 
@@ -1463,8 +1592,13 @@ static bool loadFastScene(const res::path & file, const char * data, const char
 	TextureContainerMap textures;
 	const FAST_TEXTURE_CONTAINER * ftc;
 	ftc = fts_read<FAST_TEXTURE_CONTAINER>(data, end, fsh->nb_textures);
+	std::vector<res::path> textureNames;
+	for(long k = 0; k < fsh->nb_textures; k++) {
+		textureNames.push_back(res::path::load(util::loadString(ftc[k].fic)).remove_ext());
+	}
+	TextureContainer::Prefetch(textureNames);
 	for(long k = 0; k < fsh->nb_textures; k++) {
-		res::path file = res::path::load(util::loadString(ftc[k].fic)).remove_ext();
+		const res::path & file = textureNames[k];
 		TextureContainer * tmpTC;
 		tmpTC = TextureContainer::Load(file, TextureContainer::Level);
 		if(tmpTC) {
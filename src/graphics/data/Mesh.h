@@ -106,8 +106,29 @@ extern EERIE_CAMERA * ACTIVECAM;
 
 //	Entity Struct End
 
+/*!
+ * Find the nearest background polygon crossed by a line segment.
+ *
+ * Walks the background tiles crossed by the segment in order and tests each polygon
+ * at most once, stopping shortly after the first hit.
+ *
+ * \param ignored Polygons with any of these flags are skipped.
+ * \return true if a polygon was hit, hit is then set to the intersection point.
+ */
+bool RaycastBackground(const Vec3f & orgn, const Vec3f & dest, Vec3f & hit,
+                       PolyType ignored = PolyType());
+
 bool Visible(const Vec3f & orgn, const Vec3f & dest, Vec3f * hit);
 
+//! Record a line-of-sight query to be replayed by RaycastBenchmark()
+void RaycastBenchmarkRecord(const Vec3f & orgn, const Vec3f & dest);
+
+/*!
+ * Replay the recently recorded line-of-sight queries with both the tile traversal
+ * and the old fixed-step ray marcher and log the timings.
+ */
+void RaycastBenchmark();
+
 EERIE_BKG_INFO * getFastBackgroundData(float x, float z);
 
 EERIEPOLY * CheckTopPoly(const Vec3f & pos);
@@ -128,7 +149,12 @@ EERIEPOLY * GetMaxPoly(const Vec3f & pos);
  
 int PointIn2DPolyXZ(const EERIEPOLY * ep, float x, float z);
 
-int EERIELaunchRay3(const Vec3f & orgn, const Vec3f & dest, Vec3f & hit, long flag);
+/*!
+ * Cast a ray through the background, treating tiles without polygons as solid.
+ *
+ * \return 1 if something was hit, -1 if the ray left the background and 0 otherwise.
+ */
+int EERIELaunchRay3(const Vec3f & orgn, const Vec3f & dest, Vec3f & hit);
 
 Vec3f EE_RT(const Vec3f & in);
 void EE_P(const Vec3f * in, TexturedVertex * out);
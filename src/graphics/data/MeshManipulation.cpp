@@ -59,6 +59,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "graphics/GraphicsTypes.h"
 #include "graphics/Vertex.h"
 #include "graphics/data/Mesh.h"
+#include "graphics/data/MeshTweak.h"
 #include "graphics/data/TextureContainer.h"
 #include "graphics/effects/DrawEffects.h"
 
@@ -131,149 +132,6 @@ long IsInSelection(const EERIE_3DOBJ * obj, long vert, long tw) {
 	return -1;
 }
 
-static long GetEquivalentVertex(const EERIE_3DOBJ * obj, const EERIE_VERTEX * vert) {
-	
-	for(size_t i = 0; i < obj->vertexlist.size(); i++) {
-		if(obj->vertexlist[i].v.x == vert->v.x
-		   && obj->vertexlist[i].v.y == vert->v.y
-		   && obj->vertexlist[i].v.z == vert->v.z
-		) {
-			return i;
-		}
-	}
-
-	return -1;
-}
-
-static long ObjectAddVertex(EERIE_3DOBJ * obj, const EERIE_VERTEX * vert) {
-	
-	for(size_t i = 0; i < obj->vertexlist.size(); i++) {
-		if(obj->vertexlist[i].v.x == vert->v.x
-		   && obj->vertexlist[i].v.y == vert->v.y
-		   && obj->vertexlist[i].v.z == vert->v.z
-		) {
-			return i;
-		}
-	}
-
-	obj->vertexlist.push_back(*vert);
-	return obj->vertexlist.size() - 1;
-}
-
-static long GetActionPoint(const EERIE_3DOBJ * obj, const char * name) {
-	
-	if(!obj)
-		return -1;
-
-	for(size_t n = 0; n < obj->actionlist.size(); n++) { // TODO iterator
-		if(obj->actionlist[n].name == name) {
-			return obj->actionlist[n].idx;
-		}
-	}
-
-	return -1;
-}
-
-static long ObjectAddFace(EERIE_3DOBJ * obj, const EERIE_FACE * face, const EERIE_3DOBJ * srcobj) {
-	
-	// Check Already existing faces
-	for(size_t i = 0; i < obj->facelist.size(); i++) {
-		if(obj->vertexlist[obj->facelist[i].vid[0]].v.x == srcobj->vertexlist[face->vid[0]].v.x
-		   && obj->vertexlist[obj->facelist[i].vid[1]].v.x == srcobj->vertexlist[face->vid[1]].v.x
-		   && obj->vertexlist[obj->facelist[i].vid[2]].v.x == srcobj->vertexlist[face->vid[2]].v.x
-		   && obj->vertexlist[obj->facelist[i].vid[0]].v.y == srcobj->vertexlist[face->vid[0]].v.y
-		   && obj->vertexlist[obj->facelist[i].vid[1]].v.y == srcobj->vertexlist[face->vid[1]].v.y
-		   && obj->vertexlist[obj->facelist[i].vid[2]].v.y == srcobj->vertexlist[face->vid[2]].v.y
-		   && obj->vertexlist[obj->facelist[i].vid[0]].v.z == srcobj->vertexlist[face->vid[0]].v.z
-		   && obj->vertexlist[obj->facelist[i].vid[1]].v.z == srcobj->vertexlist[face->vid[1]].v.z
-		   && obj->vertexlist[obj->facelist[i].vid[2]].v.z == srcobj->vertexlist[face->vid[2]].v.z
-		) {
-			return -1;
-		}
-	}
-
-	long f0 = ObjectAddVertex(obj, &srcobj->vertexlist[face->vid[0]]);
-	long f1 = ObjectAddVertex(obj, &srcobj->vertexlist[face->vid[1]]);
-	long f2 = ObjectAddVertex(obj, &srcobj->vertexlist[face->vid[2]]);
-
-	if(f1 == -1 || f2 == -1 || f0 == -1)
-		return -1;
-
-	obj->facelist.push_back(*face);
-
-	obj->facelist.back().vid[0] = (unsigned short)f0;
-	obj->facelist.back().vid[1] = (unsigned short)f1;
-	obj->facelist.back().vid[2] = (unsigned short)f2;
-	obj->facelist.back().texid = 0; 
-
-	for(size_t i = 0; i < obj->texturecontainer.size(); i++) {
-		if(0 <= face->texid
-		   && (size_t)face->texid < srcobj->texturecontainer.size()
-		   && obj->texturecontainer[i] == srcobj->texturecontainer[face->texid]
-		) {
-			obj->facelist.back().texid = (short)i;
-			break;
-		}
-	}
-
-	return obj->facelist.size() - 1;
-}
-
-static long ObjectAddAction(EERIE_3DOBJ * obj, const std::string & name, long act,
-                            long sfx, const EERIE_VERTEX * vert) {
-	
-	long newvert = ObjectAddVertex(obj, vert);
-
-	if (newvert < 0) return -1;
-	
-	long j = 0;
-	for(std::vector<EERIE_ACTIONLIST>::iterator i = obj->actionlist.begin();
-	    i != obj->actionlist.end(); ++i) {
-		if(i->name == name) {
-			return j;
-		}
-		j++;
-	}
-	
-	obj->actionlist.push_back(EERIE_ACTIONLIST());
-	
-	EERIE_ACTIONLIST & action = obj->actionlist.back();
-	
-	action.name = name;
-	action.act = act;
-	action.sfx = sfx;
-	action.idx = newvert;
-	
-	return (obj->actionlist.size() - 1);
-}
-
-long ObjectAddMap(EERIE_3DOBJ * obj, TextureContainer * tc) {
-	
-	if(tc == NULL)
-		return -1;
-
-	for(size_t i = 0; i < obj->texturecontainer.size(); i++) {
-		if(obj->texturecontainer[i] == tc)
-			return i;
-	}
-
-	obj->texturecontainer.push_back(tc);
-
-	return obj->texturecontainer.size() - 1;
-}
-
-static void AddVertexToGroup(EERIE_3DOBJ * obj, long group, const EERIE_VERTEX * vert) {
-
-	for(size_t i = 0; i < obj->vertexlist.size(); i++) {
-		if(obj->vertexlist[i].v.x == vert->v.x
-		   && obj->vertexlist[i].v.y == vert->v.y
-		   && obj->vertexlist[i].v.z == vert->v.z
-		) {
-			AddVertexIdxToGroup(obj, group, i);
-		}
-	}
-}
-
 void AddVertexIdxToGroup(EERIE_3DOBJ * obj, long group, long val) {
 	
 	for(size_t i = 0; i < obj->grouplist[group].indexes.size(); i++) {
@@ -285,400 +143,6 @@ void AddVertexIdxToGroup(EERIE_3DOBJ * obj, long group, long val) {
 	obj->grouplist[group].indexes.push_back(val);
 }
 
-static void ObjectAddSelection(EERIE_3DOBJ * obj, long numsel, long vidx) {
-	
-	for(size_t i = 0; i < obj->selections[numsel].selected.size(); i++) {
-		if(obj->selections[numsel].selected[i] == vidx)
-			return;
-	}
-	
-	obj->selections[numsel].selected.push_back(vidx);
-}
-
-static EERIE_3DOBJ * CreateIntermediaryMesh(const EERIE_3DOBJ * obj1, const EERIE_3DOBJ * obj2, long tw) {
-	
-	long tw1 = -1;
-	long tw2 = -1;
-	long iw1 = -1;
-	long jw1 = -1;
-	long sel_head1 = -1;
-	long sel_head2 = -1;
-	long sel_torso1 = -1;
-	long sel_torso2 = -1;
-	long sel_legs1 = -1;
-	long sel_legs2 = -1;
-
-	// First we retreive selection groups indexes
-	for(size_t i = 0; i < obj1->selections.size(); i++) { // TODO iterator
-		if(obj1->selections[i].name == "head") {
-			sel_head1 = i;
-		} else if(obj1->selections[i].name == "chest") {
-			sel_torso1 = i;
-		} else if(obj1->selections[i].name == "leggings") {
-			sel_legs1 = i;
-		}
-	}
-
-	for(size_t i = 0; i < obj2->selections.size(); i++) { // TODO iterator
-		if(obj2->selections[i].name == "head") {
-			sel_head2 = i;
-		} else if(obj2->selections[i].name == "chest") {
-			sel_torso2 = i;
-		} else if(obj2->selections[i].name == "leggings") {
-			sel_legs2 = i;
-		}
-	}
-
-	if(sel_head1 == -1) return NULL;
-
-	if(sel_head2 == -1) return NULL;
-
-	if(sel_torso1 == -1) return NULL;
-
-	if(sel_torso2 == -1) return NULL;
-
-	if(sel_legs1 == -1) return NULL;
-
-	if(sel_legs2 == -1) return NULL;
-
-	if(tw == TWEAK_HEAD) {
-		tw1 = sel_head1;
-		tw2 = sel_head2;
-		iw1 = sel_torso1;
-		jw1 = sel_legs1;
-	}
-
-	if(tw == TWEAK_TORSO) {
-		tw1 = sel_torso1;
-		tw2 = sel_torso2;
-		iw1 = sel_head1;
-		jw1 = sel_legs1;
-	}
-
-	if(tw == TWEAK_LEGS) {
-		tw1 = sel_legs1;
-		tw2 = sel_legs2;
-		iw1 = sel_torso1;
-		jw1 = sel_head1;
-	}
-
-	if(tw1 == -1 || tw2 == -1)
-		return NULL;
-
-	// Now Retreives Tweak Action Points
-	{
-		long idx_head1 = GetActionPoint(obj1, "head2chest");
-		if(idx_head1 < 0)
-			return NULL;
-
-		long idx_head2 = GetActionPoint(obj2, "head2chest");
-		if(idx_head2 < 0)
-			return NULL;
-
-		long idx_torso1 = GetActionPoint(obj1, "chest2leggings");
-		if(idx_torso1 < 0)
-			return NULL;
-
-		long idx_torso2 = GetActionPoint(obj2, "chest2leggings");
-		if(idx_torso2 < 0)
-			return NULL;
-	}
-
-	// copy vertices
-	std::vector<EERIE_VERTEX> obj1vertexlist2 = obj1->vertexlist;
-	std::vector<EERIE_VERTEX> obj2vertexlist2 = obj2->vertexlist;
-
-	// Work will contain the Tweaked object
-	EERIE_3DOBJ * work = new EERIE_3DOBJ;
-	work->pos = obj1->pos;
-	work->angle = obj1->angle;
-	
-	// We reset all data to create a fresh object
-	work->cub = obj1->cub;
-	work->quat = obj1->quat;
-
-	// Linked objects are linked to this object.
-	if(obj1->linked.size() > obj2->linked.size()) {
-		work->linked = obj1->linked;
-	} else if(obj2->linked.size() > 0) {
-		work->linked = obj2->linked;
-	} else {
-		work->linked.clear();
-	}
-
-	// Is the origin of object in obj1 or obj2 ? Retreives it for work object
-	if(IsInSelection(obj1, obj1->origin, tw1) != -1) {
-		work->point0 = obj2->point0;
-		work->origin = ObjectAddVertex(work, &obj2vertexlist2[obj2->origin]); 
-	} else {
-		work->point0 = obj1->point0;
-		work->origin = ObjectAddVertex(work, &obj1vertexlist2[obj1->origin]); 
-	}
-
-	// Recreate Action Points included in work object.for Obj1
-	for(size_t i = 0; i < obj1->actionlist.size(); i++) {
-		const EERIE_ACTIONLIST & action = obj1->actionlist[i];
-
-		if(IsInSelection(obj1, action.idx, iw1) != -1
-				|| IsInSelection(obj1, action.idx, jw1) != -1
-				|| action.name == "head2chest"
-				|| action.name == "chest2leggings"
-		) {
-			ObjectAddAction(work, action.name, action.act,
-							action.sfx, &obj1vertexlist2[action.idx]);
-		}
-	}
-
-	// Do the same for Obj2
-	for(size_t i = 0; i < obj2->actionlist.size(); i++) {
-		const EERIE_ACTIONLIST & action = obj2->actionlist[i];
-
-		if(IsInSelection(obj2, action.idx, tw2) != -1
-				|| action.name == "head2chest"
-				|| action.name == "chest2leggings"
-		) {
-			ObjectAddAction(work, action.name, action.act,
-							action.sfx, &obj2vertexlist2[action.idx]);
-		}
-	}
-
-	// Recreate Vertex using Obj1 Vertexes
-	for(size_t i = 0; i < obj1->vertexlist.size(); i++) {
-		if(IsInSelection(obj1, i, iw1) != -1 || IsInSelection(obj1, i, jw1) != -1) {
-			ObjectAddVertex(work, &obj1vertexlist2[i]);
-		}
-	}
-
-	// The same for Obj2
-	for(size_t i = 0; i < obj2->vertexlist.size(); i++) {
-		if(IsInSelection(obj2, i, tw2) != -1) {
-			ObjectAddVertex(work, &obj2vertexlist2[i]);
-		}
-	}
-
-
-	// Look in Faces for forgotten Vertexes... AND
-	// Re-Create TextureContainers Infos
-	// We look for texturecontainers included in the future tweaked object
-	TextureContainer * tc = NULL;
-
-	for(size_t i = 0; i < obj1->facelist.size(); i++) {
-		const EERIE_FACE & face = obj1->facelist[i];
-
-		if(((IsInSelection(obj1, face.vid[0], iw1) != -1)
-				||	(IsInSelection(obj1, face.vid[0], jw1) != -1))
-				&&	((IsInSelection(obj1, face.vid[1], iw1) != -1)
-					 ||	(IsInSelection(obj1, face.vid[1], jw1) != -1))
-				&&	((IsInSelection(obj1, face.vid[2], iw1) != -1)
-					 ||	(IsInSelection(obj1, face.vid[2], jw1) != -1))
-		) {
-			if(face.texid != -1) {
-				if(tc != obj1->texturecontainer[face.texid]) {
-					tc = obj1->texturecontainer[face.texid];
-					ObjectAddMap(work, tc);
-				}
-			}
-
-			ObjectAddFace(work, &face, obj1);
-		}
-	}
-
-	for(size_t i = 0; i < obj2->facelist.size(); i++) {
-		const EERIE_FACE & face = obj2->facelist[i];
-
-		if(IsInSelection(obj2, face.vid[0], tw2) != -1
-		   || IsInSelection(obj2, face.vid[1], tw2) != -1
-		   || IsInSelection(obj2, face.vid[2], tw2) != -1
-		) {
-
-			if(face.texid != -1) {
-				if(tc != obj2->texturecontainer[face.texid]) {
-					tc = obj2->texturecontainer[face.texid];
-					ObjectAddMap(work, tc);
-				}
-			}
-
-			ObjectAddFace(work, &face, obj2);
-		}
-	}
-
-	// Recreate Groups
-	work->grouplist.resize(std::max(obj1->grouplist.size(), obj2->grouplist.size()));
-
-	for(size_t k = 0; k < obj1->grouplist.size(); k++) {
-		work->grouplist[k].name = obj1->grouplist[k].name;
-		long v = GetEquivalentVertex(work, &obj1vertexlist2[obj1->grouplist[k].origin]);
-
-		if(v >= 0) {
-			work->grouplist[k].siz = obj1->grouplist[k].siz;
-
-			if ((IsInSelection(obj1, obj1->grouplist[k].origin, iw1) != -1)
-			        || (IsInSelection(obj1, obj1->grouplist[k].origin, jw1) != -1))
-				work->grouplist[k].origin = v;
-		}
-	}
-
-	for(size_t k = 0; k < obj2->grouplist.size(); k++) {
-		if(k >= obj1->grouplist.size()) {
-			work->grouplist[k].name = obj2->grouplist[k].name;
-		}
-
-		long v = GetEquivalentVertex(work, &obj2vertexlist2[obj2->grouplist[k].origin]);
-
-		if(v >= 0) {
-			work->grouplist[k].siz = obj2->grouplist[k].siz;
-
-			if(IsInSelection(obj2, obj2->grouplist[k].origin, tw2) != -1)
-				work->grouplist[k].origin = v;
-		}
-	}
-
-	// Recreate Selection Groups (only the 3 selections needed to reiterate MeshTweaking !)
-	work->selections.resize(3);
-	work->selections[0].name = "head";
-	work->selections[1].name = "chest";
-	work->selections[2].name = "leggings";
-
-	// Re-Creating sel_head
-	if(tw == TWEAK_HEAD) {
-		for(size_t l = 0; l < obj2->selections[sel_head2].selected.size(); l++) {
-			EERIE_VERTEX temp;
-			temp.v = obj2vertexlist2[obj2->selections[sel_head2].selected[l]].v;
-			long t = GetEquivalentVertex(work, &temp);
-
-			if(t != -1) {
-				ObjectAddSelection(work, 0, t);
-			}
-		}
-	} else {
-		for(size_t l = 0; l < obj1->selections[sel_head1].selected.size(); l++) {
-			EERIE_VERTEX temp;
-			temp.v = obj1vertexlist2[obj1->selections[sel_head1].selected[l]].v;
-			long t = GetEquivalentVertex(work, &temp);
-
-			if(t != -1) {
-				ObjectAddSelection(work, 0, t);
-			}
-		}
-	}
-
-	// Re-Create sel_torso
-	if(tw == TWEAK_TORSO) {
-		for(size_t l = 0; l < obj2->selections[sel_torso2].selected.size(); l++) {
-			EERIE_VERTEX temp;
-			temp.v = obj2vertexlist2[obj2->selections[sel_torso2].selected[l]].v;
-			long t = GetEquivalentVertex(work, &temp);
-
-			if(t != -1) {
-				ObjectAddSelection(work, 1, t);
-			}
-		}
-	} else {
-		for(size_t l = 0; l < obj1->selections[sel_torso1].selected.size(); l++) {
-			EERIE_VERTEX temp;
-			temp.v = obj1vertexlist2[obj1->selections[sel_torso1].selected[l]].v;
-			long t = GetEquivalentVertex(work, &temp);
-
-			if(t != -1) {
-				ObjectAddSelection(work, 1, t);
-			}
-		}
-	}
-
-	// Re-Create sel_legs
-	if(tw == TWEAK_LEGS) {
-		for(size_t l = 0; l < obj2->selections[sel_legs2].selected.size(); l++) {
-			EERIE_VERTEX temp;
-			temp.v = obj2vertexlist2[obj2->selections[sel_legs2].selected[l]].v;
-			long t = GetEquivalentVertex(work, &temp);
-
-			if(t != -1) {
-				ObjectAddSelection(work, 2, t);
-			}
-		}
-	} else {
-		for(size_t l = 0; l < obj1->selections[sel_legs1].selected.size(); l++) {
-			EERIE_VERTEX temp;
-			temp.v = obj1vertexlist2[obj1->selections[sel_legs1].selected[l]].v;
-			long t = GetEquivalentVertex(work, &temp);
-
-			if(t != -1) {
-				ObjectAddSelection(work, 2, t);
-			}
-		}
-	}
-
-	//Now recreates other selections...
-	for(size_t i = 0; i < obj1->selections.size(); i++) {
-		
-		if(EERIE_OBJECT_GetSelection(work, obj1->selections[i].name) == -1) {
-			long num = work->selections.size();
-			work->selections.resize(num + 1);
-			work->selections[num].name = obj1->selections[i].name;
-
-			for(size_t l = 0; l < obj1->selections[i].selected.size(); l++) {
-				EERIE_VERTEX temp;
-				temp.v = obj1vertexlist2[obj1->selections[i].selected[l]].v;
-				long t = GetEquivalentVertex(work, &temp);
-
-				if (t != -1)
-				{
-					ObjectAddSelection(work, num, t);
-				}
-			}
-
-			long ii = EERIE_OBJECT_GetSelection(obj2, obj1->selections[i].name);
-
-			if(ii != -1) {
-				for(size_t l = 0; l < obj2->selections[ii].selected.size(); l++) {
-					EERIE_VERTEX temp;
-					temp.v = obj2vertexlist2[obj2->selections[ii].selected[l]].v;
-					long t = GetEquivalentVertex(work, &temp);
-
-					if(t != -1) {
-						ObjectAddSelection(work, num, t);
-					}
-				}
-			}
-		}
-	}
-
-	for(size_t i = 0; i < obj2->selections.size(); i++) {
-		if(EERIE_OBJECT_GetSelection(work, obj2->selections[i].name) == -1) {
-			long num = work->selections.size();
-			work->selections.resize(num + 1);
-			work->selections[num].name = obj2->selections[i].name;
-
-			for(size_t l = 0; l < obj2->selections[i].selected.size(); l++) {
-				EERIE_VERTEX temp;
-				temp.v = obj2vertexlist2[obj2->selections[i].selected[l]].v;
-				long t = GetEquivalentVertex(work, &temp);
-
-				if(t != -1) {
-					ObjectAddSelection(work, num, t);
-				}
-			}
-		}
-	}
-
-	// Recreate Animation-groups vertex
-	for(size_t i = 0; i < obj1->grouplist.size(); i++) {
-		for(size_t j = 0; j < obj1->grouplist[i].indexes.size(); j++) {
-			AddVertexToGroup(work, i, &obj1vertexlist2[obj1->grouplist[i].indexes[j]]);
-		}
-	}
-
-	for(size_t i = 0; i < obj2->grouplist.size(); i++) {
-		for(size_t j = 0; j < obj2->grouplist[i].indexes.size(); j++) {
-			AddVertexToGroup(work, i, &obj2vertexlist2[obj2->grouplist[i].indexes[j]]);
-		}
-	}
-
-	work->vertexlist3 = work->vertexlist;
-
-	return work;
-}
-
 void EERIE_MESH_TWEAK_Do(Entity * io, TweakType tw, const res::path & path) {
 	
 	res::path ftl_file = ("game" / path).set_ext("ftl");
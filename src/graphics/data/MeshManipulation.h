@@ -48,7 +48,6 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "io/resource/ResourcePath.h"
 
 struct EERIE_3DOBJ;
-class TextureContainer;
 class Entity;
 
 enum TweakFlag {
@@ -75,6 +74,5 @@ void EERIE_MESH_TWEAK_Do(Entity * io, TweakType tw, const res::path & path);
 long IsInSelection(const EERIE_3DOBJ * obj, long vert, long tw);
 void AddVertexIdxToGroup(EERIE_3DOBJ * obj, long group, long val);
 void EERIE_MESH_TWEAK_Skin(EERIE_3DOBJ * obj, const res::path & skintochange, const res::path & skinname);
-long ObjectAddMap(EERIE_3DOBJ * obj, TextureContainer * tc);
 
 #endif // ARX_GRAPHICS_DATA_MESHMANIPULATION_H
@@ -0,0 +1,661 @@
+/*
+ * Copyright 2011-2012 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/* Based on:
+===========================================================================
+ARX FATALIS GPL Source Code
+Copyright (C) 1999-2010 Arkane Studios SA, a ZeniMax Media company.
+
+This file is part of the Arx Fatalis GPL Source Code ('Arx Fatalis Source Code'). 
+
+Arx Fatalis Source Code is free software: you can redistribute it and/or modify it under the terms of the GNU General Public 
+License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+Arx Fatalis Source Code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with Arx Fatalis Source Code.  If not, see 
+<http://www.gnu.org/licenses/>.
+
+In addition, the Arx Fatalis Source Code is also subject to certain additional terms. You should have received a copy of these 
+additional terms immediately following the terms and conditions of the GNU General Public License which accompanied the Arx 
+Fatalis Source Code. If not, please request a copy in writing from Arkane Studios at the address below.
+
+If you have questions concerning this license or the applicable additional terms, you may contact in writing Arkane Studios, c/o 
+ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
+===========================================================================
+*/
+// Code: Cyril Meynier
+//
+// Copyright (c) 1999-2000 ARKANE Studios SA. All rights reserved
+
+#include "graphics/data/MeshTweak.h"
+
+#include <stddef.h>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "graphics/GraphicsTypes.h"
+#include "graphics/data/MeshManipulation.h"
+
+#include "math/Types.h"
+
+#include "platform/Platform.h"
+
+#include "scene/Object.h"
+
+namespace {
+
+//! Bit pattern of a vertex position, with -0 and +0 treated as equal like operator==
+struct VertexPosition {
+	
+	u32 x;
+	u32 y;
+	u32 z;
+	
+	bool operator==(const VertexPosition & o) const {
+		return x == o.x && y == o.y && z == o.z;
+	}
+	
+};
+
+size_t hash_value(const VertexPosition & pos) {
+	size_t seed = 0;
+	boost::hash_combine(seed, pos.x);
+	boost::hash_combine(seed, pos.y);
+	boost::hash_combine(seed, pos.z);
+	return seed;
+}
+
+u32 getPositionBits(float value) {
+	if(value == 0.f) {
+		return 0;
+	}
+	u32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+/*!
+ * \return false if the position can never compare equal to another one
+ *         because it has a NaN component
+ */
+bool getVertexPosition(const Vec3f & v, VertexPosition & pos) {
+	if(v.x != v.x || v.y != v.y || v.z != v.z) {
+		return false;
+	}
+	pos.x = getPositionBits(v.x);
+	pos.y = getPositionBits(v.y);
+	pos.z = getPositionBits(v.z);
+	return true;
+}
+
+/*!
+ * Merges vertices with the same position while building a mesh
+ *
+ * Replaces linear searches through the vertex list. While the index is in use,
+ * vertices must only be added to the mesh through it.
+ */
+class VertexIndex {
+	
+	typedef boost::unordered_map<VertexPosition, long> Positions;
+	
+	EERIE_3DOBJ * m_obj;
+	Positions m_positions;
+	
+public:
+	
+	explicit VertexIndex(EERIE_3DOBJ * obj) : m_obj(obj) {
+		for(size_t i = 0; i < obj->vertexlist.size(); i++) {
+			VertexPosition pos;
+			if(getVertexPosition(obj->vertexlist[i].v, pos)) {
+				m_positions.insert(Positions::value_type(pos, long(i)));
+			}
+		}
+	}
+	
+	//! \return the index of the first vertex at the given position or -1
+	long find(const Vec3f & v) const {
+		VertexPosition pos;
+		if(!getVertexPosition(v, pos)) {
+			return -1;
+		}
+		Positions::const_iterator it = m_positions.find(pos);
+		return (it == m_positions.end()) ? -1 : it->second;
+	}
+	
+	//! \return the index of the vertex at the position of vert, adding it if needed
+	long add(const EERIE_VERTEX & vert) {
+		
+		long index = long(m_obj->vertexlist.size());
+		
+		VertexPosition pos;
+		if(getVertexPosition(vert.v, pos)) {
+			std::pair<Positions::iterator, bool> result;
+			result = m_positions.insert(Positions::value_type(pos, index));
+			if(!result.second) {
+				return result.first->second;
+			}
+		}
+		
+		m_obj->vertexlist.push_back(vert);
+		
+		return index;
+	}
+	
+};
+
+//! Vertex indices of the faces in a mesh being built
+typedef boost::unordered_set<u64> FaceIndex;
+
+u64 getFaceKey(long v0, long v1, long v2) {
+	return (u64(u16(v0)) << 32) | (u64(u16(v1)) << 16) | u64(u16(v2));
+}
+
+//! Membership test for the vertices of a selection
+class SelectionMask {
+	
+	std::vector<bool> m_selected;
+	
+public:
+	
+	SelectionMask(const EERIE_3DOBJ * obj, long sel) : m_selected(obj->vertexlist.size(), false) {
+		if(sel < 0) {
+			return;
+		}
+		const std::vector<long> & selected = obj->selections[sel].selected;
+		for(size_t i = 0; i < selected.size(); i++) {
+			if(selected[i] >= 0 && size_t(selected[i]) < m_selected.size()) {
+				m_selected[selected[i]] = true;
+			}
+		}
+	}
+	
+	bool contains(long vert) const {
+		return vert >= 0 && size_t(vert) < m_selected.size() && m_selected[vert];
+	}
+	
+};
+
+//! Appends vertex indices to a list, skipping indices that are already in it
+class VertexSet {
+	
+	std::vector<long> & m_list;
+	std::vector<bool> m_contains;
+	
+public:
+	
+	VertexSet(std::vector<long> & list, size_t vertexCount)
+		: m_list(list), m_contains(vertexCount, false) {
+		for(size_t i = 0; i < list.size(); i++) {
+			if(list[i] >= 0 && size_t(list[i]) < vertexCount) {
+				m_contains[list[i]] = true;
+			}
+		}
+	}
+	
+	void add(long vert) {
+		arx_assert(vert >= 0 && size_t(vert) < m_contains.size());
+		if(!m_contains[vert]) {
+			m_contains[vert] = true;
+			m_list.push_back(vert);
+		}
+	}
+	
+};
+
+} // anonymous namespace
+
+static long GetActionPoint(const EERIE_3DOBJ * obj, const char * name) {
+	
+	if(!obj)
+		return -1;
+
+	for(size_t n = 0; n < obj->actionlist.size(); n++) { // TODO iterator
+		if(obj->actionlist[n].name == name) {
+			return obj->actionlist[n].idx;
+		}
+	}
+
+	return -1;
+}
+
+static long ObjectAddFace(EERIE_3DOBJ * obj, VertexIndex & vertices, FaceIndex & faces,
+                          const EERIE_FACE * face, const EERIE_3DOBJ * srcobj) {
+	
+	const EERIE_VERTEX & v0 = srcobj->vertexlist[face->vid[0]];
+	const EERIE_VERTEX & v1 = srcobj->vertexlist[face->vid[1]];
+	const EERIE_VERTEX & v2 = srcobj->vertexlist[face->vid[2]];
+	
+	// Check Already existing faces
+	// Vertex positions are unique, so faces with the same positions use the same vertices
+	long e0 = vertices.find(v0.v);
+	long e1 = vertices.find(v1.v);
+	long e2 = vertices.find(v2.v);
+	if(e0 != -1 && e1 != -1 && e2 != -1 && faces.find(getFaceKey(e0, e1, e2)) != faces.end()) {
+		return -1;
+	}
+
+	long f0 = vertices.add(v0);
+	long f1 = vertices.add(v1);
+	long f2 = vertices.add(v2);
+
+	obj->facelist.push_back(*face);
+
+	obj->facelist.back().vid[0] = (unsigned short)f0;
+	obj->facelist.back().vid[1] = (unsigned short)f1;
+	obj->facelist.back().vid[2] = (unsigned short)f2;
+	obj->facelist.back().texid = 0; 
+	
+	faces.insert(getFaceKey(f0, f1, f2));
+
+	for(size_t i = 0; i < obj->texturecontainer.size(); i++) {
+		if(0 <= face->texid
+		   && (size_t)face->texid < srcobj->texturecontainer.size()
+		   && obj->texturecontainer[i] == srcobj->texturecontainer[face->texid]
+		) {
+			obj->facelist.back().texid = (short)i;
+			break;
+		}
+	}
+
+	return obj->facelist.size() - 1;
+}
+
+static long ObjectAddAction(EERIE_3DOBJ * obj, VertexIndex & vertices, const std::string & name,
+                            long act, long sfx, const EERIE_VERTEX * vert) {
+	
+	long newvert = vertices.add(*vert);
+	
+	long j = 0;
+	for(std::vector<EERIE_ACTIONLIST>::iterator i = obj->actionlist.begin();
+	    i != obj->actionlist.end(); ++i) {
+		if(i->name == name) {
+			return j;
+		}
+		j++;
+	}
+	
+	obj->actionlist.push_back(EERIE_ACTIONLIST());
+	
+	EERIE_ACTIONLIST & action = obj->actionlist.back();
+	
+	action.name = name;
+	action.act = act;
+	action.sfx = sfx;
+	action.idx = newvert;
+	
+	return (obj->actionlist.size() - 1);
+}
+
+long ObjectAddMap(EERIE_3DOBJ * obj, TextureContainer * tc) {
+	
+	if(tc == NULL)
+		return -1;
+
+	for(size_t i = 0; i < obj->texturecontainer.size(); i++) {
+		if(obj->texturecontainer[i] == tc)
+			return i;
+	}
+
+	obj->texturecontainer.push_back(tc);
+
+	return obj->texturecontainer.size() - 1;
+}
+
+//! Add the vertices at the positions of a list of source vertices, if any
+static void AddEquivalentVertices(VertexSet & set, const VertexIndex & vertices,
+                                  const std::vector<EERIE_VERTEX> & srcvertices,
+                                  const std::vector<long> & indices) {
+	for(size_t i = 0; i < indices.size(); i++) {
+		long t = vertices.find(srcvertices[indices[i]].v);
+		if(t != -1) {
+			set.add(t);
+		}
+	}
+}
+
+//! Add the vertices at the positions of a source selection to a selection
+static void AddEquivalentSelection(EERIE_3DOBJ * obj, const VertexIndex & vertices, long numsel,
+                                   const EERIE_3DOBJ * srcobj,
+                                   const std::vector<EERIE_VERTEX> & srcvertices, long srcsel) {
+	VertexSet selection(obj->selections[numsel].selected, obj->vertexlist.size());
+	AddEquivalentVertices(selection, vertices, srcvertices, srcobj->selections[srcsel].selected);
+}
+
+EERIE_3DOBJ * CreateIntermediaryMesh(const EERIE_3DOBJ * obj1, const EERIE_3DOBJ * obj2, long tw) {
+	
+	long tw1 = -1;
+	long tw2 = -1;
+	long iw1 = -1;
+	long jw1 = -1;
+	long sel_head1 = -1;
+	long sel_head2 = -1;
+	long sel_torso1 = -1;
+	long sel_torso2 = -1;
+	long sel_legs1 = -1;
+	long sel_legs2 = -1;
+
+	// First we retreive selection groups indexes
+	for(size_t i = 0; i < obj1->selections.size(); i++) { // TODO iterator
+		if(obj1->selections[i].name == "head") {
+			sel_head1 = i;
+		} else if(obj1->selections[i].name == "chest") {
+			sel_torso1 = i;
+		} else if(obj1->selections[i].name == "leggings") {
+			sel_legs1 = i;
+		}
+	}
+
+	for(size_t i = 0; i < obj2->selections.size(); i++) { // TODO iterator
+		if(obj2->selections[i].name == "head") {
+			sel_head2 = i;
+		} else if(obj2->selections[i].name == "chest") {
+			sel_torso2 = i;
+		} else if(obj2->selections[i].name == "leggings") {
+			sel_legs2 = i;
+		}
+	}
+
+	if(sel_head1 == -1) return NULL;
+
+	if(sel_head2 == -1) return NULL;
+
+	if(sel_torso1 == -1) return NULL;
+
+	if(sel_torso2 == -1) return NULL;
+
+	if(sel_legs1 == -1) return NULL;
+
+	if(sel_legs2 == -1) return NULL;
+
+	if(tw == TWEAK_HEAD) {
+		tw1 = sel_head1;
+		tw2 = sel_head2;
+		iw1 = sel_torso1;
+		jw1 = sel_legs1;
+	}
+
+	if(tw == TWEAK_TORSO) {
+		tw1 = sel_torso1;
+		tw2 = sel_torso2;
+		iw1 = sel_head1;
+		jw1 = sel_legs1;
+	}
+
+	if(tw == TWEAK_LEGS) {
+		tw1 = sel_legs1;
+		tw2 = sel_legs2;
+		iw1 = sel_torso1;
+		jw1 = sel_head1;
+	}
+
+	if(tw1 == -1 || tw2 == -1)
+		return NULL;
+
+	// Now Retreives Tweak Action Points
+	{
+		long idx_head1 = GetActionPoint(obj1, "head2chest");
+		if(idx_head1 < 0)
+			return NULL;
+
+		long idx_head2 = GetActionPoint(obj2, "head2chest");
+		if(idx_head2 < 0)
+			return NULL;
+
+		long idx_torso1 = GetActionPoint(obj1, "chest2leggings");
+		if(idx_torso1 < 0)
+			return NULL;
+
+		long idx_torso2 = GetActionPoint(obj2, "chest2leggings");
+		if(idx_torso2 < 0)
+			return NULL;
+	}
+
+	// copy vertices
+	std::vector<EERIE_VERTEX> obj1vertexlist2 = obj1->vertexlist;
+	std::vector<EERIE_VERTEX> obj2vertexlist2 = obj2->vertexlist;
+
+	// Work will contain the Tweaked object
+	EERIE_3DOBJ * work = new EERIE_3DOBJ;
+	work->pos = obj1->pos;
+	work->angle = obj1->angle;
+	
+	// We reset all data to create a fresh object
+	work->cub = obj1->cub;
+	work->quat = obj1->quat;
+
+	// Linked objects are linked to this object.
+	if(obj1->linked.size() > obj2->linked.size()) {
+		work->linked = obj1->linked;
+	} else if(obj2->linked.size() > 0) {
+		work->linked = obj2->linked;
+	} else {
+		work->linked.clear();
+	}
+
+	VertexIndex vertices(work);
+	FaceIndex faces;
+	
+	SelectionMask tweaked1(obj1, tw1);
+	SelectionMask kept1(obj1, iw1);
+	SelectionMask kept2(obj1, jw1);
+	SelectionMask tweaked2(obj2, tw2);
+
+	// Is the origin of object in obj1 or obj2 ? Retreives it for work object
+	if(tweaked1.contains(obj1->origin)) {
+		work->point0 = obj2->point0;
+		work->origin = vertices.add(obj2vertexlist2[obj2->origin]);
+	} else {
+		work->point0 = obj1->point0;
+		work->origin = vertices.add(obj1vertexlist2[obj1->origin]);
+	}
+
+	// Recreate Action Points included in work object.for Obj1
+	for(size_t i = 0; i < obj1->actionlist.size(); i++) {
+		const EERIE_ACTIONLIST & action = obj1->actionlist[i];
+
+		if(kept1.contains(action.idx)
+				|| kept2.contains(action.idx)
+				|| action.name == "head2chest"
+				|| action.name == "chest2leggings"
+		) {
+			ObjectAddAction(work, vertices, action.name, action.act,
+							action.sfx, &obj1vertexlist2[action.idx]);
+		}
+	}
+
+	// Do the same for Obj2
+	for(size_t i = 0; i < obj2->actionlist.size(); i++) {
+		const EERIE_ACTIONLIST & action = obj2->actionlist[i];
+
+		if(tweaked2.contains(action.idx)
+				|| action.name == "head2chest"
+				|| action.name == "chest2leggings"
+		) {
+			ObjectAddAction(work, vertices, action.name, action.act,
+							action.sfx, &obj2vertexlist2[action.idx]);
+		}
+	}
+
+	// Recreate Vertex using Obj1 Vertexes
+	for(size_t i = 0; i < obj1->vertexlist.size(); i++) {
+		if(kept1.contains(i) || kept2.contains(i)) {
+			vertices.add(obj1vertexlist2[i]);
+		}
+	}
+
+	// The same for Obj2
+	for(size_t i = 0; i < obj2->vertexlist.size(); i++) {
+		if(tweaked2.contains(i)) {
+			vertices.add(obj2vertexlist2[i]);
+		}
+	}
+
+
+	// Look in Faces for forgotten Vertexes... AND
+	// Re-Create TextureContainers Infos
+	// We look for texturecontainers included in the future tweaked object
+	TextureContainer * tc = NULL;
+
+	for(size_t i = 0; i < obj1->facelist.size(); i++) {
+		const EERIE_FACE & face = obj1->facelist[i];
+
+		if((kept1.contains(face.vid[0]) || kept2.contains(face.vid[0]))
+		   && (kept1.contains(face.vid[1]) || kept2.contains(face.vid[1]))
+		   && (kept1.contains(face.vid[2]) || kept2.contains(face.vid[2]))
+		) {
+			if(face.texid != -1) {
+				if(tc != obj1->texturecontainer[face.texid]) {
+					tc = obj1->texturecontainer[face.texid];
+					ObjectAddMap(work, tc);
+				}
+			}
+
+			ObjectAddFace(work, vertices, faces, &face, obj1);
+		}
+	}
+
+	for(size_t i = 0; i < obj2->facelist.size(); i++) {
+		const EERIE_FACE & face = obj2->facelist[i];
+
+		if(tweaked2.contains(face.vid[0])
+		   || tweaked2.contains(face.vid[1])
+		   || tweaked2.contains(face.vid[2])
+		) {
+
+			if(face.texid != -1) {
+				if(tc != obj2->texturecontainer[face.texid]) {
+					tc = obj2->texturecontainer[face.texid];
+					ObjectAddMap(work, tc);
+				}
+			}
+
+			ObjectAddFace(work, vertices, faces, &face, obj2);
+		}
+	}
+
+	// Recreate Groups
+	work->grouplist.resize(std::max(obj1->grouplist.size(), obj2->grouplist.size()));
+
+	for(size_t k = 0; k < obj1->grouplist.size(); k++) {
+		work->grouplist[k].name = obj1->grouplist[k].name;
+		long v = vertices.find(obj1vertexlist2[obj1->grouplist[k].origin].v);
+
+		if(v >= 0) {
+			work->grouplist[k].siz = obj1->grouplist[k].siz;
+
+			if(kept1.contains(obj1->grouplist[k].origin) || kept2.contains(obj1->grouplist[k].origin))
+				work->grouplist[k].origin = v;
+		}
+	}
+
+	for(size_t k = 0; k < obj2->grouplist.size(); k++) {
+		if(k >= obj1->grouplist.size()) {
+			work->grouplist[k].name = obj2->grouplist[k].name;
+		}
+
+		long v = vertices.find(obj2vertexlist2[obj2->grouplist[k].origin].v);
+
+		if(v >= 0) {
+			work->grouplist[k].siz = obj2->grouplist[k].siz;
+
+			if(tweaked2.contains(obj2->grouplist[k].origin))
+				work->grouplist[k].origin = v;
+		}
+	}
+
+	// Recreate Selection Groups (only the 3 selections needed to reiterate MeshTweaking !)
+	work->selections.resize(3);
+	work->selections[0].name = "head";
+	work->selections[1].name = "chest";
+	work->selections[2].name = "leggings";
+
+	// Re-Creating sel_head
+	if(tw == TWEAK_HEAD) {
+		AddEquivalentSelection(work, vertices, 0, obj2, obj2vertexlist2, sel_head2);
+	} else {
+		AddEquivalentSelection(work, vertices, 0, obj1, obj1vertexlist2, sel_head1);
+	}
+
+	// Re-Create sel_torso
+	if(tw == TWEAK_TORSO) {
+		AddEquivalentSelection(work, vertices, 1, obj2, obj2vertexlist2, sel_torso2);
+	} else {
+		AddEquivalentSelection(work, vertices, 1, obj1, obj1vertexlist2, sel_torso1);
+	}
+
+	// Re-Create sel_legs
+	if(tw == TWEAK_LEGS) {
+		AddEquivalentSelection(work, vertices, 2, obj2, obj2vertexlist2, sel_legs2);
+	} else {
+		AddEquivalentSelection(work, vertices, 2, obj1, obj1vertexlist2, sel_legs1);
+	}
+
+	//Now recreates other selections...
+	for(size_t i = 0; i < obj1->selections.size(); i++) {
+		
+		if(EERIE_OBJECT_GetSelection(work, obj1->selections[i].name) == -1) {
+			long num = work->selections.size();
+			work->selections.resize(num + 1);
+			work->selections[num].name = obj1->selections[i].name;
+
+			AddEquivalentSelection(work, vertices, num, obj1, obj1vertexlist2, i);
+
+			long ii = EERIE_OBJECT_GetSelection(obj2, obj1->selections[i].name);
+
+			if(ii != -1) {
+				AddEquivalentSelection(work, vertices, num, obj2, obj2vertexlist2, ii);
+			}
+		}
+	}
+
+	for(size_t i = 0; i < obj2->selections.size(); i++) {
+		if(EERIE_OBJECT_GetSelection(work, obj2->selections[i].name) == -1) {
+			long num = work->selections.size();
+			work->selections.resize(num + 1);
+			work->selections[num].name = obj2->selections[i].name;
+
+			AddEquivalentSelection(work, vertices, num, obj2, obj2vertexlist2, i);
+		}
+	}
+
+	// Recreate Animation-groups vertex
+	for(size_t i = 0; i < work->grouplist.size(); i++) {
+		
+		VertexSet group(work->grouplist[i].indexes, work->vertexlist.size());
+		
+		if(i < obj1->grouplist.size()) {
+			AddEquivalentVertices(group, vertices, obj1vertexlist2, obj1->grouplist[i].indexes);
+		}
+		
+		if(i < obj2->grouplist.size()) {
+			AddEquivalentVertices(group, vertices, obj2vertexlist2, obj2->grouplist[i].indexes);
+		}
+	}
+
+	work->vertexlist3 = work->vertexlist;
+
+	return work;
+}
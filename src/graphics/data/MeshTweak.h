@@ -0,0 +1,70 @@
+/*
+ * Copyright 2011-2012 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/* Based on:
+===========================================================================
+ARX FATALIS GPL Source Code
+Copyright (C) 1999-2010 Arkane Studios SA, a ZeniMax Media company.
+
+This file is part of the Arx Fatalis GPL Source Code ('Arx Fatalis Source Code'). 
+
+Arx Fatalis Source Code is free software: you can redistribute it and/or modify it under the terms of the GNU General Public 
+License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+Arx Fatalis Source Code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with Arx Fatalis Source Code.  If not, see 
+<http://www.gnu.org/licenses/>.
+
+In addition, the Arx Fatalis Source Code is also subject to certain additional terms. You should have received a copy of these 
+additional terms immediately following the terms and conditions of the GNU General Public License which accompanied the Arx 
+Fatalis Source Code. If not, please request a copy in writing from Arkane Studios at the address below.
+
+If you have questions concerning this license or the applicable additional terms, you may contact in writing Arkane Studios, c/o 
+ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
+===========================================================================
+*/
+// Code: Cyril Meynier
+//
+// Copyright (c) 1999-2000 ARKANE Studios SA. All rights reserved
+
+#ifndef ARX_GRAPHICS_DATA_MESHTWEAK_H
+#define ARX_GRAPHICS_DATA_MESHTWEAK_H
+
+struct EERIE_3DOBJ;
+class TextureContainer;
+
+long ObjectAddMap(EERIE_3DOBJ * obj, TextureContainer * tc);
+
+/*!
+ * Replace one body part of a mesh with the same part from another mesh
+ *
+ * Vertices at the same position are merged. The new mesh only keeps the head, chest
+ * and leggings selections of its sources plus any other selections.
+ *
+ * \param obj1 the mesh to tweak.
+ * \param obj2 the mesh containing the new body part.
+ * \param tw   TWEAK_HEAD, TWEAK_TORSO or TWEAK_LEGS.
+ *
+ * \return a new mesh, or NULL if either source mesh is missing a body part selection
+ *         or one of the "head2chest" and "chest2leggings" action points.
+ */
+EERIE_3DOBJ * CreateIntermediaryMesh(const EERIE_3DOBJ * obj1, const EERIE_3DOBJ * obj2, long tw);
+
+#endif // ARX_GRAPHICS_DATA_MESHTWEAK_H
@@ -51,6 +51,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <cstdlib>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <boost/algorithm/string/case_conv.hpp>
 
@@ -190,16 +191,24 @@ TextureContainer::~TextureContainer() {
 	ResetVertexLists(this);
 }
 
-bool TextureContainer::LoadFile(const res::path & strPathname) {
+//! \return the image file for a texture name, or an empty path if there is none.
+static res::path findTextureFile(const res::path & name) {
 	
-	res::path tempPath = strPathname;
+	res::path tempPath = name;
 	bool foundPath = resources->getFile(tempPath.append(".png")) != NULL;
 	foundPath = foundPath || resources->getFile(tempPath.set_ext("jpg"));
 	foundPath = foundPath || resources->getFile(tempPath.set_ext("jpeg"));
 	foundPath = foundPath || resources->getFile(tempPath.set_ext("bmp"));
 	foundPath = foundPath || resources->getFile(tempPath.set_ext("tga"));
+	
+	return foundPath ? tempPath : res::path();
+}
 
-	if(!foundPath) {
+bool TextureContainer::LoadFile(const res::path & strPathname) {
+	
+	res::path tempPath = findTextureFile(strPathname);
+
+	if(tempPath.empty()) {
 		LogError << strPathname << " not found";
 		return false;
 	}
@@ -275,6 +284,23 @@ TextureContainer * TextureContainer::Load(const res::path & name, TCFlags flags)
 	return newTexture;
 }
 
+void TextureContainer::Prefetch(const std::vector<res::path> & names) {
+	
+	std::vector<res::path> files;
+	files.reserve(names.size());
+	
+	for(size_t i = 0; i < names.size(); i++) {
+		if(!Find(names[i])) {
+			res::path file = findTextureFile(names[i]);
+			if(!file.empty()) {
+				files.push_back(file);
+			}
+		}
+	}
+	
+	resources->prefetch(files);
+}
+
 TextureContainer * TextureContainer::LoadUI(const res::path & strName, TCFlags flags) {
 	return Load(strName, flags | TextureContainer::NoMipmap);
 }
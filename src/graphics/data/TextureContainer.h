@@ -118,6 +118,12 @@ public:
 	 */
 	static TextureContainer * Find(const res::path & strTextureName);
 	
+	/*!
+	 * Start decompressing the image files for textures that are not loaded yet.
+	 * \param names Texture names as passed to Load(), without an extension.
+	 */
+	static void Prefetch(const std::vector<res::path> & names);
+	
 	static void DeleteAll(TCFlags flag = TCFlags::all());
 	
 	/*!
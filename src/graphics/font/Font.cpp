@@ -19,11 +19,14 @@
 
 #include "graphics/font/Font.h"
 
+#include <algorithm>
 #include <sstream>
 #include <iomanip>
 #include <iterator>
 #include <cmath>
 
+#include <boost/functional/hash.hpp>
+
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
@@ -43,6 +46,9 @@
 //! Pre-load all visible characters below this one when creating a font object
 static const Font::Char FONT_PRELOAD_LIMIT = 127;
 
+//! Maximum number of laid out texts to keep for each font
+static const size_t FONT_LAYOUT_CACHE_SIZE = 256;
+
 Font::Font(const res::path & fontFile, unsigned int fontSize, FT_Face face) 
 	: info(fontFile, fontSize)
 	, referenceCount(0)
@@ -250,11 +256,14 @@ Font::glyph_iterator Font::getNextGlyph(text_iterator & it, text_iterator end) {
 	// Re-upload the changed textures
 	textures->upload();
 	
+	// Texture pages changed - cached layouts may refer to outdated glyphs
+	clearLayouts();
+	
 	return glyphs.find(chr); // the newly inserted glyph
 }
 
 static void addGlyphVertices(std::vector<TexturedVertex> & vertices,
-                             const Font::Glyph & glyph, const Vec2f & pos, Color color) {
+                             const Font::Glyph & glyph, const Vec2f & pos) {
 	
 	float w = glyph.size.x;
 	float h = -glyph.size.y;
@@ -270,22 +279,18 @@ static void addGlyphVertices(std::vector<TexturedVertex> & vertices,
 	TexturedVertex quad[4];
 	quad[0].p = Vec3f(p.x, p.y, 0);
 	quad[0].uv = Vec2f(uStart, vStart);
-	quad[0].color = color.toRGBA();
 	quad[0].rhw = 1.0f;
 
 	quad[1].p = Vec3f(p.x + w, p.y, 0);
 	quad[1].uv = Vec2f(uEnd, vStart);
-	quad[1].color = color.toRGBA();
 	quad[1].rhw = 1.0f;
 
 	quad[2].p = Vec3f(p.x + w, p.y + h, 0);
 	quad[2].uv = Vec2f(uEnd, vEnd);
-	quad[2].color = color.toRGBA();
 	quad[2].rhw = 1.0f;
 
 	quad[3].p = Vec3f(p.x, p.y + h, 0);
 	quad[3].uv = Vec2f(uStart, vEnd);
-	quad[3].color = color.toRGBA();
 	quad[3].rhw = 1.0f;
 
 	vertices.push_back(quad[0]);
@@ -297,24 +302,36 @@ static void addGlyphVertices(std::vector<TexturedVertex> & vertices,
 	vertices.push_back(quad[3]);
 }
 
-template <bool DoDraw>
-Vec2i Font::process(int x, int y, text_iterator start, text_iterator end, Color color) {
+size_t Font::TextRangeHash::operator()(const std::string & text) const {
+	return boost::hash_range(text.begin(), text.end());
+}
+
+size_t Font::TextRangeHash::operator()(const TextRange & text) const {
+	return boost::hash_range(text.begin, text.end);
+}
+
+bool Font::TextRangeEqual::operator()(const TextRange & a, const std::string & b) const {
+	return size_t(a.end - a.begin) == b.length() && std::equal(a.begin, a.end, b.begin());
+}
+
+bool Font::TextRangeEqual::operator()(const std::string & a, const TextRange & b) const {
+	return operator()(b, a);
+}
+
+bool Font::TextRangeEqual::operator()(const std::string & a, const std::string & b) const {
+	return a == b;
+}
+
+void Font::layout(TextLayout & layout, text_iterator start, text_iterator end) {
+	
+	// Subtract one line height (since we flipped the Y origin to be like GDI)
+	Vec2f pen(0.f, float(face->size->metrics.ascender >> 6));
 	
-	Vec2f pen(x, y);
-		
 	int startX = 0;
 	int endX = 0;
 	
-	if(DoDraw) {
-		// Subtract one line height (since we flipped the Y origin to be like GDI)
-		pen.y += face->size->metrics.ascender >> 6;
-	}
-	
 	FT_UInt prevGlyphIndex = 0;
 	FT_Pos prevRsbDelta = 0;
-
-	typedef std::map< unsigned int, std::vector<TexturedVertex> > MapTextureVertices;
-	MapTextureVertices mapTextureVertices;
 	
 	for(text_iterator it = start; it != end; ) {
 		
@@ -343,11 +360,22 @@ Vec2i Font::process(int x, int y, text_iterator start, text_iterator end, Color
 		}
 		prevRsbDelta = glyph.rsb_delta;
 		
-		// Draw
-		if(DoDraw && glyph.size.x != 0 && glyph.size.y != 0) {
-			addGlyphVertices(mapTextureVertices[glyph.texture], glyph, pen, color);
-		} else {
-			ARX_UNUSED(pen), ARX_UNUSED(color);
+		if(glyph.size.x != 0 && glyph.size.y != 0) {
+			
+			TextRun * run = NULL;
+			for(size_t i = 0; i < layout.runs.size(); i++) {
+				if(layout.runs[i].texture == glyph.texture) {
+					run = &layout.runs[i];
+					break;
+				}
+			}
+			if(!run) {
+				layout.runs.push_back(TextRun());
+				run = &layout.runs.back();
+				run->texture = glyph.texture;
+			}
+			
+			addGlyphVertices(run->vertices, glyph, pen);
 		}
 		
 		// If this is the first drawn char, note the start position
@@ -360,59 +388,99 @@ Vec2i Font::process(int x, int y, text_iterator start, text_iterator end, Color
 		pen.x += glyph.advance.x;
 	}
 	
-	if(DoDraw && !mapTextureVertices.empty()) {
-
-		GRenderer->SetRenderState(Renderer::Lighting, false);
-		GRenderer->SetRenderState(Renderer::AlphaBlending, true);
-		GRenderer->SetBlendFunc(Renderer::BlendSrcAlpha, Renderer::BlendInvSrcAlpha);
-
-		GRenderer->SetRenderState(Renderer::DepthTest, false);
-		GRenderer->SetRenderState(Renderer::DepthWrite, false);
-		GRenderer->SetCulling(Renderer::CullNone);
-		
-		// Fixed pipeline texture stage operation
-		GRenderer->GetTextureStage(0)->setColorOp(TextureStage::ArgDiffuse);
-		GRenderer->GetTextureStage(0)->setAlphaOp(TextureStage::ArgTexture);
-
-		GRenderer->GetTextureStage(0)->setWrapMode(TextureStage::WrapClamp);
-		GRenderer->GetTextureStage(0)->setMinFilter(TextureStage::FilterNearest);
-		GRenderer->GetTextureStage(0)->setMagFilter(TextureStage::FilterNearest);
+	std::sort(layout.runs.begin(), layout.runs.end());
+	
+	layout.size.x = endX - startX;
+	layout.size.y = face->size->metrics.height >> 6;
+}
 
-		for(MapTextureVertices::const_iterator it = mapTextureVertices.begin(); it != mapTextureVertices.end(); ++it) {
-			
-			if(!it->second.empty()) {
-				GRenderer->SetTexture(0, &textures->getTexture(it->first));
-				EERIEDRAWPRIM(Renderer::TriangleList, &it->second[0], it->second.size());
-			}
-		}
-					
-		GRenderer->ResetTexture(0);
-		TextureStage * stage = GRenderer->GetTextureStage(0);
-		stage->setColorOp(TextureStage::OpModulate,
-		                  TextureStage::ArgTexture, TextureStage::ArgCurrent);
-		stage->setAlphaOp(TextureStage::ArgTexture);
-		stage->setWrapMode(TextureStage::WrapRepeat);
-		stage->setMinFilter(TextureStage::FilterLinear);
-		stage->setMagFilter(TextureStage::FilterLinear);
-		
-		GRenderer->SetRenderState(Renderer::AlphaBlending, false);
-		GRenderer->SetRenderState(Renderer::DepthWrite, true);
-		GRenderer->SetCulling(Renderer::CullCCW);
-		
+const Font::TextLayout & Font::getLayout(text_iterator start, text_iterator end) {
+	
+	TextRange range = { start, end };
+	TextLayoutIndex::iterator it = layoutIndex.find(range, TextRangeHash(), TextRangeEqual());
+	if(it != layoutIndex.end()) {
+		layouts.splice(layouts.begin(), layouts, it->second);
+		return layouts.front();
+	}
+	
+	// Laying out the text may insert glyphs and clear the cache
+	TextLayout text;
+	layout(text, start, end);
+	text.text.assign(start, end);
+	
+	if(layouts.size() >= FONT_LAYOUT_CACHE_SIZE) {
+		layoutIndex.erase(layouts.back().text);
+		layouts.pop_back();
 	}
 	
-	int sizeX = endX - startX;
-	int sizeY = face->size->metrics.height >> 6;
+	layouts.push_front(TextLayout());
+	layouts.front().text.swap(text.text);
+	layouts.front().size = text.size;
+	layouts.front().runs.swap(text.runs);
+	layoutIndex[layouts.front().text] = layouts.begin();
 	
-	return Vec2i(sizeX, sizeY);
+	return layouts.front();
+}
+
+void Font::clearLayouts() {
+	layoutIndex.clear();
+	layouts.clear();
 }
 
 void Font::draw(int x, int y, text_iterator start, text_iterator end, Color color) {
-	process<true>(x, y, start, end, color);
+	
+	const TextLayout & text = getLayout(start, end);
+	if(text.runs.empty()) {
+		return;
+	}
+	
+	GRenderer->SetRenderState(Renderer::Lighting, false);
+	GRenderer->SetRenderState(Renderer::AlphaBlending, true);
+	GRenderer->SetBlendFunc(Renderer::BlendSrcAlpha, Renderer::BlendInvSrcAlpha);
+	
+	GRenderer->SetRenderState(Renderer::DepthTest, false);
+	GRenderer->SetRenderState(Renderer::DepthWrite, false);
+	GRenderer->SetCulling(Renderer::CullNone);
+	
+	// Fixed pipeline texture stage operation
+	GRenderer->GetTextureStage(0)->setColorOp(TextureStage::ArgDiffuse);
+	GRenderer->GetTextureStage(0)->setAlphaOp(TextureStage::ArgTexture);
+	
+	GRenderer->GetTextureStage(0)->setWrapMode(TextureStage::WrapClamp);
+	GRenderer->GetTextureStage(0)->setMinFilter(TextureStage::FilterNearest);
+	GRenderer->GetTextureStage(0)->setMagFilter(TextureStage::FilterNearest);
+	
+	Vec3f offset(x, y, 0.f);
+	ColorRGBA rgba = color.toRGBA();
+	
+	for(std::vector<TextRun>::const_iterator run = text.runs.begin(); run != text.runs.end(); ++run) {
+		
+		vertices.assign(run->vertices.begin(), run->vertices.end());
+		for(size_t i = 0; i < vertices.size(); i++) {
+			vertices[i].p += offset;
+			vertices[i].color = rgba;
+		}
+		
+		GRenderer->SetTexture(0, &textures->getTexture(run->texture));
+		EERIEDRAWPRIM(Renderer::TriangleList, &vertices[0], vertices.size());
+	}
+	
+	GRenderer->ResetTexture(0);
+	TextureStage * stage = GRenderer->GetTextureStage(0);
+	stage->setColorOp(TextureStage::OpModulate,
+	                  TextureStage::ArgTexture, TextureStage::ArgCurrent);
+	stage->setAlphaOp(TextureStage::ArgTexture);
+	stage->setWrapMode(TextureStage::WrapRepeat);
+	stage->setMinFilter(TextureStage::FilterLinear);
+	stage->setMagFilter(TextureStage::FilterLinear);
+	
+	GRenderer->SetRenderState(Renderer::AlphaBlending, false);
+	GRenderer->SetRenderState(Renderer::DepthWrite, true);
+	GRenderer->SetCulling(Renderer::CullCCW);
 }
 
 Vec2i Font::getTextSize(text_iterator start, text_iterator end) {
-	return process<false>(0, 0, start, end, Color::none);
+	return getLayout(start, end).size;
 }
 
 int Font::getLineHeight() const {
@@ -22,10 +22,14 @@
 
 #include <string>
 #include <map>
+#include <list>
+#include <vector>
 
 #include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "graphics/Color.h"
+#include "graphics/Vertex.h"
 #include "math/Vector.h"
 
 #include "io/resource/ResourcePath.h"
@@ -151,8 +155,56 @@ private:
 	
 private:
 	
-	template <bool Draw>
-	Vec2i process(int pX, int pY, text_iterator start, text_iterator end, Color color);
+	//! Vertices for all glyphs of a text that are on the same texture page
+	struct TextRun {
+		
+		unsigned int texture;
+		std::vector<TexturedVertex> vertices;
+		
+		bool operator<(const TextRun & other) const { return texture < other.texture; }
+		
+	};
+	
+	/*!
+	 * A laid out text
+	 *
+	 * Vertex positions are relative to the position passed to draw().
+	 * Vertex colors are set when drawing.
+	 */
+	struct TextLayout {
+		std::string text;
+		Vec2i size;
+		std::vector<TextRun> runs;
+	};
+	
+	typedef std::list<TextLayout> TextLayouts;
+	
+	struct TextRange {
+		text_iterator begin;
+		text_iterator end;
+	};
+	
+	struct TextRangeHash {
+		size_t operator()(const std::string & text) const;
+		size_t operator()(const TextRange & text) const;
+	};
+	
+	struct TextRangeEqual {
+		bool operator()(const TextRange & a, const std::string & b) const;
+		bool operator()(const std::string & a, const TextRange & b) const;
+		bool operator()(const std::string & a, const std::string & b) const;
+	};
+	
+	typedef boost::unordered_map<std::string, TextLayouts::iterator,
+	                             TextRangeHash, TextRangeEqual> TextLayoutIndex;
+	
+	//! Get the cached layout for a text, laying it out if needed
+	const TextLayout & getLayout(text_iterator start, text_iterator end);
+	
+	void layout(TextLayout & layout, text_iterator start, text_iterator end);
+	
+	//! Forget all cached layouts
+	void clearLayouts();
 	
 	Info info;
 	unsigned int referenceCount;
@@ -170,6 +222,13 @@ private:
 	
 	class PackedTexture * textures;
 	
+	//! Recently used layouts, most recent first
+	TextLayouts layouts;
+	TextLayoutIndex layoutIndex;
+	
+	//! Scratch buffer for draw()
+	std::vector<TexturedVertex> vertices;
+	
 };
 
 #endif // ARX_GRAPHICS_FONT_FONT_H
@@ -159,21 +159,30 @@ bool Image::IsCompressed(Image::Format pFormat) {
 
 bool Image::LoadFromFile(const res::path & filename) {
 	
-	size_t size = 0;
-	void * pData = resources->readAlloc(filename, size);
+	PakFile * file = resources->getFile(filename);
+	if(!file) {
+		return false;
+	}
+	
+	// Decode directly from the mapped archive if possible
+	if(const char * data = file->data()) {
+		return LoadFromMemory(data, file->size(), filename.string().c_str());
+	}
+	
+	void * pData = file->readAlloc();
 	
 	if(!pData) {
 		return false;
 	}
 	
-	bool ret = LoadFromMemory(pData, size, filename.string().c_str());
+	bool ret = LoadFromMemory(pData, file->size(), filename.string().c_str());
 	
 	free(pData);
 	
 	return ret;
 }
 
-bool Image::LoadFromMemory(void * pData, unsigned int size, const char * file) {
+bool Image::LoadFromMemory(const void * pData, unsigned int size, const char * file) {
 	
 	if(!pData) {
 		return false;
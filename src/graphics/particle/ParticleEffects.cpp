@@ -85,9 +85,12 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 //TODO(lubosz): extern globals :(
 extern Color ulBKGColor;
 
-static const size_t MAX_PARTICLES = 2200;
-static long ParticleCount = 0;
-static PARTICLE_DEF particle[MAX_PARTICLES];
+//! Particle storage, sized by config.misc.maxParticles in ARX_PARTICLES_ClearAll()
+static std::vector<PARTICLE_DEF> particles;
+//! Unused entries in particles, the next one to allocate is at the back
+static std::vector<size_t> freeParticles;
+//! Used entries in particles, in allocation order
+static std::vector<size_t> liveParticles;
 
 static TextureContainer * blood_splat = NULL;
 static TextureContainer * bloodsplat[6];
@@ -104,7 +107,7 @@ static TextureContainer * explo[MAX_EXPLO]; // TextureContainer for animated exp
 long			NewSpell=0;
 
 long getParticleCount() {
-	return ParticleCount;
+	return long(liveParticles.size());
 }
 
 void ARX_PARTICLES_Spawn_Lava_Burn(Vec3f pos, Entity * io) {
@@ -828,8 +831,18 @@ void ARX_PARTICLES_FirstInit() {
 }
 
 void ARX_PARTICLES_ClearAll() {
-	memset(particle, 0, sizeof(PARTICLE_DEF) * MAX_PARTICLES);
-	ParticleCount = 0;
+	
+	size_t count = size_t(config.misc.maxParticles);
+	
+	particles.assign(count, PARTICLE_DEF());
+	
+	freeParticles.resize(count);
+	for(size_t i = 0; i < count; i++) {
+		freeParticles[i] = count - 1 - i;
+	}
+	
+	liveParticles.clear();
+	liveParticles.reserve(count);
 }
 
 PARTICLE_DEF * createParticle(bool allocateWhilePaused) {
@@ -838,32 +851,31 @@ PARTICLE_DEF * createParticle(bool allocateWhilePaused) {
 		return NULL;
 	}
 	
-	for(size_t i = 0; i < MAX_PARTICLES; i++) {
-		
-		PARTICLE_DEF * pd = &particle[i];
-		
-		if(pd->exist) {
-			continue;
-		}
-		
-		ParticleCount++;
-		pd->exist = true;
-		pd->timcreation = long(arxtime);
-		
-		pd->is2D = false;
-		pd->rgb = Color3f::white;
-		pd->tc = NULL;
-		pd->special = 0;
-		pd->source = NULL;
-		pd->delay = 0;
-		pd->zdec = false;
-		pd->move = Vec3f_ZERO;
-		pd->scale = Vec3f_ONE;
-		
-		return pd;
+	if(freeParticles.empty()) {
+		return NULL;
 	}
 	
-	return NULL;
+	size_t index = freeParticles.back();
+	freeParticles.pop_back();
+	liveParticles.push_back(index);
+	
+	PARTICLE_DEF * pd = &particles[index];
+	arx_assert(!pd->exist);
+	
+	pd->exist = true;
+	pd->timcreation = long(arxtime);
+	
+	pd->is2D = false;
+	pd->rgb = Color3f::white;
+	pd->tc = NULL;
+	pd->special = 0;
+	pd->source = NULL;
+	pd->delay = 0;
+	pd->zdec = false;
+	pd->move = Vec3f_ZERO;
+	pd->scale = Vec3f_ONE;
+	
+	return pd;
 }
 
 void MagFX(const Vec3f & pos) {
@@ -1002,33 +1014,80 @@ void LaunchFireballBoom(const Vec3f & poss, float level, Vec3f * direction, Colo
 	
 }
 
-void ARX_PARTICLES_Update(EERIE_CAMERA * cam)  {
-	
-	ARX_PROFILE_FUNC();
-	
-	if(!ACTIVEBKG) {
-		return;
-	}
-	
-	if(ParticleCount == 0) {
-		return;
+namespace {
+
+/*!
+ * Per-frame state of the particles that are drawn this frame
+ *
+ * The values needed for the motion update are kept in separate arrays so that
+ * ARX_PARTICLES_UpdateMotion() can be a simple loop without branches.
+ */
+struct ParticleFrame {
+	
+	std::vector<size_t> index; //!< Entry in particles
+	std::vector<long> age; //!< Time since the particle was created
+	
+	// Start position, replaced by the current position
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	
+	std::vector<float> moveX;
+	std::vector<float> moveY;
+	std::vector<float> moveZ;
+	
+	std::vector<float> val; //!< Scaled age used for the movement
+	std::vector<float> gravity;
+	std::vector<float> lifetime;
+	std::vector<float> fadeTime; //!< Half the lifetime for particles that fade in and out, or 0
+	
+	// Results
+	std::vector<float> ageRatio;
+	std::vector<float> alpha;
+	
+	size_t size;
+	
+	ParticleFrame() : size(0) { }
+	
+	void reset(size_t capacity) {
+		size = 0;
+		if(index.size() < capacity) {
+			index.resize(capacity);
+			age.resize(capacity);
+			x.resize(capacity);
+			y.resize(capacity);
+			z.resize(capacity);
+			moveX.resize(capacity);
+			moveY.resize(capacity);
+			moveZ.resize(capacity);
+			val.resize(capacity);
+			gravity.resize(capacity);
+			lifetime.resize(capacity);
+			fadeTime.resize(capacity);
+			ageRatio.resize(capacity);
+			alpha.resize(capacity);
+		}
 	}
 	
-	Vec3f in;
-	Vec3f inn;
-	TexturedVertex out;
+};
+
+ParticleFrame particleFrame;
+
+} // anonymous namespace
+
+//! Handle delays, expiry and particle transformations and collect particles to draw
+static void ARX_PARTICLES_UpdateLifetime(unsigned long tim) {
 	
-	unsigned long tim = (unsigned long)arxtime;
+	ParticleFrame & frame = particleFrame;
 	
-	long pcc = ParticleCount;
+	// Particles created by this loop will be processed in the next frame
+	size_t count = liveParticles.size();
+	frame.reset(count);
 	
-	for(size_t i = 0; i < MAX_PARTICLES && pcc > 0; i++) {
-
-		PARTICLE_DEF * part = &particle[i];
-		if(!part->exist) {
-			continue;
-		}
-
+	for(size_t i = 0; i < count; i++) {
+		
+		PARTICLE_DEF * part = &particles[liveParticles[i]];
+		
 		long framediff = part->timcreation + part->tolive - tim;
 		long framediff2 = tim - part->timcreation;
 		
@@ -1057,7 +1116,6 @@ void ARX_PARTICLES_Update(EERIE_CAMERA * cam)  {
 
 			if(!bkgData || !bkgData->treat) {
 				part->exist = false;
-				ParticleCount--;
 				continue;
 			}
 		}
@@ -1082,7 +1140,6 @@ void ARX_PARTICLES_Update(EERIE_CAMERA * cam)  {
 				
 			} else {
 				part->exist = false;
-				ParticleCount--;
 				continue;
 			}
 		}
@@ -1108,38 +1165,91 @@ void ARX_PARTICLES_Update(EERIE_CAMERA * cam)  {
 			}
 		}
 		
-		float val = (part->tolive - framediff) * 0.01f;
+		size_t n = frame.size++;
+		
+		frame.index[n] = liveParticles[i];
+		frame.age[n] = framediff2;
 		
+		Vec3f start = part->ov;
+		Vec3f move = part->move;
 		if((part->special & FOLLOW_SOURCE) && part->sourceionum != EntityHandle::Invalid
 				&& entities[part->sourceionum]) {
-			inn = in = *part->source;
+			start = *part->source;
+			move = Vec3f_ZERO;
 		} else if((part->special & FOLLOW_SOURCE2) && part->sourceionum != EntityHandle::Invalid
 							&& entities[part->sourceionum]) {
-			inn = in = *part->source + part->move * val;
-		} else {
-			inn = in = part->ov + part->move * val;
+			start = *part->source;
 		}
+		frame.x[n] = start.x;
+		frame.y[n] = start.y;
+		frame.z[n] = start.z;
+		frame.moveX[n] = move.x;
+		frame.moveY[n] = move.y;
+		frame.moveZ[n] = move.z;
+		
+		frame.val[n] = (part->tolive - framediff) * 0.01f;
+		frame.gravity[n] = (part->special & GRAVITY) ? 1.47f : 0.f;
+		frame.lifetime[n] = float(part->tolive);
+		frame.fadeTime[n] = (part->special & FADE_IN_AND_OUT) ? float(long(part->tolive / 2)) : 0.f;
+	}
+}
+
+//! Compute the position and fade of all particles collected by ARX_PARTICLES_UpdateLifetime()
+static void ARX_PARTICLES_UpdateMotion() {
+	
+	ParticleFrame & frame = particleFrame;
+	
+	float * x = &frame.x[0];
+	float * y = &frame.y[0];
+	float * z = &frame.z[0];
+	const float * moveX = &frame.moveX[0];
+	const float * moveY = &frame.moveY[0];
+	const float * moveZ = &frame.moveZ[0];
+	const float * val = &frame.val[0];
+	const float * gravity = &frame.gravity[0];
+	const float * lifetime = &frame.lifetime[0];
+	const float * fadeTime = &frame.fadeTime[0];
+	const long * age = &frame.age[0];
+	float * ageRatio = &frame.ageRatio[0];
+	float * alpha = &frame.alpha[0];
+	
+	for(size_t i = 0; i < frame.size; i++) {
+		
+		x[i] += moveX[i] * val[i];
+		y[i] += moveY[i] * val[i] + gravity[i] * val[i] * val[i];
+		z[i] += moveZ[i] * val[i];
+		
+		float t = float(age[i]);
+		ageRatio[i] = t / lifetime[i];
+		
+		float fadeIn = t / fadeTime[i];
+		float fadeOut = 1.f - (t - fadeTime[i]) / fadeTime[i];
+		float fade = (t <= fadeTime[i]) ? fadeIn : fadeOut;
+		alpha[i] = (fadeTime[i] > 0.f) ? fade : 1.f - ageRatio[i];
+	}
+}
+
+//! Draw all particles collected by ARX_PARTICLES_UpdateLifetime()
+static void ARX_PARTICLES_Render(EERIE_CAMERA * cam, unsigned long tim) {
+	
+	const ParticleFrame & frame = particleFrame;
+	
+	TexturedVertex out;
+	
+	for(size_t i = 0; i < frame.size; i++) {
 		
-		if(part->special & GRAVITY) {
-			in.y = inn.y = inn.y + 1.47f * val * val;
-		}
+		PARTICLE_DEF * part = &particles[frame.index[i]];
 		
-		float fd = float(framediff2) / float(part->tolive);
-		float r = 1.f - fd;
-		if(part->special & FADE_IN_AND_OUT) {
-			long t = part->tolive / 2;
-			if(framediff2 <= t) {
-				r = float(framediff2) / float(t);
-			} else {
-				r = 1.f - float(framediff2 - t) / float(t);
-			}
-		}
+		long framediff2 = frame.age[i];
+		Vec3f in(frame.x[i], frame.y[i], frame.z[i]);
+		float fd = frame.ageRatio[i];
+		float r = frame.alpha[i];
 		
 		if(!part->is2D) {
 			
 			Sphere sp;
 			sp.origin = in;
-			EE_RTP(inn, &out);
+			EE_RTP(in, &out);
 			if(out.rhw < 0 || out.p.z > cam->cdepth * fZFogEnd) {
 				continue;
 			}
@@ -1181,7 +1291,6 @@ void ARX_PARTICLES_Update(EERIE_CAMERA * cam)  {
 						SpawnGroundSplat(sp, rgb, 0);
 					}
 					part->exist = false;
-					ParticleCount--;
 					continue;
 				}
 			}
@@ -1195,7 +1304,6 @@ void ARX_PARTICLES_Update(EERIE_CAMERA * cam)  {
 						SpawnGroundSplat(sp, rgb, 2);
 					}
 					part->exist = false;
-					ParticleCount--;
 					continue;
 				}
 			}
@@ -1208,7 +1316,6 @@ void ARX_PARTICLES_Update(EERIE_CAMERA * cam)  {
 		}
 		
 		if(r <= 0.f) {
-			pcc--;
 			continue;
 		}
 		
@@ -1281,11 +1388,46 @@ void ARX_PARTICLES_Update(EERIE_CAMERA * cam)  {
 			EERIEAddSprite(mat, in, siz, color, temp);
 			
 		}
-		
-		pcc--;
 	}
 }
 
+//! Return the entries of particles that died this frame to the free list
+static void ARX_PARTICLES_Compact() {
+	
+	size_t count = 0;
+	
+	for(size_t i = 0; i < liveParticles.size(); i++) {
+		size_t index = liveParticles[i];
+		if(particles[index].exist) {
+			liveParticles[count++] = index;
+		} else {
+			freeParticles.push_back(index);
+		}
+	}
+	
+	liveParticles.resize(count);
+}
+
+void ARX_PARTICLES_Update(EERIE_CAMERA * cam)  {
+	
+	ARX_PROFILE_FUNC();
+	
+	if(!ACTIVEBKG) {
+		return;
+	}
+	
+	if(liveParticles.empty()) {
+		return;
+	}
+	
+	unsigned long tim = (unsigned long)arxtime;
+	
+	ARX_PARTICLES_UpdateLifetime(tim);
+	ARX_PARTICLES_UpdateMotion();
+	ARX_PARTICLES_Render(cam, tim);
+	ARX_PARTICLES_Compact();
+}
+
 void RestoreAllLightsInitialStatus() {
 	for(size_t i = 0; i < MAX_LIGHTS; i++) {
 		if(GLight[i]) {
@@ -41,12 +41,16 @@
 #include "gui/Interface.h"
 
 #include "ai/PathFinderManager.h"
+#include "ai/Perception.h"
+#include "physics/Collisions.h"
 #include "script/ScriptEvent.h"
 #include "scene/Interactive.h"
 #include "game/EntityManager.h"
 #include "game/NPC.h"
 
 #include "graphics/Renderer.h"
+#include "graphics/RenderBatcher.h"
+#include "graphics/data/FTL.h"
 #include "graphics/DrawLine.h"
 
 #include "window/RenderWindow.h"
@@ -213,6 +217,11 @@ void ShowInfoText() {
 	DebugBox frameInfo = DebugBox(Vec2i(10, 10), "FrameInfo");
 	frameInfo.add("Prims", EERIEDrawnPolys);
 	frameInfo.add("Particles", getParticleCount());
+	{
+		RenderBatcher::Statistics stats = RenderBatcher::getInstance().getTotalStatistics();
+		frameInfo.add("Batches", boost::str(boost::format("%d draws %d states %d verts")
+		                                    % stats.drawCalls % stats.stateChanges % stats.vertices));
+	}
 	frameInfo.add("TIME", static_cast<long>((unsigned long)(arxtime) / 1000));
 	frameInfo.print();
 	
@@ -261,8 +270,26 @@ void ShowInfoText() {
 	miscBox.add("Camera focal", ACTIVECAM->focal);
 	miscBox.add("Cinema", CINEMA_DECAL);
 	miscBox.add("Mouse", Vec2i(DANAEMouse));
-	miscBox.add("Pathfind queue", EERIE_PATHFINDER_Get_Queued_Number());
-	miscBox.add("Pathfind status", (PATHFINDER_WORKING ? "Working" : "Idled"));
+	miscBox.add("Collision tests", ARX_COLLISION_GetTestCount());
+	{
+		MeshCacheStatistics stats = MCache_GetStatistics();
+		miscBox.add("Mesh cache", boost::str(boost::format("%d hits %d misses %d/%dKiB")
+		                                     % stats.hits % stats.misses
+		                                     % (stats.size / 1024) % (stats.budget / 1024)));
+	}
+	{
+		PathFinderStatistics stats = EERIE_PATHFINDER_Get_Statistics();
+		miscBox.add("Pathfind queue", long(stats.queued));
+		float averageLatency = stats.processed ? stats.totalLatency / stats.processed : 0.f;
+		miscBox.add("Pathfind working", boost::str(boost::format("%d/%d") % stats.working % stats.workers));
+		miscBox.add("Pathfind latency", boost::str(boost::format("%4.2fms avg %4.2fms max")
+		                                           % averageLatency % stats.maxLatency));
+	}
+	{
+		PerceptionStatistics stats = ARX_PERCEPTION_GetStatistics();
+		miscBox.add("Perception", boost::str(boost::format("%d queries %d found %4.2fms")
+		                                     % stats.queries % stats.candidates % stats.time));
+	}
 	miscBox.print();
 	
 	{
@@ -1169,7 +1169,7 @@ void ActiveSpellsGui::spellsOnPlayerUpdate(float intensity) {
 		if(!spell)
 			continue;
 		
-		if(std::find(spell->m_targets.begin(), spell->m_targets.end(), PlayerEntityHandle) == spell->m_targets.end()) {
+		if(std::find(spell->targets().begin(), spell->targets().end(), PlayerEntityHandle) == spell->targets().end()) {
 			continue;
 		}
 		
@@ -39,10 +39,11 @@
 
 #include "io/Blast.h"
 
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
 
-#include "io/log/Logger.h"
+#include "platform/Platform.h"
 
 #define MAXBITS 13              /* maximum code length */
 #define MAXWIN 4096             /* maximum window size */
@@ -256,6 +257,26 @@ static int construct(huffman * h, const unsigned char * rep, int n) {
 	return left;
 }
 
+/* bit lengths of literal codes */
+static const unsigned char litlen[] = {
+	11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8,
+	9, 7, 6, 7, 8, 7, 6, 55, 8, 23, 24, 12, 11, 7, 9, 11, 12, 6, 7, 22, 5,
+	7, 24, 6, 11, 9, 6, 7, 22, 7, 11, 38, 7, 9, 8, 25, 11, 8, 11, 9, 12,
+	8, 12, 5, 38, 5, 38, 5, 11, 7, 5, 6, 21, 6, 10, 53, 8, 7, 24, 10, 27,
+	44, 253, 253, 253, 252, 252, 252, 13, 12, 45, 12, 45, 12, 61, 12, 45,
+	44, 173
+};
+/* bit lengths of length codes 0..15 */
+static const unsigned char lenlen[] = {2, 35, 36, 53, 38, 23};
+/* bit lengths of distance codes 0..63 */
+static const unsigned char distlen[] = {2, 20, 53, 230, 247, 151, 248};
+static const short base[16] = {     /* base for length codes */
+	3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264
+};
+static const char extra[16] = {     /* extra bits for length codes */
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8
+};
+
 /*
  * Decode PKWare Compression Library stream.
  *
@@ -310,25 +331,6 @@ static BlastResult blastDecompress(state * s) {
 	static huffman litcode = {litcnt, litsym};   /* length code */
 	static huffman lencode = {lencnt, lensym};   /* length code */
 	static huffman distcode = {distcnt, distsym};/* distance code */
-	/* bit lengths of literal codes */
-	static const unsigned char litlen[] = {
-		11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8,
-		9, 7, 6, 7, 8, 7, 6, 55, 8, 23, 24, 12, 11, 7, 9, 11, 12, 6, 7, 22, 5,
-		7, 24, 6, 11, 9, 6, 7, 22, 7, 11, 38, 7, 9, 8, 25, 11, 8, 11, 9, 12,
-		8, 12, 5, 38, 5, 38, 5, 11, 7, 5, 6, 21, 6, 10, 53, 8, 7, 24, 10, 27,
-		44, 253, 253, 253, 252, 252, 252, 13, 12, 45, 12, 45, 12, 61, 12, 45,
-		44, 173
-	};
-	/* bit lengths of length codes 0..15 */
-	static const unsigned char lenlen[] = {2, 35, 36, 53, 38, 23};
-	/* bit lengths of distance codes 0..63 */
-	static const unsigned char distlen[] = {2, 20, 53, 230, 247, 151, 248};
-	static const short base[16] = {     /* base for length codes */
-		3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264
-	};
-	static const char extra[16] = {     /* extra bits for length codes */
-		0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8
-	};
 	
 	/* set up decoding tables (once--might not be thread-safe) */
 	if(virgin) {
@@ -430,6 +432,286 @@ BlastResult blast(blast_in infun, void *inhow, blast_out outfun, void *outhow) {
 	return err;
 }
 
+// Table-driven decoder for in-memory buffers.
+
+namespace {
+
+/*
+ * Lookup table for a canonical Huffman code.
+ *
+ * The table is indexed by the next maxlen bits of the stream (in stream order,
+ * i.e. the first bit is the least significant bit of the index). Each entry
+ * stores the decoded symbol in the upper bits and the length of its code in the
+ * lowest four bits. Codes shorter than maxlen are replicated for all possible
+ * values of the remaining bits, so a single lookup decodes any code.
+ */
+template <int MaxLen, int Count>
+struct BlastLookupTable {
+	
+	enum { bits = MaxLen, size = 1 << MaxLen };
+	
+	u16 entry[size];
+	
+	BlastLookupTable(const unsigned char * rep, int n) {
+		
+		short count[MAXBITS + 1];
+		short symbol[Count];
+		huffman h = { count, symbol };
+		int incomplete = construct(&h, rep, n);
+		arx_assert(incomplete == 0);
+		ARX_UNUSED(incomplete);
+		
+		std::memset(entry, 0, sizeof(entry));
+		
+		/* walk the codes in the same order as decode() */
+		int first = 0;
+		int index = 0;
+		for(int len = 1; len <= MaxLen; len++) {
+			for(int i = 0; i < count[len]; i++) {
+				
+				/* stored codes are inverted and bit-reversed */
+				int code = first + i;
+				unsigned reversed = 0;
+				for(int j = 0; j < len; j++) {
+					reversed |= unsigned(((code >> (len - 1 - j)) & 1) ^ 1) << j;
+				}
+				
+				u16 value = u16((symbol[index + i] << 4) | len);
+				for(unsigned k = reversed; k < unsigned(size); k += 1u << len) {
+					entry[k] = value;
+				}
+			}
+			index += count[len];
+			first += count[len];
+			first <<= 1;
+		}
+	}
+	
+};
+
+/* literal codes are up to 13 bits, length codes up to 7 and distance codes up to 8 */
+const BlastLookupTable<13, 256> litTable(litlen, sizeof(litlen));
+const BlastLookupTable<7, 16> lenTable(lenlen, sizeof(lenlen));
+const BlastLookupTable<8, 64> distTable(distlen, sizeof(distlen));
+
+/*
+ * Input state for the table-driven decoder.
+ *
+ * Bits are kept in a 64-bit buffer that is refilled a byte at a time, but only
+ * when it runs low. Bits past the end of the input read as zero - a code or
+ * value that would need them raises blast_truncated_error.
+ */
+class BlastBitReader {
+	
+	const unsigned char * in;
+	const unsigned char * end;
+	u64 bitbuf;
+	unsigned bitcnt;
+	
+public:
+	
+	BlastBitReader(const char * buf, size_t size)
+		: in(reinterpret_cast<const unsigned char *>(buf))
+		, end(reinterpret_cast<const unsigned char *>(buf) + size)
+		, bitbuf(0), bitcnt(0) { }
+	
+	void refill() {
+		if(end - in >= 8) {
+			while(bitcnt <= 56) {
+				bitbuf |= u64(*in++) << bitcnt;
+				bitcnt += 8;
+			}
+		} else {
+			while(bitcnt <= 56 && in != end) {
+				bitbuf |= u64(*in++) << bitcnt;
+				bitcnt += 8;
+			}
+		}
+	}
+	
+	int bits(unsigned need) {
+		if(bitcnt < need) {
+			refill();
+			if(bitcnt < need) {
+				throw blast_truncated_error();
+			}
+		}
+		int val = int(bitbuf & ((u64(1) << need) - 1));
+		bitbuf >>= need;
+		bitcnt -= need;
+		return val;
+	}
+	
+	template <int MaxLen, int Count>
+	int decode(const BlastLookupTable<MaxLen, Count> & table) {
+		if(bitcnt < unsigned(MaxLen)) {
+			refill();
+		}
+		u16 value = table.entry[bitbuf & ((u64(1) << MaxLen) - 1)];
+		unsigned len = value & 15;
+		if(len > bitcnt) {
+			throw blast_truncated_error();
+		}
+		bitbuf >>= len;
+		bitcnt -= len;
+		return value >> 4;
+	}
+	
+};
+
+/*
+ * Output state for the table-driven decoder.
+ *
+ * The output buffer doubles as the sliding window, so copies read directly from
+ * previously written data.
+ */
+class BlastBufferWriter {
+	
+	char * buf;
+	size_t pos;
+	size_t capacity;
+	bool resizable;
+	
+public:
+	
+	BlastBufferWriter(char * b, size_t size, size_t fill, bool canResize)
+		: buf(b), pos(fill), capacity(size), resizable(canResize) { }
+	
+	char * data() const { return buf; }
+	size_t size() const { return pos; }
+	size_t allocated() const { return capacity; }
+	
+	bool reserve(size_t count) {
+		
+		if(capacity - pos >= count) {
+			return true;
+		}
+		
+		if(!resizable) {
+			return false;
+		}
+		
+		size_t newCapacity = std::max(capacity * 2, pos + std::max(count, size_t(MAXWIN)));
+		char * newBuf = static_cast<char *>(realloc(buf, newCapacity));
+		if(!newBuf) {
+			return false;
+		}
+		
+		buf = newBuf;
+		capacity = newCapacity;
+		return true;
+	}
+	
+	void put(int byte) {
+		buf[pos++] = char(byte);
+	}
+	
+	void copy(size_t dist, size_t len) {
+		char * to = buf + pos;
+		const char * from = to - dist;
+		pos += len;
+		if(dist >= len) {
+			std::memcpy(to, from, len);
+		} else {
+			/* overlapping copy - repeats the last dist bytes */
+			do {
+				*to++ = *from++;
+			} while(--len);
+		}
+	}
+	
+};
+
+/*
+ * Same as blastDecompress(), but using the lookup tables and with distances
+ * checked against the whole output buffer instead of the first window.
+ */
+BlastResult blastDecompressBuffer(BlastBitReader & in, BlastBufferWriter & out) {
+	
+	int lit = in.bits(8);
+	if(lit > 1) {
+		return BLAST_INVALID_LITERAL_FLAG;
+	}
+	
+	int dict = in.bits(8);
+	if(dict < 4 || dict > 6) {
+		return BLAST_INVALID_DIC_SIZE;
+	}
+	
+	while(true) {
+		
+		if(in.bits(1)) {
+			
+			int symbol = in.decode(lenTable);
+			int len = base[symbol] + in.bits(extra[symbol]);
+			if(len == 519) {
+				break; // end code
+			}
+			
+			int distBits = (len == 2) ? 2 : dict;
+			size_t dist = (size_t(in.decode(distTable)) << distBits) + in.bits(distBits) + 1;
+			if(dist > out.size()) {
+				return BLAST_INVALID_OFFSET;
+			}
+			
+			if(!out.reserve(len)) {
+				return BLAST_OUTPUT_ERROR;
+			}
+			out.copy(dist, len);
+			
+		} else {
+			
+			int symbol = lit ? in.decode(litTable) : in.bits(8);
+			
+			if(!out.reserve(1)) {
+				return BLAST_OUTPUT_ERROR;
+			}
+			out.put(symbol);
+			
+		}
+	}
+	
+	return BLAST_SUCCESS;
+}
+
+BlastResult blastBuffer(const char * from, size_t fromSize, BlastBufferWriter & out) {
+	
+	BlastBitReader in(from, fromSize);
+	
+	try {
+		return blastDecompressBuffer(in, out);
+	} catch(const blast_truncated_error &) {
+		return BLAST_TRUNCATED_INPUT;
+	}
+}
+
+} // anonymous namespace
+
+BlastResult blastBuffer(const char * from, size_t fromSize, BlastMemOutBuffer & out) {
+	
+	BlastBufferWriter writer(out.buf, out.size, 0, false);
+	
+	BlastResult error = blastBuffer(from, fromSize, writer);
+	
+	out.buf += writer.size();
+	out.size -= writer.size();
+	
+	return error;
+}
+
+BlastResult blastBuffer(const char * from, size_t fromSize, BlastMemOutBufferRealloc & out) {
+	
+	BlastBufferWriter writer(out.buf, out.allocSize, out.fillSize, true);
+	
+	BlastResult error = blastBuffer(from, fromSize, writer);
+	
+	out.buf = writer.data();
+	out.allocSize = writer.allocated();
+	out.fillSize = writer.size();
+	
+	return error;
+}
+
 // Additional functions.
 
 int blastOutMem(void * Param, unsigned char * buf, size_t len) {
@@ -486,12 +768,11 @@ int blastOutMemRealloc(void * Param, unsigned char * buf, size_t len) {
 
 char * blastMemAlloc(const char * from, size_t fromSize, size_t & toSize) {
 	
-	BlastMemInBuffer in(from, fromSize);
 	BlastMemOutBufferRealloc out;
 	
-	BlastResult error = blast(blastInMem, &in, blastOutMemRealloc, &out);
+	BlastResult error = blastBuffer(from, fromSize, out);
 	if(error) {
-		LogError << "blastMemAlloc error " << error << " for " << fromSize;
+		free(out.buf);
 		toSize = 0;
 		return NULL;
 	}
@@ -505,12 +786,10 @@ char * blastMemAlloc(const char * from, size_t fromSize, size_t & toSize) {
 
 size_t blastMem(const char * from, size_t fromSize, char * to, size_t toSize) {
 	
-	BlastMemInBuffer in(from, fromSize);
 	BlastMemOutBuffer out(to, toSize);
 	
-	BlastResult error = blast(blastInMem, &in, blastOutMem, &out);
+	BlastResult error = blastBuffer(from, fromSize, out);
 	if(error) {
-		LogError << "blastMem error " << error << " for " << fromSize << "/" << toSize;
 		return 0;
 	}
 	
@@ -147,16 +147,41 @@ size_t blastInMem(void * Param, const unsigned char ** buf);
  */
 int blastOutMemRealloc(void * Param, unsigned char * buf, size_t len);
 
+/*!
+ * Decompress data from a memory buffer into a BlastMemOutBuffer.
+ *
+ * Produces the same output as blast() with blastInMem() and blastOutMem(), but
+ * reads the input through a 64-bit bit buffer and decodes the Huffman codes with
+ * lookup tables instead of one bit at a time.
+ * Advances the buf pointer and decreases size by the amount of data written.
+ *
+ * If the input is corrupt and the output buffer is also too small, the returned
+ * error may differ from the one returned by blast().
+ */
+BlastResult blastBuffer(const char * from, size_t fromSize, BlastMemOutBuffer & out);
+
+/*!
+ * Decompress data from a memory buffer into a BlastMemOutBufferRealloc.
+ *
+ * Same as blastBuffer() for a BlastMemOutBuffer, but grows the output buffer as
+ * needed. The same allocation rules as for blastOutMemRealloc() apply.
+ */
+BlastResult blastBuffer(const char * from, size_t fromSize, BlastMemOutBufferRealloc & out);
+
 /*!
  * Decompress data and allocate memory as needed.
  * Returned pointer should be deallocated using free(), not delete.
  * 
  * If the uncompressed size is known, always uses blastMem instead.
+ * 
+ * \return NULL on error. Errors are not logged, use blastBuffer() to get the cause.
  */
 char * blastMemAlloc(const char * from, size_t fromSize, size_t & toSize);
 
 /*!
  * Decompress data.
+ * 
+ * \return the number of bytes written or 0 on error. Errors are not logged.
  */
 size_t blastMem(const char * from, size_t fromSize, char * to, size_t toSize);
 
@@ -43,6 +43,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "io/SaveBlock.h"
 
+#include <algorithm>
 #include <cstdlib>
 
 #include <boost/algorithm/string/case_conv.hpp>
@@ -54,6 +55,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "io/Blast.h"
 
 #include "platform/Platform.h"
+#include "platform/Time.h"
 
 static const u32 SAV_VERSION_OLD = (1<<16) | 0;
 static const u32 SAV_VERSION_RELEASE = (1<<16) | 1;
@@ -249,7 +251,9 @@ char * SaveBlock::File::loadData(std::istream & handle, size_t & size, const std
 	}
 }
 
-SaveBlock::SaveBlock(const fs::path & _savefile) : savefile(_savefile), totalSize(0), usedSize(0), chunkCount(0) { }
+SaveBlock::SaveBlock(const fs::path & _savefile)
+	: savefile(_savefile), totalSize(0), usedSize(0), chunkCount(0), committedSize(0),
+	  incremental(false) { }
 
 SaveBlock::~SaveBlock() { }
 
@@ -326,35 +330,47 @@ bool SaveBlock::loadFileTable() {
 		usedSize += file.storedSize, chunkCount += file.chunks.size();
 	}
 	
+	committedSize = size_t(handle.tellg()) - 4;
+	
 	return true;
 }
 
-void SaveBlock::writeFileTable(const std::string & important) {
+void SaveBlock::writeFileTable(std::ostream & stream, const std::string & important) {
 	
 	LogDebug("writeFileTable " << savefile);
 	
+	u64 startTime = platform::getTimeUs();
+	
+	// Never overwrite the current file table
+	totalSize = std::max(totalSize, committedSize);
+	
 	u32 fatOffset = totalSize;
-	handle.seekp(fatOffset + 4);
+	stream.seekp(fatOffset + 4);
 	
-	fs::write(handle, SAV_VERSION_NOEXT);
+	fs::write(stream, SAV_VERSION_NOEXT);
 	
 	u32 nFiles = files.size();
-	fs::write(handle, nFiles);
+	fs::write(stream, nFiles);
 	
 	Files::const_iterator ifile = files.find(important);
 	if(ifile != files.end()) {
-		ifile->second.writeEntry(handle, ifile->first);
+		ifile->second.writeEntry(stream, ifile->first);
 	}
 	
 	for(Files::const_iterator file = files.begin(); file != files.end(); ++file) {
 		if(file != ifile) {
-			file->second.writeEntry(handle, file->first);
+			file->second.writeEntry(stream, file->first);
 		}
 	}
 	
-	handle.seekp(0);
-	fs::write(handle, fatOffset);
+	committedSize = size_t(stream.tellp()) - 4;
 	
+	// Only switch to the new file table once it has been written completely
+	stream.flush();
+	stream.seekp(0);
+	fs::write(stream, fatOffset);
+	
+	stats.writeTime += platform::getElapsedUs(startTime);
 }
 
 bool SaveBlock::open(bool writable) {
@@ -393,18 +409,25 @@ bool SaveBlock::flush(const std::string & important) {
 	arx_assert(important.find_first_of(BADSAVCHAR) == std::string::npos,
 	           "bad save filename: \"%s\"", important.c_str());
 	
+	while(writePending()) { }
+	
+	Autolock lock(mutex);
+	
+	bool written = false;
 	if((usedSize * 2 < totalSize || chunkCount > (files.size() * 4 / 3))) {
-		defragment();
+		written = defragment(important);
 	}
 	
-	writeFileTable(important);
+	if(!written) {
+		writeFileTable(handle, important);
+	}
 	
 	handle.flush();
 	
 	return handle.good();
 }
 
-bool SaveBlock::defragment() {
+bool SaveBlock::defragment(const std::string & important) {
 	
 	LogDebug("defragmenting " << savefile << " save: using " << usedSize << " / " << totalSize
 	         << " b for " << files.size() << " files in " << chunkCount << " chunks");
@@ -423,7 +446,7 @@ bool SaveBlock::defragment() {
 		return false;
 	}
 	
-	totalSize = 0;
+	totalSize = 0, committedSize = 0;
 	tempFile.seekp(4);
 	
 	for(Files::iterator file = files.begin(); file != files.end(); ++file) {
@@ -457,6 +480,9 @@ bool SaveBlock::defragment() {
 	
 	usedSize = totalSize, chunkCount = files.size();
 	
+	// Write the file table before replacing the old save block so that it is never incomplete
+	writeFileTable(tempFile, important);
+	
 	if(tempFile.fail()) {
 		fs::remove(tempFileName);
 		handle.close(), files.clear();
@@ -475,8 +501,26 @@ bool SaveBlock::defragment() {
 	return handle.is_open();
 }
 
+static bool deflateData(const char * data, size_t size, std::vector<char> & compressed) {
+	
+	if(size <= 1) {
+		return false;
+	}
+	
+	uLongf compressedSize = size - 1;
+	compressed.resize(compressedSize);
+	if(compress2((Bytef*)&compressed[0], &compressedSize, (const Bytef*)data, size, 1) != Z_OK) {
+		return false;
+	}
+	
+	compressed.resize(compressedSize);
+	return true;
+}
+
 bool SaveBlock::save(const std::string & name, const char * data, size_t size) {
 	
+	Autolock lock(mutex);
+	
 	if(!handle) {
 		return false;
 	}
@@ -484,35 +528,67 @@ bool SaveBlock::save(const std::string & name, const char * data, size_t size) {
 	arx_assert(name.find_first_of(BADSAVCHAR) == std::string::npos,
 	           "bad save filename: \"%s\"", name.c_str());
 	
-	File * file = &files[name];
+	File & file = files[name];
 	
-	file->uncompressedSize = size;
+	u32 checksum = crc32(crc32(0, Z_NULL, 0), (const Bytef*)data, uInt(size));
+	if(file.hasChecksum && file.uncompressedSize == size && file.checksum == checksum) {
+		stats.unchanged++;
+		return true;
+	}
 	
-	if(size == 0) {
-		file->comp = File::None;
-		file->storedSize = 0;
+	file.uncompressedSize = size;
+	
+	// The checksum is only recorded once the data has been written successfully
+	file.hasChecksum = false;
+	
+	if(incremental) {
+		PendingData copy(new std::vector<char>(data, data + size));
+		pending[name] = PendingFile(copy, checksum);
+		queued.post();
 		return true;
 	}
 	
-	uLongf compressedSize = size - 1;
-	char * compressed = new char[compressedSize];
-	const char * p;
-	if(compress2((Bytef*)compressed, &compressedSize, (const Bytef*)data, size, 1) == Z_OK) {
-		file->comp = File::Deflate;
-		file->storedSize = compressedSize;
-		p = compressed;
+	return store(file, data, size, checksum);
+}
+
+bool SaveBlock::store(File & file, const char * data, size_t size, u32 checksum) {
+	
+	u64 startTime = platform::getTimeUs();
+	std::vector<char> compressed;
+	bool deflated = deflateData(data, size, compressed);
+	stats.compressTime += platform::getElapsedUs(startTime);
+	
+	bool written;
+	if(deflated) {
+		written = writeData(file, File::Deflate, &compressed[0], compressed.size());
 	} else {
-		file->comp = File::None;
-		file->storedSize = size;
-		p = data;
+		written = writeData(file, File::None, data, size);
 	}
 	
-	LogDebug("saving " << name << " " << file->uncompressedSize << " " << file->storedSize);
+	file.checksum = checksum;
+	file.hasChecksum = written;
+	
+	return written;
+}
+
+bool SaveBlock::writeData(File & file, File::Compression comp, const char * p, size_t storedSize) {
+	
+	LogDebug("saving " << file.uncompressedSize << " " << storedSize);
 	
-	size_t remaining = file->storedSize;
+	u64 startTime = platform::getTimeUs();
 	
-	for(File::ChunkList::iterator chunk = file->chunks.begin();
-	    chunk != file->chunks.end(); ++chunk) {
+	file.comp = comp;
+	file.storedSize = storedSize;
+	
+	size_t remaining = storedSize;
+	
+	File::ChunkList::iterator chunk = file.chunks.begin();
+	for(; chunk != file.chunks.end() && remaining != 0; ++chunk) {
+		
+		if(incremental && chunk->offset < committedSize) {
+			// Still referenced by the file table on disk
+			break;
+		}
 		
 		handle.seekp(chunk->offset + 4);
 		
@@ -524,25 +600,116 @@ bool SaveBlock::save(const std::string & name, const char * data, size_t size) {
 		handle.write(p, chunk->size);
 		p += chunk->size;
 		remaining -= chunk->size;
-		
-		if(remaining == 0) {
-			file->chunks.erase(++chunk, file->chunks.end());
-			delete[] compressed;
-			return true;
-		}
 	}
 	
-	file->chunks.push_back(File::Chunk(remaining, totalSize));
-	handle.seekp(totalSize + 4);
-	handle.write(p, remaining);
-	totalSize += remaining, usedSize += remaining, chunkCount++;
+	for(File::ChunkList::const_iterator i = chunk; i != file.chunks.end(); ++i) {
+		usedSize -= i->size, chunkCount--;
+	}
+	file.chunks.erase(chunk, file.chunks.end());
 	
-	delete[] compressed;
+	if(remaining != 0) {
+		// Never overwrite the current file table
+		totalSize = std::max(totalSize, committedSize);
+		file.chunks.push_back(File::Chunk(remaining, totalSize));
+		handle.seekp(totalSize + 4);
+		handle.write(p, remaining);
+		totalSize += remaining, usedSize += remaining, chunkCount++;
+	}
+	
+	stats.writeTime += platform::getElapsedUs(startTime);
+	stats.written++;
+	stats.writtenSize += storedSize;
 	
 	return !handle.fail();
 }
 
+void SaveBlock::setIncremental(bool enable) {
+	
+	if(!enable) {
+		while(writePending()) { }
+	}
+	
+	Autolock lock(mutex);
+	
+	incremental = enable;
+}
+
+bool SaveBlock::writePending() {
+	
+	std::string name;
+	PendingData data;
+	u32 checksum;
+	
+	{
+		Autolock lock(mutex);
+		if(pending.empty()) {
+			return false;
+		}
+		name = pending.begin()->first;
+		data = pending.begin()->second.data;
+		checksum = pending.begin()->second.checksum;
+	}
+	
+	u64 startTime = platform::getTimeUs();
+	std::vector<char> compressed;
+	const char * p = data->empty() ? NULL : &(*data)[0];
+	bool deflated = deflateData(p, data->size(), compressed);
+	u64 compressTime = platform::getElapsedUs(startTime);
+	
+	Autolock lock(mutex);
+	
+	stats.compressTime += compressTime;
+	
+	// The file may have been saved again, removed or written by another thread in the meantime
+	PendingFiles::iterator entry = pending.find(name);
+	if(entry == pending.end() || entry->second.data != data) {
+		return true;
+	}
+	pending.erase(entry);
+	
+	Files::iterator file = files.find(name);
+	if(file == files.end()) {
+		return true;
+	}
+	
+	bool written;
+	if(deflated) {
+		written = writeData(file->second, File::Deflate, &compressed[0], compressed.size());
+	} else {
+		written = writeData(file->second, File::None, p, data->size());
+	}
+	
+	file->second.checksum = checksum;
+	file->second.hasChecksum = written;
+	
+	if(!written) {
+		LogError << "Error writing " << name << " to " << savefile;
+	}
+	
+	return true;
+}
+
+void SaveBlock::waitPending() {
+	queued.wait();
+}
+
+void SaveBlock::wakeWaiting() {
+	queued.post();
+}
+
+SaveBlock::Statistics SaveBlock::getStatistics() const {
+	Autolock lock(mutex);
+	return stats;
+}
+
+void SaveBlock::resetStatistics() {
+	Autolock lock(mutex);
+	stats = Statistics();
+}
+
 void SaveBlock::remove(const std::string & name) {
+	Autolock lock(mutex);
+	pending.erase(name);
 	files.erase(name);
 }
 
@@ -551,6 +718,21 @@ char * SaveBlock::load(const std::string & name, size_t & size) {
 	arx_assert(name.find_first_of(BADSAVCHAR) == std::string::npos,
 	           "bad save filename: \"%s\"", name.c_str());
 	
+	Autolock lock(mutex);
+	
+	PendingFiles::const_iterator entry = pending.find(name);
+	if(entry != pending.end()) {
+		// Not written yet
+		const std::vector<char> & data = *entry->second.data;
+		size = data.size();
+		if(size == 0) {
+			return NULL;
+		}
+		char * buf = (char*)malloc(size);
+		std::copy(data.begin(), data.end(), buf);
+		return buf;
+	}
+	
 	Files::const_iterator file = files.find(name);
 	
 	return (file == files.end()) ? NULL : file->second.loadData(handle, size, name);
@@ -559,11 +741,14 @@ char * SaveBlock::load(const std::string & name, size_t & size) {
 bool SaveBlock::hasFile(const std::string & name) const {
 	arx_assert(name.find_first_of(BADSAVCHAR) == std::string::npos,
 	           "bad save filename: \"%s\"", name.c_str());
+	Autolock lock(mutex);
 	return (files.find(name) != files.end());
 }
 
 std::vector<std::string> SaveBlock::getFiles() const {
 	
+	Autolock lock(mutex);
+	
 	std::vector<std::string> result;
 	
 	for(Files::const_iterator file = files.begin(); file != files.end(); ++file) {
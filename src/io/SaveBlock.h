@@ -48,8 +48,10 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <string>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
 
+#include "platform/Lock.h"
 #include "platform/Platform.h"
 #include "io/fs/FilePath.h"
 #include "io/fs/FileStream.h"
@@ -59,6 +61,22 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
  */
 class SaveBlock {
 	
+public:
+	
+	//! Counters for the work done by save() and writePending().
+	struct Statistics {
+		
+		u64 compressTime; //!< Time spent compressing files, in microseconds.
+		u64 writeTime; //!< Time spent writing files and file tables, in microseconds.
+		
+		size_t written; //!< Number of files written.
+		size_t writtenSize; //!< Number of bytes written for files, after compression.
+		size_t unchanged; //!< Number of saves that were skipped because the data did not change.
+		
+		Statistics() : compressTime(0), writeTime(0), written(0), writtenSize(0), unchanged(0) { }
+		
+	};
+	
 private:
 	
 	struct File {
@@ -87,6 +105,12 @@ private:
 		ChunkList chunks;
 		Compression comp;
 		
+		//! CRC-32 of the uncompressed data, only known for files saved since the block was opened.
+		u32 checksum;
+		bool hasChecksum;
+		
+		File() : storedSize(0), uncompressedSize(0), comp(None), checksum(0), hasChecksum(false) { }
+		
 		const char * compressionName() const;
 		
 		bool loadOffsets(std::istream & handle, u32 version);
@@ -99,6 +123,21 @@ private:
 	
 	typedef boost::unordered_map<std::string, File> Files;
 	
+	typedef boost::shared_ptr<const std::vector<char> > PendingData;
+	
+	//! Data queued by save() in incremental mode and the checksum to record once it is written.
+	struct PendingFile {
+		
+		PendingData data;
+		u32 checksum;
+		
+		PendingFile() : checksum(0) { }
+		PendingFile(const PendingData & data, u32 checksum) : data(data), checksum(checksum) { }
+		
+	};
+	
+	typedef boost::unordered_map<std::string, PendingFile> PendingFiles;
+	
 	fs::path savefile;
 	fs::fstream handle;
 	size_t totalSize;
@@ -106,9 +145,26 @@ private:
 	size_t chunkCount;
 	Files files;
 	
-	bool defragment();
+	//! End of the file table that is currently on disk, relative to the start of the data.
+	size_t committedSize;
+	
+	bool incremental;
+	PendingFiles pending;
+	
+	Statistics stats;
+	
+	//! Protects all members against concurrent access from writePending().
+	mutable Lock mutex;
+	
+	//! Posted for each file queued by save(), see waitPending().
+	Semaphore queued;
+	
+	bool defragment(const std::string & important);
 	bool loadFileTable();
-	void writeFileTable(const std::string & important);
+	void writeFileTable(std::ostream & stream, const std::string & important);
+	
+	bool store(File & file, const char * data, size_t size, u32 checksum);
+	bool writeData(File & file, File::Compression comp, const char * data, size_t storedSize);
 	
 public:
 	
@@ -128,18 +184,61 @@ public:
 	bool open(bool writable = false);
 	
 	/*!
-	 * Finalize the save block: defragment if needed and write the file table.
+	 * Finalize the save block: write all pending files, defragment if needed and
+	 * write the file table.
+	 *
+	 * The new file table is written after all file data and only becomes active
+	 * once it is complete, so the previous table stays valid if writing fails.
 	 */
 	bool flush(const std::string & important);
 	
 	/*!
 	 * Save a file to the save block.
 	 * This only writes the file data and does not add the file to the file table.
-	 * Also, it may destroy any previous on-disk file table.
+	 * In non-incremental mode, it may overwrite data referenced by the on-disk
+	 * file table.
 	 * flush() should be called before destructing this SaveBlock instance
+	 *
+	 * Saving the same data that was last saved under the same name does nothing.
 	 */
 	bool save(const std::string & name, const char * data, size_t size);
 	
+	/*!
+	 * Enable or disable incremental mode.
+	 *
+	 * In incremental mode, save() only copies the data and queues it to be compressed
+	 * and written by writePending(), which can be called from another thread.
+	 * Chunks referenced by the on-disk file table are never overwritten, so the save
+	 * block on disk stays consistent until the next flush().
+	 *
+	 * Disabling incremental mode writes all pending files.
+	 */
+	void setIncremental(bool enable);
+	
+	/*!
+	 * Compress and write one file queued by save() in incremental mode.
+	 *
+	 * This may be called from any thread. The compression is done without holding
+	 * the lock so other methods can be used in the meantime.
+	 *
+	 * \return false if there were no pending files.
+	 */
+	bool writePending();
+	
+	/*!
+	 * Block until save() queues a file in incremental mode or wakeWaiting() is called.
+	 *
+	 * Each queued file wakes up one waiting thread. The file may already have been
+	 * written by another thread when this returns.
+	 */
+	void waitPending();
+	
+	//! Wake up one thread blocked in waitPending().
+	void wakeWaiting();
+	
+	Statistics getStatistics() const;
+	void resetStatistics();
+	
 	/*!
 	 * Remove a file from the save block.
 	 */
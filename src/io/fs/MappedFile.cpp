@@ -0,0 +1,164 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/fs/MappedFile.h"
+
+#include "Configure.h"
+
+#include "platform/Platform.h"
+
+#if ARX_HAVE_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+#include <windows.h>
+#endif
+
+#include "io/fs/FilePath.h"
+#include "io/fs/Filesystem.h"
+
+namespace fs {
+
+mapped_file::mapped_file(const path & p) : buffer(NULL), length(0), mapped(false) {
+	open(p);
+}
+
+#if ARX_HAVE_MMAP
+
+static const char * map_file(const path & p, size_t & size) {
+	
+	int fd = ::open(p.string().c_str(), O_RDONLY);
+	if(fd < 0) {
+		return NULL;
+	}
+	
+	struct stat buf;
+	if(fstat(fd, &buf) != 0 || buf.st_size <= 0 || u64(buf.st_size) != u64(size_t(buf.st_size))) {
+		::close(fd);
+		return NULL;
+	}
+	
+	void * data = mmap(NULL, size_t(buf.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(data == MAP_FAILED) {
+		return NULL;
+	}
+	
+	size = size_t(buf.st_size);
+	return static_cast<const char *>(data);
+}
+
+static void unmap_file(const char * data, size_t size) {
+	munmap(const_cast<char *>(data), size);
+}
+
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+
+static const char * map_file(const path & p, size_t & size) {
+	
+	HANDLE file = CreateFileA(p.string().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+	                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+	
+	LARGE_INTEGER filesize;
+	if(!GetFileSizeEx(file, &filesize) || filesize.QuadPart <= 0
+	   || u64(filesize.QuadPart) != u64(size_t(filesize.QuadPart))) {
+		CloseHandle(file);
+		return NULL;
+	}
+	
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if(!mapping) {
+		return NULL;
+	}
+	
+	// The view keeps a reference to the mapping object.
+	void * data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if(!data) {
+		return NULL;
+	}
+	
+	size = size_t(filesize.QuadPart);
+	return static_cast<const char *>(data);
+}
+
+static void unmap_file(const char * data, size_t size) {
+	ARX_UNUSED(size);
+	UnmapViewOfFile(data);
+}
+
+#else
+
+static const char * map_file(const path & p, size_t & size) {
+	ARX_UNUSED(p), ARX_UNUSED(size);
+	return NULL;
+}
+
+static void unmap_file(const char * data, size_t size) {
+	ARX_UNUSED(data), ARX_UNUSED(size);
+}
+
+#endif
+
+bool mapped_file::open(const path & p) {
+	
+	close();
+	
+	size_t size = 0;
+	const char * data = map_file(p, size);
+	if(data) {
+		buffer = data, length = size, mapped = true;
+		return true;
+	}
+	
+	// Mapping is not supported or failed - fall back to reading the whole file.
+	char * copy = read_file(p, size);
+	if(copy && size == 0) {
+		delete[] copy, copy = NULL;
+	}
+	if(copy) {
+		buffer = copy, length = size, mapped = false;
+	}
+	
+	return is_open();
+}
+
+void mapped_file::close() {
+	
+	if(!buffer) {
+		return;
+	}
+	
+	if(mapped) {
+		unmap_file(buffer, length);
+	} else {
+		delete[] buffer;
+	}
+	
+	buffer = NULL, length = 0, mapped = false;
+}
+
+} // namespace fs
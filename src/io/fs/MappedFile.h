@@ -0,0 +1,76 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_IO_FS_MAPPEDFILE_H
+#define ARX_IO_FS_MAPPEDFILE_H
+
+#include <stddef.h>
+
+#include <boost/noncopyable.hpp>
+
+namespace fs {
+
+class path;
+
+/*!
+ * Read-only view of the whole contents of a file.
+ *
+ * The file is mapped into memory if the platform supports it, otherwise it is
+ * read into a heap buffer. Either way, the data stays valid until the object is
+ * closed or destroyed.
+ */
+class mapped_file : private boost::noncopyable {
+	
+	const char * buffer;
+	size_t length;
+	bool mapped;
+	
+public:
+	
+	mapped_file() : buffer(NULL), length(0), mapped(false) { }
+	
+	explicit mapped_file(const path & p);
+	
+	~mapped_file() { close(); }
+	
+	/*!
+	 * \brief Open a file, closing the previous one
+	 *
+	 * Empty files cannot be opened.
+	 *
+	 * \return true if the file contents are available.
+	 */
+	bool open(const path & p);
+	
+	void close();
+	
+	bool is_open() const { return buffer != NULL; }
+	
+	//! \return true if the data is backed by a memory mapping and not a heap copy.
+	bool is_mapped() const { return mapped; }
+	
+	const char * data() const { return buffer; }
+	
+	size_t size() const { return length; }
+	
+};
+
+} // namespace fs
+
+#endif // ARX_IO_FS_MAPPEDFILE_H
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/resource/PakCache.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/foreach.hpp>
+
+PakCache::PakCache(size_t _budget)
+	: size(0), budget(_budget), hits(0), misses(0), evictions(0) { }
+
+PakCache::~PakCache() {
+	clear();
+}
+
+bool PakCache::read(const PakFile * file, void * buf) {
+	
+	Autolock lock(this->lock);
+	
+	Index::iterator it = index.find(file);
+	if(it == index.end()) {
+		misses++;
+		return false;
+	}
+	
+	hits++;
+	
+	// Move the entry to the front of the LRU list.
+	entries.splice(entries.begin(), entries, it->second);
+	
+	memcpy(buf, it->second->data, it->second->size);
+	
+	return true;
+}
+
+bool PakCache::contains(const PakFile * file) {
+	
+	Autolock lock(this->lock);
+	
+	return index.find(file) != index.end();
+}
+
+void PakCache::insert(const PakFile * file, char * data, size_t dataSize) {
+	
+	Autolock lock(this->lock);
+	
+	if(dataSize > budget || index.find(file) != index.end()) {
+		free(data);
+		return;
+	}
+	
+	evict(budget - dataSize);
+	
+	Entry entry;
+	entry.file = file;
+	entry.data = data;
+	entry.size = dataSize;
+	entries.push_front(entry);
+	index[file] = entries.begin();
+	
+	size += dataSize;
+}
+
+void PakCache::remove(const PakFile * file) {
+	
+	Autolock lock(this->lock);
+	
+	Index::iterator it = index.find(file);
+	if(it == index.end()) {
+		return;
+	}
+	
+	size -= it->second->size;
+	free(it->second->data);
+	entries.erase(it->second);
+	index.erase(it);
+}
+
+void PakCache::clear() {
+	
+	Autolock lock(this->lock);
+	
+	BOOST_FOREACH(const Entry & entry, entries) {
+		free(entry.data);
+	}
+	
+	entries.clear();
+	index.clear();
+	size = 0;
+}
+
+void PakCache::setBudget(size_t _budget) {
+	
+	Autolock lock(this->lock);
+	
+	budget = _budget;
+	
+	evict(budget);
+}
+
+PakCache::Statistics PakCache::getStatistics() {
+	
+	Autolock lock(this->lock);
+	
+	Statistics stats;
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.evictions = evictions;
+	stats.entries = entries.size();
+	stats.size = size;
+	stats.budget = budget;
+	
+	return stats;
+}
+
+void PakCache::resetStatistics() {
+	
+	Autolock lock(this->lock);
+	
+	hits = misses = evictions = 0;
+}
+
+void PakCache::evict(size_t limit) {
+	
+	while(size > limit && !entries.empty()) {
+		const Entry & entry = entries.back();
+		size -= entry.size;
+		free(entry.data);
+		index.erase(entry.file);
+		entries.pop_back();
+		evictions++;
+	}
+}
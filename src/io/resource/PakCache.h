@@ -0,0 +1,116 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_IO_RESOURCE_PAKCACHE_H
+#define ARX_IO_RESOURCE_PAKCACHE_H
+
+#include <stddef.h>
+#include <list>
+
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "platform/Lock.h"
+#include "platform/Platform.h"
+
+class PakFile;
+
+/*!
+ * Bounded LRU cache of decompressed .pak file entries.
+ *
+ * Compressed files store their decompressed contents here after each read so that
+ * reading the same file again (or seeking backwards in a handle) does not need to
+ * decompress it again. All methods are thread-safe.
+ */
+class PakCache : private boost::noncopyable {
+	
+public:
+	
+	static const size_t DefaultBudget = 64 * 1024 * 1024;
+	
+	struct Statistics {
+		u64 hits;
+		u64 misses;
+		u64 evictions;
+		size_t entries;
+		size_t size; //!< Total size of all cached entries in bytes
+		size_t budget;
+	};
+	
+	explicit PakCache(size_t budget = DefaultBudget);
+	~PakCache();
+	
+	/*!
+	 * Copy the cached contents of a file.
+	 *
+	 * \param buf Buffer of at least file->size() bytes.
+	 * \return false if the file is not cached.
+	 */
+	bool read(const PakFile * file, void * buf);
+	
+	//! Check if a file is cached without affecting the statistics or LRU order.
+	bool contains(const PakFile * file);
+	
+	/*!
+	 * Add the contents of a file to the cache.
+	 *
+	 * Takes ownership of data, which must be allocated with malloc().
+	 * Entries larger than the budget are not cached.
+	 */
+	void insert(const PakFile * file, char * data, size_t size);
+	
+	void remove(const PakFile * file);
+	
+	void clear();
+	
+	//! Set the maximum total size of all cached entries, evicting entries as needed.
+	void setBudget(size_t budget);
+	
+	Statistics getStatistics();
+	
+	void resetStatistics();
+	
+private:
+	
+	struct Entry {
+		const PakFile * file;
+		char * data;
+		size_t size;
+	};
+	
+	typedef std::list<Entry> Entries;
+	typedef boost::unordered_map<const PakFile *, Entries::iterator> Index;
+	
+	Lock lock;
+	
+	Entries entries; //!< Most recently used entries first
+	Index index;
+	
+	size_t size;
+	size_t budget;
+	
+	u64 hits;
+	u64 misses;
+	u64 evictions;
+	
+	void evict(size_t limit);
+	
+};
+
+#endif // ARX_IO_RESOURCE_PAKCACHE_H
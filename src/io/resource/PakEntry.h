@@ -54,6 +54,24 @@ public:
 	virtual void read(void * buf) const = 0;
 	char * readAlloc() const;
 	
+	/*!
+	 * Get the file contents without copying them.
+	 *
+	 * Only available for uncompressed files in memory-mapped archives.
+	 * The returned pointer remains valid until the archive is removed.
+	 *
+	 * \return a pointer to size() bytes or NULL if the file must be read().
+	 */
+	virtual const char * data() const { return NULL; }
+	
+	/*!
+	 * Decompress the file into the resource cache if it is compressed and not
+	 * already cached. Does nothing for uncompressed files.
+	 *
+	 * This may be called from any thread.
+	 */
+	virtual void prefetch() const { }
+	
 	virtual PakFileHandle * open() const = 0;
 	
 };
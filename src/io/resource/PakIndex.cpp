@@ -0,0 +1,145 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/resource/PakIndex.h"
+
+namespace {
+
+const size_t PAK_INDEX_MIN_SIZE = 1024; // must be a power of two
+
+} // anonymous namespace
+
+u64 PakIndex::hash(const std::string & name) {
+	
+	// 64-bit FNV-1a
+	u64 h = 0xcbf29ce484222325ull;
+	for(size_t i = 0; i < name.length(); i++) {
+		h ^= u64(u8(name[i]));
+		h *= 0x100000001b3ull;
+	}
+	
+	// Mix the high bits into the low bits used to select the bucket.
+	return h ^ (h >> 32);
+}
+
+size_t PakIndex::findSlot(const std::string & name, u64 h) const {
+	
+	size_t mask = entries.size() - 1;
+	size_t i = size_t(h) & mask;
+	
+	while(entries[i].file && (entries[i].hash != h || entries[i].name != name)) {
+		i = (i + 1) & mask;
+	}
+	
+	return i;
+}
+
+void PakIndex::grow() {
+	
+	std::vector<Entry> old;
+	old.swap(entries);
+	
+	entries.resize(old.empty() ? PAK_INDEX_MIN_SIZE : old.size() * 2);
+	
+	size_t mask = entries.size() - 1;
+	for(size_t j = 0; j < old.size(); j++) {
+		if(!old[j].file) {
+			continue;
+		}
+		size_t i = size_t(old[j].hash) & mask;
+		while(entries[i].file) {
+			i = (i + 1) & mask;
+		}
+		entries[i].hash = old[j].hash;
+		entries[i].file = old[j].file;
+		entries[i].name.swap(old[j].name);
+	}
+}
+
+void PakIndex::insert(const std::string & name, PakFile * file) {
+	
+	arx_assert(file != NULL);
+	
+	if((count + 1) * 2 > entries.size()) {
+		grow();
+	}
+	
+	u64 h = hash(name);
+	Entry & entry = entries[findSlot(name, h)];
+	
+	if(!entry.file) {
+		entry.hash = h;
+		entry.name = name;
+		count++;
+	}
+	
+	entry.file = file;
+}
+
+PakFile * PakIndex::find(const std::string & name) const {
+	
+	if(count == 0) {
+		return NULL;
+	}
+	
+	return entries[findSlot(name, hash(name))].file;
+}
+
+void PakIndex::remove(const std::string & name) {
+	
+	if(count == 0) {
+		return;
+	}
+	
+	size_t mask = entries.size() - 1;
+	size_t i = findSlot(name, hash(name));
+	if(!entries[i].file) {
+		return;
+	}
+	
+	// Shift following entries of the probe sequence back into the hole.
+	size_t j = i;
+	while(true) {
+		
+		j = (j + 1) & mask;
+		if(!entries[j].file) {
+			break;
+		}
+		
+		// Distance of the hole and the current entry from the entry's home slot
+		size_t home = size_t(entries[j].hash) & mask;
+		if(((i - home) & mask) < ((j - home) & mask)) {
+			entries[i].hash = entries[j].hash;
+			entries[i].file = entries[j].file;
+			entries[i].name.swap(entries[j].name);
+			i = j;
+		}
+		
+	}
+	
+	entries[i].hash = 0;
+	entries[i].file = NULL;
+	entries[i].name.clear();
+	count--;
+}
+
+void PakIndex::clear() {
+	entries.clear();
+	count = 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_IO_RESOURCE_PAKINDEX_H
+#define ARX_IO_RESOURCE_PAKINDEX_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "platform/Platform.h"
+
+class PakFile;
+
+/*!
+ * Flat hash table mapping full resource paths to files.
+ *
+ * Used by \ref PakReader to resolve a path with a single probe sequence instead of
+ * walking the \ref PakDirectory tree one path component at a time.
+ *
+ * Uses open addressing with linear probing and backward-shift deletion, so there
+ * are no tombstones and the load factor is kept at or below one half.
+ */
+class PakIndex : private boost::noncopyable {
+	
+	struct Entry {
+		
+		u64 hash;
+		PakFile * file; //!< NULL if the slot is empty
+		std::string name;
+		
+		Entry() : hash(0), file(NULL) { }
+		
+	};
+	
+	std::vector<Entry> entries;
+	size_t count;
+	
+	size_t findSlot(const std::string & name, u64 hash) const;
+	void grow();
+	
+public:
+	
+	PakIndex() : count(0) { }
+	
+	/*!
+	 * Add a file or replace the file previously stored for the same path.
+	 */
+	void insert(const std::string & name, PakFile * file);
+	
+	//! \return the file stored for the given path or NULL.
+	PakFile * find(const std::string & name) const;
+	
+	void remove(const std::string & name);
+	
+	void clear();
+	
+	size_t size() const { return count; }
+	
+	static u64 hash(const std::string & name);
+	
+};
+
+#endif // ARX_IO_RESOURCE_PAKINDEX_H
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/resource/PakPrefetcher.h"
+
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+
+#include "io/resource/PakEntry.h"
+#include "platform/Thread.h"
+#include "platform/profiler/Profiler.h"
+
+class PakPrefetchPool::Worker : public Thread {
+	
+	PakPrefetchPool & owner;
+	
+	void run();
+	
+public:
+	
+	explicit Worker(PakPrefetchPool & _owner) : owner(_owner) { }
+	
+};
+
+void PakPrefetchPool::Worker::run() {
+	
+	for(;;) {
+		
+		owner.wake.wait();
+		
+		{
+			Autolock lock(owner.lock);
+			if(owner.stopping) {
+				break;
+			}
+		}
+		
+		// The queue may have been cleared since the file was added
+		const PakFile * file = owner.next();
+		if(!file) {
+			continue;
+		}
+		
+		{
+			ARX_PROFILE(PakPrefetch);
+			file->prefetch();
+		}
+		
+		owner.done();
+	}
+	
+}
+
+PakPrefetchPool::PakPrefetchPool(size_t count)
+	: busy(0), waiting(false), stopping(false) {
+	
+	if(count == 0) {
+		count = std::max(Thread::getCPUCount(), 2u) - 1;
+	}
+	
+	for(size_t i = 0; i < count; i++) {
+		Worker * worker = new Worker(*this);
+		worker->setThreadName("PAK prefetch");
+		worker->setPriority(Thread::Low);
+		worker->start();
+		workers.push_back(worker);
+	}
+	
+}
+
+PakPrefetchPool::~PakPrefetchPool() {
+	
+	clear();
+	
+	{
+		Autolock lock(this->lock);
+		stopping = true;
+	}
+	
+	wake.post(unsigned(workers.size()));
+	
+	BOOST_FOREACH(Worker * worker, workers) {
+		worker->waitForCompletion();
+		delete worker;
+	}
+}
+
+void PakPrefetchPool::add(const std::vector<const PakFile *> & files) {
+	
+	if(files.empty()) {
+		return;
+	}
+	
+	{
+		Autolock lock(this->lock);
+		queue.insert(queue.end(), files.begin(), files.end());
+	}
+	
+	wake.post(unsigned(files.size()));
+}
+
+void PakPrefetchPool::clear() {
+	
+	lock.lock();
+	
+	queue.clear();
+	
+	// Wait for files that are currently being decompressed.
+	if(busy) {
+		waiting = true;
+		lock.unlock();
+		idle.wait();
+	} else {
+		lock.unlock();
+	}
+}
+
+size_t PakPrefetchPool::getQueuedCount() {
+	
+	Autolock lock(this->lock);
+	
+	return queue.size() + busy;
+}
+
+const PakFile * PakPrefetchPool::next() {
+	
+	Autolock lock(this->lock);
+	
+	if(queue.empty()) {
+		return NULL;
+	}
+	
+	const PakFile * file = queue.front();
+	queue.pop_front();
+	busy++;
+	
+	return file;
+}
+
+void PakPrefetchPool::done() {
+	
+	Autolock lock(this->lock);
+	
+	arx_assert(busy > 0);
+	busy--;
+	
+	if(busy == 0 && waiting) {
+		waiting = false;
+		idle.post();
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_IO_RESOURCE_PAKPREFETCHER_H
+#define ARX_IO_RESOURCE_PAKPREFETCHER_H
+
+#include <stddef.h>
+#include <deque>
+#include <vector>
+
+#include "io/resource/PakReader.h"
+#include "platform/Lock.h"
+
+/*!
+ * Pool of worker threads that decompress .pak file entries into the resource cache.
+ *
+ * This lives outside of \ref PakReader so that tools using the resource code do not
+ * need the thread implementation.
+ */
+class PakPrefetchPool : public PakPrefetcher {
+	
+public:
+	
+	/*!
+	 * \param count Number of worker threads to use,
+	 *              or 0 to use one less than the number of processors.
+	 */
+	explicit PakPrefetchPool(size_t count = 0);
+	~PakPrefetchPool();
+	
+	void add(const std::vector<const PakFile *> & files);
+	
+	//! Must not be called from more than one thread at a time.
+	void clear();
+	
+	//! \return the number of files that are queued or being decompressed
+	size_t getQueuedCount();
+	
+private:
+	
+	class Worker;
+	friend class Worker;
+	
+	Lock lock;
+	Semaphore wake; //!< Posted for each queued file and for each worker when stopping
+	Semaphore idle; //!< Posted when the last busy file is done while clear() is waiting
+	
+	std::deque<const PakFile *> queue;
+	std::vector<Worker *> workers;
+	size_t busy;
+	bool waiting;
+	bool stopping;
+	
+	const PakFile * next();
+	void done();
+	
+};
+
+#endif // ARX_IO_RESOURCE_PAKPREFETCHER_H
@@ -33,12 +33,26 @@
 #include "io/fs/FilePath.h"
 #include "io/fs/Filesystem.h"
 #include "io/fs/FileStream.h"
+#include "io/fs/MappedFile.h"
+
+#include "platform/Lock.h"
 
 #include "util/String.h"
 
-namespace {
+/*! Stream for a .pak file archive that is shared by all the files it contains. */
+class PakArchiveStream : private boost::noncopyable {
+	
+public:
+	
+	fs::ifstream stream;
+	Lock lock; //!< Must be held while using the stream
+	
+	explicit PakArchiveStream(const fs::path & pakfile)
+		: stream(pakfile, fs::fstream::in | fs::fstream::binary) { }
+	
+};
 
-const size_t PAK_READ_BUF_SIZE = 1024;
+namespace {
 
 static PakReader::ReleaseType guessReleaseType(u32 first_bytes) {
 	switch(first_bytes) {
@@ -75,12 +89,12 @@ static void pakDecrypt(char * fat, size_t fat_size, PakReader::ReleaseType keyId
 /*! Uncompressed file in a .pak file archive. */
 class UncompressedFile : public PakFile {
 	
-	std::istream & archive;
+	PakArchiveStream & archive;
 	size_t offset;
 	
 public:
 	
-	explicit UncompressedFile(std::istream * _archive, size_t _offset, size_t size)
+	explicit UncompressedFile(PakArchiveStream * _archive, size_t _offset, size_t size)
 		: PakFile(size), archive(*_archive), offset(_offset) { }
 	
 	void read(void * buf) const;
@@ -113,14 +127,16 @@ public:
 
 void UncompressedFile::read(void * buf) const {
 	
-	archive.seekg(offset);
+	Autolock lock(archive.lock);
+	
+	archive.stream.seekg(offset);
 	
-	fs::read(archive, buf, size());
+	fs::read(archive.stream, buf, size());
 	
-	arx_assert(!archive.fail());
-	arx_assert(size_t(archive.gcount()) == size());
+	arx_assert(!archive.stream.fail());
+	arx_assert(size_t(archive.stream.gcount()) == size());
 	
-	archive.clear();
+	archive.stream.clear();
 }
 
 PakFileHandle * UncompressedFile::open() const {
@@ -133,18 +149,20 @@ size_t UncompressedFileHandle::read(void * buf, size_t size) {
 		return 0;
 	}
 	
-	file.archive.seekg(file.offset + offset);
+	Autolock lock(file.archive.lock);
+	
+	file.archive.stream.seekg(file.offset + offset);
 	
 	if(file.size() < offset + size) {
 		size = (offset > file.size()) ? 0 : (file.size() - offset);
 	}
 	
-	fs::read(file.archive, buf, size);
+	fs::read(file.archive.stream, buf, size);
 	
-	size_t nread = file.archive.gcount();
+	size_t nread = file.archive.stream.gcount();
 	offset += nread;
 	
-	file.archive.clear();
+	file.archive.stream.clear();
 	
 	return nread;
 }
@@ -172,35 +190,32 @@ size_t UncompressedFileHandle::tell() {
 	return offset;
 }
 
-/*! Compressed file in a .pak file archive. */
-class CompressedFile : public PakFile {
+/*! Uncompressed file in a memory-mapped .pak file archive. */
+class MappedFile : public PakFile {
 	
-	std::ifstream & archive;
-	size_t offset;
-	size_t storedSize;
+	const char * contents;
 	
 public:
 	
-	explicit CompressedFile(std::ifstream * _archive, size_t _offset, size_t size,
-	                        size_t _storedSize)
-		: PakFile(size), archive(*_archive), offset(_offset), storedSize(_storedSize) { }
+	explicit MappedFile(const char * _contents, size_t size)
+		: PakFile(size), contents(_contents) { }
 	
 	void read(void * buf) const;
 	
 	PakFileHandle * open() const;
 	
-	friend class CompressedFileHandle;
+	const char * data() const { return contents; }
 	
 };
 
-class CompressedFileHandle : public PakFileHandle {
+class MappedFileHandle : public PakFileHandle {
 	
-	const CompressedFile & file;
+	const MappedFile & file;
 	size_t offset;
 	
 public:
 	
-	explicit CompressedFileHandle(const CompressedFile * _file)
+	explicit MappedFileHandle(const MappedFile * _file)
 		: file(*_file), offset(0) { }
 	
 	size_t read(void * buf, size_t size);
@@ -209,135 +224,160 @@ public:
 	
 	size_t tell();
 	
-	~CompressedFileHandle() { }
+	~MappedFileHandle() { }
 	
 };
 
-struct BlastFileInBuffer : private boost::noncopyable {
-	
-	std::ifstream & file;
-	size_t remaining;
-	
-	unsigned char readbuf[PAK_READ_BUF_SIZE];
-	
-	explicit BlastFileInBuffer(std::ifstream * f, size_t count)
-		: file(*f), remaining(count) { }
-	
-};
+void MappedFile::read(void * buf) const {
+	memcpy(buf, contents, size());
+}
 
-size_t blastInFile(void * Param, const unsigned char ** buf) {
+PakFileHandle * MappedFile::open() const {
+	return new MappedFileHandle(this);
+}
+
+size_t MappedFileHandle::read(void * buf, size_t size) {
 	
-	BlastFileInBuffer * p = (BlastFileInBuffer *)Param;
+	if(offset >= file.size()) {
+		return 0;
+	}
+	
+	size = std::min(size, file.size() - offset);
 	
-	*buf = p->readbuf;
+	memcpy(buf, file.data() + offset, size);
 	
-	size_t count = std::min(p->remaining, ARRAY_SIZE(p->readbuf));
-	p->remaining -= count;
+	offset += size;
 	
-	return fs::read(p->file, p->readbuf, count).gcount();
+	return size;
 }
 
-void CompressedFile::read(void * buf) const {
+int MappedFileHandle::seek(Whence whence, int _offset) {
 	
-	archive.seekg(offset);
-	
-	BlastFileInBuffer in(&archive, storedSize);
-	BlastMemOutBuffer out(reinterpret_cast<char *>(buf), size());
+	size_t base;
+	switch(whence) {
+		case SeekSet: base = 0; break;
+		case SeekEnd: base = file.size(); break;
+		case SeekCur: base = offset; break;
+		default: return -1;
+	}
 	
-	int r = blast(blastInFile, &in, blastOutMem, &out);
-	if(r) {
-		LogError << "Blast error " << r << " outSize=" << size();
+	if((int)base + _offset < 0) {
+		return -1;
 	}
 	
-	arx_assert(!archive.fail());
-	arx_assert(in.remaining == 0);
-	arx_assert(out.size == 0);
+	offset = (int)base + _offset;
 	
-	archive.clear();
+	return offset;
 }
 
-PakFileHandle * CompressedFile::open() const {
-	return new CompressedFileHandle(this);
+size_t MappedFileHandle::tell() {
+	return offset;
 }
 
-struct BlastMemOutBufferOffset {
-	char * buf;
-	size_t currentOffset;
-	size_t startOffset;
-	size_t endOffset;
+/*!
+ * Compressed file in a .pak file archive.
+ *
+ * Decompressed contents are kept in the resource cache.
+ */
+class CompressedFile : public PakFile {
+	
+	PakCache & cache;
+	
+protected:
+	
+	explicit CompressedFile(PakCache & _cache, size_t size)
+		: PakFile(size), cache(_cache) { }
+	
+	//! Decompress the whole file, bypassing the cache.
+	virtual bool decompress(void * buf) const = 0;
+	
+public:
+	
+	void read(void * buf) const;
+	
+	void prefetch() const;
+	
+	PakFileHandle * open() const;
+	
 };
 
-int blastOutMemOffset(void * Param, unsigned char * buf, size_t len) {
-	
-	BlastMemOutBufferOffset * p = (BlastMemOutBufferOffset *)Param;
+/*!
+ * Handle for a compressed file.
+ *
+ * The whole file is decompressed on the first read so that seeking is cheap.
+ */
+class CompressedFileHandle : public PakFileHandle {
 	
-	arx_assert(p->currentOffset <= p->endOffset);
+	const CompressedFile & file;
+	size_t offset;
+	char * contents;
 	
-	if(p->currentOffset == p->endOffset) {
-		return 1;
-	}
+public:
 	
-	if(p->currentOffset < p->startOffset) {
-		size_t toStart = p->startOffset - p->currentOffset;
-		if(len <= toStart) {
-			p->currentOffset += len;
-			return 0;
-		} else {
-			p->currentOffset = p->startOffset;
-			buf += toStart;
-			len -= toStart;
-		}
-	}
+	explicit CompressedFileHandle(const CompressedFile * _file)
+		: file(*_file), offset(0), contents(NULL) { }
 	
-	size_t toCopy = std::min(len, p->endOffset - p->currentOffset);
+	size_t read(void * buf, size_t size);
 	
-	arx_assert(toCopy != 0);
+	int seek(Whence whence, int offset);
 	
-	memcpy(p->buf, buf, toCopy);
+	size_t tell();
 	
-	p->currentOffset += toCopy;
-	p->buf += toCopy;
+	~CompressedFileHandle() {
+		free(contents);
+	}
 	
-	return 0;
-}
+};
 
-size_t CompressedFileHandle::read(void * buf, size_t size) {
+void CompressedFile::read(void * buf) const {
 	
-	if(offset >= file.size()) {
-		return 0;
+	if(cache.read(this, buf)) {
+		return;
 	}
 	
-	if(size < file.size() || offset != 0) {
-		LogWarning << "Partially reading a compressed file - inefficent: size=" << size
-		           << " offset=" << offset << " total=" << file.size();
+	if(!decompress(buf)) {
+		return;
 	}
 	
-	file.archive.seekg(file.offset);
+	char * copy = (char *)malloc(size());
+	memcpy(copy, buf, size());
+	cache.insert(this, copy, size());
+}
+
+void CompressedFile::prefetch() const {
 	
-	BlastFileInBuffer in(&file.archive, file.storedSize);
-	BlastMemOutBufferOffset out;
+	if(cache.contains(this)) {
+		return;
+	}
+	
+	char * contents = (char *)malloc(size());
+	if(!decompress(contents)) {
+		free(contents);
+		return;
+	}
 	
-	out.buf = reinterpret_cast<char *>(buf);
-	out.currentOffset = 0;
-	out.startOffset = offset;
-	out.endOffset = std::min(offset + size, file.size());
+	cache.insert(this, contents, size());
+}
+
+PakFileHandle * CompressedFile::open() const {
+	return new CompressedFileHandle(this);
+}
+
+size_t CompressedFileHandle::read(void * buf, size_t size) {
 	
-	if(out.endOffset <= out.startOffset) {
+	if(offset >= file.size()) {
 		return 0;
 	}
 	
-	// TODO this is really inefficient
-	int r = ::blast(blastInFile, &in, blastOutMemOffset, &out);
-	if(r && (r != 1 || (size == file.size() && offset == 0))) {
-		LogError << "PakReader::fRead: blast error " << r << " outSize=" << file.size();
-		return 0;
+	if(!contents) {
+		contents = file.readAlloc();
 	}
 	
-	size = out.currentOffset - out.startOffset;
+	size = std::min(size, file.size() - offset);
 	
-	offset += size;
+	memcpy(buf, contents + offset, size);
 	
-	file.archive.clear();
+	offset += size;
 	
 	return size;
 }
@@ -365,6 +405,89 @@ size_t CompressedFileHandle::tell() {
 	return offset;
 }
 
+//! Decompress a whole file entry and log errors.
+static bool blastFile(const char * from, size_t storedSize, void * buf, size_t size) {
+	
+	BlastMemOutBuffer out(reinterpret_cast<char *>(buf), size);
+	
+	BlastResult error = blastBuffer(from, storedSize, out);
+	if(error) {
+		LogError << "Error decompressing file: blast error " << error << " for "
+		         << storedSize << " -> " << size;
+		return false;
+	}
+	
+	if(out.size != 0) {
+		LogError << "Error decompressing file: got " << (size - out.size) << " of "
+		         << size << " bytes";
+		return false;
+	}
+	
+	return true;
+}
+
+/*! Compressed file in a .pak file archive accessed through a stream. */
+class StreamCompressedFile : public CompressedFile {
+	
+	PakArchiveStream & archive;
+	size_t offset;
+	size_t storedSize;
+	
+	bool decompress(void * buf) const;
+	
+public:
+	
+	explicit StreamCompressedFile(PakArchiveStream * _archive, PakCache & cache,
+	                              size_t _offset, size_t size, size_t _storedSize)
+		: CompressedFile(cache, size), archive(*_archive), offset(_offset),
+		  storedSize(_storedSize) { }
+	
+};
+
+bool StreamCompressedFile::decompress(void * buf) const {
+	
+	std::vector<char> compressed(storedSize);
+	
+	{
+		Autolock lock(archive.lock);
+		
+		archive.stream.seekg(offset);
+		
+		fs::read(archive.stream, &compressed[0], storedSize);
+		
+		bool failed = archive.stream.fail();
+		
+		archive.stream.clear();
+		
+		if(failed) {
+			LogError << "Error reading compressed file at " << offset << " size=" << storedSize;
+			return false;
+		}
+	}
+	
+	return blastFile(&compressed[0], storedSize, buf, size());
+}
+
+/*! Compressed file in a memory-mapped .pak file archive. */
+class MappedCompressedFile : public CompressedFile {
+	
+	const char * contents;
+	size_t storedSize;
+	
+	bool decompress(void * buf) const;
+	
+public:
+	
+	explicit MappedCompressedFile(const char * _contents, PakCache & cache, size_t size,
+	                              size_t _storedSize)
+		: CompressedFile(cache, size), contents(_contents), storedSize(_storedSize) { }
+	
+};
+
+bool MappedCompressedFile::decompress(void * buf) const {
+	return blastFile(contents, storedSize, buf, size());
+}
+
 /*! Plain file not in a .pak file archive. */
 class PlainFile : public PakFile {
 	
@@ -434,48 +557,109 @@ size_t PlainFileHandle::tell() {
 	return ifs.tellg();
 }
 
-} // anonymous namespace
-
-PakReader::~PakReader() {
-	clear();
-}
+//! Read the (still encrypted) FAT from an archive stream.
+static char * readFat(std::istream & ifs, const fs::path & pakfile, u32 & fat_size) {
 
-bool PakReader::addArchive(const fs::path & pakfile) {
+	// Read fat location and size.
+	u32 fat_offset;
 	
-	fs::ifstream * ifs = new fs::ifstream(pakfile, fs::fstream::in | fs::fstream::binary);
+	if(fs::read(ifs, fat_offset).fail()) {
+		LogError << pakfile << ": error reading FAT offset";
+		return NULL;
+	}
+	if(ifs.seekg(fat_offset).fail()) {
+		LogError << pakfile << ": error seeking to FAT offset " << fat_offset;
+		return NULL;
+	}
+	if(fs::read(ifs, fat_size).fail()) {
+		LogError << pakfile << ": error reading FAT size at offset " << fat_offset;
+		return NULL;
+	}
 	
-	if(!ifs->is_open()) {
-		delete ifs;
-		return false;
+	// Read the whole FAT.
+	char * fat = new char[fat_size];
+	if(ifs.read(fat, fat_size).fail()) {
+		LogError << pakfile << ": error reading FAT at " << fat_offset
+		         << " with size " << fat_size;
+		delete[] fat;
+		return NULL;
 	}
 	
+	return fat;
+}
+
+//! Copy the (still encrypted) FAT out of a memory-mapped archive.
+static char * readFat(const fs::mapped_file & mapping, const fs::path & pakfile,
+                      u32 & fat_size) {
+	
+	const char * pos = mapping.data();
+	size_t size = mapping.size();
+	
 	// Read fat location and size.
 	u32 fat_offset;
-	u32 fat_size;
 	
-	if(fs::read(*ifs, fat_offset).fail()) {
+	if(!util::safeGet(fat_offset, pos, size)) {
 		LogError << pakfile << ": error reading FAT offset";
-		delete ifs;
-		return false;
+		return NULL;
 	}
-	if(ifs->seekg(fat_offset).fail()) {
+	if(fat_offset > mapping.size()) {
 		LogError << pakfile << ": error seeking to FAT offset " << fat_offset;
-		delete ifs;
-		return false;
+		return NULL;
 	}
-	if(fs::read(*ifs, fat_size).fail()) {
+	pos = mapping.data() + fat_offset, size = mapping.size() - fat_offset;
+	if(!util::safeGet(fat_size, pos, size)) {
 		LogError << pakfile << ": error reading FAT size at offset " << fat_offset;
-		delete ifs;
-		return false;
+		return NULL;
 	}
 	
-	// Read the whole FAT.
-	char * fat = new char[fat_size];
-	if(ifs->read(fat, fat_size).fail()) {
+	// Copy the whole FAT as it needs to be decrypted in place.
+	if(fat_size > size) {
 		LogError << pakfile << ": error reading FAT at " << fat_offset
 		         << " with size " << fat_size;
-		delete[] fat;
-		delete ifs;
+		return NULL;
+	}
+	char * fat = new char[fat_size];
+	memcpy(fat, pos, fat_size);
+	
+	return fat;
+}
+
+static std::string joinPath(const res::path & dir, const std::string & name) {
+	return dir.empty() ? name : dir.string() + res::path::dir_sep + name;
+}
+
+#ifdef ARX_DEBUG
+static const char BADPATHCHAR[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ\\";
+#endif
+
+} // anonymous namespace
+
+PakReader::~PakReader() {
+	clear();
+}
+
+bool PakReader::addArchive(const fs::path & pakfile) {
+	
+	fs::mapped_file * mapping = new fs::mapped_file(pakfile);
+	PakArchiveStream * archive = NULL;
+	
+	u32 fat_size;
+	char * fat;
+	if(mapping->is_open()) {
+		fat = readFat(*mapping, pakfile, fat_size);
+	} else {
+		delete mapping, mapping = NULL;
+		archive = new PakArchiveStream(pakfile);
+		if(!archive->stream.is_open()) {
+			delete archive;
+			return false;
+		}
+		fat = readFat(archive->stream, pakfile, fat_size);
+	}
+	
+	if(!fat) {
+		delete mapping;
+		delete archive;
 		return false;
 	}
 	
@@ -491,7 +675,11 @@ bool PakReader::addArchive(const fs::path & pakfile) {
 	
 	char * pos = fat;
 	
-	paks.push_back(ifs);
+	if(mapping) {
+		mappings.push_back(mapping);
+	} else {
+		paks.push_back(archive);
+	}
 	
 	while(fat_size) {
 		
@@ -501,7 +689,8 @@ bool PakReader::addArchive(const fs::path & pakfile) {
 			goto error;
 		}
 		
-		PakDirectory * dir = addDirectory(res::path::load(dirname));
+		res::path dirpath = res::path::load(dirname);
+		PakDirectory * dir = addDirectory(dirpath);
 		
 		u32 nfiles;
 		if(!util::safeGet(nfiles, pos, fat_size)) {
@@ -532,14 +721,31 @@ bool PakReader::addArchive(const fs::path & pakfile) {
 			}
 			
 			const u32 PAK_FILE_COMPRESSED = 1;
+			bool compressed = (flags & PAK_FILE_COMPRESSED) && size != 0;
 			PakFile * file;
-			if((flags & PAK_FILE_COMPRESSED) && size != 0) {
-				file = new CompressedFile(ifs, offset, uncompressedSize, size);
+			if(mapping) {
+				if(u64(offset) + u64(size) > u64(mapping->size())) {
+					LogError << pakfile << ": file data out of bounds: " << dirpath << '/'
+					         << filename;
+					goto error;
+				}
+				const char * contents = mapping->data() + offset;
+				if(compressed) {
+					file = new MappedCompressedFile(contents, cache, uncompressedSize, size);
+				} else {
+					file = new MappedFile(contents, size);
+				}
 			} else {
-				file = new UncompressedFile(ifs, offset, size);
+				if(compressed) {
+					file = new StreamCompressedFile(archive, cache, offset, uncompressedSize, size);
+				} else {
+					file = new UncompressedFile(archive, offset, size);
+				}
 			}
 			
-			dir->addFile(std::string(filename, len), file);
+			std::string name(filename, len);
+			dir->addFile(name, file);
+			index.insert(joinPath(dirpath, name), file);
 		}
 		
 	}
@@ -561,12 +767,36 @@ void PakReader::clear() {
 	
 	release = 0;
 	
+	if(prefetcher) {
+		prefetcher->clear();
+	}
+	cache.clear();
+	
+	index.clear();
 	files.clear();
 	dirs.clear();
 	
-	BOOST_FOREACH(std::istream * is, paks) {
-		delete is;
+	BOOST_FOREACH(PakArchiveStream * archive, paks) {
+		delete archive;
 	}
+	paks.clear();
+	
+	BOOST_FOREACH(fs::mapped_file * mapping, mappings) {
+		delete mapping;
+	}
+	mappings.clear();
+}
+
+PakFile * PakReader::getFile(const res::path & path) {
+	
+	arx_assert(path.string().find_first_of(BADPATHCHAR) == std::string::npos,
+	           "bad pak path: \"%s\"", path.string().c_str());
+	
+	if(path.is_up()) {
+		LogWarning << "Bad path: " << path;
+	}
+	
+	return index.find(path.string());
 }
 
 bool PakReader::read(const res::path & name, void * buf) {
@@ -603,11 +833,38 @@ PakFileHandle * PakReader::open(const res::path & name) {
 	return f->open();
 }
 
+void PakReader::prefetch(const std::vector<res::path> & names) {
+	
+	if(!prefetcher) {
+		return;
+	}
+	
+	std::vector<const PakFile *> files;
+	files.reserve(names.size());
+	
+	BOOST_FOREACH(const res::path & name, names) {
+		if(const PakFile * f = getFile(name)) {
+			files.push_back(f);
+		}
+	}
+	
+	prefetcher->add(files);
+}
+
+void PakReader::setPrefetcher(PakPrefetcher * newPrefetcher) {
+	
+	if(prefetcher) {
+		prefetcher->clear();
+	}
+	
+	prefetcher = newPrefetcher;
+}
+
 bool PakReader::addFiles(const fs::path & path, const res::path & mount) {
 	
 	if(fs::is_directory(path)) {
 			
-		bool ret = addFiles(addDirectory(mount), path);
+		bool ret = addFiles(addDirectory(mount), path, mount);
 	
 		if(ret) {
 			LogInfo << "Added dir " << path;
@@ -619,7 +876,7 @@ bool PakReader::addFiles(const fs::path & path, const res::path & mount) {
 		
 		PakDirectory * dir = addDirectory(mount.parent());
 		
-		return addFile(dir, path, mount.filename());
+		return addFile(dir, path, mount.parent(), mount.filename());
 		
 	}
 	
@@ -630,7 +887,16 @@ void PakReader::removeFile(const res::path & file) {
 	
 	PakDirectory * dir = getDirectory(file.parent());
 	if(dir) {
+		if(PakFile * f = index.find(file.string())) {
+			if(prefetcher) {
+				prefetcher->clear();
+			}
+			for(; f; f = f->alternative()) {
+				cache.remove(f);
+			}
+		}
 		dir->removeFile(file.filename());
+		index.remove(file.string());
 	}
 }
 
@@ -645,7 +911,7 @@ bool PakReader::removeDirectory(const res::path & name) {
 }
 
 bool PakReader::addFile(PakDirectory * dir, const fs::path & path,
-                        const std::string & name) {
+                        const res::path & mount, const std::string & name) {
 	
 	if(name.empty()) {
 		return false;
@@ -656,11 +922,14 @@ bool PakReader::addFile(PakDirectory * dir, const fs::path & path,
 		return false;
 	}
 	
-	dir->addFile(name, new PlainFile(path, size));
+	PakFile * file = new PlainFile(path, size);
+	dir->addFile(name, file);
+	index.insert(joinPath(mount, name), file);
 	return true;
 }
 
-bool PakReader::addFiles(PakDirectory * dir, const fs::path & path) {
+bool PakReader::addFiles(PakDirectory * dir, const fs::path & path,
+                         const res::path & mount) {
 	
 	bool ret = true;
 	
@@ -678,9 +947,9 @@ bool PakReader::addFiles(PakDirectory * dir, const fs::path & path) {
 		boost::to_lower(name);
 		
 		if(it.is_directory()) {
-			ret &= addFiles(dir->addDirectory(name), entry);
+			ret &= addFiles(dir->addDirectory(name), entry, joinPath(mount, name));
 		} else if(it.is_regular_file()) {
-			ret &= addFile(dir, entry, name);
+			ret &= addFile(dir, entry, mount, name);
 		}
 		
 	}
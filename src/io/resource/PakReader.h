@@ -25,11 +25,14 @@
 
 #include <boost/noncopyable.hpp>
 
+#include "io/resource/PakCache.h"
 #include "io/resource/PakEntry.h"
+#include "io/resource/PakIndex.h"
 #include "io/resource/ResourcePath.h"
 #include "platform/Flags.h"
 
-namespace fs { class path; }
+namespace fs { class path; class mapped_file; }
+class PakArchiveStream;
 
 enum Whence {
 	SeekSet,
@@ -51,6 +54,23 @@ public:
 	
 };
 
+/*!
+ * Interface for decompressing files in the background, see \ref PakReader::prefetch().
+ */
+class PakPrefetcher : private boost::noncopyable {
+	
+public:
+	
+	//! Queue files to be decompressed into the cache using \ref PakFile::prefetch().
+	virtual void add(const std::vector<const PakFile *> & files) = 0;
+	
+	//! Drop all queued files and wait for files that are currently being decompressed.
+	virtual void clear() = 0;
+	
+	virtual ~PakPrefetcher() { }
+	
+};
+
 class PakReader : public PakDirectory {
 	
 public:
@@ -62,7 +82,7 @@ public:
 	};
 	DECLARE_FLAGS(ReleaseType, ReleaseFlags)
 	
-	inline PakReader() : release(0) { }
+	inline PakReader() : release(0), prefetcher(NULL) { }
 	~PakReader();
 	
 	void removeFile(const res::path & name);
@@ -87,23 +107,65 @@ public:
 	 */
 	bool addFiles(const fs::path & path, const res::path & mount = res::path());
 	
+	/*!
+	 * Add the contents of a .pak archive.
+	 *
+	 * The archive is memory-mapped if possible so that uncompressed files can be
+	 * accessed without copying, see \ref PakFile::data().
+	 */
 	bool addArchive(const fs::path & pakfile);
 	void clear();
 	
+	/*!
+	 * Get a file using the flat path index instead of walking the directory tree.
+	 * Hides \ref PakDirectory::getFile().
+	 */
+	PakFile * getFile(const res::path & path);
+	
+	inline bool hasFile(const res::path & path) {
+		return getFile(path) != NULL;
+	}
+	
 	bool read(const res::path & name, void * buf);
 	char * readAlloc(const res::path & name , size_t & size);
 	
 	PakFileHandle * open(const res::path & name);
 	
+	/*!
+	 * Decompress files in the background so that they can later be read from the cache.
+	 *
+	 * Missing files are ignored. This only queues the files and returns immediately.
+	 * Does nothing if no prefetcher has been set.
+	 */
+	void prefetch(const std::vector<res::path> & names);
+	
+	/*!
+	 * Set the prefetcher used by \ref prefetch().
+	 *
+	 * The prefetcher is not owned by the PakReader and must be cleared or reset
+	 * before the PakReader is destroyed.
+	 */
+	void setPrefetcher(PakPrefetcher * prefetcher);
+	
+	//! Cache of decompressed file contents, shared by all compressed files.
+	inline PakCache & getCache() { return cache; }
+	
 	inline ReleaseFlags getReleaseType() { return release; }
 	
 private:
 	
 	ReleaseFlags release;
-	std::vector<std::istream *> paks;
+	std::vector<PakArchiveStream *> paks;
+	std::vector<fs::mapped_file *> mappings;
+	
+	PakIndex index;
+	
+	PakCache cache;
+	PakPrefetcher * prefetcher;
 	
-	bool addFiles(PakDirectory * dir, const fs::path & path);
-	bool addFile(PakDirectory * dir, const fs::path & path, const std::string & name);
+	bool addFiles(PakDirectory * dir, const fs::path & path, const res::path & mount);
+	bool addFile(PakDirectory * dir, const fs::path & path, const res::path & mount,
+	             const std::string & name);
 	
 };
 
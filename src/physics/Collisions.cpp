@@ -46,6 +46,8 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "physics/Collisions.h"
 
+#include <glm/gtx/norm.hpp>
+
 #include "core/GameTime.h"
 #include "core/Core.h"
 #include "game/Damage.h"
@@ -468,6 +470,19 @@ static bool CollidedFromBack(Entity * io,Entity * ioo) {
 	return false;
 }
 
+// Number of entities checked against collision queries in the current and in the last frame
+static long g_collisionTests = 0;
+static long g_collisionTestsLastFrame = 0;
+
+void ARX_COLLISION_NewFrame() {
+	g_collisionTestsLastFrame = g_collisionTests;
+	g_collisionTests = 0;
+}
+
+long ARX_COLLISION_GetTestCount() {
+	return g_collisionTestsLastFrame;
+}
+
 // Returns 0 if nothing in cyl
 // Else returns Y Offset to put cylinder in a proper place
 float CheckAnythingInCylinder(const Cylinder & cyl, Entity * ioo, long flags) {
@@ -552,8 +567,17 @@ float CheckAnythingInCylinder(const Cylinder & cyl, Entity * ioo, long flags) {
 			FULL_TEST = 1;
 			AMOUNT = entities.size();
 		}
+		
+		std::vector<long> nearby;
+		if(!FULL_TEST) {
+			TREATZONE_GetNearbyIO(cyl.origin, 1000.f, nearby);
+			AMOUNT = nearby.size();
+		}
+		
+		g_collisionTests += AMOUNT;
 
-		for(long i = 0; i < AMOUNT; i++) {
+		for(long n = 0; n < AMOUNT; n++) {
+			long i = FULL_TEST ? n : nearby[n];
 			const EntityHandle handle = EntityHandle(i);
 			
 			if(FULL_TEST) {
@@ -841,10 +865,22 @@ bool CheckEverythingInSphere(const Sphere & sphere, long source, EntityHandle ta
 	float sr30 = sphere.radius + 20.f;
 	float sr40 = sphere.radius + 30.f;
 	float sr180 = sphere.radius + 500.f;
+	
+	// Entities farther than sr180 can only be hit as platforms, which reach 440 + radius
+	std::vector<long> nearby;
+	if(ValidIONum(targ)) {
+		if(TREATZONE_CUR > 0) {
+			nearby.push_back(0);
+		}
+	} else {
+		TREATZONE_GetNearbyIO(sphere.origin, sr180, nearby);
+	}
+	
+	g_collisionTests += nearby.size();
 
-	for(long i = 0; i < TREATZONE_CUR; i++) {
+	for(size_t n = 0; n < nearby.size(); n++) {
+		long i = nearby[n];
 		if(ValidIONum(targ)) {
-			i = TREATZONE_CUR;
 			io = entities[targ];
 
 			if(!io
@@ -1046,8 +1082,15 @@ bool CheckAnythingInSphere(const Sphere & sphere, EntityHandle source, CASFlags
 	float sr30 = sphere.radius + 20.f;
 	float sr40 = sphere.radius + 30.f;
 	float sr180 = sphere.radius + 500.f;
+	
+	// Entities farther than sr180 can only be hit as platforms, which reach 440 + radius
+	std::vector<long> nearby;
+	TREATZONE_GetNearbyIO(sphere.origin, sr180, nearby);
+	
+	g_collisionTests += nearby.size();
 
-	for(long i = 0; i < TREATZONE_CUR; i++) {
+	for(size_t n = 0; n < nearby.size(); n++) {
+		long i = nearby[n];
 		
 		if(treatio[i].show != 1 || !treatio[i].io || treatio[i].num == source)
 			continue;
@@ -1561,120 +1604,61 @@ bool IO_Visible(const Vec3f & orgn, const Vec3f & dest, Vec3f * hit)
 {
 	ARX_PROFILE_FUNC();
 	
-	Vec3f i;
-	float pas = 35.f;
-
-	Vec3f found_hit = Vec3f_ZERO;
-	EERIEPOLY *found_ep = NULL;
-	float iter;
-	
-	//current ray pos
-	Vec3f tmpPos = orgn;
+	RaycastBenchmarkRecord(orgn, dest);
 	
-	float distance;
-	float nearest = distance = fdist(orgn, dest);
-
-	if(distance < pas)
-		pas = distance * .5f;
-
-	// ray incs
-	Vec3f d = dest - orgn;
+	Vec3f polyHit;
+	bool blocked = RaycastBackground(orgn, dest, polyHit, POLY_WATER | POLY_TRANS | POLY_NOCOL);
 	
-	// absolute ray incs
-	Vec3f ad = glm::abs(d);
+	float distance = fdist(orgn, dest);
+	float nearest = blocked ? fdist(orgn, polyHit) : distance;
 	
-	if(ad.x >= ad.y && ad.x >= ad.z) {
-		if(ad.x != d.x)
-			i.x = -pas;
-		else
-			i.x = pas;
-
-		iter = ad.x / pas;
-		float t = 1.f / (iter);
-		i.y = d.y * t;
-		i.z = d.z * t;
-	} else if(ad.y >= ad.x && ad.y >= ad.z) {
-		if(ad.y != d.y)
-			i.y = -pas;
-		else
-			i.y = pas;
-
-		iter = ad.y / pas;
-		float t = 1.f / (iter);
-		i.x = d.x * t;
-		i.z = d.z * t;
-	} else {
-		if(ad.z != d.z)
-			i.z = -pas;
-		else
-			i.z = pas;
-
-		iter = ad.z / pas;
-		float t = 1.f / (iter);
-		i.x = d.x * t;
-		i.y = d.y * t;
-	}
+	Vec3f d = dest - orgn;
 	
-	tmpPos.x -= i.x;
-	tmpPos.y -= i.y;
-	tmpPos.z -= i.z;
-
-	while(iter > 0.f) {
-		iter -= 1.f;
-		tmpPos.x += i.x;
-		tmpPos.y += i.y;
-		tmpPos.z += i.z;
-
-		Sphere sphere = Sphere(tmpPos, 65.f);
-		
+	// CheckIOInSphere() ignores entities farther than 565 from the sphere center,
+	// so only view blockers near the ray need to be tested at each step
+	float pas = std::min(35.f, distance * .5f);
+	std::vector<Entity *> blockers;
+	{
+		float range = 65.f + 500.f + pas;
+		float len2 = glm::length2(d);
 		for(size_t num = 0; num < entities.size(); num++) {
 			const EntityHandle handle = EntityHandle(num);
 			Entity * io = entities[handle];
-
-			if(io && (io->gameFlags & GFLAG_VIEW_BLOCKER)) {
-				if(CheckIOInSphere(sphere, *io)) {
-					float dd = fdist(orgn, sphere.origin);
-
-					if(dd < nearest) {
-						hit->x=tmpPos.x;
-						hit->y=tmpPos.y;
-						hit->z=tmpPos.z;
-						return false;
-					}
-				}
+			
+			if(!io || !(io->gameFlags & GFLAG_VIEW_BLOCKER)) {
+				continue;
+			}
+			
+			float t = (len2 > 0.f) ? glm::clamp(glm::dot(io->pos - orgn, d) / len2, 0.f, 1.f) : 0.f;
+			if(closerThan(io->pos, orgn + d * t, range)) {
+				blockers.push_back(io);
 			}
 		}
-
-		long px = (long)(tmpPos.x * ACTIVEBKG->Xmul);
-		long pz = (long)(tmpPos.z * ACTIVEBKG->Zmul);
-
-		if(px < 0 || px >= ACTIVEBKG->Xsize || pz < 0 || pz >= ACTIVEBKG->Zsize)
-			break;
-
-		EERIE_BKG_INFO * eg = &ACTIVEBKG->fastdata[px][pz];
-
-		for(long k = 0; k < eg->nbpolyin; k++) {
-			EERIEPOLY * ep = eg->polyin[k];
-
-			if(!(ep->type & (POLY_WATER | POLY_TRANS | POLY_NOCOL)))
-			if((ep->min.y - pas < tmpPos.y) && (ep->max.y + pas > tmpPos.y))
-			if((ep->min.x - pas < tmpPos.x) && (ep->max.x + pas > tmpPos.x))
-			if((ep->min.z - pas < tmpPos.z) && (ep->max.z + pas > tmpPos.z))
-			if(RayCollidingPoly(orgn, dest, *ep, hit)) {
-				float dd = fdist(orgn, *hit);
-				if(dd < nearest) {
-					nearest = dd;
-					found_ep = ep;
-					found_hit = *hit;
+	}
+	
+	// View blockers in front of the nearest background hit
+	if(!blockers.empty() && pas > 0.f) {
+		Vec3f step = d * (pas / distance);
+		Vec3f pos = orgn;
+		for(float dd = 0.f; dd < nearest; dd += pas, pos += step) {
+			
+			Sphere sphere = Sphere(pos, 65.f);
+			
+			g_collisionTests += blockers.size();
+			
+			for(size_t num = 0; num < blockers.size(); num++) {
+				if(CheckIOInSphere(sphere, *blockers[num])) {
+					*hit = pos;
+					return false;
 				}
 			}
 		}
 	}
 	
-	if(!found_ep)
+	if(!blocked)
 		return true;
 	
-	*hit = found_hit;
+	*hit = polyHit;
 
 	return false;
 }
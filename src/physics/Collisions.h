@@ -82,6 +82,11 @@ extern size_t EXCEPTIONS_LIST_Pos;
 extern short EXCEPTIONS_LIST[MAX_IN_SPHERE + 1];
 extern bool DIRECT_PATH;
 
+//! Start counting the entities tested by collision queries for a new frame
+void ARX_COLLISION_NewFrame();
+//! \return the number of entities tested by collision queries in the last frame
+long ARX_COLLISION_GetTestCount();
+
 bool ARX_COLLISION_Move_Cylinder(IO_PHYSICS * ip, Entity * io, float MOVE_CYLINDER_STEP, CollisionFlags flags = 0);
 float CheckAnythingInCylinder(const Cylinder & cyl, Entity * ioo, long flags = 0);
 
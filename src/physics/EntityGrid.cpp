@@ -0,0 +1,97 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "physics/EntityGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+EntityGrid::EntityGrid(float cellSize)
+	: m_cellSize(cellSize), m_count(0), m_query(0) {
+	std::memset(m_visited, 0, sizeof(m_visited));
+}
+
+void EntityGrid::clear() {
+	
+	if(m_count == 0) {
+		return;
+	}
+	
+	for(size_t i = 0; i < BucketCount; i++) {
+		m_buckets[i].clear();
+	}
+	
+	m_count = 0;
+}
+
+long EntityGrid::getCell(float coord) const {
+	return long(std::floor(coord / m_cellSize));
+}
+
+size_t EntityGrid::getBucket(long x, long z) {
+	u32 hash = u32(x) * 73856093u ^ u32(z) * 19349663u;
+	return hash % BucketCount;
+}
+
+void EntityGrid::insert(long index, const Vec3f & pos) {
+	m_buckets[getBucket(getCell(pos.x), getCell(pos.z))].push_back(index);
+	m_count++;
+}
+
+void EntityGrid::query(const Vec3f & pos, float radius, std::vector<long> & result) const {
+	
+	if(m_count == 0) {
+		return;
+	}
+	
+	size_t start = result.size();
+	
+	long x0 = getCell(pos.x - radius);
+	long x1 = getCell(pos.x + radius);
+	long z0 = getCell(pos.z - radius);
+	long z1 = getCell(pos.z + radius);
+	
+	if(size_t(x1 - x0 + 1) * size_t(z1 - z0 + 1) >= BucketCount) {
+		// The query area covers more cells than there are buckets
+		for(size_t i = 0; i < BucketCount; i++) {
+			result.insert(result.end(), m_buckets[i].begin(), m_buckets[i].end());
+		}
+	} else {
+		
+		if(++m_query == 0) {
+			std::memset(m_visited, 0, sizeof(m_visited));
+			m_query = 1;
+		}
+		
+		for(long z = z0; z <= z1; z++) {
+			for(long x = x0; x <= x1; x++) {
+				size_t bucket = getBucket(x, z);
+				if(m_visited[bucket] == m_query) {
+					continue;
+				}
+				m_visited[bucket] = m_query;
+				result.insert(result.end(), m_buckets[bucket].begin(), m_buckets[bucket].end());
+			}
+		}
+		
+	}
+	
+	std::sort(result.begin() + start, result.end());
+}
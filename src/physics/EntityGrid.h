@@ -0,0 +1,75 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_PHYSICS_ENTITYGRID_H
+#define ARX_PHYSICS_ENTITYGRID_H
+
+#include <stddef.h>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "math/Types.h"
+#include "platform/Platform.h"
+
+/*!
+ * Uniform spatial hash of entity positions in the x/z plane.
+ *
+ * Used as a broad phase for collision queries: entries are identified by an
+ * index chosen by the caller, and queries return all entries that may be
+ * within a given horizontal distance of a position, plus possibly some that
+ * are farther away.
+ */
+class EntityGrid : private boost::noncopyable {
+	
+public:
+	
+	explicit EntityGrid(float cellSize);
+	
+	void clear();
+	
+	void insert(long index, const Vec3f & pos);
+	
+	/*!
+	 * Append the indices of entries that may be within radius of pos in the x/z plane.
+	 * The appended indices are sorted in increasing order.
+	 */
+	void query(const Vec3f & pos, float radius, std::vector<long> & result) const;
+	
+	size_t size() const { return m_count; }
+	
+private:
+	
+	static const size_t BucketCount = 1024;
+	
+	float m_cellSize;
+	size_t m_count;
+	
+	std::vector<long> m_buckets[BucketCount];
+	
+	//! Query number in which each bucket was last visited, to skip hash collisions
+	mutable u32 m_visited[BucketCount];
+	mutable u32 m_query;
+	
+	long getCell(float coord) const;
+	static size_t getBucket(long x, long z);
+	
+};
+
+#endif // ARX_PHYSICS_ENTITYGRID_H
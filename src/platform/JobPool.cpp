@@ -0,0 +1,148 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "platform/JobPool.h"
+
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+
+#include "platform/Thread.h"
+
+class JobPool::Worker : public Thread {
+	
+	JobPool & owner;
+	
+	void run();
+	
+public:
+	
+	explicit Worker(JobPool & _owner) : owner(_owner) { }
+	
+};
+
+void JobPool::Worker::run() {
+	
+	for(;;) {
+		
+		owner.wake.wait();
+		
+		{
+			Autolock lock(owner.lock);
+			if(owner.stopping) {
+				break;
+			}
+		}
+		
+		while(Job * job = owner.take()) {
+			job->run();
+			owner.finish();
+		}
+	}
+	
+}
+
+JobPool::JobPool(const std::string & name, size_t count)
+	: batch(NULL), next(0), pending(0), waiting(false), stopping(false) {
+	
+	if(count == 0) {
+		count = std::max(Thread::getCPUCount(), 2u) - 1;
+	}
+	
+	for(size_t i = 0; i < count; i++) {
+		Worker * worker = new Worker(*this);
+		worker->setThreadName(name);
+		worker->start();
+		workers.push_back(worker);
+	}
+	
+}
+
+JobPool::~JobPool() {
+	
+	{
+		Autolock lock(this->lock);
+		stopping = true;
+	}
+	
+	wake.post(unsigned(workers.size()));
+	
+	BOOST_FOREACH(Worker * worker, workers) {
+		worker->waitForCompletion();
+		delete worker;
+	}
+}
+
+void JobPool::run(const std::vector<Job *> & jobs) {
+	
+	if(jobs.empty()) {
+		return;
+	}
+	
+	{
+		Autolock lock(this->lock);
+		arx_assert(pending == 0);
+		batch = &jobs;
+		next = 0;
+		pending = jobs.size();
+	}
+	
+	// The calling thread takes one of the jobs itself
+	wake.post(unsigned(std::min(workers.size(), jobs.size() - 1)));
+	
+	while(Job * job = take()) {
+		job->run();
+		finish();
+	}
+	
+	lock.lock();
+	if(pending > 0) {
+		waiting = true;
+		lock.unlock();
+		idle.wait();
+		lock.lock();
+	}
+	batch = NULL;
+	lock.unlock();
+}
+
+JobPool::Job * JobPool::take() {
+	
+	Autolock lock(this->lock);
+	
+	if(!batch || next == batch->size()) {
+		return NULL;
+	}
+	
+	return (*batch)[next++];
+}
+
+void JobPool::finish() {
+	
+	Autolock lock(this->lock);
+	
+	arx_assert(pending > 0);
+	pending--;
+	
+	if(pending == 0 && waiting) {
+		waiting = false;
+		idle.post();
+	}
+}
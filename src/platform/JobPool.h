@@ -0,0 +1,93 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ARX_PLATFORM_JOBPOOL_H
+#define ARX_PLATFORM_JOBPOOL_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "platform/Lock.h"
+
+/*!
+ * Pool of worker threads for splitting per-frame work into independent jobs.
+ *
+ * Jobs are submitted in batches with run(), which returns once all jobs in the batch
+ * have finished. The calling thread also executes jobs while it waits.
+ */
+class JobPool : private boost::noncopyable {
+	
+public:
+	
+	class Job {
+		
+	public:
+		
+		virtual ~Job() { }
+		
+		//! Do the work - may be called from any thread
+		virtual void run() = 0;
+		
+	};
+	
+	/*!
+	 * \param name  Name for the worker threads.
+	 * \param count Number of worker threads to use,
+	 *              or 0 to use one less than the number of processors.
+	 */
+	explicit JobPool(const std::string & name, size_t count = 0);
+	~JobPool();
+	
+	/*!
+	 * Run a batch of jobs and wait for all of them to finish.
+	 *
+	 * Jobs may run in any order and in parallel.
+	 * Must not be called from more than one thread at a time.
+	 */
+	void run(const std::vector<Job *> & jobs);
+	
+	size_t getWorkerCount() const { return workers.size(); }
+	
+private:
+	
+	class Worker;
+	friend class Worker;
+	
+	Lock lock;
+	Semaphore wake; //!< Posted for each worker that should look for jobs
+	Semaphore idle; //!< Posted when the last job finished while run() is waiting
+	
+	const std::vector<Job *> * batch;
+	size_t next;
+	size_t pending;
+	bool waiting;
+	bool stopping;
+	
+	std::vector<Worker *> workers;
+	
+	Job * take();
+	void finish();
+	
+};
+
+#endif // ARX_PLATFORM_JOBPOOL_H
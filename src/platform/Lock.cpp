@@ -19,6 +19,8 @@
 
 #include "platform/Lock.h"
 
+#include <climits>
+
 #if ARX_HAVE_PTHREADS
 
 Lock::Lock() : locked(false) {
@@ -53,6 +55,47 @@ void Lock::unlock() {
 	pthread_mutex_unlock(&mutex);
 }
 
+Semaphore::Semaphore(unsigned initial) : count(initial) {
+	const pthread_mutex_t mutex_init = PTHREAD_MUTEX_INITIALIZER;
+	mutex = mutex_init;
+	const pthread_cond_t cond_init = PTHREAD_COND_INITIALIZER;
+	cond = cond_init;
+}
+
+Semaphore::~Semaphore() {
+	
+}
+
+void Semaphore::wait() {
+	
+	pthread_mutex_lock(&mutex);
+	
+	while(count == 0) {
+		int rc = pthread_cond_wait(&cond, &mutex);
+		arx_assert(rc == 0);
+		ARX_UNUSED(rc);
+	}
+	
+	count--;
+	pthread_mutex_unlock(&mutex);
+}
+
+void Semaphore::post(unsigned n) {
+	
+	if(n == 0) {
+		return;
+	}
+	
+	pthread_mutex_lock(&mutex);
+	count += n;
+	if(n == 1) {
+		pthread_cond_signal(&cond);
+	} else {
+		pthread_cond_broadcast(&cond);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
 #elif ARX_PLATFORM == ARX_PLATFORM_WIN32
 
 Lock::Lock() {
@@ -74,4 +117,24 @@ void Lock::unlock() {
 	ReleaseMutex(mutex);
 }
 
+Semaphore::Semaphore(unsigned initial) {
+	semaphore = CreateSemaphore(NULL, LONG(initial), LONG_MAX, NULL);
+}
+
+Semaphore::~Semaphore() {
+	CloseHandle(semaphore);
+}
+
+void Semaphore::wait() {
+	DWORD rc = WaitForSingleObject(semaphore, INFINITE);
+	arx_assert(rc == WAIT_OBJECT_0);
+	ARX_UNUSED(rc);
+}
+
+void Semaphore::post(unsigned n) {
+	if(n > 0) {
+		ReleaseSemaphore(semaphore, LONG(n), NULL);
+	}
+}
+
 #endif
@@ -76,4 +76,32 @@ public:
 	
 };
 
+/*!
+ * Counting semaphore
+ *
+ * wait() blocks until the count is non-zero and then decrements it.
+ */
+class Semaphore {
+	
+private:
+	
+#if ARX_HAVE_PTHREADS
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	unsigned count;
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+	HANDLE semaphore;
+#endif
+	
+public:
+	
+	explicit Semaphore(unsigned initial = 0);
+	~Semaphore();
+	
+	void wait();
+	
+	void post(unsigned n = 1);
+	
+};
+
 #endif // ARX_PLATFORM_LOCK_H
@@ -19,6 +19,8 @@
 
 #include "platform/Thread.h"
 
+#include <algorithm>
+
 #include "platform/CrashHandler.h"
 #include "platform/Platform.h"
 #include "platform/profiler/Profiler.h"
@@ -263,3 +265,22 @@ void Thread::sleep(unsigned milliseconds) {
 #else
 #error "Sleep not supported: need ARX_HAVE_NANOSLEEP in non-Windows systems"
 #endif
+
+#if ARX_HAVE_SYSCONF
+#include <unistd.h>
+#endif
+
+unsigned Thread::getCPUCount() {
+	
+#if ARX_HAVE_SYSCONF && defined(_SC_NPROCESSORS_ONLN)
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? unsigned(count) : 1;
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return std::max(unsigned(info.dwNumberOfProcessors), 1u);
+#else
+	return 1;
+#endif
+	
+}
@@ -107,6 +107,13 @@ public:
 	
 	static thread_id_type getCurrentThreadId();
 	
+	/*!
+	 * \brief Get the number of logical processors available to this process
+	 *
+	 * \return the processor count, or 1 if it could not be determined.
+	 */
+	static unsigned getCPUCount();
+	
 protected:
 	
 	/*!
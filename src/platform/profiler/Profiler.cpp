@@ -21,6 +21,7 @@
 
 #if BUILD_PROFILER_INSTRUMENT
 
+#include <algorithm>
 #include <atomic>
 #include <cstring>
 #include <map>
@@ -32,36 +33,112 @@
 #include <boost/algorithm/string/join.hpp>
 #include <boost/container/flat_map.hpp>
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "io/fs/FilePath.h"
 #include "io/fs/FileStream.h"
 #include "io/log/Logger.h"
 
+#include "platform/Lock.h"
 #include "platform/Thread.h"
 #include "platform/Time.h"
 #include "platform/profiler/ProfilerDataFormat.h"
 
 #include "util/String.h"
 
+#if ARX_COMPILER_MSVC
+	#define ARX_PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+	#define ARX_PROFILER_THREAD_LOCAL __thread
+#endif
+
+template <typename T>
+void writeStruct(std::ofstream & out, T & data, size_t & pos) {
+	out.write((const char*)&data, sizeof(T));
+	pos += sizeof(T);
+}
+
+static void writeChunk(std::ofstream & out, ArxProfilerChunkType type, size_t dataSize, size_t & pos) {
+	SavedProfilerChunkHeader chunk;
+	chunk.type = type;
+	chunk.size = dataSize;
+	std::memset(chunk.padding, 0, sizeof(chunk.padding));
+	writeStruct(out, chunk, pos);
+	LogDebug("Writing chunk at offset " << pos << " type " << chunk.type << " size " << chunk.size);
+}
+
+class ProfilerStringTable : public boost::noncopyable {
+public:
+	ProfilerStringTable() : m_written(0) { }
+	
+	u32 add(std::string value) {
+		
+		boost::container::flat_map<std::string, u32>::iterator si = m_map.find(value);
+		u32 stringIndex;
+		
+		if(si == m_map.end()) {
+			m_list.push_back(value);
+			stringIndex = m_list.size() - 1;
+			m_map[value] = stringIndex;
+		} else {
+			stringIndex = si->second;
+		}
+		
+		return stringIndex;
+	}
+	
+	int entries() {
+		return m_list.size();
+	}
+	
+	//! \return true if strings were added since the last call to takeNewData()
+	bool hasNewData() {
+		return m_written != m_list.size();
+	}
+	
+	//! Get the strings added since the last call, joined with null bytes
+	std::string takeNewData() {
+		std::vector<std::string> added(m_list.begin() + m_written, m_list.end());
+		m_written = m_list.size();
+		std::string result = boost::algorithm::join(added, std::string("\0", 1));
+		return result;
+	}
+	
+	void clear() {
+		m_map.clear();
+		m_list.clear();
+		m_written = 0;
+	}
+	
+private:
+	boost::container::flat_map<std::string, u32> m_map;
+	std::vector<std::string> m_list;
+	size_t m_written;
+};
+
 class Profiler {
 	
 public:
 	Profiler();
 	
-	void flush();
-	void reset();
+	void start();
+	void stop();
+	bool isRunning() const { return m_writer != NULL; }
 	
 	void registerThread(const std::string& threadName);
 	void unregisterThread();
 	
-	void addProfilePoint(const char* tag, thread_id_type threadId, u64 startTime, u64 endTime);
+	void addProfilePoint(const char* tag, u64 startTime, u64 endTime);
+	
+	//! Write all samples collected so far to the profile file
+	void drain();
 	
 private:
-	static const u32 NB_SAMPLES = 100 * 1000;
+	//! Number of samples buffered per thread, must be a power of two
+	static const u32 NB_SAMPLES = 32 * 1024;
 	
 	struct ProfilerSample {
 		const char*    tag;
-		thread_id_type threadId;
 		u64            startTime;
 		u64            endTime;
 	};
@@ -72,121 +149,145 @@ private:
 		u64            startTime;
 		u64            endTime;
 	};
-
-	typedef std::map<thread_id_type, ProfilerThread> ThreadInfos;
 	
-	ThreadInfos        m_threads;
+	/*!
+	 * Samples recorded by a single thread.
+	 *
+	 * Only the owning thread advances m_writeIndex and only the writer thread
+	 * advances m_readIndex, so no locking is needed to add samples.
+	 */
+	struct ThreadBuffer {
+		ProfilerThread   info;
+		boost::array<ProfilerSample, NB_SAMPLES> samples;
+		std::atomic<u32> writeIndex;
+		std::atomic<u32> readIndex;
+		std::atomic<u32> dropped;
+		bool             finished;
+	};
+	
+	class Writer : public StoppableThread {
+		Profiler & m_profiler;
+		void run();
+	public:
+		explicit Writer(Profiler & profiler) : m_profiler(profiler) { }
+	};
+	
+	typedef std::vector<ThreadBuffer *> ThreadBuffers;
+	
+	static ARX_PROFILER_THREAD_LOCAL ThreadBuffer * t_buffer;
+	
+	Lock               m_threadsLock; //!< Protects m_threads and m_finishedThreads
+	ThreadBuffers      m_threads;
+	std::vector<SavedProfilerThread> m_finishedThreads;
+	
+	std::atomic<bool>  m_enabled;
+	Writer *           m_writer;
 	
-	boost::array<ProfilerSample, NB_SAMPLES> m_samples;
-	std::atomic<int> m_writeIndex;
-	bool               m_canWrite;
+	// Only used by the writer thread while running
+	fs::ofstream       m_out;
+	size_t             m_pos;
+	ProfilerStringTable m_strings;
+	boost::unordered_map<const char *, u32> m_tagStrings;
+	std::vector<SavedProfilerSample> m_samplesData;
+	u64                m_sampleCount;
+	u64                m_droppedCount;
 	
-	void writeProfileLog();
+	SavedProfilerThread saveThread(const ProfilerThread & thread);
+	void writeStrings();
+	void writeThreads();
 };
 
+ARX_PROFILER_THREAD_LOCAL Profiler::ThreadBuffer * Profiler::t_buffer = NULL;
 
-Profiler::Profiler() {
-	m_writeIndex = 0;
-	m_canWrite = true;
-	m_samples.fill(ProfilerSample());
-}
-
-void Profiler::reset() {
-	m_writeIndex = 0;
-	m_samples.fill(ProfilerSample());
+Profiler::Profiler()
+	: m_writer(NULL)
+	, m_pos(0)
+	, m_sampleCount(0)
+	, m_droppedCount(0)
+{
+	m_enabled = false;
 }
 
 void Profiler::registerThread(const std::string& threadName) {
-	thread_id_type threadId = Thread::getCurrentThreadId();
-	ProfilerThread & thread = m_threads[threadId];
-	thread.threadName = threadName;
-	thread.threadId = threadId;
-	thread.startTime = platform::getTimeUs();
-	thread.endTime = thread.startTime;
+	
+	ThreadBuffer * buffer = new ThreadBuffer;
+	buffer->info.threadName = threadName;
+	buffer->info.threadId = Thread::getCurrentThreadId();
+	buffer->info.startTime = platform::getTimeUs();
+	buffer->info.endTime = buffer->info.startTime;
+	buffer->writeIndex = 0;
+	buffer->readIndex = 0;
+	buffer->dropped = 0;
+	buffer->finished = false;
+	
+	Autolock lock(m_threadsLock);
+	m_threads.push_back(buffer);
+	t_buffer = buffer;
 }
 	
 void Profiler::unregisterThread() {
-	thread_id_type threadId = Thread::getCurrentThreadId();
-	ProfilerThread & thread = m_threads[threadId];
-	thread.endTime = platform::getTimeUs();
+	
+	ThreadBuffer * buffer = t_buffer;
+	if(!buffer) {
+		return;
+	}
+	t_buffer = NULL;
+	
+	Autolock lock(m_threadsLock);
+	
+	buffer->info.endTime = platform::getTimeUs();
+	
+	if(isRunning()) {
+		// The writer thread will delete the buffer once all samples have been written
+		buffer->finished = true;
+	} else {
+		m_threads.erase(std::find(m_threads.begin(), m_threads.end(), buffer));
+		delete buffer;
+	}
 }
 
-void Profiler::addProfilePoint(const char* tag, thread_id_type threadId, u64 startTime, u64 endTime) {
+void Profiler::addProfilePoint(const char* tag, u64 startTime, u64 endTime) {
 	
-	while(!m_canWrite);
+	ThreadBuffer * buffer = t_buffer;
+	if(!buffer || !m_enabled.load(std::memory_order_relaxed)) {
+		return;
+	}
 	
-	u32 pos = m_writeIndex.fetch_add(1);
+	u32 writeIndex = buffer->writeIndex.load(std::memory_order_relaxed);
+	u32 readIndex = buffer->readIndex.load(std::memory_order_acquire);
+	if(writeIndex - readIndex >= NB_SAMPLES) {
+		// The writer thread is not keeping up
+		buffer->dropped.store(buffer->dropped.load(std::memory_order_relaxed) + 1,
+		                      std::memory_order_relaxed);
+		return;
+	}
 	
-	ProfilerSample & sample = m_samples[pos % NB_SAMPLES];
+	ProfilerSample & sample = buffer->samples[writeIndex & (NB_SAMPLES - 1)];
 	sample.tag = tag;
-	sample.threadId = threadId;
 	sample.startTime = startTime;
 	sample.endTime = endTime;
-}
-
-void Profiler::flush() {
 	
-	m_canWrite = false;
-	writeProfileLog();
-	reset();
-	m_canWrite = true;
-}
-
-
-template <typename T>
-void writeStruct(std::ofstream & out, T & data, size_t & pos) {
-	out.write((const char*)&data, sizeof(T));
-	pos += sizeof(T);
+	buffer->writeIndex.store(writeIndex + 1, std::memory_order_release);
 }
 
-static void writeChunk(std::ofstream & out, ArxProfilerChunkType type, size_t dataSize, size_t & pos) {
-	SavedProfilerChunkHeader chunk;
-	chunk.type = type;
-	chunk.size = dataSize;
-	std::memset(chunk.padding, 0, sizeof(chunk.padding));
-	writeStruct(out, chunk, pos);
-	LogDebug("Writing chunk at offset " << pos << " type " << chunk.type << " size " << chunk.size);
+void Profiler::Writer::run() {
+	while(!isStopRequested()) {
+		m_profiler.drain();
+		sleep(10);
+	}
 }
 
-class ProfilerStringTable : public boost::noncopyable {
-public:
-	u32 add(std::string value) {
-		
-		boost::container::flat_map<std::string, u32>::iterator si = m_map.find(value);
-		u32 stringIndex;
-		
-		if(si == m_map.end()) {
-			m_list.push_back(value);
-			stringIndex = m_list.size() - 1;
-			m_map[value] = stringIndex;
-		} else {
-			stringIndex = si->second;
-		}
-		
-		return stringIndex;
-	}
-	
-	int entries() {
-		return m_list.size();
-	}
+void Profiler::start() {
 	
-	std::string data() {
-		std::string result = boost::algorithm::join(m_list, std::string("\0", 1));
-		return result;
+	if(isRunning()) {
+		return;
 	}
 	
-private:
-	boost::container::flat_map<std::string, u32> m_map;
-	std::vector<std::string> m_list;
-};
-
-void Profiler::writeProfileLog() {
-	
 	std::string filename = util::getDateTimeString() + ".arxprof";
 	LogInfo << "Writing profiler log to: " << filename;
 	
-	fs::ofstream out(fs::path(filename), std::ios::binary | std::ios::out);
-	size_t pos = 0;
+	m_out.open(fs::path(filename), std::ios::binary | std::ios::out);
+	m_pos = 0;
 	
 	int fileVersion = 1;
 	
@@ -196,79 +297,172 @@ void Profiler::writeProfileLog() {
 	std::strncpy(header.magic, profilerMagic, 8);
 	header.version = fileVersion;
 	std::memset(header.padding, 0, sizeof(header.padding));
-	writeStruct(out, header, pos);
+	writeStruct(m_out, header, m_pos);
 	
-	LogDebug("Building string table");
-	ProfilerStringTable stringTable;
-	std::vector<SavedProfilerThread> threadsData;
-	std::vector<SavedProfilerSample> samplesData;
+	m_strings.clear();
+	m_tagStrings.clear();
+	m_sampleCount = 0;
+	m_droppedCount = 0;
 	
-	for(ThreadInfos::const_iterator it = m_threads.begin(); it != m_threads.end(); ++it) {
-		const ProfilerThread & thread = it->second;
-		
-		u32 stringIndex = stringTable.add(thread.threadName);
-		
-		SavedProfilerThread saved;
-		saved.stringIndex = stringIndex;
-		saved.threadId = thread.threadId;
-		saved.startTime = thread.startTime;
-		saved.endTime = thread.endTime;
-		threadsData.push_back(saved);
+	{
+		Autolock lock(m_threadsLock);
+		m_finishedThreads.clear();
+		BOOST_FOREACH(ThreadBuffer * buffer, m_threads) {
+			// Discard samples from before the capture
+			buffer->readIndex.store(buffer->writeIndex.load(std::memory_order_acquire),
+			                        std::memory_order_release);
+			buffer->dropped = 0;
+		}
 	}
 	
-	// Profile points
-	u32 index = 0;
-	u32 numItems = m_writeIndex;
+	m_enabled = true;
 	
-	if(numItems >= NB_SAMPLES) {
-		index = numItems;
-		numItems = NB_SAMPLES;
-	}
+	m_writer = new Writer(*this);
+	m_writer->setThreadName("Profiler writer");
+	m_writer->start();
+}
+
+void Profiler::stop() {
 	
-	for(u32 i = 0; i < numItems; ++i, ++index) {
-		ProfilerSample & sample = m_samples[index % NB_SAMPLES];
-		
-		u32 stringIndex = stringTable.add(sample.tag);
-		
-		SavedProfilerSample saved;
-		saved.stringIndex = stringIndex;
-		saved.threadId = sample.threadId;
-		saved.startTime = sample.startTime;
-		saved.endTime = sample.endTime;
-		samplesData.push_back(saved);
+	if(!isRunning()) {
+		return;
 	}
 	
-	LogInfo << "Writing data: "
-	" Strings " << stringTable.entries() <<
-	", Threads " << threadsData.size() <<
-	", Points "  << samplesData.size();
+	m_enabled = false;
+	
+	m_writer->stop();
+	
+	drain();
+	writeThreads();
+	
+	m_out.close();
 	
 	{
-		std::string stringsData = stringTable.data();
-		int dataSize = stringsData.size() + 1; // termination
-		writeChunk(out, ArxProfilerChunkType_Strings, dataSize, pos);
-		
-		out.write(stringsData.c_str(), dataSize);
-		pos += dataSize;
+		Autolock lock(m_threadsLock);
+		delete m_writer, m_writer = NULL;
 	}
 	
-	{
-		int dataSize = threadsData.size() * sizeof(SavedProfilerThread);
-		writeChunk(out, ArxProfilerChunkType_Threads, dataSize, pos);
-		
-		out.write((const char*) threadsData.data(), dataSize);
-		pos += dataSize;
+	LogInfo << "Wrote profiler log: "
+	" Strings " << m_strings.entries() <<
+	", Points "  << m_sampleCount <<
+	", Dropped " << m_droppedCount;
+	
+	if(m_droppedCount != 0) {
+		LogWarning << "Profiler dropped " << m_droppedCount << " samples";
+	}
+}
+
+SavedProfilerThread Profiler::saveThread(const ProfilerThread & thread) {
+	
+	SavedProfilerThread saved;
+	saved.stringIndex = m_strings.add(thread.threadName);
+	saved.threadId = thread.threadId;
+	saved.startTime = thread.startTime;
+	saved.endTime = thread.endTime;
+	
+	return saved;
+}
+
+void Profiler::writeStrings() {
+	
+	if(!m_strings.hasNewData()) {
+		return;
 	}
 	
+	std::string stringsData = m_strings.takeNewData();
+	int dataSize = stringsData.size() + 1; // termination
+	writeChunk(m_out, ArxProfilerChunkType_Strings, dataSize, m_pos);
+	
+	m_out.write(stringsData.c_str(), dataSize);
+	m_pos += dataSize;
+}
+
+void Profiler::writeThreads() {
+	
+	std::vector<SavedProfilerThread> threadsData;
+	
 	{
-		int dataSize = samplesData.size() * sizeof(SavedProfilerSample);
-		writeChunk(out, ArxProfilerChunkType_Samples, dataSize, pos);
+		Autolock lock(m_threadsLock);
+		threadsData = m_finishedThreads;
+		u64 now = platform::getTimeUs();
+		BOOST_FOREACH(ThreadBuffer * buffer, m_threads) {
+			SavedProfilerThread saved = saveThread(buffer->info);
+			if(!buffer->finished) {
+				saved.endTime = now;
+			}
+			threadsData.push_back(saved);
+		}
+	}
+	
+	writeStrings();
+	
+	int dataSize = threadsData.size() * sizeof(SavedProfilerThread);
+	writeChunk(m_out, ArxProfilerChunkType_Threads, dataSize, m_pos);
+	
+	m_out.write((const char*) threadsData.data(), dataSize);
+	m_pos += dataSize;
+}
+
+void Profiler::drain() {
+	
+	m_samplesData.clear();
+	
+	Autolock lock(m_threadsLock);
+	
+	for(size_t i = 0; i < m_threads.size(); ) {
+		
+		ThreadBuffer * buffer = m_threads[i];
+		
+		u32 writeIndex = buffer->writeIndex.load(std::memory_order_acquire);
+		u32 readIndex = buffer->readIndex.load(std::memory_order_relaxed);
+		
+		for(; readIndex != writeIndex; ++readIndex) {
+			const ProfilerSample & sample = buffer->samples[readIndex & (NB_SAMPLES - 1)];
+			
+			boost::unordered_map<const char *, u32>::const_iterator it = m_tagStrings.find(sample.tag);
+			u32 stringIndex;
+			if(it == m_tagStrings.end()) {
+				stringIndex = m_strings.add(sample.tag);
+				m_tagStrings[sample.tag] = stringIndex;
+			} else {
+				stringIndex = it->second;
+			}
+			
+			SavedProfilerSample saved;
+			saved.stringIndex = stringIndex;
+			saved.threadId = buffer->info.threadId;
+			saved.startTime = sample.startTime;
+			saved.endTime = sample.endTime;
+			m_samplesData.push_back(saved);
+		}
+		
+		buffer->readIndex.store(readIndex, std::memory_order_release);
+		
+		m_droppedCount += buffer->dropped.exchange(0, std::memory_order_relaxed);
 		
-		out.write((const char*) samplesData.data(), dataSize);
-		pos += dataSize;
+		if(buffer->finished) {
+			// The thread has exited and all its samples have been collected
+			m_finishedThreads.push_back(saveThread(buffer->info));
+			m_threads.erase(m_threads.begin() + i);
+			delete buffer;
+		} else {
+			i++;
+		}
+	}
+	
+	if(m_samplesData.empty()) {
+		return;
 	}
 	
-	out.close();
+	writeStrings();
+	
+	int dataSize = m_samplesData.size() * sizeof(SavedProfilerSample);
+	writeChunk(m_out, ArxProfilerChunkType_Samples, dataSize, m_pos);
+	
+	m_out.write((const char*) m_samplesData.data(), dataSize);
+	m_pos += dataSize;
+	
+	m_sampleCount += m_samplesData.size();
 }
 
 
@@ -280,8 +474,17 @@ void profiler::initialize() {
 	g_profiler.registerThread("main");
 }
 
-void profiler::flush() {
-	g_profiler.flush();
+void profiler::shutdown() {
+	g_profiler.stop();
+	g_profiler.unregisterThread();
+}
+
+void profiler::toggle() {
+	if(g_profiler.isRunning()) {
+		g_profiler.stop();
+	} else {
+		g_profiler.start();
+	}
 }
 
 void profiler::registerThread(const std::string & threadName) {
@@ -301,13 +504,14 @@ profiler::Scope::Scope(const char * tag)
 }
 
 profiler::Scope::~Scope() {
-	g_profiler.addProfilePoint(m_tag, Thread::getCurrentThreadId(), m_startTime, platform::getTimeUs());
+	g_profiler.addProfilePoint(m_tag, m_startTime, platform::getTimeUs());
 }
 
 #else
 
 void profiler::initialize() {}
-void profiler::flush() {}
+void profiler::shutdown() {}
+void profiler::toggle() {}
 
 void profiler::registerThread(const std::string & threadName) {
 	ARX_UNUSED(threadName);
@@ -29,8 +29,17 @@ namespace profiler {
 	//! Initialize the Profiler
 	void initialize();
 	
-	//! Write the collected profile data to disk
-	void flush();
+	//! Stop streaming profile data and unregister the main thread
+	void shutdown();
+	
+	/*!
+	 * Start streaming profile data to a new file, or stop if already streaming.
+	 *
+	 * Samples are buffered per thread and written to disk continuously by a
+	 * background thread. If a thread records samples faster than they can be
+	 * written, the excess samples are dropped and counted.
+	 */
+	void toggle();
 	
 	void registerThread(const std::string& threadName);
 	void unregisterThread();
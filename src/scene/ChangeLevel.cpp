@@ -86,6 +86,8 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "io/log/Logger.h"
 
 #include "platform/Platform.h"
+#include "platform/Thread.h"
+#include "platform/Time.h"
 
 #include "scene/Interactive.h"
 #include "scene/GameSound.h"
@@ -130,6 +132,59 @@ static long CONVERT_CREATED = 0;
 long DONT_WANT_PLAYER_INZONE = 0;
 static SaveBlock * g_currentSavedGame = NULL;
 
+//! Time spent serializing the current game, in microseconds
+static u64 g_currentSavedGameSerializeTime = 0;
+
+/*!
+ * Compresses and writes files saved to the current game in the background.
+ *
+ * The SaveBlock is used in incremental mode so that saving a level only needs to
+ * serialize the entities on the main thread.
+ */
+class SaveBlockWriterThread : public Thread {
+	
+	SaveBlock & m_block;
+	bool m_stopRequested;
+	
+	void run() {
+		for(;;) {
+			m_block.waitPending();
+			if(m_stopRequested) {
+				break;
+			}
+			m_block.writePending();
+		}
+	}
+	
+public:
+	
+	explicit SaveBlockWriterThread(SaveBlock & block)
+		: m_block(block), m_stopRequested(false) { }
+	
+	//! Stop the thread without writing the remaining pending files.
+	void stop() {
+		m_stopRequested = true;
+		m_block.wakeWaiting();
+		setPriority(Highest);
+		waitForCompletion();
+	}
+	
+};
+
+static SaveBlockWriterThread * g_currentSavedGameWriter = NULL;
+
+static void logCurrentSavedGameStatistics() {
+	
+	SaveBlock::Statistics stats = g_currentSavedGame->getStatistics();
+	
+	LogDebug("Current game: serialize " << g_currentSavedGameSerializeTime << " us, compress "
+	         << stats.compressTime << " us, write " << stats.writeTime << " us; "
+	         << stats.written << " files written (" << stats.writtenSize << " bytes), "
+	         << stats.unchanged << " unchanged");
+	
+	ARX_UNUSED(stats);
+}
+
 static ARX_CHANGELEVEL_IO_INDEX * idx_io = NULL;
 static ARX_CHANGELEVEL_INVENTORY_DATA_SAVE ** Gaids = NULL;
 
@@ -206,10 +261,17 @@ static long GetIOAnimIdx2(const Entity * io, ANIM_HANDLE * anim) {
 
 bool ARX_Changelevel_CurGame_Clear() {
 	
+	if(g_currentSavedGameWriter) {
+		g_currentSavedGameWriter->stop();
+		delete g_currentSavedGameWriter, g_currentSavedGameWriter = NULL;
+	}
+	
 	if(g_currentSavedGame) {
 		delete g_currentSavedGame, g_currentSavedGame = NULL;
 	}
 	
+	g_currentSavedGameSerializeTime = 0;
+	
 	if(CURRENT_GAME_FILE.empty()) {
 		CURRENT_GAME_FILE = fs::paths.user / "current.sav";
 	}
@@ -241,6 +303,13 @@ static bool openCurrentSavedGameFile() {
 		return false;
 	}
 	
+	g_currentSavedGame->setIncremental(true);
+	
+	g_currentSavedGameWriter = new SaveBlockWriterThread(*g_currentSavedGame);
+	g_currentSavedGameWriter->setThreadName("Save writer");
+	g_currentSavedGameWriter->setPriority(Thread::Low);
+	g_currentSavedGameWriter->start();
+	
 	return true;
 }
 
@@ -344,6 +413,8 @@ void ARX_CHANGELEVEL_Change(const std::string & level, const std::string & targe
 	ARX_CHANGELEVEL_PopLevel(num, true);
 	LogDebug("After  ARX_CHANGELEVEL_PopLevel");
 	
+	logCurrentSavedGameStatistics();
+	
 	// Now restore player pos to destination
 	EntityHandle t = entities.getById(target);
 	if(t > 0 && entities[t]) {
@@ -374,6 +445,8 @@ static bool ARX_CHANGELEVEL_PushLevel(long num, long newnum) {
 	// Close secondary inventory before leaving
 	g_secondaryInventoryHud.close();
 	
+	u64 startTime = platform::getTimeUs();
+	
 	// Now we can save our things
 	if(!ARX_CHANGELEVEL_Push_Index(num)) {
 		LogError << "Error Saving Index...";
@@ -395,6 +468,8 @@ static bool ARX_CHANGELEVEL_PushLevel(long num, long newnum) {
 		return false;
 	}
 	
+	g_currentSavedGameSerializeTime += platform::getElapsedUs(startTime);
+	
 	return true;
 }
 
@@ -1079,15 +1154,8 @@ static long ARX_CHANGELEVEL_Push_IO(const Entity * io, long level) {
 	// Save Local Timers ?
 	long count = 0;
 
-	for (int i = 0; i < MAX_TIMER_SCRIPT; i++)
-	{
-		if (scr_timer[i].exist)
-		{
-			if (scr_timer[i].io == io)
-			{
-				count++;
-			}
-		}
+	for(long i = io->timers; i != -1; i = scr_timer[i].next) {
+		count++;
 	}
 
 	ais.nbtimers = count;
@@ -1116,33 +1184,27 @@ static long ARX_CHANGELEVEL_Push_IO(const Entity * io, long level) {
 
 	long timm = (unsigned long)(arxtime); //treat warning C4244 conversion from 'float' to 'unsigned long''
 
-	for (int i = 0; i < MAX_TIMER_SCRIPT; i++)
-	{
-		if (scr_timer[i].exist)
-		{
-			if (scr_timer[i].io == io)
-			{
-				ARX_CHANGELEVEL_TIMERS_SAVE * ats = (ARX_CHANGELEVEL_TIMERS_SAVE *)(dat + pos);
-				memset(ats, 0, sizeof(ARX_CHANGELEVEL_TIMERS_SAVE));
-				ats->longinfo = scr_timer[i].longinfo;
-				ats->msecs = scr_timer[i].msecs;
-				util::storeString(ats->name, scr_timer[i].name.c_str());
-				ats->pos = scr_timer[i].pos;
-
-				if (scr_timer[i].es == &io->script)
-					ats->script = 0;
-				else	ats->script = 1;
-
-				ats->tim = (scr_timer[i].tim + scr_timer[i].msecs) - timm;
-
-				if (ats->tim < 0) ats->tim = 0;
-
-				//else ats->tim=-ats->tim;
-				ats->times = scr_timer[i].times;
-				ats->flags = scr_timer[i].flags;
-				pos += sizeof(ARX_CHANGELEVEL_TIMERS_SAVE);
-			}
-		}
+	for(long i = io->timers; i != -1; i = scr_timer[i].next) {
+		
+		ARX_CHANGELEVEL_TIMERS_SAVE * ats = (ARX_CHANGELEVEL_TIMERS_SAVE *)(dat + pos);
+		memset(ats, 0, sizeof(ARX_CHANGELEVEL_TIMERS_SAVE));
+		ats->longinfo = scr_timer[i].longinfo;
+		ats->msecs = scr_timer[i].msecs;
+		util::storeString(ats->name, scr_timer[i].name.c_str());
+		ats->pos = scr_timer[i].pos;
+		
+		if (scr_timer[i].es == &io->script)
+			ats->script = 0;
+		else	ats->script = 1;
+		
+		ats->tim = (scr_timer[i].tim + scr_timer[i].msecs) - timm;
+		
+		if (ats->tim < 0) ats->tim = 0;
+		
+		//else ats->tim=-ats->tim;
+		ats->times = scr_timer[i].times;
+		ats->flags = scr_timer[i].flags;
+		pos += sizeof(ARX_CHANGELEVEL_TIMERS_SAVE);
 	}
 
 	ARX_CHANGELEVEL_SCRIPT_SAVE * ass = (ARX_CHANGELEVEL_SCRIPT_SAVE *)(dat + pos);
@@ -2132,8 +2194,6 @@ static Entity * ARX_CHANGELEVEL_Pop_IO(const std::string & idString, EntityInsta
 				continue;
 			}
 			
-			ActiveTimers++;
-			
 			if(ats->script) {
 				scr_timer[num].es = &io->over_script;
 			} else {
@@ -2141,7 +2201,6 @@ static Entity * ARX_CHANGELEVEL_Pop_IO(const std::string & idString, EntityInsta
 			}
 			
 			scr_timer[num].flags = sFlags;
-			scr_timer[num].exist = 1;
 			scr_timer[num].io = io;
 			scr_timer[num].msecs = ats->msecs;
 			scr_timer[num].name = boost::to_lower_copy(util::loadString(ats->name));
@@ -2156,6 +2215,8 @@ static Entity * ARX_CHANGELEVEL_Pop_IO(const std::string & idString, EntityInsta
 			}
 			
 			scr_timer[num].times = ats->times;
+			
+			ARX_SCRIPT_Timer_Start(num);
 		}
 		
 		if(!loadScriptData(io->script, dat, pos) || !loadScriptData(io->over_script, dat, pos)) {
@@ -2697,6 +2758,7 @@ static bool ARX_CHANGELEVEL_PopLevel(long instance, bool reloadflag) {
 		for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
 			if(scr_timer[i].exist) {
 				scr_timer[i].tim = ulDTime;
+				ARX_SCRIPT_Timer_Reschedule(i);
 			}
 		}
 	} else {
@@ -2822,6 +2884,8 @@ bool ARX_CHANGELEVEL_Save(const std::string & name, const fs::path & savefile) {
 		return false;
 	}
 	
+	logCurrentSavedGameStatistics();
+	
 	arxtime.resume();
 	
 	// Copy the savegame and screenshot to the final destination, overwriting previous files
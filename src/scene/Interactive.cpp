@@ -103,6 +103,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "physics/Anchors.h"
 #include "physics/Collisions.h"
 #include "physics/CollisionShapes.h"
+#include "physics/EntityGrid.h"
 #include "physics/Box.h"
 #include "physics/Clothes.h"
 
@@ -407,8 +408,16 @@ TREATZONE_IO * treatio = NULL;
 long TREATZONE_CUR = 0;
 static long TREATZONE_MAX = 0;
 
+static const float TREATZONE_GRID_CELL_SIZE = 400.f;
+// How far entities may move during a frame after the grid has been updated
+static const float TREATZONE_GRID_MARGIN = 200.f;
+
+// Broad phase for collision queries against the treat zone, indexed by treatio entry
+static EntityGrid treatzoneGrid(TREATZONE_GRID_CELL_SIZE);
+
 void TREATZONE_Clear() {
 	TREATZONE_CUR = 0;
+	treatzoneGrid.clear();
 }
 
 void TREATZONE_Release() {
@@ -416,6 +425,30 @@ void TREATZONE_Release() {
 	treatio = NULL;
 	TREATZONE_MAX = 0;
 	TREATZONE_CUR = 0;
+	treatzoneGrid.clear();
+}
+
+static void TREATZONE_UpdateGrid() {
+	
+	treatzoneGrid.clear();
+	
+	for(long i = 0; i < TREATZONE_CUR; i++) {
+		if(treatio[i].io) {
+			treatzoneGrid.insert(i, treatio[i].io->pos);
+		}
+	}
+}
+
+void TREATZONE_GetNearbyIO(const Vec3f & pos, float radius, std::vector<long> & result) {
+	
+	size_t start = result.size();
+	
+	treatzoneGrid.query(pos, radius + TREATZONE_GRID_MARGIN, result);
+	
+	// The player moves the most between grid updates
+	if(TREATZONE_CUR > 0 && (result.size() == start || result[start] != 0)) {
+		result.insert(result.begin() + start, 0);
+	}
 }
 
 void TREATZONE_RemoveIO(Entity * io)
@@ -451,6 +484,7 @@ void TREATZONE_AddIO(Entity * io, bool justCollide)
 
 	treatio[TREATZONE_CUR].show = io->show;
 	treatio[TREATZONE_CUR].num = io->index();
+	treatzoneGrid.insert(TREATZONE_CUR, io->pos);
 	TREATZONE_CUR++;
 }
 
@@ -486,8 +520,11 @@ void PrepareIOTreatZone(long flag) {
 		lastpos = ACTIVECAM->orgTrans.pos;
 	}
 
-	if(status++)
+	if(status++) {
+		// Keep the entity positions in the grid up to date between treat zone updates
+		TREATZONE_UpdateGrid();
 		return;
+	}
 
 	TREATZONE_Clear();
 	long Cam_Room = ARX_PORTALS_GetRoomNumForPosition(ACTIVECAM->orgTrans.pos, 1);
@@ -623,6 +660,8 @@ void PrepareIOTreatZone(long flag) {
 	}
 
 	long M_TREAT = TREATZONE_CUR;
+	
+	std::vector<long> nearby;
 
 	for(size_t i = 1; i < entities.size(); i++) {
 		const EntityHandle handle = EntityHandle(i);
@@ -638,8 +677,16 @@ void PrepareIOTreatZone(long flag) {
 				continue;
 
 			bool toadd = false;
+			
+			nearby.clear();
+			treatzoneGrid.query(io->pos, 300.f, nearby);
 
-			for(long ii = 1; ii < M_TREAT; ii++) {
+			for(size_t n = 0; n < nearby.size(); n++) {
+				long ii = nearby[n];
+				if(ii < 1 || ii >= M_TREAT) {
+					continue;
+				}
+				
 				Entity * ioo = treatio[ii].io;
 
 				if(ioo) {
@@ -1142,15 +1189,14 @@ void ARX_INTERACTIVE_TeleportBehindTarget(Entity * io)
 
 		if(num != -1) {
 			EntityHandle t = io->index();
-			ActiveTimers++;
 			scr_timer[num].es = NULL;
-			scr_timer[num].exist = 1;
 			scr_timer[num].io = io;
 			scr_timer[num].msecs = Random::get(3000, 6000);
 			scr_timer[num].name = "_r_a_t_";
 			scr_timer[num].pos = -1; 
 			scr_timer[num].tim = (unsigned long)(arxtime);
 			scr_timer[num].times = 1;
+			ARX_SCRIPT_Timer_Start(num);
 			entities[t]->show = SHOW_FLAG_TELEPORTING;
 			AddRandomSmoke(io, 10);
 			ARX_PARTICLES_Add_Smoke(io->pos, 3, 20);
@@ -2445,9 +2491,11 @@ void UpdateInter() {
 				pos.y = io->_npcdata->vvpos;
 			}
 
-			EERIEDrawAnimQuatUpdate(io->obj, io->animlayer, temp, pos, diff, io, true);
+			EERIEDrawAnimQuatQueueUpdate(io->obj, io->animlayer, temp, pos, diff, io, true);
 		}
 	}
+	
+	FlushAnimationUpdates();
 }
 
 
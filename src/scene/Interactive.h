@@ -49,6 +49,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include <stddef.h>
 #include <string>
+#include <vector>
 
 #include "game/Entity.h"
 #include "game/EntityId.h"
@@ -171,6 +172,15 @@ void TREATZONE_Clear();
 void TREATZONE_Release();
 void TREATZONE_AddIO(Entity * io, bool justCollide = false);
 void TREATZONE_RemoveIO(Entity * io);
+
+/*!
+ * Get the treatio indices of entities that may be within radius of pos in the x/z plane.
+ *
+ * Entity positions are taken when the treat zone is updated at the start of each frame,
+ * with a margin for the distance moved since then. The player (index 0) is always included.
+ * The indices are appended to result in increasing order.
+ */
+void TREATZONE_GetNearbyIO(const Vec3f & pos, float radius, std::vector<long> & result);
 bool IsSameObject(Entity * io, Entity * ioo);
 void ARX_INTERACTIVE_ClearAllDynData();
 bool HaveCommonGroup(Entity * io, Entity * ioo);
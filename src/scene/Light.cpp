@@ -62,6 +62,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "scene/Object.h"
 #include "scene/GameSound.h"
 #include "scene/Interactive.h"
+#include "scene/LightBatch.h"
 
 static const float GLOBAL_LIGHT_FACTOR=0.85f;
 
@@ -629,53 +630,21 @@ float GetColorz(const Vec3f &pos) {
 	return (std::min(ff.r, 255.f) + std::min(ff.g, 255.f) + std::min(ff.b, 255.f)) * (1.f/3);
 }
 
-ColorRGBA ApplyLight(const glm::quat * quat, const Vec3f & position, const Vec3f & normal, const ColorMod & colorMod, float materialDiffuse) {
-
-	Color3f tempColor = colorMod.ambientColor;
-
-	// Dynamic lights
+void PrepareLlights(LightBatch & batch, const ColorMod & colorMod, float materialDiffuse) {
+	
+	batch.clear();
+	batch.setColorMod(colorMod.factor, colorMod.term);
+	
 	for(int l = 0; l != MAX_LLIGHTS; l++) {
 		EERIE_LIGHT * light = llights[l];
-
+		
 		if(!light)
 			break;
-
-		Vec3f vLight = glm::normalize(light->pos - position);
-
-		Vec3f Cur_vLights = glm::inverse(*quat) * vLight;
 		
-		float cosangle = glm::dot(normal, Cur_vLights);
-
-		// If light visible
-		if(cosangle > 0.f) {
-			float distance = fdist(position, light->pos);
-
-			// Evaluate its intensity depending on the distance Light<->Object
-			if(distance <= light->fallstart) {
-				cosangle *= light->intensity * GLOBAL_LIGHT_FACTOR;
-			} else {
-				float p = ((light->fallend - distance) * light->falldiffmul);
-
-				if(p <= 0.f)
-					cosangle = 0.f;
-				else
-					cosangle *= p * (light->intensity * GLOBAL_LIGHT_FACTOR);
-			}
-
-			cosangle *= materialDiffuse;
-
-			tempColor += light->rgb255 * cosangle;
-		}
+		float intensity = light->intensity * GLOBAL_LIGHT_FACTOR * materialDiffuse;
+		batch.add(light->pos, light->fallstart, light->fallend, light->falldiffmul,
+		          light->rgb255 * intensity);
 	}
-
-	tempColor *= colorMod.factor;
-	tempColor += colorMod.term;
-
-	u8 ir = clipByte255(tempColor.r);
-	u8 ig = clipByte255(tempColor.g);
-	u8 ib = clipByte255(tempColor.b);
-
-	return Color(ir, ig, ib, 255).toRGBA();
 }
 
 void ApplyTileLights(EERIEPOLY * ep, const Vec2s & pos)
@@ -689,52 +658,38 @@ void ApplyTileLights(EERIEPOLY * ep, const Vec2s & pos)
 	TILE_LIGHTS * tls = &tilelights[pos.x][pos.y];
 	size_t nbvert = (ep->type & POLY_QUAD) ? 4 : 3;
 
-	for(size_t j = 0; j < nbvert; j++) {
-
-		if(tls->el.empty()) {
+	if(tls->el.empty()) {
+		for(size_t j = 0; j < nbvert; j++) {
 			ep->tv[j].color = ep->v[j].color;
-			continue;
 		}
+		return;
+	}
 
-		Color3f tempColor;
+	Color3f colors[4];
+	for(size_t j = 0; j < nbvert; j++) {
 		Color c = Color::fromRGBA(ep->v[j].color);
-		tempColor.r = c.r;
-		tempColor.g = c.g;
-		tempColor.b = c.b;
-
-		Vec3f & position = ep->v[j].p;
-		Vec3f & normal = ep->nrml[j];
-
-		for(size_t i = 0; i < tls->el.size(); i++) {
-			EERIE_LIGHT * light = tls->el[i];
-
-			Vec3f vLight = glm::normalize(light->pos - position);
+		colors[j] = Color3f(c.r, c.g, c.b);
+	}
 
-			float cosangle = glm::dot(normal, vLight);
+	LightBatch batch;
 
-			if(cosangle > 0.f) {
-				float distance = fdist(light->pos, position);
+	for(size_t i = 0; i < tls->el.size(); ) {
 
-				if(distance <= light->fallstart) {
-					cosangle *= light->intensity * GLOBAL_LIGHT_FACTOR;
-				} else {
-					float p = ((light->fallend - distance) * light->falldiffmul);
-
-					if(p <= 0.f)
-						cosangle = 0.f;
-					else
-						cosangle *= p * (light->intensity * GLOBAL_LIGHT_FACTOR);
-				}
-				cosangle *= 0.5f;
+		batch.clear();
+		for(; i < tls->el.size() && !batch.full(); i++) {
+			EERIE_LIGHT * light = tls->el[i];
+			float intensity = light->intensity * GLOBAL_LIGHT_FACTOR * 0.5f;
+			batch.add(light->pos, light->fallstart, light->fallend, light->falldiffmul,
+			          light->rgb255 * lightInfraFactor * intensity);
+		}
 
-				tempColor += light->rgb255 * lightInfraFactor * cosangle;
-			}
+		for(size_t j = 0; j < nbvert; j++) {
+			colors[j] = batch.accumulate(ep->v[j].p, ep->nrml[j], colors[j]);
 		}
+	}
 
-		u8 ir = clipByte255(tempColor.r);
-		u8 ig = clipByte255(tempColor.g);
-		u8 ib = clipByte255(tempColor.b);
-		ep->tv[j].color = Color(ir, ig, ib, 255).toRGBA();
+	for(size_t j = 0; j < nbvert; j++) {
+		ep->tv[j].color = batch.finish(colors[j]);
 	}
 }
 
@@ -61,6 +61,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 struct EERIE_LIGHT;
 struct EERIEPOLY;
 struct SMY_VERTEX;
+class LightBatch;
 class Entity;
 
 const size_t MAX_LIGHTS = 1200;
@@ -164,7 +165,14 @@ void ComputeTileLights(short x,short z);
 void ClearTileLights();
 
 float GetColorz(const Vec3f &pos);
-ColorRGBA ApplyLight(const glm::quat * quat, const Vec3f & position, const Vec3f & normal, const ColorMod & colorMod, float materialDiffuse = 1.f);
+
+/*!
+ * Prepare the lights selected by UpdateLlights() for lighting an object
+ *
+ * Use LightBatch::setRotation() and LightBatch::apply() with colorMod.ambientColor
+ * as the base color to light the object's vertices.
+ */
+void PrepareLlights(LightBatch & batch, const ColorMod & colorMod, float materialDiffuse = 1.f);
 void ApplyTileLights(EERIEPOLY * ep, const Vec2s & pos);
 
 void EERIERemovePrecalcLights();
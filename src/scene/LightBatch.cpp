@@ -0,0 +1,199 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scene/LightBatch.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ARX_LIGHTBATCH_SSE2 1
+#include <emmintrin.h>
+#else
+#define ARX_LIGHTBATCH_SSE2 0
+#endif
+
+#include "graphics/Math.h"
+#include "platform/Platform.h"
+
+LightBatch::LightBatch() {
+	clear();
+}
+
+void LightBatch::clear() {
+	m_count = 0;
+	m_rotated = false;
+	m_factor = Color3f::white;
+	m_term = Color3f::black;
+}
+
+void LightBatch::add(const Vec3f & pos, float fallstart, float fallend, float falldiffmul,
+                     const Color3f & color) {
+	
+	arx_assert(m_count < Capacity);
+	
+	size_t i = m_count++;
+	
+	if(i % 4 == 0) {
+		// Start a new group: unused lights have no color and are never visible
+		for(size_t j = i; j < i + 4; j++) {
+			m_x[j] = m_y[j] = m_z[j] = 0.f;
+			m_fallstart[j] = m_fallend[j] = m_falldiffmul[j] = 0.f;
+			m_r[j] = m_g[j] = m_b[j] = 0.f;
+		}
+	}
+	
+	m_x[i] = pos.x;
+	m_y[i] = pos.y;
+	m_z[i] = pos.z;
+	m_fallstart[i] = fallstart;
+	m_fallend[i] = fallend;
+	m_falldiffmul[i] = falldiffmul;
+	m_r[i] = color.r;
+	m_g[i] = color.g;
+	m_b[i] = color.b;
+}
+
+void LightBatch::setRotation(const glm::quat & rotation) {
+	
+	// dot(normal, inverse(rotation) * dir) == dot(transpose(M) * normal, dir)
+	// where the columns of M are the transformed basis vectors
+	glm::quat inverse = glm::inverse(rotation);
+	m_rotation[0] = inverse * Vec3f(1.f, 0.f, 0.f);
+	m_rotation[1] = inverse * Vec3f(0.f, 1.f, 0.f);
+	m_rotation[2] = inverse * Vec3f(0.f, 0.f, 1.f);
+	m_rotated = true;
+}
+
+void LightBatch::setColorMod(const Color3f & factor, const Color3f & term) {
+	m_factor = factor;
+	m_term = term;
+}
+
+Color3f LightBatch::accumulate(const Vec3f & position, const Vec3f & normal, Color3f color) const {
+	
+	Vec3f n = normal;
+	if(m_rotated) {
+		n = Vec3f(glm::dot(normal, m_rotation[0]), glm::dot(normal, m_rotation[1]),
+		          glm::dot(normal, m_rotation[2]));
+	}
+	
+	#if ARX_LIGHTBATCH_SSE2
+	
+	const __m128 px = _mm_set1_ps(position.x);
+	const __m128 py = _mm_set1_ps(position.y);
+	const __m128 pz = _mm_set1_ps(position.z);
+	const __m128 nx = _mm_set1_ps(n.x);
+	const __m128 ny = _mm_set1_ps(n.y);
+	const __m128 nz = _mm_set1_ps(n.z);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128i bias = _mm_set1_epi32(0x3f800000);
+	
+	__m128 r = zero;
+	__m128 g = zero;
+	__m128 b = zero;
+	
+	for(size_t i = 0; i < m_count; i += 4) {
+		
+		__m128 dx = _mm_sub_ps(_mm_load_ps(m_x + i), px);
+		__m128 dy = _mm_sub_ps(_mm_load_ps(m_y + i), py);
+		__m128 dz = _mm_sub_ps(_mm_load_ps(m_z + i), pz);
+		
+		__m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		
+		__m128 cosangle = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, dx), _mm_mul_ps(ny, dy)), _mm_mul_ps(nz, dz));
+		cosangle = _mm_div_ps(cosangle, _mm_sqrt_ps(dist2));
+		
+		// Same approximation as ffsqrt()
+		__m128i bits = _mm_sub_epi32(_mm_castps_si128(dist2), bias);
+		bits = _mm_add_epi32(_mm_srli_epi32(bits, 1), bias);
+		__m128 dist = _mm_castsi128_ps(bits);
+		
+		// Full intensity up to fallstart, then linear falloff until fallend
+		__m128 falloff = _mm_sub_ps(_mm_load_ps(m_fallend + i), dist);
+		falloff = _mm_max_ps(_mm_mul_ps(falloff, _mm_load_ps(m_falldiffmul + i)), zero);
+		__m128 inner = _mm_cmple_ps(dist, _mm_load_ps(m_fallstart + i));
+		falloff = _mm_or_ps(_mm_and_ps(inner, one), _mm_andnot_ps(inner, falloff));
+		
+		// Lights behind the surface (or at the vertex position) do not contribute
+		__m128 weight = _mm_and_ps(_mm_cmpgt_ps(cosangle, zero), _mm_mul_ps(cosangle, falloff));
+		
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m_r + i), weight));
+		g = _mm_add_ps(g, _mm_mul_ps(_mm_load_ps(m_g + i), weight));
+		b = _mm_add_ps(b, _mm_mul_ps(_mm_load_ps(m_b + i), weight));
+	}
+	
+	ARX_ALIGNAS(16) float sum[3][4];
+	_mm_store_ps(sum[0], r);
+	_mm_store_ps(sum[1], g);
+	_mm_store_ps(sum[2], b);
+	color.r += (sum[0][0] + sum[0][1]) + (sum[0][2] + sum[0][3]);
+	color.g += (sum[1][0] + sum[1][1]) + (sum[1][2] + sum[1][3]);
+	color.b += (sum[2][0] + sum[2][1]) + (sum[2][2] + sum[2][3]);
+	
+	#else
+	
+	for(size_t i = 0; i < m_count; i++) {
+		
+		Vec3f d(m_x[i] - position.x, m_y[i] - position.y, m_z[i] - position.z);
+		
+		float dist2 = glm::dot(d, d);
+		float cosangle = glm::dot(n, d) / std::sqrt(dist2);
+		if(!(cosangle > 0.f)) {
+			continue;
+		}
+		
+		float dist = ffsqrt(dist2);
+		
+		if(dist > m_fallstart[i]) {
+			float falloff = (m_fallend[i] - dist) * m_falldiffmul[i];
+			if(falloff <= 0.f) {
+				continue;
+			}
+			cosangle *= falloff;
+		}
+		
+		color.r += m_r[i] * cosangle;
+		color.g += m_g[i] * cosangle;
+		color.b += m_b[i] * cosangle;
+	}
+	
+	#endif
+	
+	return color;
+}
+
+ColorRGBA LightBatch::finish(Color3f color) const {
+	
+	color *= m_factor;
+	color += m_term;
+	
+	u8 ir = clipByte255(color.r);
+	u8 ig = clipByte255(color.g);
+	u8 ib = clipByte255(color.b);
+	
+	return Color(ir, ig, ib, 255).toRGBA();
+}
+
+void LightBatch::apply(const Vec3f * positions, const Vec3f * normals, size_t count,
+                       const Color3f & base, ColorRGBA * colors) const {
+	for(size_t i = 0; i < count; i++) {
+		colors[i] = apply(positions[i], normals[i], base);
+	}
+}
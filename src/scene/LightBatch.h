@@ -0,0 +1,113 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_SCENE_LIGHTBATCH_H
+#define ARX_SCENE_LIGHTBATCH_H
+
+#include <stddef.h>
+
+#include "graphics/Color.h"
+#include "math/Types.h"
+#include "platform/Alignment.h"
+
+/*!
+ * A list of point lights prepared for lighting many vertices.
+ *
+ * Lights are stored in structure-of-arrays form so that four of them can be
+ * evaluated at once with SSE2. A scalar implementation is used on other platforms.
+ *
+ * The lighting model is the one used for objects and background tiles:
+ * each light contributes color * max(cos(angle), 0) * attenuation, where the
+ * attenuation falls off linearly between fallstart and fallend. Like fdist(), the
+ * attenuation uses an approximate distance.
+ */
+class LightBatch {
+	
+public:
+	
+	//! Maximum number of lights in one batch
+	static const size_t Capacity = 32;
+	
+	LightBatch();
+	
+	//! Remove all lights, the rotation and the color modifier
+	void clear();
+	
+	size_t size() const { return m_count; }
+	bool empty() const { return m_count == 0; }
+	bool full() const { return m_count == Capacity; }
+	
+	/*!
+	 * Add a light to the batch
+	 *
+	 * \param color Light color, already scaled by the light's intensity.
+	 */
+	void add(const Vec3f & pos, float fallstart, float fallend, float falldiffmul,
+	         const Color3f & color);
+	
+	/*!
+	 * Set the rotation applied to light directions before comparing them with normals
+	 *
+	 * Equivalent to transforming each light direction by glm::inverse(rotation),
+	 * but only needs to transform the normal once per vertex.
+	 */
+	void setRotation(const glm::quat & rotation);
+	
+	//! Set the factor and offset applied to the final color
+	void setColorMod(const Color3f & factor, const Color3f & term);
+	
+	//! Add the light reaching a vertex to an existing color
+	Color3f accumulate(const Vec3f & position, const Vec3f & normal, Color3f color) const;
+	
+	//! Apply the color modifier to an accumulated color and convert it
+	ColorRGBA finish(Color3f color) const;
+	
+	//! Light a single vertex starting with the given base color
+	ColorRGBA apply(const Vec3f & position, const Vec3f & normal, const Color3f & base) const {
+		return finish(accumulate(position, normal, base));
+	}
+	
+	//! Light count vertices starting with the same base color
+	void apply(const Vec3f * positions, const Vec3f * normals, size_t count,
+	           const Color3f & base, ColorRGBA * colors) const;
+	
+private:
+	
+	size_t m_count;
+	
+	bool m_rotated;
+	Vec3f m_rotation[3]; //!< Rows of the matrix applied to normals
+	
+	Color3f m_factor;
+	Color3f m_term;
+	
+	// Padded to a multiple of four with lights that never contribute
+	ARX_ALIGNAS(16) float m_x[Capacity];
+	ARX_ALIGNAS(16) float m_y[Capacity];
+	ARX_ALIGNAS(16) float m_z[Capacity];
+	ARX_ALIGNAS(16) float m_fallstart[Capacity];
+	ARX_ALIGNAS(16) float m_fallend[Capacity];
+	ARX_ALIGNAS(16) float m_falldiffmul[Capacity];
+	ARX_ALIGNAS(16) float m_r[Capacity];
+	ARX_ALIGNAS(16) float m_g[Capacity];
+	ARX_ALIGNAS(16) float m_b[Capacity];
+	
+};
+
+#endif // ARX_SCENE_LIGHTBATCH_H
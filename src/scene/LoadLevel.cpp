@@ -50,11 +50,13 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <ctime>
 #include <iomanip>
 #include <sstream>
+#include <vector>
 
 #include <boost/algorithm/string/case_conv.hpp>
 
 #include "ai/PathFinderManager.h"
 #include "ai/Paths.h"
+#include "ai/Perception.h"
 
 #include "core/Application.h"
 #include "core/GameTime.h"
@@ -486,6 +488,32 @@ Vec3f MSP;
 
 extern long FASTmse;
 
+/*!
+ * Start decompressing the models and scripts for the entities in a level so
+ * that the worker threads can work on them while the scene is being loaded.
+ */
+static void prefetchLevelEntities(const DANAE_LS_INTER * dli, long count) {
+	
+	std::vector<res::path> files;
+	files.reserve(size_t(count) * 2);
+	
+	for(long i = 0; i < count; i++) {
+		
+		std::string pathstr = boost::to_lower_copy(util::loadString(dli[i].name));
+		
+		size_t pos = pathstr.find("graph");
+		if(pos != std::string::npos) {
+			pathstr = pathstr.substr(pos);
+		}
+		
+		res::path classPath = res::path::load(pathstr).remove_ext();
+		files.push_back(("game" / classPath) + ".ftl");
+		files.push_back(classPath + ".asl");
+	}
+	
+	resources->prefetch(files);
+}
+
 bool DanaeLoadLevel(const res::path & file, bool loadEntities) {
 	
 	LogInfo << "Loading Level " << file;
@@ -544,6 +572,11 @@ bool DanaeLoadLevel(const res::path & file, bool loadEntities) {
 		return false;
 	}
 	
+	if(loadEntities && dlh.nb_inter > 0) {
+		size_t interPos = pos + (dlh.nb_scn > 0 ? sizeof(DANAE_LS_SCENE) : 0);
+		prefetchLevelEntities(reinterpret_cast<const DANAE_LS_INTER *>(dat + interPos), dlh.nb_inter);
+	}
+	
 	LogDebug("Loading Scene");
 	
 	// Loading Scene
@@ -717,6 +750,8 @@ bool DanaeLoadLevel(const res::path & file, bool loadEntities) {
 			}
 		}
 		
+		EERIE_PATHFINDER_Update_Index();
+		
 	} else {
 		pos += sizeof(DANAE_LS_LIGHT) * nb_lights;
 	}
@@ -826,6 +861,9 @@ bool DanaeLoadLevel(const res::path & file, bool loadEntities) {
 			char * compressed = lightingFile->readAlloc();
 			dat = (char*)blastMemAlloc(compressed, lightingFile->size(), FileSize);
 			free(compressed);
+			if(!dat) {
+				LogError << "Could not decompress lighting file " << lightingFileName;
+			}
 		} else {
 			dat = lightingFile->readAlloc();
 			FileSize = lightingFile->size();
@@ -899,6 +937,8 @@ bool DanaeLoadLevel(const res::path & file, bool loadEntities) {
 		}
 	}
 	
+	EERIE_PATHFINDER_Update_Index();
+	
 	progressBarAdvance(2.f);
 	LoadLevelScreen();
 	
@@ -961,6 +1001,7 @@ void DanaeClearLevel(long flag)
 	FlyingOverIO = NULL;
 
 	EERIE_PATHFINDER_Release();
+	ARX_PERCEPTION_Clear();
 
 	InitBkg(ACTIVEBKG, MAX_BKGX, MAX_BKGZ, BKG_SIZX, BKG_SIZZ);
 	
@@ -1166,6 +1166,8 @@ void EERIE_CreateCedricData(EERIE_3DOBJ * eobj) {
 				outVert.z = temp.z;
 			}
 		}
+		
+		obj->vertices.build(obj->bones, eobj->vertexlocal);
 	}
 }
 
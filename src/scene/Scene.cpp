@@ -49,6 +49,8 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <cstdio>
 #include <cmath>
 
+#include <boost/scoped_ptr.hpp>
+
 #include "ai/Paths.h"
 
 #include "animation/AnimationRender.h"
@@ -87,6 +89,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "physics/Projectile.h"
 
+#include "platform/JobPool.h"
 #include "platform/profiler/Profiler.h"
 
 
@@ -1049,23 +1052,54 @@ static void RenderLava() {
 	vPolyLava.clear();
 }
 
-static void ARX_PORTALS_Frustrum_RenderRoomTCullSoft(long room_num, const EERIE_FRUSTRUM_DATA & frustrums, long tim) {
+//! Compute the lights for all tiles used by a room and their neighbours
+static void ARX_PORTALS_ComputeRoomTileLights(const EERIE_ROOM_DATA & room) {
 	
-	ARX_PROFILE_FUNC();
+	const EP_DATA * pEPDATA = &room.epdata[0];
 	
-	if(!RoomDraw[room_num].count)
-		return;
-
-	EERIE_ROOM_DATA & room = portals->rooms[room_num];
-
-	if(!room.pVertexBuffer) {
-		// No need to spam this for every frame as there will already be an
-		// earlier warning
-		LogDebug("no vertex data for room " << room_num);
-		return;
+	for(long lll = 0; lll < room.nb_polys; lll++, pEPDATA++) {
+		
+		if(ACTIVEBKG->fastdata[pEPDATA->p.x][pEPDATA->p.y].treat) {
+			continue;
+		}
+		
+		// TODO copy-paste background tiles
+		short tilex = pEPDATA->p.x;
+		short tilez = pEPDATA->p.y;
+		short radius = 1;
+		
+		short minx = std::max(tilex - radius, 0);
+		short maxx = std::min(tilex + radius, ACTIVEBKG->Xsize - 1);
+		short minz = std::max(tilez - radius, 0);
+		short maxz = std::min(tilez + radius, ACTIVEBKG->Zsize - 1);
+
+		for(short z = minz; z <= maxz; z++)
+		for(short x = minx; x <= maxx; x++) {
+			EERIE_BKG_INFO & feg2 = ACTIVEBKG->fastdata[x][z];
+
+			if(!feg2.treat) {
+				feg2.treat = true;
+				ComputeTileLights(x, z);
+			}
+		}
 	}
+}
 
-	SMY_VERTEX * pMyVertex = room.pVertexBuffer->lock(NoOverwrite);
+/*!
+ * Cull and light the polygons of one room
+ *
+ * This may run on any thread: it only writes to the room's own polygons, index ranges
+ * and vertex buffer, and to the given lava and water lists. Tile lights must already
+ * have been computed with ARX_PORTALS_ComputeRoomTileLights().
+ */
+static void ARX_PORTALS_Frustrum_RenderRoomTCullSoft(long room_num, const EERIE_FRUSTRUM_DATA & frustrums,
+                                                     long tim, SMY_VERTEX * pMyVertex,
+                                                     std::vector<EERIEPOLY *> & lava,
+                                                     std::vector<EERIEPOLY *> & water) {
+	
+	ARX_PROFILE_FUNC();
+	
+	EERIE_ROOM_DATA & room = portals->rooms[room_num];
 
 	unsigned short *pIndices=room.indexBuffer;
 
@@ -1074,28 +1108,6 @@ static void ARX_PORTALS_Frustrum_RenderRoomTCullSoft(long room_num, const EERIE_
 	for(long lll=0; lll<room.nb_polys; lll++, pEPDATA++) {
 		EERIE_BKG_INFO *feg = &ACTIVEBKG->fastdata[pEPDATA->p.x][pEPDATA->p.y];
 
-		if(!feg->treat) {
-			// TODO copy-paste background tiles
-			short tilex = pEPDATA->p.x;
-			short tilez = pEPDATA->p.y;
-			short radius = 1;
-			
-			short minx = std::max(tilex - radius, 0);
-			short maxx = std::min(tilex + radius, ACTIVEBKG->Xsize - 1);
-			short minz = std::max(tilez - radius, 0);
-			short maxz = std::min(tilez + radius, ACTIVEBKG->Zsize - 1);
-
-			for(short z = minz; z <= maxz; z++)
-			for(short x = minx; x <= maxx; x++) {
-				EERIE_BKG_INFO & feg2 = ACTIVEBKG->fastdata[x][z];
-
-				if(!feg2.treat) {
-					feg2.treat = true;
-					ComputeTileLights(x, z);
-				}
-			}
-		}
-
 		EERIEPOLY *ep = &feg->polydata[pEPDATA->idx];
 
 		if(!ep->tex) {
@@ -1182,10 +1194,10 @@ static void ARX_PORTALS_Frustrum_RenderRoomTCullSoft(long room_num, const EERIE_
 
 				if(ep->type & POLY_LAVA) {
 					ManageLava_VertexBuffer(ep, to, tim, pMyVertexCurr);
-					vPolyLava.push_back(ep);
+					lava.push_back(ep);
 				} else if(ep->type & POLY_WATER) {
 					ManageWater_VertexBuffer(ep, to, tim, pMyVertexCurr);
-					vPolyWater.push_back(ep);
+					water.push_back(ep);
 				}
 			}
 
@@ -1235,8 +1247,99 @@ static void ARX_PORTALS_Frustrum_RenderRoomTCullSoft(long room_num, const EERIE_
 			}
 		}
 	}
+}
+
+namespace {
+
+class RoomCullingJob : public JobPool::Job {
+	
+public:
+	
+	long room;
+	const EERIE_FRUSTRUM_DATA * frustrums;
+	long tim;
+	SMY_VERTEX * vertices;
+	std::vector<EERIEPOLY *> lava;
+	std::vector<EERIEPOLY *> water;
+	
+	void run() {
+		ARX_PORTALS_Frustrum_RenderRoomTCullSoft(room, *frustrums, tim, vertices, lava, water);
+	}
+	
+};
+
+boost::scoped_ptr<JobPool> sceneJobPool;
+std::vector<RoomCullingJob> roomCullingJobs;
+std::vector<JobPool::Job *> roomCullingJobList;
+
+} // anonymous namespace
+
+/*!
+ * Cull and light all visible rooms
+ *
+ * Each room is handled by a separate job on the room culling pool. Vertex buffers are
+ * locked and unlocked here as that must happen on the render thread.
+ */
+static void ARX_PORTALS_Frustrum_RenderRoomsTCullSoft(long tim) {
+	
+	ARX_PROFILE_FUNC();
+	
+	roomCullingJobs.resize(RoomDrawList.size());
+	roomCullingJobList.clear();
+	
+	for(size_t i = 0; i < RoomDrawList.size(); i++) {
+		
+		long room_num = RoomDrawList[i];
+		
+		if(!RoomDraw[room_num].count) {
+			continue;
+		}
+		
+		EERIE_ROOM_DATA & room = portals->rooms[room_num];
+		
+		if(!room.pVertexBuffer) {
+			// No need to spam this for every frame as there will already be an
+			// earlier warning
+			LogDebug("no vertex data for room " << room_num);
+			continue;
+		}
+		
+		// Tiles are shared between rooms
+		ARX_PORTALS_ComputeRoomTileLights(room);
+		
+		RoomCullingJob & job = roomCullingJobs[i];
+		job.room = room_num;
+		job.frustrums = &RoomDraw[room_num].frustrum;
+		job.tim = tim;
+		job.vertices = room.pVertexBuffer->lock(NoOverwrite);
+		job.lava.clear();
+		job.water.clear();
+		roomCullingJobList.push_back(&job);
+	}
+	
+	ARX_SCENE_GetJobPool().run(roomCullingJobList);
+	
+	for(size_t i = 0; i < roomCullingJobList.size(); i++) {
+		const RoomCullingJob & job = static_cast<const RoomCullingJob &>(*roomCullingJobList[i]);
+		portals->rooms[job.room].pVertexBuffer->unlock();
+		vPolyLava.insert(vPolyLava.end(), job.lava.begin(), job.lava.end());
+		vPolyWater.insert(vPolyWater.end(), job.water.begin(), job.water.end());
+	}
+}
+
+JobPool & ARX_SCENE_GetJobPool() {
+	
+	if(!sceneJobPool) {
+		sceneJobPool.reset(new JobPool("Scene"));
+	}
+	
+	return *sceneJobPool;
+}
 
-	room.pVertexBuffer->unlock();
+void ARX_SCENE_Release() {
+	sceneJobPool.reset();
+	roomCullingJobs.clear();
+	roomCullingJobList.clear();
 }
 
 
@@ -1475,9 +1578,7 @@ void ARX_SCENE_Update() {
 		CreateScreenFrustrum(&frustrum);
 		ARX_PORTALS_Frustrum_ComputeRoom(roomIndex, frustrum);
 
-		for(size_t i = 0; i < RoomDrawList.size(); i++) {
-			ARX_PORTALS_Frustrum_RenderRoomTCullSoft(RoomDrawList[i], RoomDraw[RoomDrawList[i]].frustrum, tim);
-		}
+		ARX_PORTALS_Frustrum_RenderRoomsTCullSoft(tim);
 	} else {
 		RoomDrawRelease();
 	}
@@ -50,6 +50,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "math/Types.h"
 
 class Entity;
+class JobPool;
 struct Sphere;
 
 long ARX_PORTALS_GetRoomNumForPosition(const Vec3f & pos, long flag = 0);
@@ -59,6 +60,16 @@ void ARX_SCENE_Render();
 bool ARX_SCENE_PORTAL_ClipIO(Entity * io, const Vec3f & position);
 void RoomDrawRelease();
 
+//! Stop the worker threads used by the scene update
+void ARX_SCENE_Release();
+
+/*!
+ * Pool of worker threads shared by all per-frame work that is split into jobs
+ *
+ * Must only be used from the main thread.
+ */
+JobPool & ARX_SCENE_GetJobPool();
+
 bool VisibleSphere(const Sphere & shpere);
 
 #endif // ARX_SCENE_SCENE_H
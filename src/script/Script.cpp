@@ -52,9 +52,11 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <cstdio>
 #include <algorithm>
 #include <limits>
+#include <vector>
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "ai/Paths.h"
 
@@ -101,37 +103,6 @@ long FORBID_SCRIPT_IO_CREATION = 0;
 SCR_TIMER * scr_timer = NULL;
 long ActiveTimers = 0;
 
-long FindScriptPos(const EERIE_SCRIPT * es, const std::string & str) {
-	
-	// TODO(script-parser) remove, respect quoted strings
-	
-	const char * start = es->data;
-	const char * end = es->data + es->size;
-	
-	while(true) {
-		
-		const char * dat = std::search(start, end, str.begin(), str.end());
-		if(dat + str.length() >= end) {
-			return -1;
-		}
-		
-		start = dat + 1;
-		if(((unsigned char)dat[str.length()]) > 32) {
-			continue;
-		}
-		
-		// Check if the line is commented out!
-		for(const char * search = dat; search[0] != '/' || search[1] != '/'; search--) {
-			if(*search == '\n' || search == es->data) {
-				return dat - es->data;
-			}
-		}
-		
-	}
-	
-	return -1;
-}
-
 ScriptResult SendMsgToAllIO(ScriptMessage msg, const std::string & params) {
 	
 	ScriptResult ret = ACCEPT;
@@ -270,16 +241,12 @@ void ARX_SCRIPT_AllowInterScriptExec() {
 
 static void ARX_SCRIPT_ReleaseLabels(EERIE_SCRIPT * es) {
 	
-	if(!es || !es->labels) {
+	if(!es) {
 		return;
 	}
 	
-	for(long i = 0; i < es->nb_labels; i++) {
-		free(es->labels[i].string);
-	}
-	free(es->labels);
-	es->labels = NULL;
-	es->nb_labels = 0;
+	es->events.clear();
+	es->labels.clear();
 }
 
 void ReleaseScript(EERIE_SCRIPT * es) {
@@ -1122,37 +1089,154 @@ void CloneLocalVars(Entity * ioo, Entity * io) {
 	ioo->script.lvar = io->script.lvar;
 }
 
-static SCRIPT_VAR * GetFreeVarSlot(SCRIPT_VARIABLES& _svff) {
-	_svff.resize(_svff.size() + 1);
-	SCRIPT_VAR * v = &_svff.back();
-	return v;
+namespace {
+
+typedef boost::unordered_map<std::string, u32> VariableIds;
+
+//! Interned script variable names - ids start at 1 and are never reused
+VariableIds variableIds;
+
+u32 getVariableId(const std::string & name) {
+	VariableIds::const_iterator it = variableIds.find(name);
+	return (it == variableIds.end()) ? 0 : it->second;
+}
+
+u32 internVariable(const std::string & name) {
+	VariableIds::const_iterator it = variableIds.find(name);
+	if(it != variableIds.end()) {
+		return it->second;
+	}
+	u32 id = u32(variableIds.size() + 1);
+	variableIds[name] = id;
+	return id;
+}
+
+size_t hashVariableId(u32 id) {
+	u32 hash = id * 2654435761u;
+	return size_t(hash ^ (hash >> 16));
 }
 
-static SCRIPT_VAR * GetVarAddress(SCRIPT_VARIABLES & svf, const std::string & name) {
+} // anonymous namespace
+
+void ScriptVariables::insert(u32 id, size_t var) const {
+	
+	size_t mask = m_index.size() - 1;
 	
-	for(SCRIPT_VARIABLES::iterator it = svf.begin(); it != svf.end(); ++it) {
-		if(it->type != TYPE_UNKNOWN) {
-			if(name == it->name) {
-				return &(*it);
+	for(size_t i = hashVariableId(id) & mask; ; i = (i + 1) & mask) {
+		Bucket & bucket = m_index[i];
+		if(bucket.id == 0) {
+			bucket.id = id;
+			bucket.var = u32(var);
+			return;
+		}
+		if(bucket.id == id) {
+			// Keep the first variable, unless it has no type and the new one does
+			if(m_vars[bucket.var].type == TYPE_UNKNOWN && m_vars[var].type != TYPE_UNKNOWN) {
+				bucket.var = u32(var);
 			}
+			return;
 		}
 	}
+}
 
+void ScriptVariables::rebuildIndex() const {
+	
+	// Keep the load factor at or below one half
+	size_t capacity = 8;
+	while(capacity < m_vars.size() * 2) {
+		capacity *= 2;
+	}
+	
+	Bucket empty = { 0, 0 };
+	m_index.assign(capacity, empty);
+	
+	for(size_t i = 0; i < m_vars.size(); i++) {
+		insert(internVariable(m_vars[i].name), i);
+	}
+	
+	m_indexed = true;
+}
+
+const SCRIPT_VAR * ScriptVariables::lookup(const std::string & name) const {
+	
+	if(m_vars.empty()) {
+		return NULL;
+	}
+	
+	if(!m_indexed) {
+		rebuildIndex();
+	}
+	
+	// Names that were never interned are not used by any variable
+	u32 id = getVariableId(name);
+	if(id == 0) {
+		return NULL;
+	}
+	
+	size_t mask = m_index.size() - 1;
+	
+	for(size_t i = hashVariableId(id) & mask; m_index[i].id != 0; i = (i + 1) & mask) {
+		if(m_index[i].id == id) {
+			return &m_vars[m_index[i].var];
+		}
+	}
+	
 	return NULL;
 }
 
+SCRIPT_VAR * ScriptVariables::find(const std::string & name) {
+	return const_cast<SCRIPT_VAR *>(lookup(name));
+}
+
+const SCRIPT_VAR * ScriptVariables::find(const std::string & name) const {
+	return lookup(name);
+}
+
+SCRIPT_VAR & ScriptVariables::add(const std::string & name) {
+	
+	m_vars.resize(m_vars.size() + 1);
+	m_vars.back().name = name;
+	
+	if(!m_indexed || m_index.size() < m_vars.size() * 2) {
+		rebuildIndex();
+	} else {
+		insert(internVariable(name), m_vars.size() - 1);
+	}
+	
+	return m_vars.back();
+}
+
+static SCRIPT_VAR * GetVarAddress(SCRIPT_VARIABLES & svf, const std::string & name) {
+	
+	SCRIPT_VAR * var = svf.find(name);
+	
+	return (var && var->type != TYPE_UNKNOWN) ? var : NULL;
+}
+
 static const SCRIPT_VAR * GetVarAddress(const SCRIPT_VARIABLES & svf,
                                         const std::string & name) {
 	
-	for(SCRIPT_VARIABLES::const_iterator it = svf.begin(); it != svf.end(); ++it) {
-		if(it->type != TYPE_UNKNOWN) {
-			if(name == it->name) {
-				return &(*it);
-			}
-		}
-	}
+	const SCRIPT_VAR * var = svf.find(name);
+	
+	return (var && var->type != TYPE_UNKNOWN) ? var : NULL;
+}
 
-	return NULL;
+//! Get the variable to set, creating it if needed
+static SCRIPT_VAR * GetVarSlot(SCRIPT_VARIABLES & svf, const std::string & name) {
+	
+	SCRIPT_VAR * var = svf.find(name);
+	
+	if(!var) {
+		return &svf.add(name);
+	}
+	
+	if(var->type == TYPE_UNKNOWN) {
+		// Reuse variables that were never assigned a type
+		*var = SCRIPT_VAR();
+		var->name = name;
+	}
+	
+	return var;
 }
 
 long GETVarValueLong(const SCRIPT_VARIABLES& svf, const std::string & name) {
@@ -1282,17 +1366,7 @@ float GetVarValueInterpretedAsFloat(const std::string & temp1, const EERIE_SCRIP
 
 SCRIPT_VAR* SETVarValueLong(SCRIPT_VARIABLES& svf, const std::string& name, long val)
 {
-	SCRIPT_VAR* tsv = GetVarAddress(svf, name);
-
-	if (!tsv)
-	{
-		tsv = GetFreeVarSlot(svf);
-
-		if (!tsv)
-			return NULL;
-
-		tsv->name = name;
-	}
+	SCRIPT_VAR* tsv = GetVarSlot(svf, name);
 
 	tsv->ival = val;
 	return tsv;
@@ -1300,17 +1374,7 @@ SCRIPT_VAR* SETVarValueLong(SCRIPT_VARIABLES& svf, const std::string& name, long
 
 SCRIPT_VAR* SETVarValueFloat(SCRIPT_VARIABLES& svf, const std::string& name, float val)
 {
-	SCRIPT_VAR* tsv = GetVarAddress(svf, name);
-
-	if (!tsv)
-	{
-		tsv = GetFreeVarSlot(svf);
-
-		if (!tsv)
-			return NULL;
-
-		tsv->name = name;
-	}
+	SCRIPT_VAR* tsv = GetVarSlot(svf, name);
 
 	tsv->fval = val;
 	return tsv;
@@ -1318,17 +1382,7 @@ SCRIPT_VAR* SETVarValueFloat(SCRIPT_VARIABLES& svf, const std::string& name, flo
 
 SCRIPT_VAR* SETVarValueText(SCRIPT_VARIABLES& svf, const std::string& name, const std::string& val)
 {
-	SCRIPT_VAR* tsv = GetVarAddress(svf, name);
-
-	if (!tsv)
-	{
-		tsv = GetFreeVarSlot(svf);
-
-		if (!tsv)
-			return NULL;
-
-		tsv->name = name.c_str();
-	}
+	SCRIPT_VAR* tsv = GetVarSlot(svf, name);
 	
 	tsv->text = val;
 	
@@ -1661,18 +1715,82 @@ ScriptResult SendInitScriptEvent(Entity * io) {
 	return ACCEPT;
 }
 
-//! Checks if timer named texx exists.
-static bool ARX_SCRIPT_Timer_Exist(const std::string & texx) {
+namespace {
+
+struct TimerQueueEntry {
+	
+	unsigned long time;
+	unsigned long serial;
+	long num;
+	
+	//! Order for a min-heap: earliest due time first, then by slot
+	bool operator<(const TimerQueueEntry & o) const {
+		if(time != o.time) {
+			return time > o.time;
+		}
+		return num > o.num;
+	}
+	
+};
+
+/*!
+ * Running timers, ordered by due time
+ *
+ * Entries are not removed when a timer is cleared or rescheduled - they are skipped
+ * once their serial number no longer matches the timer.
+ */
+std::vector<TimerQueueEntry> timerQueue;
+unsigned long timerSerial = 0;
+
+//! Unused timer slots
+std::vector<long> freeTimers;
+
+//! Number of running timers with each name
+typedef boost::unordered_map<std::string, size_t> TimerNames;
+TimerNames timerNames;
+
+//! Timers not owned by any entity
+long unownedTimers = -1;
+
+long & getTimerList(Entity * io) {
+	return io ? io->timers : unownedTimers;
+}
+
+void rebuildTimerQueue() {
+	
+	timerQueue.clear();
 	
 	for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
-		if(scr_timer[i].exist) {
-			if(scr_timer[i].name == texx) {
-				return true;
-			}
+		const SCR_TIMER & timer = scr_timer[i];
+		if(timer.exist) {
+			TimerQueueEntry entry = { timer.tim + timer.msecs, timer.serial, i };
+			timerQueue.push_back(entry);
 		}
 	}
 	
-	return false;
+	std::make_heap(timerQueue.begin(), timerQueue.end());
+}
+
+void scheduleTimer(long num) {
+	
+	// Drop stale entries before they outnumber the timers
+	if(timerQueue.size() >= size_t(2 * MAX_TIMER_SCRIPT)) {
+		rebuildTimerQueue();
+	}
+	
+	SCR_TIMER & timer = scr_timer[num];
+	timer.serial = ++timerSerial;
+	
+	TimerQueueEntry entry = { timer.tim + timer.msecs, timer.serial, num };
+	timerQueue.push_back(entry);
+	std::push_heap(timerQueue.begin(), timerQueue.end());
+}
+
+} // anonymous namespace
+
+//! Checks if timer named texx exists.
+static bool ARX_SCRIPT_Timer_Exist(const std::string & texx) {
+	return timerNames.find(texx) != timerNames.end();
 }
 
 std::string ARX_SCRIPT_Timer_GetDefaultName() {
@@ -1692,13 +1810,42 @@ std::string ARX_SCRIPT_Timer_GetDefaultName() {
 // Get a free script timer
 //*************************************************************************************
 long ARX_SCRIPT_Timer_GetFree() {
+	return freeTimers.empty() ? -1 : freeTimers.back();
+}
+
+void ARX_SCRIPT_Timer_Start(long num) {
 	
-	for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
-		if(!(scr_timer[i].exist))
-			return i;
+	SCR_TIMER & timer = scr_timer[num];
+	arx_assert(!timer.exist);
+	
+	if(!freeTimers.empty() && freeTimers.back() == num) {
+		freeTimers.pop_back();
+	} else {
+		std::vector<long>::iterator it = std::find(freeTimers.begin(), freeTimers.end(), num);
+		arx_assert(it != freeTimers.end());
+		freeTimers.erase(it);
 	}
 	
-	return -1;
+	timer.exist = 1;
+	ActiveTimers++;
+	
+	long & list = getTimerList(timer.io);
+	timer.prev = -1;
+	timer.next = list;
+	if(list != -1) {
+		scr_timer[list].prev = num;
+	}
+	list = num;
+	
+	timerNames[timer.name]++;
+	
+	scheduleTimer(num);
+}
+
+void ARX_SCRIPT_Timer_Reschedule(long num) {
+	if(scr_timer[num].exist) {
+		scheduleTimer(num);
+	}
 }
 
 //*************************************************************************************
@@ -1713,31 +1860,54 @@ long ARX_SCRIPT_CountTimers() {
 // Clears a timer by its Index (long timer_idx) on the timers list
 //*************************************************************************************
 void ARX_SCRIPT_Timer_ClearByNum(long timer_idx) {
-	if(scr_timer[timer_idx].exist) {
-		LogDebug("clearing timer " << scr_timer[timer_idx].name);
-		scr_timer[timer_idx].name.clear();
-		ActiveTimers--;
-		scr_timer[timer_idx].exist = 0;
+	
+	SCR_TIMER & timer = scr_timer[timer_idx];
+	if(!timer.exist) {
+		return;
+	}
+	
+	LogDebug("clearing timer " << timer.name);
+	
+	if(timer.prev != -1) {
+		scr_timer[timer.prev].next = timer.next;
+	} else {
+		getTimerList(timer.io) = timer.next;
+	}
+	if(timer.next != -1) {
+		scr_timer[timer.next].prev = timer.prev;
 	}
+	timer.prev = timer.next = -1;
+	
+	TimerNames::iterator it = timerNames.find(timer.name);
+	arx_assert(it != timerNames.end());
+	if(--it->second == 0) {
+		timerNames.erase(it);
+	}
+	
+	timer.name.clear();
+	ActiveTimers--;
+	timer.exist = 0;
+	
+	freeTimers.push_back(timer_idx);
 }
 
 void ARX_SCRIPT_Timer_Clear_By_Name_And_IO(const std::string & timername, Entity * io) {
-	for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
-		if(scr_timer[i].exist && scr_timer[i].io == io && scr_timer[i].name == timername) {
+	for(long i = getTimerList(io); i != -1; ) {
+		long next = scr_timer[i].next;
+		if(scr_timer[i].name == timername) {
 			ARX_SCRIPT_Timer_ClearByNum(i);
 		}
+		i = next;
 	}
 }
 
-void ARX_SCRIPT_Timer_Clear_All_Locals_For_IO(Entity * io)
-{
-	for (long i = 0; i < MAX_TIMER_SCRIPT; i++)
-	{
-		if (scr_timer[i].exist)
-		{
-			if ((scr_timer[i].io == io) && (scr_timer[i].es == &io->over_script))
-				ARX_SCRIPT_Timer_ClearByNum(i);
+void ARX_SCRIPT_Timer_Clear_All_Locals_For_IO(Entity * io) {
+	for(long i = getTimerList(io); i != -1; ) {
+		long next = scr_timer[i].next;
+		if(scr_timer[i].es == &io->over_script) {
+			ARX_SCRIPT_Timer_ClearByNum(i);
 		}
+		i = next;
 	}
 }
 
@@ -1754,6 +1924,18 @@ void ARX_SCRIPT_Timer_FirstInit(long number)
 	delete[] scr_timer;
 	scr_timer = new SCR_TIMER[MAX_TIMER_SCRIPT];
 	ActiveTimers = 0;
+	
+	// Hand out the lowest slots first
+	freeTimers.clear();
+	freeTimers.reserve(MAX_TIMER_SCRIPT);
+	for(long i = MAX_TIMER_SCRIPT - 1; i >= 0; i--) {
+		freeTimers.push_back(i);
+	}
+	
+	timerQueue.clear();
+	timerQueue.reserve(2 * MAX_TIMER_SCRIPT);
+	timerNames.clear();
+	unownedTimers = -1;
 }
 
 void ARX_SCRIPT_Timer_ClearAll()
@@ -1763,23 +1945,20 @@ void ARX_SCRIPT_Timer_ClearAll()
 			ARX_SCRIPT_Timer_ClearByNum(i);
 
 	ActiveTimers = 0;
+	timerQueue.clear();
 }
 
 void ARX_SCRIPT_Timer_Clear_For_IO(Entity * io) {
-	for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
-		if(scr_timer[i].exist && scr_timer[i].io == io) {
-			ARX_SCRIPT_Timer_ClearByNum(i);
-		}
+	while(getTimerList(io) != -1) {
+		ARX_SCRIPT_Timer_ClearByNum(getTimerList(io));
 	}
 }
 
 long ARX_SCRIPT_GetSystemIOScript(Entity * io, const std::string & name) {
 	
-	if(ActiveTimers) {
-		for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
-			if(scr_timer[i].exist && scr_timer[i].io == io && scr_timer[i].name == name) {
-				return i;
-			}
+	for(long i = getTimerList(io); i != -1; i = scr_timer[i].next) {
+		if(scr_timer[i].name == name) {
+			return i;
 		}
 	}
 	
@@ -1828,20 +2007,38 @@ void ARX_SCRIPT_Timer_Check() {
 	ARX_PROFILE_FUNC();
 	
 	if(!ActiveTimers) {
+		timerQueue.clear();
 		return;
 	}
 	
-	for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
+	unsigned long now = static_cast<unsigned long>(arxtime);
+	
+	// Timers (re)scheduled while running this frame's timers wait for the next frame
+	unsigned long lastSerial = timerSerial;
+	std::vector<TimerQueueEntry> postponed;
+	
+	while(!timerQueue.empty() && timerQueue.front().time <= now) {
+		
+		TimerQueueEntry entry = timerQueue.front();
+		std::pop_heap(timerQueue.begin(), timerQueue.end());
+		timerQueue.pop_back();
 		
+		if(entry.serial > lastSerial) {
+			postponed.push_back(entry);
+			continue;
+		}
+		
+		long i = entry.num;
 		SCR_TIMER * st = &scr_timer[i];
-		if(!st->exist) {
+		if(!st->exist || st->serial != entry.serial) {
+			// Timer was cleared or rescheduled
 			continue;
 		}
 		
-		unsigned long now = static_cast<unsigned long>(arxtime);
 		unsigned long fire_time = st->tim + st->msecs;
-		if(fire_time > now) {
-			// Timer not ready to fire yet
+		if(fire_time != entry.time) {
+			// Timer was delayed without being rescheduled
+			scheduleTimer(i);
 			continue;
 		}
 		
@@ -1851,6 +2048,7 @@ void ARX_SCRIPT_Timer_Check() {
 			st->tim += st->msecs * increment;
 			arx_assert(st->tim <= now && st->tim + st->msecs > now,
 			           "start=%lu wait=%ld now=%lu", st->tim, st->msecs, now);
+			scheduleTimer(i);
 			continue;
 		}
 		
@@ -1860,6 +2058,7 @@ void ARX_SCRIPT_Timer_Check() {
 		
 		if(!es && st->name == "_r_a_t_") {
 			if(Manage_Specific_RAT_Timer(st)) {
+				scheduleTimer(i);
 				continue;
 			}
 		}
@@ -1875,6 +2074,7 @@ void ARX_SCRIPT_Timer_Check() {
 				st->times--;
 			}
 			st->tim += st->msecs;
+			scheduleTimer(i);
 		}
 		
 		if(es && ValidIOAddress(io)) {
@@ -1885,6 +2085,11 @@ void ARX_SCRIPT_Timer_Check() {
 		}
 		
 	}
+	
+	for(size_t i = 0; i < postponed.size(); i++) {
+		timerQueue.push_back(postponed[i]);
+		std::push_heap(timerQueue.begin(), timerQueue.end());
+	}
 }
 
 void ARX_SCRIPT_Init_Event_Stats() {
@@ -2035,6 +2240,7 @@ void loadScript(EERIE_SCRIPT & script, PakFile * file) {
 		script.timers[j] = 0;
 	}
 	
+	ARX_SCRIPT_ComputeLabels(script);
 	ARX_SCRIPT_ComputeShortcuts(script);
 	
 }
@@ -52,7 +52,10 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <string>
 #include <vector>
 
+#include <boost/unordered_map.hpp>
+
 #include "platform/Flags.h"
+#include "platform/Platform.h"
 
 class PakFile;
 class Entity;
@@ -88,11 +91,6 @@ struct SCRIPT_VAR {
 	}
 };
 
-struct LABEL_INFO {
-	char * string;
-	long idx;
-};
-
 enum DisabledEvent {
 	DISABLE_HIT             = (1<<0),
 	DISABLE_CHAT            = (1<<1),
@@ -108,7 +106,69 @@ enum DisabledEvent {
 DECLARE_FLAGS(DisabledEvent, DisabledEvents)
 DECLARE_FLAGS_OPERATORS(DisabledEvents)
 
-typedef std::vector<SCRIPT_VAR> SCRIPT_VARIABLES;
+/*!
+ * A set of script variables
+ *
+ * Behaves like a std::vector<SCRIPT_VAR>, but also keeps an open-addressing hash index
+ * from interned variable names to entries so that lookups do not need to compare
+ * strings. Any mutable access to the entries invalidates the index, which is then
+ * rebuilt by the next lookup.
+ */
+class ScriptVariables {
+	
+public:
+	
+	typedef std::vector<SCRIPT_VAR>::iterator iterator;
+	typedef std::vector<SCRIPT_VAR>::const_iterator const_iterator;
+	
+	ScriptVariables() : m_indexed(true) { }
+	
+	size_t size() const { return m_vars.size(); }
+	bool empty() const { return m_vars.empty(); }
+	
+	SCRIPT_VAR & operator[](size_t i) { m_indexed = false; return m_vars[i]; }
+	const SCRIPT_VAR & operator[](size_t i) const { return m_vars[i]; }
+	
+	iterator begin() { m_indexed = false; return m_vars.begin(); }
+	iterator end() { m_indexed = false; return m_vars.end(); }
+	const_iterator begin() const { return m_vars.begin(); }
+	const_iterator end() const { return m_vars.end(); }
+	
+	void clear() { m_vars.clear(); m_index.clear(); m_indexed = true; }
+	void resize(size_t size) { m_vars.resize(size); m_indexed = false; }
+	iterator erase(iterator it) { m_indexed = false; return m_vars.erase(it); }
+	
+	/*!
+	 * Find the variable with the given name, including variables without a type
+	 *
+	 * If there are several variables with the same name, prefer the first one with a type.
+	 */
+	SCRIPT_VAR * find(const std::string & name);
+	const SCRIPT_VAR * find(const std::string & name) const;
+	
+	//! Add a new variable without checking if the name is already used
+	SCRIPT_VAR & add(const std::string & name);
+	
+private:
+	
+	struct Bucket {
+		u32 id; //!< Interned name, 0 for empty buckets
+		u32 var; //!< Index into m_vars
+	};
+	
+	std::vector<SCRIPT_VAR> m_vars;
+	mutable std::vector<Bucket> m_index;
+	mutable bool m_indexed;
+	
+	void rebuildIndex() const;
+	void insert(u32 id, size_t var) const;
+	const SCRIPT_VAR * lookup(const std::string & name) const;
+	
+};
+
+typedef ScriptVariables SCRIPT_VARIABLES;
+
+typedef boost::unordered_map<std::string, long> ScriptLabels;
 
 struct EERIE_SCRIPT {
 	size_t size;
@@ -119,10 +179,10 @@ struct EERIE_SCRIPT {
 	DisabledEvents allowevents;
 	EERIE_SCRIPT * master;
 	long shortcut[MAX_SHORTCUT];
-	long nb_labels;
-	LABEL_INFO * labels;
+	ScriptLabels events; //!< Positions of the "on <event>" handlers, by event name
+	ScriptLabels labels; //!< Positions of the ">>label" targets, by label name
 
-	EERIE_SCRIPT() : size(), data(), lastcall(), allowevents(), master(), nb_labels(), labels() {
+	EERIE_SCRIPT() : size(), data(), lastcall(), allowevents(), master() {
 		memset(&timers, 0, sizeof(timers));
 		memset(&shortcut, 0, sizeof(shortcut));
 	}
@@ -141,8 +201,14 @@ struct SCR_TIMER {
 	Entity * io;
 	EERIE_SCRIPT * es;
 	
+	// Bookkeeping for running timers, maintained by ARX_SCRIPT_Timer_Start() and ClearByNum()
+	long prev; //!< Previous timer owned by the same entity or -1
+	long next; //!< Next timer owned by the same entity or -1
+	unsigned long serial; //!< Identifies the current entry in the timer queue
+	
 	inline SCR_TIMER() : name(), exist(0), flags(0), times(0),
-	                     msecs(0), pos(0), longinfo(0), tim(0), io(NULL), es(NULL) { }
+	                     msecs(0), pos(0), longinfo(0), tim(0), io(NULL), es(NULL),
+	                     prev(-1), next(-1), serial(0) { }
 	
 	inline void reset() {
 		name.clear();
@@ -155,6 +221,9 @@ struct SCR_TIMER {
 		tim = 0;
 		io = NULL;
 		es = NULL;
+		prev = -1;
+		next = -1;
+		serial = 0;
 	}
 	
 };
@@ -427,7 +496,27 @@ void ARX_SCRIPT_Timer_Check();
 void ARX_SCRIPT_Timer_FirstInit(long number);
 void ARX_SCRIPT_Timer_ClearAll();
 void ARX_SCRIPT_Timer_Clear_For_IO(Entity * io);
+
+/*!
+ * Get the index of an unused timer slot
+ *
+ * The slot is only taken once its fields have been filled in and it has been
+ * passed to \ref ARX_SCRIPT_Timer_Start.
+ *
+ * \return the slot index or -1 if all timers are in use.
+ */
 long ARX_SCRIPT_Timer_GetFree();
+
+/*!
+ * Start the timer in a slot returned by \ref ARX_SCRIPT_Timer_GetFree
+ *
+ * The name, entity, start time and period must already be set and the name and
+ * entity must not change while the timer is running.
+ */
+void ARX_SCRIPT_Timer_Start(long num);
+
+//! Update the due time of a running timer after changing its start time or period
+void ARX_SCRIPT_Timer_Reschedule(long num);
  
 void ARX_SCRIPT_SetMainEvent(Entity * io, const std::string & newevent);
 void ARX_SCRIPT_EventStackExecute(size_t limit = 20);
@@ -487,6 +576,20 @@ void Stack_SendIOScriptEvent(Entity * io, ScriptMessage msg, const std::string &
  */
 long FindScriptPos(const EERIE_SCRIPT * es, const std::string & str);
 
+/*!
+ * Index all "on <event>" handlers and ">>label" targets in a script
+ *
+ * Like FindScriptPos(), this records the first occurrence of each name that is not
+ * in a // comment and is followed by a separator.
+ */
+void ARX_SCRIPT_ComputeLabels(EERIE_SCRIPT & es);
+
+//! \return the position of the "on <name>" handler in the script, or -1
+long FindScriptEvent(const EERIE_SCRIPT * es, const std::string & name);
+
+//! \return the position of the ">>name" label in the script, or -1
+long FindScriptLabel(const EERIE_SCRIPT * es, const std::string & name);
+
 void CloneLocalVars(Entity * ioo, Entity * io);
 void ARX_SCRIPT_Free_All_Global_Variables();
 void MakeLocalText(EERIE_SCRIPT * es, std::string & tx);
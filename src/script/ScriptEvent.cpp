@@ -43,6 +43,8 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "script/ScriptEvent.h"
 
+#include <boost/algorithm/string/predicate.hpp>
+
 #include "core/GameTime.h"
 #include "core/Core.h"
 
@@ -155,7 +157,12 @@ void ARX_SCRIPT_ComputeShortcuts(EERIE_SCRIPT& es)
 	long nb = std::min((long)MAX_SHORTCUT, (long)SM_MAXCMD);
 
 	for (long j = 1; j < nb; j++) {
-		es.shortcut[j] = FindScriptPos(&es, AS_EVENT[j].name);
+		const std::string & name = AS_EVENT[j].name;
+		if(boost::starts_with(name, "on ")) {
+			es.shortcut[j] = FindScriptEvent(&es, name.substr(3));
+		} else {
+			es.shortcut[j] = FindScriptPos(&es, name);
+		}
 	}
 }
 
@@ -254,7 +261,6 @@ ScriptResult ScriptEvent::send(EERIE_SCRIPT * es, ScriptMessage msg, const std::
                                Entity * io, const std::string & evname, long info) {
 	
 	ScriptResult ret = ACCEPT;
-	std::string eventname;
 	long pos;
 	
 	totalCount++;
@@ -275,8 +281,7 @@ ScriptResult ScriptEvent::send(EERIE_SCRIPT * es, ScriptMessage msg, const std::
 	
 	// Finds script position to execute code...
 	if (!evname.empty()) {
-		eventname = "on " + evname;
-		pos = FindScriptPos(es, eventname);
+		pos = FindScriptEvent(es, evname);
 	} else {
 		if (msg == SM_EXECUTELINE) {
 			pos = info;
@@ -357,7 +362,7 @@ ScriptResult ScriptEvent::send(EERIE_SCRIPT * es, ScriptMessage msg, const std::
 
 	if (msg != SM_EXECUTELINE) {
 		if (!evname.empty()) {
-			pos += eventname.length(); // adding 'ON ' length
+			pos += 3 + evname.length(); // adding 'ON ' length
 		} else {
 			pos += AS_EVENT[msg].name.length();
 		}
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2011-2012 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/* Based on:
+===========================================================================
+ARX FATALIS GPL Source Code
+Copyright (C) 1999-2010 Arkane Studios SA, a ZeniMax Media company.
+
+This file is part of the Arx Fatalis GPL Source Code ('Arx Fatalis Source Code'). 
+
+Arx Fatalis Source Code is free software: you can redistribute it and/or modify it under the terms of the GNU General Public 
+License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+Arx Fatalis Source Code is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with Arx Fatalis Source Code.  If not, see 
+<http://www.gnu.org/licenses/>.
+
+In addition, the Arx Fatalis Source Code is also subject to certain additional terms. You should have received a copy of these 
+additional terms immediately following the terms and conditions of the GNU General Public License which accompanied the Arx 
+Fatalis Source Code. If not, please request a copy in writing from Arkane Studios at the address below.
+
+If you have questions concerning this license or the applicable additional terms, you may contact in writing Arkane Studios, c/o 
+ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
+===========================================================================
+*/
+// Code: Cyril Meynier
+//
+// Copyright (c) 1999-2000 ARKANE Studios SA. All rights reserved
+
+#include "script/Script.h"
+
+#include <stddef.h>
+#include <algorithm>
+#include <string>
+#include <utility>
+
+long FindScriptPos(const EERIE_SCRIPT * es, const std::string & str) {
+	
+	// TODO(script-parser) remove, respect quoted strings
+	
+	const char * start = es->data;
+	const char * end = es->data + es->size;
+	
+	while(true) {
+		
+		const char * dat = std::search(start, end, str.begin(), str.end());
+		if(dat + str.length() >= end) {
+			return -1;
+		}
+		
+		start = dat + 1;
+		if(((unsigned char)dat[str.length()]) > 32) {
+			continue;
+		}
+		
+		// Check if the line is commented out!
+		for(const char * search = dat; search[0] != '/' || search[1] != '/'; search--) {
+			if(*search == '\n' || search == es->data) {
+				return dat - es->data;
+			}
+		}
+		
+	}
+	
+	return -1;
+}
+
+void ARX_SCRIPT_ComputeLabels(EERIE_SCRIPT & es) {
+	
+	es.events.clear();
+	es.labels.clear();
+	
+	const char * data = es.data;
+	size_t size = es.size;
+	
+	bool commented = false;
+	
+	for(size_t i = 0; i < size; i++) {
+		
+		if(data[i] == '\n') {
+			commented = false;
+			continue;
+		}
+		
+		if(commented) {
+			continue;
+		}
+		
+		ScriptLabels * table;
+		size_t begin;
+		if(data[i] == '/' && i + 1 < size && data[i + 1] == '/') {
+			commented = true;
+			continue;
+		} else if(data[i] == 'o' && i + 2 < size && data[i + 1] == 'n' && data[i + 2] == ' ') {
+			table = &es.events;
+			begin = i + 3;
+		} else if(data[i] == '>' && i + 1 < size && data[i + 1] == '>') {
+			table = &es.labels;
+			begin = i + 2;
+		} else {
+			continue;
+		}
+		
+		size_t end = begin;
+		while(end < size && ((unsigned char)data[end]) > 32) {
+			end++;
+		}
+		
+		if(end != begin && end < size) {
+			table->insert(std::make_pair(std::string(data + begin, data + end), long(i)));
+		}
+	}
+}
+
+long FindScriptEvent(const EERIE_SCRIPT * es, const std::string & name) {
+	ScriptLabels::const_iterator it = es->events.find(name);
+	return (it == es->events.end()) ? -1 : it->second;
+}
+
+long FindScriptLabel(const EERIE_SCRIPT * es, const std::string & name) {
+	ScriptLabels::const_iterator it = es->labels.find(name);
+	return (it == es->labels.end()) ? -1 : it->second;
+}
@@ -258,7 +258,7 @@ bool Context::jumpToLabel(const std::string & target, bool substack) {
 		stack.push_back(pos);
 	}
 	
-	long targetpos = FindScriptPos(script, ">>" + target);
+	long targetpos = FindScriptLabel(script, target);
 	if(targetpos == -1) {
 		return false;
 	}
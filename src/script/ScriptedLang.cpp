@@ -885,9 +885,7 @@ void timerCommand(const std::string & timer, Context & context) {
 		return;
 	}
 	
-	ActiveTimers++;
 	scr_timer[num].es = context.getScript();
-	scr_timer[num].exist = 1;
 	scr_timer[num].io = io;
 	scr_timer[num].msecs = millisecons;
 	scr_timer[num].name = timername;
@@ -897,6 +895,7 @@ void timerCommand(const std::string & timer, Context & context) {
 	
 	scr_timer[num].flags = (idle && io) ? 1 : 0;
 	
+	ARX_SCRIPT_Timer_Start(num);
 }
 
 void setupScriptedLang() {
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tests/animation/SkinningTest.h"
+
+#include <vector>
+
+#include "src/animation/Skeleton.h"
+#include "src/animation/Skinning.h"
+
+#include "tests/util/TestRandom.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SkinningTest);
+
+namespace {
+
+// Bones with 0 to 20 vertices each so that all SIMD tail lengths are covered
+std::vector<Bone> makeBones(TestRandom & gen, size_t vertexCount) {
+	
+	std::vector<Bone> bones(12);
+	for(size_t v = 0; v < vertexCount; v++) {
+		// Leave one bone without vertices
+		unsigned bone = gen.getIndex(unsigned(bones.size() - 1));
+		bones[bone < 3 ? bone : bone + 1].idxvertices.push_back(long(v));
+	}
+	
+	return bones;
+}
+
+glm::mat4x4 makeMatrix(TestRandom & gen) {
+	
+	glm::mat4x4 matrix = glm::toMat4(gen.getRotation());
+	
+	Vec3f scale(gen.get(0.5f, 2.f), gen.get(0.5f, 2.f), gen.get(0.5f, 2.f));
+	for(int i = 0; i < 3; i++) {
+		matrix[0][i] *= scale.x;
+		matrix[1][i] *= scale.y;
+		matrix[2][i] *= scale.z;
+	}
+	
+	return matrix;
+}
+
+} // anonymous namespace
+
+void SkinningTest::layoutTest() {
+	
+	TestRandom gen(1);
+	
+	std::vector<Vec3f> local(130);
+	for(size_t v = 0; v < local.size(); v++) {
+		local[v] = gen.getVec(100.f);
+	}
+	
+	std::vector<Bone> bones = makeBones(gen, local.size());
+	
+	SkinnedVertices vertices;
+	vertices.build(bones, &local[0]);
+	
+	CPPUNIT_ASSERT_EQUAL(local.size(), vertices.size());
+	CPPUNIT_ASSERT_EQUAL(size_t(0), vertices.begin(0));
+	CPPUNIT_ASSERT_EQUAL(vertices.size(), vertices.end(bones.size() - 1));
+	CPPUNIT_ASSERT(vertices.begin(3) == vertices.end(3));
+	
+	for(size_t i = 0; i < bones.size(); i++) {
+		CPPUNIT_ASSERT_EQUAL(bones[i].idxvertices.size(), vertices.end(i) - vertices.begin(i));
+		for(size_t v = 0; v < bones[i].idxvertices.size(); v++) {
+			CPPUNIT_ASSERT_EQUAL(bones[i].idxvertices[v], vertices.indices()[vertices.begin(i) + v]);
+		}
+	}
+	
+	vertices.clear();
+	CPPUNIT_ASSERT_EQUAL(size_t(0), vertices.size());
+}
+
+void SkinningTest::transformTest() {
+	
+	TestRandom gen(2);
+	
+	std::vector<Vec3f> local(250);
+	for(size_t v = 0; v < local.size(); v++) {
+		local[v] = gen.getVec(200.f);
+	}
+	
+	std::vector<Bone> bones = makeBones(gen, local.size());
+	
+	SkinnedVertices vertices;
+	vertices.build(bones, &local[0]);
+	
+	std::vector<Vec3f> out(local.size() + 1);
+	
+	for(int pass = 0; pass < 20; pass++) {
+		for(size_t i = 0; i < bones.size(); i++) {
+			
+			glm::mat4x4 matrix = makeMatrix(gen);
+			Vec3f translation = gen.getVec(1000.f);
+			
+			// Transform a sub-range to check that it does not write past the end
+			size_t begin = vertices.begin(i) + size_t(pass % 2);
+			size_t end = vertices.end(i);
+			if(begin >= end) {
+				continue;
+			}
+			Vec3f guard(-1.f, -2.f, -3.f);
+			out[end - begin] = guard;
+			vertices.transform(begin, end, matrix, translation, &out[0]);
+			CPPUNIT_ASSERT(bitEqual(guard, out[end - begin]));
+			
+			for(size_t v = begin; v < end; v++) {
+				// The expression used before the vertices were sorted by bone
+				Vec3f expected = Vec3f(matrix * Vec4f(local[vertices.indices()[v]], 1.f));
+				expected += translation;
+				CPPUNIT_ASSERT(bitEqual(expected, out[v - begin]));
+			}
+		}
+	}
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tests/graphics/MeshTweakTest.h"
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "src/graphics/GraphicsTypes.h"
+#include "src/graphics/data/MeshManipulation.h"
+#include "src/graphics/data/MeshTweak.h"
+#include "src/scene/Object.h"
+
+#include "tests/graphics/LegacyMeshTweak.h"
+#include "tests/util/TestRandom.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MeshTweakTest);
+
+// The test meshes have no physics, animation or collision data, so there is no need
+// to link scene/Object.cpp and everything it depends on.
+
+EERIE_3DOBJ::~EERIE_3DOBJ() { }
+
+long EERIE_OBJECT_GetSelection(const EERIE_3DOBJ * obj, const std::string & selname) {
+	
+	for(size_t i = 0; i < obj->selections.size(); i++) {
+		if(obj->selections[i].name == selname) {
+			return i;
+		}
+	}
+	
+	return -1;
+}
+
+namespace {
+
+// Only the pointers are compared, so the textures are never dereferenced
+char textures[4];
+
+TextureContainer * getTexture(size_t i) {
+	return reinterpret_cast<TextureContainer *>(&textures[i]);
+}
+
+/*!
+ * Build a small mesh with the selections and action points needed for tweaking
+ *
+ * Positions come from a coarse grid so that there are many vertices at the same
+ * position, both within one mesh and between the two merged meshes. Some positions
+ * use -0 or NaN.
+ */
+EERIE_3DOBJ * makeMesh(TestRandom & gen, const std::string & extra) {
+	
+	EERIE_3DOBJ * obj = new EERIE_3DOBJ;
+	
+	const float coords[] = { -1.f, -0.f, 0.f, 1.f };
+	
+	obj->vertexlist.resize(40);
+	for(size_t i = 0; i < obj->vertexlist.size(); i++) {
+		EERIE_VERTEX & vertex = obj->vertexlist[i];
+		vertex.v = Vec3f(coords[gen.getIndex(4)], coords[gen.getIndex(4)], coords[gen.getIndex(4)]);
+		if(gen.getChance(3)) {
+			vertex.v.y = std::numeric_limits<float>::quiet_NaN();
+		}
+		vertex.norm = Vec3f(float(i), 0.f, 0.f);
+	}
+	obj->origin = gen.getIndex(unsigned(obj->vertexlist.size()));
+	obj->point0 = Vec3f(float(gen.getIndex(10)), 0.f, 0.f);
+	
+	obj->texturecontainer.push_back(getTexture(gen.getIndex(4)));
+	obj->texturecontainer.push_back(getTexture(gen.getIndex(4)));
+	
+	obj->facelist.resize(50);
+	for(size_t i = 0; i < obj->facelist.size(); i++) {
+		EERIE_FACE & face = obj->facelist[i];
+		for(size_t j = 0; j < 3; j++) {
+			face.vid[j] = (unsigned short)gen.getIndex(unsigned(obj->vertexlist.size()));
+		}
+		face.texid = short(gen.getIndex(3)) - 1;
+		face.transval = float(i);
+	}
+	
+	const char * names[] = { "head", "chest", "leggings", extra.c_str(), "shared" };
+	obj->selections.resize(5);
+	for(size_t i = 0; i < obj->selections.size(); i++) {
+		obj->selections[i].name = names[i];
+		for(size_t v = 0; v < obj->vertexlist.size(); v++) {
+			// Body parts overlap a little at the seams
+			bool selected = (i < 3) ? (v * 3 / obj->vertexlist.size() == i || gen.getChance(10))
+			                        : gen.getChance(30);
+			if(selected) {
+				obj->selections[i].selected.push_back(long(v));
+			}
+		}
+	}
+	
+	const char * actions[] = { "head2chest", "chest2leggings", "primary_attach", extra.c_str() };
+	obj->actionlist.resize(4);
+	for(size_t i = 0; i < obj->actionlist.size(); i++) {
+		obj->actionlist[i].name = actions[i];
+		obj->actionlist[i].idx = gen.getIndex(unsigned(obj->vertexlist.size()));
+		obj->actionlist[i].act = long(i);
+		obj->actionlist[i].sfx = long(i) + 10;
+	}
+	
+	obj->grouplist.resize(3 + gen.getIndex(3));
+	for(size_t i = 0; i < obj->grouplist.size(); i++) {
+		VertexGroup & group = obj->grouplist[i];
+		group.name = extra + char('a' + i);
+		group.origin = gen.getIndex(unsigned(obj->vertexlist.size()));
+		group.siz = float(i) + 0.5f;
+		for(size_t v = 0; v < obj->vertexlist.size(); v++) {
+			if(gen.getChance(25)) {
+				group.indexes.push_back(long(v));
+			}
+		}
+	}
+	
+	return obj;
+}
+
+void checkEqual(const EERIE_3DOBJ * expected, const EERIE_3DOBJ * actual) {
+	
+	CPPUNIT_ASSERT(expected != NULL);
+	CPPUNIT_ASSERT(actual != NULL);
+	
+	CPPUNIT_ASSERT_EQUAL(expected->origin, actual->origin);
+	CPPUNIT_ASSERT(bitEqual(expected->point0, actual->point0));
+	
+	CPPUNIT_ASSERT_EQUAL(expected->vertexlist.size(), actual->vertexlist.size());
+	for(size_t i = 0; i < expected->vertexlist.size(); i++) {
+		CPPUNIT_ASSERT(bitEqual(expected->vertexlist[i].v, actual->vertexlist[i].v));
+		CPPUNIT_ASSERT(bitEqual(expected->vertexlist[i].norm, actual->vertexlist[i].norm));
+	}
+	CPPUNIT_ASSERT_EQUAL(expected->vertexlist3.size(), actual->vertexlist3.size());
+	
+	CPPUNIT_ASSERT_EQUAL(expected->facelist.size(), actual->facelist.size());
+	for(size_t i = 0; i < expected->facelist.size(); i++) {
+		for(size_t j = 0; j < 3; j++) {
+			CPPUNIT_ASSERT_EQUAL(expected->facelist[i].vid[j], actual->facelist[i].vid[j]);
+		}
+		CPPUNIT_ASSERT_EQUAL(expected->facelist[i].texid, actual->facelist[i].texid);
+		CPPUNIT_ASSERT_EQUAL(expected->facelist[i].transval, actual->facelist[i].transval);
+	}
+	
+	CPPUNIT_ASSERT(expected->texturecontainer == actual->texturecontainer);
+	
+	CPPUNIT_ASSERT_EQUAL(expected->selections.size(), actual->selections.size());
+	for(size_t i = 0; i < expected->selections.size(); i++) {
+		CPPUNIT_ASSERT_EQUAL(expected->selections[i].name, actual->selections[i].name);
+		CPPUNIT_ASSERT(expected->selections[i].selected == actual->selections[i].selected);
+	}
+	
+	CPPUNIT_ASSERT_EQUAL(expected->grouplist.size(), actual->grouplist.size());
+	for(size_t i = 0; i < expected->grouplist.size(); i++) {
+		CPPUNIT_ASSERT_EQUAL(expected->grouplist[i].name, actual->grouplist[i].name);
+		CPPUNIT_ASSERT_EQUAL(expected->grouplist[i].origin, actual->grouplist[i].origin);
+		CPPUNIT_ASSERT_EQUAL(expected->grouplist[i].siz, actual->grouplist[i].siz);
+		CPPUNIT_ASSERT(expected->grouplist[i].indexes == actual->grouplist[i].indexes);
+	}
+	
+	CPPUNIT_ASSERT_EQUAL(expected->actionlist.size(), actual->actionlist.size());
+	for(size_t i = 0; i < expected->actionlist.size(); i++) {
+		CPPUNIT_ASSERT_EQUAL(expected->actionlist[i].name, actual->actionlist[i].name);
+		CPPUNIT_ASSERT_EQUAL(expected->actionlist[i].idx, actual->actionlist[i].idx);
+		CPPUNIT_ASSERT_EQUAL(expected->actionlist[i].act, actual->actionlist[i].act);
+		CPPUNIT_ASSERT_EQUAL(expected->actionlist[i].sfx, actual->actionlist[i].sfx);
+	}
+}
+
+const long tweakTypes[] = { TWEAK_HEAD, TWEAK_TORSO, TWEAK_LEGS };
+
+} // anonymous namespace
+
+void MeshTweakTest::mergeTest() {
+	
+	for(unsigned long long seed = 1; seed <= 50; seed++) {
+		
+		TestRandom gen(seed);
+		EERIE_3DOBJ * obj1 = makeMesh(gen, "base");
+		EERIE_3DOBJ * obj2 = makeMesh(gen, "tweak");
+		
+		for(size_t i = 0; i < 3; i++) {
+			EERIE_3DOBJ * expected = legacy::CreateIntermediaryMesh(obj1, obj2, tweakTypes[i]);
+			EERIE_3DOBJ * actual = CreateIntermediaryMesh(obj1, obj2, tweakTypes[i]);
+			checkEqual(expected, actual);
+			delete expected;
+			delete actual;
+		}
+		
+		delete obj1;
+		delete obj2;
+	}
+}
+
+void MeshTweakTest::repeatedMergeTest() {
+	
+	// Merged meshes are merged again when more than one part is tweaked
+	for(unsigned long long seed = 100; seed <= 120; seed++) {
+		
+		TestRandom gen(seed);
+		EERIE_3DOBJ * base = makeMesh(gen, "base");
+		
+		EERIE_3DOBJ * expected = base;
+		EERIE_3DOBJ * actual = base;
+		for(size_t i = 0; i < 3; i++) {
+			
+			EERIE_3DOBJ * tweak = makeMesh(gen, "tweak");
+			
+			EERIE_3DOBJ * nextExpected = legacy::CreateIntermediaryMesh(expected, tweak, tweakTypes[i]);
+			EERIE_3DOBJ * nextActual = CreateIntermediaryMesh(actual, tweak, tweakTypes[i]);
+			checkEqual(nextExpected, nextActual);
+			
+			if(expected != base) {
+				delete expected;
+				delete actual;
+			}
+			expected = nextExpected;
+			actual = nextActual;
+			
+			delete tweak;
+		}
+		
+		delete expected;
+		delete actual;
+		delete base;
+	}
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tests/io/BlastTest.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "src/io/Blast.h"
+
+#include "tests/util/TestRandom.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BlastTest);
+
+namespace {
+
+// Example stream from the format description referenced in Blast.cpp
+const unsigned char example[] = { 0x00, 0x04, 0x82, 0x24, 0x25, 0x8f, 0x80, 0x7f };
+const char exampleResult[] = "AIAIAIAIAIAIA";
+
+// Decode using both the streaming and the table-driven decoder and compare the results
+void checkSame(const std::vector<unsigned char> & input) {
+	
+	const char * data = reinterpret_cast<const char *>(&input[0]);
+	
+	BlastMemInBuffer in(data, input.size());
+	BlastMemOutBufferRealloc expected;
+	BlastResult expectedResult = blast(blastInMem, &in, blastOutMemRealloc, &expected);
+	
+	BlastMemOutBufferRealloc actual;
+	BlastResult actualResult = blastBuffer(data, input.size(), actual);
+	
+	CPPUNIT_ASSERT_EQUAL(expectedResult, actualResult);
+	CPPUNIT_ASSERT_EQUAL(expected.fillSize, actual.fillSize);
+	if(expected.fillSize != 0) {
+		CPPUNIT_ASSERT(std::memcmp(expected.buf, actual.buf, expected.fillSize) == 0);
+	}
+	
+	free(expected.buf);
+	free(actual.buf);
+}
+
+} // anonymous namespace
+
+void BlastTest::exampleTest() {
+	
+	const char * data = reinterpret_cast<const char *>(example);
+	
+	char buffer[32];
+	size_t size = blastMem(data, sizeof(example), buffer, sizeof(buffer));
+	CPPUNIT_ASSERT_EQUAL(std::string(exampleResult), std::string(buffer, size));
+	
+	size_t allocSize = 0;
+	char * allocated = blastMemAlloc(data, sizeof(example), allocSize);
+	CPPUNIT_ASSERT(allocated != NULL);
+	CPPUNIT_ASSERT_EQUAL(std::string(exampleResult), std::string(allocated, allocSize));
+	free(allocated);
+}
+
+void BlastTest::outputSizeTest() {
+	
+	const char * data = reinterpret_cast<const char *>(example);
+	
+	char buffer[sizeof(exampleResult)];
+	
+	BlastMemOutBuffer exact(buffer, sizeof(exampleResult) - 1);
+	CPPUNIT_ASSERT_EQUAL(BLAST_SUCCESS, blastBuffer(data, sizeof(example), exact));
+	CPPUNIT_ASSERT_EQUAL(size_t(0), exact.size);
+	
+	BlastMemOutBuffer tooSmall(buffer, sizeof(exampleResult) - 2);
+	CPPUNIT_ASSERT_EQUAL(BLAST_OUTPUT_ERROR, blastBuffer(data, sizeof(example), tooSmall));
+	
+	BlastMemOutBuffer truncated(buffer, sizeof(buffer));
+	CPPUNIT_ASSERT_EQUAL(BLAST_TRUNCATED_INPUT, blastBuffer(data, sizeof(example) - 1, truncated));
+}
+
+void BlastTest::differentialTest() {
+	
+	TestRandom random(12345);
+	
+	// Truncated and corrupted versions of the example
+	for(size_t size = 0; size <= sizeof(example); size++) {
+		checkSame(std::vector<unsigned char>(example, example + size));
+	}
+	for(size_t i = 0; i < sizeof(example) * 8; i++) {
+		std::vector<unsigned char> input(example, example + sizeof(example));
+		input[i / 8] ^= (unsigned char)(1 << (i % 8));
+		checkSame(input);
+	}
+	
+	// Random data with a valid header exercises literals, copies and all error paths
+	for(size_t i = 0; i < 20000; i++) {
+		std::vector<unsigned char> input(2 + random.getIndex(512));
+		for(size_t j = 0; j < input.size(); j++) {
+			input[j] = (unsigned char)random.getIndex(256);
+		}
+		input[0] = (unsigned char)random.getIndex(2);
+		input[1] = (unsigned char)(4 + random.getIndex(3));
+		checkSame(input);
+	}
+	
+	// Completely random headers
+	for(size_t i = 0; i < 1000; i++) {
+		std::vector<unsigned char> input(1 + random.getIndex(16));
+		for(size_t j = 0; j < input.size(); j++) {
+			input[j] = (unsigned char)random.getIndex(256);
+		}
+		checkSame(input);
+	}
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tests/scene/LightBatchTest.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "src/graphics/Math.h"
+#include "src/scene/LightBatch.h"
+
+#include "tests/util/TestRandom.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(LightBatchTest);
+
+namespace {
+
+const float GLOBAL_LIGHT_FACTOR = 0.85f;
+
+struct TestLight {
+	Vec3f pos;
+	float fallstart;
+	float fallend;
+	float falldiffmul;
+	Color3f rgb255;
+	float intensity;
+};
+
+Color3f getColor(TestRandom & rng, float max) {
+	return Color3f(rng.get(0.f, max), rng.get(0.f, max), rng.get(0.f, max));
+}
+
+TestLight getLight(TestRandom & rng) {
+	TestLight light;
+	light.pos = rng.getVec(500.f);
+	light.fallstart = rng.get(0.f, 300.f);
+	light.fallend = light.fallstart + rng.get(10.f, 500.f);
+	light.falldiffmul = 1.f / (light.fallend - light.fallstart);
+	light.rgb255 = getColor(rng, 1.f) * 255.f;
+	light.intensity = rng.get(0.f, 2.f);
+	return light;
+}
+
+// The per-vertex lighting code that LightBatch replaced
+Color3f legacyApplyLight(const std::vector<TestLight> & lights, const glm::quat * quat,
+                         const Vec3f & position, const Vec3f & normal, Color3f tempColor,
+                         float materialDiffuse) {
+	
+	for(size_t l = 0; l < lights.size(); l++) {
+		const TestLight * light = &lights[l];
+		
+		Vec3f vLight = glm::normalize(light->pos - position);
+		
+		Vec3f Cur_vLights = quat ? glm::inverse(*quat) * vLight : vLight;
+		
+		float cosangle = glm::dot(normal, Cur_vLights);
+		
+		if(cosangle > 0.f) {
+			float distance = fdist(position, light->pos);
+			
+			if(distance <= light->fallstart) {
+				cosangle *= light->intensity * GLOBAL_LIGHT_FACTOR;
+			} else {
+				float p = ((light->fallend - distance) * light->falldiffmul);
+				
+				if(p <= 0.f)
+					cosangle = 0.f;
+				else
+					cosangle *= p * (light->intensity * GLOBAL_LIGHT_FACTOR);
+			}
+			
+			cosangle *= materialDiffuse;
+			
+			tempColor += light->rgb255 * cosangle;
+		}
+	}
+	
+	return tempColor;
+}
+
+ColorRGBA legacyFinish(Color3f tempColor, const Color3f & factor, const Color3f & term) {
+	
+	tempColor *= factor;
+	tempColor += term;
+	
+	u8 ir = clipByte255(tempColor.r);
+	u8 ig = clipByte255(tempColor.g);
+	u8 ib = clipByte255(tempColor.b);
+	
+	return Color(ir, ig, ib, 255).toRGBA();
+}
+
+void prepare(LightBatch & batch, const std::vector<TestLight> & lights, size_t begin, size_t end,
+             float materialDiffuse) {
+	for(size_t i = begin; i < end; i++) {
+		const TestLight & light = lights[i];
+		float intensity = light.intensity * GLOBAL_LIGHT_FACTOR * materialDiffuse;
+		batch.add(light.pos, light.fallstart, light.fallend, light.falldiffmul,
+		          light.rgb255 * intensity);
+	}
+}
+
+// Each channel may differ by rounding the final value differently
+void checkClose(ColorRGBA expected, ColorRGBA actual) {
+	Color e = Color::fromRGBA(expected);
+	Color a = Color::fromRGBA(actual);
+	CPPUNIT_ASSERT(std::abs(int(e.r) - int(a.r)) <= 1);
+	CPPUNIT_ASSERT(std::abs(int(e.g) - int(a.g)) <= 1);
+	CPPUNIT_ASSERT(std::abs(int(e.b) - int(a.b)) <= 1);
+	CPPUNIT_ASSERT_EQUAL(int(e.a), int(a.a));
+}
+
+} // anonymous namespace
+
+void LightBatchTest::objectLightingTest() {
+	
+	TestRandom rng(12345);
+	
+	for(size_t i = 0; i < 200; i++) {
+		
+		std::vector<TestLight> lights(size_t(rng.get(0.f, 19.f)));
+		for(size_t l = 0; l < lights.size(); l++) {
+			lights[l] = getLight(rng);
+		}
+		
+		float materialDiffuse = (i % 2) ? 0.5f : 1.f;
+		Color3f ambient = getColor(rng, 64.f);
+		Color3f factor = getColor(rng, 2.f);
+		Color3f term = getColor(rng, 32.f);
+		
+		LightBatch batch;
+		prepare(batch, lights, 0, lights.size(), materialDiffuse);
+		batch.setColorMod(factor, term);
+		
+		for(size_t j = 0; j < 10; j++) {
+			
+			glm::quat rotation = rng.getRotation();
+			batch.setRotation(rotation);
+			
+			for(size_t k = 0; k < 50; k++) {
+				
+				Vec3f position = rng.getVec(500.f);
+				Vec3f normal = rng.getNormal();
+				
+				Color3f expected = legacyApplyLight(lights, &rotation, position, normal, ambient,
+				                                    materialDiffuse);
+				checkClose(legacyFinish(expected, factor, term), batch.apply(position, normal, ambient));
+			}
+		}
+	}
+}
+
+void LightBatchTest::tileLightingTest() {
+	
+	TestRandom rng(54321);
+	
+	for(size_t i = 0; i < 200; i++) {
+		
+		// Tiles may have more lights than fit into one batch
+		std::vector<TestLight> lights(size_t(rng.get(1.f, 80.f)));
+		for(size_t l = 0; l < lights.size(); l++) {
+			lights[l] = getLight(rng);
+		}
+		
+		for(size_t k = 0; k < 50; k++) {
+			
+			Vec3f position = rng.getVec(500.f);
+			Vec3f normal = rng.getNormal();
+			Color3f base = getColor(rng, 255.f);
+			
+			Color3f expected = legacyApplyLight(lights, NULL, position, normal, base, 0.5f);
+			
+			LightBatch batch;
+			Color3f actual = base;
+			for(size_t begin = 0; begin < lights.size(); begin += LightBatch::Capacity) {
+				batch.clear();
+				prepare(batch, lights, begin, std::min(begin + LightBatch::Capacity, lights.size()), 0.5f);
+				actual = batch.accumulate(position, normal, actual);
+			}
+			
+			checkClose(legacyFinish(expected, Color3f::white, Color3f::black), batch.finish(actual));
+		}
+	}
+}
+
+void LightBatchTest::arrayTest() {
+	
+	TestRandom rng(42);
+	
+	std::vector<TestLight> lights(LightBatch::Capacity);
+	for(size_t l = 0; l < lights.size(); l++) {
+		lights[l] = getLight(rng);
+	}
+	
+	LightBatch batch;
+	prepare(batch, lights, 0, lights.size(), 1.f);
+	CPPUNIT_ASSERT(batch.full());
+	batch.setRotation(rng.getRotation());
+	
+	std::vector<Vec3f> positions(1000);
+	std::vector<Vec3f> normals(positions.size());
+	for(size_t i = 0; i < positions.size(); i++) {
+		positions[i] = rng.getVec(500.f);
+		normals[i] = rng.getNormal();
+	}
+	
+	Color3f ambient(10.f, 20.f, 30.f);
+	std::vector<ColorRGBA> colors(positions.size());
+	batch.apply(&positions[0], &normals[0], positions.size(), ambient, &colors[0]);
+	
+	for(size_t i = 0; i < positions.size(); i++) {
+		CPPUNIT_ASSERT_EQUAL(u32(batch.apply(positions[i], normals[i], ambient)), u32(colors[i]));
+	}
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "tests/script/ScriptLabelsTest.h"
+
+#include <string>
+#include <vector>
+
+#include "src/script/Script.h"
+
+#include "tests/util/TestRandom.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ScriptLabelsTest);
+
+namespace {
+
+// Fragments chosen so that random scripts hit handlers and labels inside comments,
+// repeated names, names that prefix other names and names at the end of the data
+const char * const fragments[] = {
+	"on ", ">>", ">", "/", "//", "\n", " ", "\t", "\r\n",
+	"a", "b", "ab", "on", "o", "n", "main", "init", "x>>y", "accept",
+};
+const size_t fragmentCount = sizeof(fragments) / sizeof(*fragments);
+
+const char * const names[] = {
+	"a", "b", "ab", "ba", "aa", "on", "o", "n", "main", "init", ">", ">a", "/", "//a", "a//", "y",
+	"mainmain", "accept", "onmain",
+};
+const size_t nameCount = sizeof(names) / sizeof(*names);
+
+struct TestScript {
+	
+	std::string text;
+	EERIE_SCRIPT es;
+	
+	explicit TestScript(const std::string & source) : text(source) {
+		es.data = text.empty() ? NULL : &text[0];
+		es.size = text.size();
+		ARX_SCRIPT_ComputeLabels(es);
+	}
+	
+};
+
+void checkSame(const std::string & text) {
+	
+	TestScript script(text);
+	
+	for(size_t i = 0; i < nameCount; i++) {
+		
+		std::string name = names[i];
+		
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(text, FindScriptPos(&script.es, "on " + name),
+		                             FindScriptEvent(&script.es, name));
+		
+		CPPUNIT_ASSERT_EQUAL_MESSAGE(text, FindScriptPos(&script.es, ">>" + name),
+		                             FindScriptLabel(&script.es, name));
+	}
+}
+
+} // anonymous namespace
+
+void ScriptLabelsTest::exampleTest() {
+	
+	TestScript script("on init {\n"
+	                  "  // on main {\n"
+	                  "  gosub a //>>b\n"
+	                  "}\n"
+	                  "on main {\n"
+	                  "  accept\n"
+	                  "}\n"
+	                  ">>a\n"
+	                  ">>a accept\n"
+	                  ">>b\n"
+	                  "on mainx {\n"
+	                  ">>c");
+	
+	CPPUNIT_ASSERT_EQUAL(0l, FindScriptEvent(&script.es, "init"));
+	CPPUNIT_ASSERT_EQUAL(long(script.text.find("on main {\n  a")), FindScriptEvent(&script.es, "main"));
+	CPPUNIT_ASSERT_EQUAL(long(script.text.find("on mainx")), FindScriptEvent(&script.es, "mainx"));
+	CPPUNIT_ASSERT_EQUAL(-1l, FindScriptEvent(&script.es, "mai"));
+	
+	CPPUNIT_ASSERT_EQUAL(long(script.text.find(">>a\n")), FindScriptLabel(&script.es, "a"));
+	CPPUNIT_ASSERT_EQUAL(long(script.text.find(">>b\non")), FindScriptLabel(&script.es, "b"));
+	CPPUNIT_ASSERT_EQUAL(-1l, FindScriptLabel(&script.es, "c"));
+	
+	checkSame(script.text);
+	checkSame(std::string());
+}
+
+void ScriptLabelsTest::differentialTest() {
+	
+	TestRandom random(17);
+	
+	for(size_t i = 0; i < 20000; i++) {
+		
+		std::string text;
+		size_t count = random.getIndex(40);
+		for(size_t j = 0; j < count; j++) {
+			text += fragments[random.getIndex(fragmentCount)];
+		}
+		
+		checkSame(text);
+	}
+}
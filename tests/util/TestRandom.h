@@ -0,0 +1,80 @@
+/*
+ * Copyright 2015 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_TESTS_UTIL_TESTRANDOM_H
+#define ARX_TESTS_UTIL_TESTRANDOM_H
+
+#include <cstring>
+
+#include "src/math/Types.h"
+
+//! Simple deterministic generator so that failures can be reproduced
+class TestRandom {
+	
+	unsigned long long state;
+	
+	unsigned long long next() {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		return state;
+	}
+	
+public:
+	
+	explicit TestRandom(unsigned long long seed) : state(seed) { }
+	
+	//! \return an integer in [0, count)
+	unsigned getIndex(unsigned count) {
+		return unsigned(next() >> 33) % count;
+	}
+	
+	//! \return true with the given probability
+	bool getChance(unsigned percent) {
+		return getIndex(100) < percent;
+	}
+	
+	//! \return a float in [min, max)
+	float get(float min, float max) {
+		return min + (max - min) * float(unsigned(next() >> 40)) / float(1 << 24);
+	}
+	
+	Vec3f getVec(float range) {
+		return Vec3f(get(-range, range), get(-range, range), get(-range, range));
+	}
+	
+	Vec3f getNormal() {
+		Vec3f v;
+		do {
+			v = getVec(1.f);
+		} while(glm::dot(v, v) < 0.01f);
+		return glm::normalize(v);
+	}
+	
+	glm::quat getRotation() {
+		glm::quat q(get(-1.f, 1.f), get(-1.f, 1.f), get(-1.f, 1.f), get(-1.f, 1.f));
+		return glm::normalize(q);
+	}
+	
+};
+
+//! Compare vectors including the sign of zero and NaN payloads
+inline bool bitEqual(const Vec3f & a, const Vec3f & b) {
+	return std::memcmp(&a, &b, sizeof(Vec3f)) == 0;
+}
+
+#endif // ARX_TESTS_UTIL_TESTRANDOM_H
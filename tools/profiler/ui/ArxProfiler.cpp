@@ -100,6 +100,14 @@ void ArxProfiler::openFile() {
 	}
 	
 	while(filePos < fileData.size()){
+		
+		// Captures are streamed to disk, so the last chunk may be incomplete
+		// if the game did not exit cleanly - keep whatever was read before it.
+		if(fileData.size() - filePos < int(sizeof(SavedProfilerChunkHeader))) {
+			qWarning() << "Truncated chunk header at offset" << filePos;
+			break;
+		}
+		
 		SavedProfilerChunkHeader chunk;
 		readStruct(chunk, fileData, filePos);
 		
@@ -108,7 +116,7 @@ void ArxProfiler::openFile() {
 		QByteArray chunkData = fileData.mid(filePos, chunkSize);
 		if(chunkData.size() != chunkSize) {
 			qWarning() << "Chunk too short, expected" << chunkSize << "got" << chunkData.size();
-			return;
+			break;
 		}
 			
 		filePos += chunkData.size();
@@ -22,6 +22,7 @@
 #include "io/SaveBlock.h"
 #include "io/fs/Filesystem.h"
 #include "io/log/Logger.h"
+#include "platform/Time.h"
 
 #include "savetool/SaveFix.h"
 #include "savetool/SaveRename.h"
@@ -122,6 +123,8 @@ int main(int argc, char ** argv) {
 	
 	Logger::initialize();
 	
+	platform::initializeTime();
+	
 	if(argc < 3) {
 		print_help();
 		return 1;